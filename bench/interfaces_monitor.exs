@@ -0,0 +1,105 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+# Replay benchmark for VintageNet.InterfacesMonitor
+#
+# This sends a dump for 1,000 interfaces to the running InterfacesMonitor the
+# same way that if_monitor would and times how long it takes to process. Each
+# interface has one IPv4 address and several IPv6 addresses. The dump is sent
+# a second time to simulate IPv6 lifetime refreshes and then all of the
+# interfaces are removed.
+#
+# Run it with:
+#
+#   mix run bench/interfaces_monitor.exs [interfaces] [ipv6 addresses per interface]
+
+alias VintageNet.InterfacesMonitor
+
+{interface_count, ipv6_count} =
+  case Enum.map(System.argv(), &String.to_integer/1) do
+    [interfaces, ipv6] -> {interfaces, ipv6}
+    [interfaces] -> {interfaces, 8}
+    [] -> {1000, 8}
+  end
+
+# if_monitor batches reports from each netlink read
+batch_size = 64
+
+# Use ifindexes that won't collide with real interfaces
+first_ifindex = 100_000
+
+ifindexes = first_ifindex..(first_ifindex + interface_count - 1)
+
+ifname = fn ifindex -> "bench#{ifindex - first_ifindex}" end
+
+links =
+  for ifindex <- ifindexes do
+    {:newlink, ifname.(ifindex), ifindex,
+     %{lower_up: true, mac_address: "02:42:ac:11:00:00", mtu: 1500, type: :ethernet, up: true}}
+  end
+
+addresses =
+  for ifindex <- ifindexes, n <- 0..ipv6_count do
+    index = ifindex - first_ifindex
+
+    if n == 0 do
+      {:newaddr, ifindex,
+       %{
+         address: {10, div(index, 256), rem(index, 256), 1},
+         family: :inet,
+         label: ifname.(ifindex),
+         local: {10, div(index, 256), rem(index, 256), 1},
+         permanent: true,
+         prefixlen: 24,
+         scope: :universe
+       }}
+    else
+      {:newaddr, ifindex,
+       %{
+         address: {0x2001, 0xDB8, index, 0, 0, 0, 0, n},
+         family: :inet6,
+         permanent: false,
+         prefixlen: 64,
+         scope: :universe
+       }}
+    end
+  end
+
+dellinks = for ifindex <- ifindexes, do: {:dellink, ifname.(ifindex), ifindex, %{}}
+
+replay = fn reports ->
+  port = :sys.get_state(InterfacesMonitor).port
+
+  {micros, _} =
+    :timer.tc(fn ->
+      reports
+      |> Enum.chunk_every(batch_size)
+      |> Enum.each(&send(InterfacesMonitor, {port, {:data, :erlang.term_to_binary(&1)}}))
+
+      # Wait for everything to be processed
+      :sys.get_state(InterfacesMonitor)
+    end)
+
+  IO.puts(
+    "  #{length(reports)} reports in #{div(micros, 1000)} ms " <>
+      "(#{Float.round(micros / length(reports), 2)} us/report)"
+  )
+end
+
+IO.puts("#{interface_count} interfaces with 1 IPv4 and #{ipv6_count} IPv6 addresses each")
+IO.puts("Initial dump:")
+replay.(links ++ addresses)
+IO.puts("Repeated addresses:")
+replay.(addresses)
+IO.puts("force_clear_ipv4_addresses on every interface:")
+
+{micros, _} =
+  :timer.tc(fn ->
+    Enum.each(ifindexes, &InterfacesMonitor.force_clear_ipv4_addresses(ifname.(&1)))
+  end)
+
+IO.puts("  #{interface_count} calls in #{div(micros, 1000)} ms")
+IO.puts("Removing interfaces:")
+replay.(dellinks)
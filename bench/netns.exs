@@ -0,0 +1,487 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+# End-to-end benchmark in a network namespace
+#
+# Unlike the unit tests and bench/interfaces_monitor.exs, this runs VintageNet
+# against a real kernel. Interfaces are changed with a long running
+# `ip -batch -` so that starting `ip` isn't counted, and the time until
+# VintageNet reports each change is measured. The scenarios are:
+#
+# * create - add interfaces all at once and wait for their `"present"`
+#   properties and then delete them
+# * address_churn - add and remove IPv4 addresses one at a time and wait for
+#   the `"addresses"` property to change
+# * carrier_flap - take the peer of a veth down and up and wait for
+#   `"lower_up"` to change
+# * failover - configure two uplinks, take the carrier of the preferred one
+#   down and wait for `"lower_up"`, `"connection"` and the default route to
+#   move to the other uplink. Then wait for it to move back.
+#
+# Interfaces are dummy interfaces when the kernel supports them and veth
+# pairs otherwise. The `[:vintage_net, :interfaces_monitor, :batch]` and
+# `[:vintage_net, :route_manager, :update]` telemetry events are collected
+# too. Times are in microseconds. A summary is printed and all of the results
+# are written as JSON to the `--output` file.
+#
+# This needs to be run in a new network namespace. Run it with:
+#
+#   bench/netns.sh [--interfaces 1000] [--churn 1000] [--flaps 200]
+#                  [--failovers 20] [--output netns_bench.json]
+
+defmodule NetnsBench.Technology do
+  @moduledoc false
+
+  # Static IPv4 configuration without any tools besides VintageNet
+  @behaviour VintageNet.Technology
+
+  alias VintageNet.Interface.RawConfig
+  alias VintageNet.IP.IPv4Config
+
+  @impl VintageNet.Technology
+  def normalize(config), do: IPv4Config.normalize(config)
+
+  @impl VintageNet.Technology
+  def to_raw_config(ifname, config, opts) do
+    %RawConfig{
+      ifname: ifname,
+      type: __MODULE__,
+      source_config: config,
+      required_ifnames: [ifname]
+    }
+    |> IPv4Config.add_config(config, opts)
+  end
+
+  @impl VintageNet.Technology
+  def ioctl(_ifname, _command, _args), do: {:error, :unsupported}
+
+  @impl VintageNet.Technology
+  def check_system(_opts), do: :ok
+end
+
+defmodule NetnsBench do
+  @moduledoc false
+
+  @timeout_ms 30_000
+
+  @telemetry_events [
+    [:vintage_net, :interfaces_monitor, :batch],
+    [:vintage_net, :route_manager, :update]
+  ]
+
+  def run(argv) do
+    {opts, _args} =
+      OptionParser.parse!(argv,
+        strict: [
+          interfaces: :integer,
+          churn: :integer,
+          flaps: :integer,
+          failovers: :integer,
+          output: :string
+        ]
+      )
+
+    check_namespace()
+    start_vintage_net()
+
+    ip = open_ip()
+    kind = interface_kind()
+    telemetry = start_telemetry()
+
+    IO.puts("Using #{kind} interfaces")
+
+    scenarios = %{
+      create: create(ip, kind, telemetry, Keyword.get(opts, :interfaces, 1000)),
+      address_churn: address_churn(ip, kind, telemetry, Keyword.get(opts, :churn, 1000)),
+      carrier_flap: carrier_flap(ip, telemetry, Keyword.get(opts, :flaps, 200)),
+      failover: failover(ip, telemetry, Keyword.get(opts, :failovers, 20))
+    }
+
+    results = %{
+      system: %{
+        otp_release: to_string(:erlang.system_info(:otp_release)),
+        elixir: System.version(),
+        kernel: :os.version() |> Tuple.to_list() |> Enum.join("."),
+        interface_kind: kind
+      },
+      scenarios: scenarios
+    }
+
+    output = Keyword.get(opts, :output, "netns_bench.json")
+    File.write!(output, [json(results), "\n"])
+    IO.puts("Results written to #{output}")
+  end
+
+  # Don't create hundreds of interfaces on a real system
+  defp check_namespace() do
+    {links, 0} = System.cmd("ip", ["-o", "link", "show"])
+
+    if length(String.split(links, "\n", trim: true)) != 1 do
+      IO.puts(:stderr, "Run this in a new network namespace with bench/netns.sh")
+      System.halt(1)
+    end
+  end
+
+  # The unit test configuration fakes the tools and doesn't change routes
+  defp start_vintage_net() do
+    tmp_dir = Path.join(System.tmp_dir!(), "vintage_net_netns_bench")
+
+    Application.load(:vintage_net)
+    Application.put_env(:vintage_net, :path, System.get_env("PATH"))
+    Application.put_env(:vintage_net, :native_routes, true)
+    Application.put_env(:vintage_net, :power_managers, [])
+    Application.put_env(:vintage_net, :tmpdir, Path.join(tmp_dir, "tmp"))
+    Application.put_env(:vintage_net, :persistence_dir, Path.join(tmp_dir, "persistence"))
+    Application.put_env(:vintage_net, :resolvconf, "/dev/null")
+
+    {:ok, _} = Application.ensure_all_started(:vintage_net)
+
+    # Wait for the initial report of the interfaces
+    {:ok, _routes} = VintageNet.InterfacesMonitor.observed_routes()
+  end
+
+  defp open_ip() do
+    Port.open({:spawn_executable, System.find_executable("ip")}, [
+      {:args, ["-force", "-batch", "-"]},
+      :binary,
+      :exit_status
+    ])
+  end
+
+  defp ip(port, commands) do
+    Port.command(port, Enum.map(List.wrap(commands), &[&1, "\n"]))
+  end
+
+  # Run an `ip` command and wait for it to finish
+  defp ip!(args) do
+    {_, 0} = System.cmd("ip", args, stderr_to_stdout: true)
+    :ok
+  end
+
+  defp interface_kind() do
+    probe = String.split(add_link("dummy", "benchprobe"))
+
+    case System.cmd("ip", probe, stderr_to_stdout: true) do
+      {_, 0} ->
+        ip!(["link", "del", "benchprobe"])
+        "dummy"
+
+      _ ->
+        "veth"
+    end
+  end
+
+  defp add_link("dummy", ifname), do: "link add #{ifname} type dummy"
+  defp add_link("veth", ifname), do: "link add #{ifname} type veth peer name #{ifname}p"
+
+  defp create(ip, kind, telemetry, count) do
+    IO.puts("create: #{count} interfaces")
+    ifnames = for i <- 0..(count - 1), do: "bench#{i}"
+
+    VintageNet.subscribe(["interface", :_, "present"])
+
+    start = now()
+    ip(ip, Enum.map(ifnames, &add_link(kind, &1)))
+    created = await(Map.new(ifnames, &{["interface", &1, "present"], fn v -> v == true end}))
+
+    start2 = now()
+    ip(ip, Enum.map(ifnames, &"link del #{&1}"))
+    deleted = await(Map.new(ifnames, &{["interface", &1, "present"], fn v -> v == nil end}))
+
+    VintageNet.unsubscribe(["interface", :_, "present"])
+
+    %{
+      count: count,
+      create: timings(created, start, count),
+      delete: timings(deleted, start2, count),
+      telemetry: take_telemetry(telemetry)
+    }
+    |> report("create")
+  end
+
+  defp address_churn(ip, kind, telemetry, count) do
+    IO.puts("address_churn: #{count} addresses")
+    ip!(String.split(add_link(kind, "churn0")))
+    ip!(["link", "set", "churn0", "up"])
+
+    property = ["interface", "churn0", "addresses"]
+    VintageNet.subscribe(property)
+
+    {adds, dels} =
+      Enum.reduce(0..(count - 1), {[], []}, fn i, {adds, dels} ->
+        address = {10, div(i, 256), rem(i, 256), 1}
+        cidr = "#{:inet.ntoa(address)}/32"
+
+        start = now()
+        ip(ip, "addr add #{cidr} dev churn0")
+        added = await(%{property => &has_address?(&1, address)})
+
+        start2 = now()
+        ip(ip, "addr del #{cidr} dev churn0")
+        deleted = await(%{property => &(not has_address?(&1, address))})
+
+        {[elapsed(added, property, start) | adds], [elapsed(deleted, property, start2) | dels]}
+      end)
+
+    VintageNet.unsubscribe(property)
+    ip!(["link", "del", "churn0"])
+
+    %{
+      count: count,
+      add: stats(adds),
+      delete: stats(dels),
+      telemetry: take_telemetry(telemetry)
+    }
+    |> report("address_churn")
+  end
+
+  defp has_address?(addresses, address) do
+    Enum.any?(addresses || [], &(&1.address == address))
+  end
+
+  defp carrier_flap(ip, telemetry, count) do
+    IO.puts("carrier_flap: #{count} flaps")
+    property = ["interface", "flap0", "lower_up"]
+    VintageNet.subscribe(property)
+
+    add_veth("flap0")
+    await(%{property => &(&1 == true)})
+
+    {downs, ups} =
+      Enum.reduce(1..count, {[], []}, fn _, {downs, ups} ->
+        start = now()
+        ip(ip, "link set flap0p down")
+        down = await(%{property => &(&1 == false)})
+
+        start2 = now()
+        ip(ip, "link set flap0p up")
+        up = await(%{property => &(&1 == true)})
+
+        {[elapsed(down, property, start) | downs], [elapsed(up, property, start2) | ups]}
+      end)
+
+    VintageNet.unsubscribe(property)
+    ip!(["link", "del", "flap0"])
+
+    %{
+      count: count,
+      carrier_down: stats(downs),
+      carrier_up: stats(ups),
+      telemetry: take_telemetry(telemetry)
+    }
+    |> report("carrier_flap")
+  end
+
+  defp failover(ip, telemetry, count) do
+    IO.puts("failover: #{count} failovers")
+    uplinks = [{"up0", "192.168.10"}, {"up1", "192.168.11"}]
+
+    VintageNet.subscribe(["available_interfaces"])
+
+    for {ifname, subnet} <- uplinks do
+      add_veth(ifname)
+
+      :ok =
+        VintageNet.configure(
+          ifname,
+          %{
+            type: NetnsBench.Technology,
+            ipv4: %{
+              method: :static,
+              address: "#{subnet}.2",
+              prefix_length: 24,
+              gateway: "#{subnet}.1"
+            }
+          },
+          persist: false
+        )
+    end
+
+    ifnames = Enum.map(uplinks, &elem(&1, 0))
+    await(%{["available_interfaces"] => &(Enum.sort(&1 || []) == ifnames)})
+    [primary, backup] = VintageNet.get(["available_interfaces"])
+
+    lower_up = ["interface", primary, "lower_up"]
+    connection = ["interface", primary, "connection"]
+    VintageNet.subscribe(lower_up)
+    VintageNet.subscribe(connection)
+
+    runs =
+      for _ <- 1..count do
+        start = now()
+        ip(ip, "link set #{primary}p down")
+
+        down =
+          await(%{
+            lower_up => &(&1 == false),
+            connection => &(&1 == :disconnected),
+            ["available_interfaces"] => &(&1 == [backup])
+          })
+
+        start2 = now()
+        ip(ip, "link set #{primary}p up")
+        up = await(%{["available_interfaces"] => &(&1 == [primary, backup])})
+
+        %{
+          lower_up: elapsed(down, lower_up, start),
+          connection: elapsed(down, connection, start),
+          route: elapsed(down, ["available_interfaces"], start),
+          failback: elapsed(up, ["available_interfaces"], start2)
+        }
+      end
+
+    VintageNet.unsubscribe(lower_up)
+    VintageNet.unsubscribe(connection)
+    VintageNet.unsubscribe(["available_interfaces"])
+
+    for ifname <- ifnames do
+      VintageNet.deconfigure(ifname, persist: false)
+      ip!(["link", "del", ifname])
+    end
+
+    %{
+      count: count,
+      primary: primary,
+      lower_up: stats(Enum.map(runs, & &1.lower_up)),
+      connection: stats(Enum.map(runs, & &1.connection)),
+      route: stats(Enum.map(runs, & &1.route)),
+      failback: stats(Enum.map(runs, & &1.failback)),
+      telemetry: take_telemetry(telemetry)
+    }
+    |> report("failover")
+  end
+
+  defp add_veth(ifname) do
+    ip!(["link", "add", ifname, "type", "veth", "peer", "name", "#{ifname}p"])
+    ip!(["link", "set", "#{ifname}p", "up"])
+    ip!(["link", "set", ifname, "up"])
+  end
+
+  # Wait for properties to have values and return when each one did.
+  # Properties that don't get them before the timeout are missing.
+  defp await(conditions) do
+    await(conditions, %{}, now() + @timeout_ms * 1000)
+  end
+
+  defp await(conditions, arrivals, _deadline) when conditions == %{}, do: arrivals
+
+  defp await(conditions, arrivals, deadline) do
+    receive do
+      {VintageNet, property, _old_value, value, _meta} ->
+        arrived = now()
+
+        case Map.fetch(conditions, property) do
+          {:ok, done?} ->
+            if done?.(value) do
+              arrivals = Map.put(arrivals, property, arrived)
+              await(Map.delete(conditions, property), arrivals, deadline)
+            else
+              await(conditions, arrivals, deadline)
+            end
+
+          :error ->
+            await(conditions, arrivals, deadline)
+        end
+    after
+      max(0, div(deadline - now(), 1000)) -> arrivals
+    end
+  end
+
+  defp elapsed(arrivals, property, start) do
+    case Map.fetch(arrivals, property) do
+      {:ok, arrived} -> arrived - start
+      :error -> nil
+    end
+  end
+
+  # Time until each property arrived and until the last one did
+  defp timings(arrivals, start, count) do
+    times = arrivals |> Map.values() |> Enum.map(&(&1 - start))
+
+    stats(times ++ List.duplicate(nil, count - length(times)))
+    |> Map.put(:total, Enum.max(times, fn -> nil end))
+  end
+
+  defp stats(times) do
+    sorted = times |> Enum.reject(&is_nil/1) |> Enum.sort()
+    n = length(sorted)
+
+    summary = %{count: n, timeouts: length(times) - n}
+
+    if n > 0 do
+      Map.merge(summary, %{
+        min: hd(sorted),
+        p50: percentile(sorted, n, 0.5),
+        p90: percentile(sorted, n, 0.9),
+        p99: percentile(sorted, n, 0.99),
+        max: List.last(sorted),
+        mean: div(Enum.sum(sorted), n)
+      })
+    else
+      summary
+    end
+  end
+
+  defp percentile(sorted, n, q), do: Enum.at(sorted, max(ceil(q * n) - 1, 0))
+
+  defp now(), do: System.monotonic_time(:microsecond)
+
+  # Collect telemetry in another process so that waiting for properties
+  # doesn't have to skip over it
+  defp start_telemetry() do
+    {:ok, agent} = Agent.start_link(fn -> [] end)
+    handler = &__MODULE__.handle_telemetry/4
+    :telemetry.attach_many("netns-bench", @telemetry_events, handler, agent)
+    agent
+  end
+
+  def handle_telemetry(event, measurements, _metadata, agent) do
+    Agent.cast(agent, &[{event, measurements} | &1])
+  end
+
+  defp take_telemetry(agent) do
+    events = Agent.get_and_update(agent, &{Enum.reverse(&1), []})
+    batches = for {[_, :interfaces_monitor, :batch], m} <- events, do: m
+    updates = for {[_, :route_manager, :update], m} <- events, do: m
+
+    %{
+      batches: length(batches),
+      reports: batches |> Enum.map(& &1.reports) |> Enum.sum(),
+      batch_latency: stats(for %{latency: latency} <- batches, do: usec(latency)),
+      batch_update: stats(Enum.map(batches, &usec(&1.update_duration))),
+      route_update: stats(Enum.map(updates, &usec(&1.duration)))
+    }
+  end
+
+  defp usec(native), do: System.convert_time_unit(native, :native, :microsecond)
+
+  defp report(results, name) do
+    for {key, %{p50: p50, p99: p99, max: max} = stats} <- results do
+      IO.puts(
+        "  #{name}.#{key}: p50 #{p50} us, p99 #{p99} us, max #{max} us" <>
+          if(stats.timeouts > 0, do: ", #{stats.timeouts} timeouts", else: "")
+      )
+    end
+
+    results
+  end
+
+  # Just enough JSON for the results
+  defp json(map) when is_map(map) do
+    members = Enum.map(map, fn {key, value} -> [json(to_string(key)), ":", json(value)] end)
+    ["{", Enum.intersperse(members, ","), "}"]
+  end
+
+  defp json(list) when is_list(list) do
+    ["[", Enum.intersperse(Enum.map(list, &json/1), ","), "]"]
+  end
+
+  defp json(nil), do: "null"
+  defp json(value) when is_boolean(value) or is_number(value), do: to_string(value)
+  defp json(value) when is_atom(value), do: json(to_string(value))
+  defp json(value) when is_binary(value), do: inspect(value)
+end
+
+NetnsBench.run(System.argv())
@@ -0,0 +1,20 @@
+#!/bin/sh
+
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+
+# Run bench/netns.exs in a new user and network namespace
+#
+# This doesn't need root and doesn't touch the host's interfaces. Arguments
+# are passed to bench/netns.exs.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+# Compile first since the namespace has no network access for dependencies
+mix compile
+
+exec unshare --user --map-root-user --net -- \
+    sh -c 'ip link set lo up && exec mix run --no-start bench/netns.exs "$@"' netns.sh "$@"
@@ -16,6 +16,12 @@ import Config
 # * resolvconf: don't update the real resolv.conf
 # * path: limit search for tools to our test harness
 # * persistence_dir: use the current directory
+# * native_routes: don't modify the real interfaces or routing tables
+# * native_dhcp: don't run DHCP on the real interfaces
+# * native_lease_watcher: parse udhcpd lease files on notify
+# * native_spawn: only run commands with the spawner in its own tests
+# * native_prober: only probe with the port in its own tests
+# * native_sock_diag: only check Erlang's sockets for Internet traffic
 # * power_managers: register a manager for test0 so that tests
 #      that need to validate power management calls can use it.
 #
@@ -30,6 +36,12 @@ config :vintage_net,
   resolvconf: "/dev/null",
   path: "#{File.cwd!()}/test/fixtures/root/bin",
   persistence_dir: "./test_tmp/persistence",
+  native_routes: false,
+  native_dhcp: false,
+  native_lease_watcher: false,
+  native_spawn: false,
+  native_prober: false,
+  native_sock_diag: false,
   power_managers: [
     {VintageNetTest.TestPowerManager, [ifname: "test0", watchdog_timeout: 50]},
     {VintageNetTest.BadPowerManager, [ifname: "bad_power0"]},
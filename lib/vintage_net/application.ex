@@ -23,20 +23,31 @@ defmodule VintageNet.Application do
     # property table
     properties = load_initial_configurations() |> Enum.map(&config_to_property/1)
 
-    children = [
-      {PropertyTable, properties: properties, name: VintageNet, tuple_events: true},
-      {VintageNet.PredictableInterfaceName, hw_path_ifnames},
-      VintageNet.PowerManager.Supervisor,
-      {BEAMNotify,
-       name: "vintage_net_comm",
-       report_env: true,
-       dispatcher: &VintageNet.OSEventDispatcher.dispatch/2},
-      VintageNet.InterfacesMonitor,
-      {VintageNet.NameResolver, args},
-      {VintageNet.RouteManager, args},
-      {Registry, keys: :unique, name: VintageNet.Interface.Registry},
-      VintageNet.InterfacesSupervisor
-    ]
+    children =
+      [
+        {PropertyTable, properties: properties, name: VintageNet, tuple_events: true},
+        VintageNet.Command.Spawner,
+        {VintageNet.PredictableInterfaceName, hw_path_ifnames},
+        VintageNet.PowerManager.Supervisor,
+        {BEAMNotify,
+         name: "vintage_net_comm",
+         report_env: true,
+         dispatcher: &VintageNet.OSEventDispatcher.dispatch/2},
+        VintageNet.DHCP.EventChannel,
+        VintageNet.DHCP.Client,
+        VintageNet.DHCP.LeaseWatcher,
+        VintageNet.InterfacesMonitor,
+        VintageNet.NetlinkCtl,
+        {VintageNet.Resolver.DNSCache, args},
+        {VintageNet.NameResolver, args},
+        {VintageNet.RouteManager, args},
+        VintageNet.Connectivity.SockDiag,
+        VintageNet.Connectivity.Prober,
+        {Registry, keys: :unique, name: VintageNet.Interface.Registry}
+      ] ++
+        # Interfaces save configurations, so persistence stops after them
+        Persistence.child_specs(args) ++
+        [VintageNet.InterfacesSupervisor]
 
     opts = [strategy: :rest_for_one, name: VintageNet.Supervisor]
     Supervisor.start_link(children, opts)
@@ -46,9 +57,15 @@ defmodule VintageNet.Application do
     # Get the default interface configurations
     default_configs = get_config_env() |> Map.new()
 
-    persisted_ifnames = Persistence.call(:enumerate, [])
+    start = System.monotonic_time(:microsecond)
 
-    configs = Enum.reduce(persisted_ifnames, default_configs, &load_and_merge_config/2)
+    configs =
+      Persistence.call(:enumerate, [])
+      |> Persistence.load_all()
+      |> Enum.reduce(default_configs, &merge_config/2)
+
+    elapsed = System.monotonic_time(:microsecond) - start
+    Logger.debug("VintageNet: loaded saved configurations in #{elapsed} us")
 
     Enum.map(configs, &normalize_config/1)
   end
@@ -89,15 +106,13 @@ defmodule VintageNet.Application do
     false
   end
 
-  defp load_and_merge_config(ifname, configs) do
-    case Persistence.call(:load, [ifname]) do
-      {:ok, config} ->
-        Map.put(configs, ifname, config)
+  defp merge_config({ifname, {:ok, config}}, configs) do
+    Map.put(configs, ifname, config)
+  end
 
-      {:error, reason} ->
-        Logger.warning("VintageNet(#{ifname}): ignoring saved config due to #{inspect(reason)}")
-        configs
-    end
+  defp merge_config({ifname, {:error, reason}}, configs) do
+    Logger.warning("VintageNet(#{ifname}): ignoring saved config due to #{inspect(reason)}")
+    configs
   end
 
   defp config_to_property({ifname, config}) do
@@ -7,6 +7,8 @@
 defmodule VintageNet.Command do
   @moduledoc false
 
+  alias VintageNet.Command.Spawner
+
   @doc """
   System.cmd wrapper to force paths
 
@@ -17,13 +19,15 @@ defmodule VintageNet.Command do
   exit status is returned with a message. `System.cmd/3` raises in this
   situation. This means that the caller needs to check the exit status if they
   care.
+
+  Commands are started by `VintageNet.Command.Spawner` if `:native_spawn` is enabled.
   """
   @spec cmd(Path.t(), [binary()], keyword()) ::
           {Collectable.t(), exit_status :: non_neg_integer()}
   def cmd(command, args, opts \\ []) when is_binary(command) do
     with {:ok, command_path} <- find_executable(command) do
       new_opts = force_path_env(opts)
-      System.cmd(command_path, args, new_opts)
+      spawn_cmd(command_path, args, new_opts, &System.cmd/3)
     end
   end
 
@@ -38,7 +42,7 @@ defmodule VintageNet.Command do
   def muon_cmd(command, args, opts \\ []) when is_binary(command) do
     with {:ok, command_path} <- find_executable(command) do
       new_opts = opts |> force_path_env() |> add_muon_options()
-      MuonTrap.cmd(command_path, args, new_opts)
+      spawn_cmd(command_path, args, new_opts, &MuonTrap.cmd/3)
     end
   end
 
@@ -53,6 +57,14 @@ defmodule VintageNet.Command do
     )
   end
 
+  # The spawner doesn't support options like cgroups, so it falls back then
+  defp spawn_cmd(command_path, args, opts, fallback) do
+    case Spawner.cmd(command_path, args, opts) do
+      :unavailable -> fallback.(command_path, args, opts)
+      result -> result
+    end
+  end
+
   defp find_executable("/" <> _ = path) do
     # User supplied the absolute path so
     # just check that it exists
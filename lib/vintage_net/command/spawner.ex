@@ -0,0 +1,219 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Command.Spawner do
+  @moduledoc false
+
+  # Run commands with the `spawner` port
+  #
+  # `System.cmd/3` and `MuonTrap.cmd/3` fork the BEAM for each command, and
+  # that gets slower as the BEAM gets bigger. The port is small, so it starts
+  # commands quickly with vfork and runs as many at once as are requested.
+  #
+  # Like MuonTrap, commands are killed when the caller exits or the port exits.
+  # Each command runs in its own process group so that anything that it starts
+  # gets killed too. Commands that need options that the port doesn't support,
+  # like cgroups from `:muontrap_options`, still go to `System.cmd/3` or
+  # `MuonTrap.cmd/3`.
+  #
+  # `VintageNet.Command` only uses this if the `:native_spawn` application
+  # environment key is `true` and the port was built.
+
+  use GenServer
+  require Logger
+
+  @supported_options [:env, :into, :stderr_to_stdout]
+
+  # Exit status when the port exits while running a command. The port's
+  # children get SIGKILL then.
+  @killed_status 128 + 9
+
+  @typedoc """
+  Spawn statistics
+
+  * `:spawns` - number of commands started
+  * `:last_spawn_usec` - how long it took to start the last command
+  * `:max_spawn_usec` - how long it took to start the slowest command
+  """
+  @type stats() :: %{
+          spawns: non_neg_integer(),
+          last_spawn_usec: non_neg_integer() | nil,
+          max_spawn_usec: non_neg_integer()
+        }
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Return whether commands should be run by the port
+  """
+  @spec available?() :: boolean()
+  def available?() do
+    Application.get_env(:vintage_net, :native_spawn, false) and File.exists?(executable())
+  end
+
+  @doc """
+  Run a command like `System.cmd/3`
+
+  `:unavailable` is returned if the port isn't running or if it doesn't
+  support the options.
+  """
+  @spec cmd(Path.t(), [binary()], keyword()) ::
+          {Collectable.t(), exit_status :: non_neg_integer()} | :unavailable
+  def cmd(path, args, opts) do
+    with true <- Enum.all?(Keyword.keys(opts), &(&1 in @supported_options)),
+         pid when is_pid(pid) <- GenServer.whereis(__MODULE__),
+         {:ok, id} <- call(pid, {:run, path, args, env(opts), stderr_to_stdout(opts)}) do
+      collect(pid, id, Keyword.get(opts, :into, ""))
+    else
+      _ -> :unavailable
+    end
+  end
+
+  @doc """
+  Return spawn statistics
+  """
+  @spec stats() :: stats()
+  def stats() do
+    GenServer.call(__MODULE__, :stats)
+  end
+
+  defp call(pid, request) do
+    GenServer.call(pid, request)
+  catch
+    :exit, _reason -> :unavailable
+  end
+
+  defp env(opts) do
+    for {name, value} <- Keyword.get(opts, :env, []) do
+      {to_string(name), value && to_string(value)}
+    end
+  end
+
+  defp stderr_to_stdout(opts), do: Keyword.get(opts, :stderr_to_stdout, false) == true
+
+  defp collect(pid, id, into) do
+    ref = Process.monitor(pid)
+    {acc, fun} = Collectable.into(into)
+
+    result = collect_output(ref, id, acc, fun)
+    Process.demonitor(ref, [:flush])
+    result
+  end
+
+  defp collect_output(ref, id, acc, fun) do
+    receive do
+      {__MODULE__, ^id, {:data, data}} ->
+        collect_output(ref, id, fun.(acc, {:cont, data}), fun)
+
+      {__MODULE__, ^id, {:exit, status}} ->
+        {fun.(acc, :done), status}
+
+      {:DOWN, ^ref, :process, _pid, _reason} ->
+        {fun.(acc, :done), @killed_status}
+    end
+  end
+
+  @impl GenServer
+  def init(_args) do
+    if available?() do
+      port =
+        Port.open({:spawn_executable, executable()}, [
+          {:packet, 2},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      state = %{
+        port: port,
+        next_id: 1,
+        commands: %{},
+        stats: %{spawns: 0, last_spawn_usec: nil, max_spawn_usec: 0}
+      }
+
+      {:ok, state}
+    else
+      :ignore
+    end
+  end
+
+  @impl GenServer
+  def handle_call({:run, path, args, env, stderr_to_stdout}, {caller, _tag}, state) do
+    id = state.next_id
+    request = {:run, id, path, args, env, stderr_to_stdout}
+    Port.command(state.port, :erlang.term_to_binary(request))
+
+    command = %{caller: caller, path: path, monitor: Process.monitor(caller)}
+
+    {:reply, {:ok, id},
+     %{state | next_id: id + 1, commands: Map.put(state.commands, id, command)}}
+  end
+
+  def handle_call(:stats, _from, state) do
+    {:reply, state.stats, state}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_message}}, %{port: port} = state) do
+    case :erlang.binary_to_term(raw_message) do
+      {:output, id, data} ->
+        case Map.fetch(state.commands, id) do
+          {:ok, command} -> send(command.caller, {__MODULE__, id, {:data, data}})
+          :error -> :ok
+        end
+
+        {:noreply, state}
+
+      {:exit, id, status, spawn_usec} ->
+        {:noreply, command_exited(state, id, status, spawn_usec)}
+    end
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("spawner exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, _reason}, state) do
+    # Kill commands whose callers exit. They're removed when the port reports
+    # that they exited.
+    for {id, %{monitor: ^ref}} <- state.commands do
+      Port.command(state.port, :erlang.term_to_binary({:kill, id}))
+    end
+
+    {:noreply, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  defp command_exited(state, id, status, spawn_usec) do
+    case Map.pop(state.commands, id) do
+      {nil, _commands} ->
+        state
+
+      {command, commands} ->
+        Process.demonitor(command.monitor, [:flush])
+        send(command.caller, {__MODULE__, id, {:exit, status}})
+        Logger.debug("spawner: started #{command.path} in #{spawn_usec} us")
+
+        stats = %{
+          state.stats
+          | spawns: state.stats.spawns + 1,
+            last_spawn_usec: spawn_usec,
+            max_spawn_usec: max(state.stats.max_spawn_usec, spawn_usec)
+        }
+
+        %{state | commands: commands, stats: stats}
+    end
+  end
+
+  defp executable() do
+    Application.app_dir(:vintage_net, ["priv", "spawner"])
+  end
+end
@@ -14,8 +14,13 @@ defmodule VintageNet.Connectivity.HostList do
   """
   @type ip_or_hostname() :: :inet.ip_address() | String.t()
 
-  @type name_port() :: {ip_or_hostname(), 1..65535}
-  @type ip_port() :: {:inet.ip_address(), 1..65535}
+  @typedoc """
+  TCP port to connect to or `:icmp` to send an ICMP echo
+  """
+  @type port_or_icmp() :: 1..65535 | :icmp
+
+  @type name_port() :: {ip_or_hostname(), port_or_icmp()}
+  @type ip_port() :: {:inet.ip_address(), port_or_icmp()}
 
   @type hostent() :: record(:hostent, [])
 
@@ -69,7 +74,8 @@ defmodule VintageNet.Connectivity.HostList do
     end
   end
 
-  defp normalize({host, port}) when port > 0 and port < 65535 do
+  defp normalize({host, port})
+       when (is_integer(port) and port > 0 and port < 65535) or port == :icmp do
     case VintageNet.IP.ip_to_tuple(host) do
       {:ok, host_as_tuple} -> {host_as_tuple, port}
       # Likely a domain name
@@ -4,8 +4,13 @@
 #
 defmodule VintageNet.Connectivity.Inspector do
   @moduledoc """
-  This module looks at the network activity of all TCP socket connections known
-  to Erlang/OTP to deduce whether the internet is working.
+  This module looks at the network activity of TCP socket connections to deduce
+  whether the internet is working.
+
+  When the `sock_diag` port is available, the kernel is asked for the counters
+  of every TCP socket on the device in one request. This includes sockets
+  owned by other OS processes. Otherwise, all TCP sockets known to Erlang/OTP
+  are checked one by one.
 
   To use it, call `check_internet/2`, save the returned cache, and then call it
   again a minute later (or so). If any socket has transferred data in both
@@ -27,13 +32,19 @@ defmodule VintageNet.Connectivity.Inspector do
   2. The TCP connection must be sending and receiving data. If the keapalive is
      longer than the `check_internet/2`
   3. It doesn't help if nobody is using the network interface.
-  4. It may have scalability issues if there are a LOT of TCP sockets.
+  4. Without `sock_diag`, it may have scalability issues if there are a LOT of
+     TCP sockets.
   """
 
+  alias VintageNet.Connectivity.SockDiag
+
   @typedoc """
   Cache for use between `check_internet/2` calls. Initialize to an empty map.
   """
-  @type cache() :: %{port() => {non_neg_integer(), non_neg_integer()}}
+  @type cache() :: %{
+          (port() | :socket.socket() | non_neg_integer()) =>
+            {non_neg_integer(), non_neg_integer()}
+        }
 
   @typedoc """
   Internet connectivity status
@@ -79,9 +90,15 @@ defmodule VintageNet.Connectivity.Inspector do
         {:no_internet, %{}}
 
       our_addresses ->
-        {:unknown, %{}}
-        |> check_ports(Port.list(), our_addresses, cache)
-        |> check_sockets(:socket.which_sockets(:tcp), our_addresses, cache)
+        case SockDiag.tcp_counters(our_addresses) do
+          {:ok, counters} ->
+            check_counters({:unknown, %{}}, counters, cache)
+
+          :unavailable ->
+            {:unknown, %{}}
+            |> check_ports(Port.list(), our_addresses, cache)
+            |> check_sockets(:socket.which_sockets(:tcp), our_addresses, cache)
+        end
     end
   end
 
@@ -105,6 +122,20 @@ defmodule VintageNet.Connectivity.Inspector do
     end
   end
 
+  @doc false
+  @spec check_counters(result(), [SockDiag.counters()], cache()) :: result()
+  def check_counters(result, counters, cache) do
+    # sock_diag only returns sockets to off-LAN hosts, so they're all of interest
+    Enum.reduce(counters, result, fn {cookie, tx, rx}, acc ->
+      case Map.fetch(cache, cookie) do
+        {:ok, previous_stats} -> update_result(acc, cookie, previous_stats, {tx, rx})
+        :error -> put_stats(acc, cookie, {tx, rx})
+      end
+    end)
+  end
+
+  defp put_stats({status, cache}, socket, stats), do: {status, Map.put(cache, socket, stats)}
+
   @doc false
   @spec check_ports(result(), [port()], [ip_address_and_mask()], cache()) :: result()
   def check_ports(result, [], _our_addresses, _cache), do: result
@@ -15,18 +15,21 @@ defmodule VintageNet.Connectivity.InternetChecker do
   """
   use GenServer
 
-  alias VintageNet.Connectivity.{CheckLogic, HostList, Inspector, TCPPing}
+  alias VintageNet.Connectivity.{CheckLogic, HostList, Inspector, Prober, TCPPing}
   alias VintageNet.PowerManager.PMControl
   alias VintageNet.RouteManager
 
+  @probe_timeout 5_000
+
   @typedoc false
   @type state() :: %{
           ifname: VintageNet.ifname(),
-          configured_hosts: [{VintageNet.any_ip_address(), non_neg_integer()}],
-          ping_list: [{:inet.ip_address(), non_neg_integer()}],
+          configured_hosts: [HostList.name_port()],
+          ping_list: [HostList.ip_port()],
           check_logic: CheckLogic.state(),
           inspector: Inspector.cache(),
-          status: Inspector.status()
+          status: Inspector.status(),
+          skipped_probe: boolean()
         }
 
   @doc """
@@ -47,7 +50,8 @@ defmodule VintageNet.Connectivity.InternetChecker do
       ping_list: [],
       check_logic: CheckLogic.init(connectivity),
       inspector: %{},
-      status: :unknown
+      status: :unknown,
+      skipped_probe: false
     }
 
     {:ok, state, {:continue, :continue}}
@@ -116,12 +120,14 @@ defmodule VintageNet.Connectivity.InternetChecker do
     # Steps
     # 1. Reset status to unknown
     # 2. See if we can determine internet-connectivity via TCP stats
-    # 3. If still unknown, refresh the ping list
-    # 4. If still unknown, ping. This step is definitive.
-    # 5. Record whether there's internet
+    # 3. If still unknown, see if the kernel already gave up on the gateway
+    # 4. If still unknown, refresh the ping list
+    # 5. If still unknown, ping. This step is definitive.
+    # 6. Record whether there's internet
     state
     |> reset_status()
     |> check_inspector()
+    |> check_gateway()
     |> reload_ping_list()
     |> ping_if_unknown()
     |> update_check_logic()
@@ -137,6 +143,19 @@ defmodule VintageNet.Connectivity.InternetChecker do
     %{state | status: status, inspector: new_cache}
   end
 
+  defp check_gateway(%{status: :unknown, skipped_probe: false} = state) do
+    # Probing is pointless when ARP or NDP couldn't resolve the default
+    # gateway. Don't skip twice in a row, though, since the kernel only retries
+    # resolving a failed neighbor when something sends traffic to it.
+    if VintageNet.get(["interface", state.ifname, "gateway_reachability"]) == :failed do
+      %{state | status: :no_internet, skipped_probe: true}
+    else
+      state
+    end
+  end
+
+  defp check_gateway(state), do: %{state | skipped_probe: false}
+
   defp reload_ping_list(%{status: :unknown, ping_list: []} = state) do
     # Create the ping list and filter out anything that's on the same LAN since
     # pinging those addresses would be inconclusive.
@@ -149,10 +168,12 @@ defmodule VintageNet.Connectivity.InternetChecker do
 
   defp reload_ping_list(state), do: state
 
-  defp ping_if_unknown(%{status: :unknown, ping_list: [who | rest]} = state) do
-    case TCPPing.ping(state.ifname, who) do
-      :ok -> %{state | status: :internet}
-      _error -> %{state | status: :no_internet, ping_list: rest}
+  defp ping_if_unknown(%{status: :unknown, ping_list: [_ | _] = ping_list} = state) do
+    # Try every host at once. If none respond, a new list gets made next time.
+    case Prober.probe(state.ifname, ping_list, @probe_timeout) do
+      {:ok, _results} -> %{state | status: :internet}
+      {:error, _results} -> %{state | status: :no_internet, ping_list: []}
+      :unavailable -> tcp_ping(state)
     end
   end
 
@@ -164,6 +185,18 @@ defmodule VintageNet.Connectivity.InternetChecker do
 
   defp ping_if_unknown(state), do: state
 
+  defp tcp_ping(%{ping_list: [{_ip, :icmp} | rest]} = state) do
+    # ICMP needs the prober
+    %{state | status: :no_internet, ping_list: rest}
+  end
+
+  defp tcp_ping(%{ping_list: [who | rest]} = state) do
+    case TCPPing.ping(state.ifname, who) do
+      :ok -> %{state | status: :internet}
+      _error -> %{state | status: :no_internet, ping_list: rest}
+    end
+  end
+
   defp update_check_logic(%{status: :internet} = state) do
     %{state | check_logic: CheckLogic.check_succeeded(state.check_logic)}
   end
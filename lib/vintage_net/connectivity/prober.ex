@@ -0,0 +1,105 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Connectivity.Prober do
+  @moduledoc false
+
+  # Check Internet connectivity with the `prober` port
+  #
+  # All of the hosts passed to `probe/3` are tried at the same time and the
+  # result comes back as soon as one responds. One port is shared by every
+  # interface so concurrent checks don't block each other.
+  # `VintageNet.Connectivity.InternetChecker` falls back to `TCPPing` when this
+  # returns `:unavailable`. The port is only used when the `:native_prober`
+  # application environment key is `true`.
+
+  use GenServer
+
+  require Logger
+
+  # Must match MAX_TARGETS in prober.c
+  @max_targets 8
+
+  @typedoc """
+  A TCP port to connect to or an ICMP echo
+  """
+  @type target() :: {:inet.ip_address(), 1..65535 | :icmp}
+
+  @typedoc """
+  Round trip time in microseconds or why the target failed
+
+  Targets are `:cancelled` if a different one succeeded first.
+  """
+  @type result() :: {:ok, non_neg_integer()} | {:error, String.t()} | :cancelled
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Probe targets from an interface
+
+  Returns `{:ok, results}` as soon as one target responds or
+  `{:error, results}` if none do within the timeout.
+  """
+  @spec probe(VintageNet.ifname(), [target()], non_neg_integer()) ::
+          {:ok, [{target(), result()}]} | {:error, [{target(), result()}]} | :unavailable
+  def probe(_ifname, targets, _timeout) when targets == [] or length(targets) > @max_targets,
+    do: :unavailable
+
+  def probe(ifname, targets, timeout) do
+    GenServer.call(__MODULE__, {:probe, ifname, targets, timeout}, timeout + 1_000)
+  catch
+    :exit, _reason -> :unavailable
+  end
+
+  @impl GenServer
+  def init(_args) do
+    executable = :code.priv_dir(:vintage_net) ++ ~c"/prober"
+    enabled? = Application.get_env(:vintage_net, :native_prober, false)
+
+    if enabled? and File.exists?(executable) do
+      port =
+        Port.open({:spawn_executable, executable}, [
+          {:packet, 2},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      {:ok, %{port: port, next_id: 1, waiters: %{}}}
+    else
+      :ignore
+    end
+  end
+
+  @impl GenServer
+  def handle_call({:probe, ifname, targets, timeout}, from, state) do
+    id = state.next_id
+
+    Port.command(state.port, :erlang.term_to_binary({:probe, id, ifname, timeout, targets}))
+
+    waiters = Map.put(state.waiters, id, {from, targets})
+    {:noreply, %{state | next_id: id + 1, waiters: waiters}}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_response}}, %{port: port} = state) do
+    {id, status, results} = :erlang.binary_to_term(raw_response)
+    {{from, targets}, waiters} = Map.pop(state.waiters, id)
+
+    GenServer.reply(from, {status, Enum.zip(targets, results)})
+    {:noreply, %{state | waiters: waiters}}
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("prober exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+end
@@ -0,0 +1,104 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Connectivity.SockDiag do
+  @moduledoc false
+
+  # Query TCP socket counters from the kernel with the `sock_diag` port
+  #
+  # This finds every established TCP socket on the device in one request
+  # rather than asking each Erlang port and socket. It also sees sockets
+  # owned by other OS processes. `VintageNet.Connectivity.Inspector` falls back
+  # to looking at Erlang's sockets when this returns `:unavailable`. The port is
+  # only used when the `:native_sock_diag` application environment key is
+  # `true`.
+
+  use GenServer
+
+  require Logger
+
+  # Must match MAX_SUBNETS in sock_diag.c
+  @max_subnets 32
+
+  @typedoc """
+  Kernel socket cookie, bytes sent and acknowledged, and bytes received
+  """
+  @type counters() :: {non_neg_integer(), non_neg_integer(), non_neg_integer()}
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Return counters for TCP sockets from the subnets to off-LAN peers
+
+  Subnets are `{address, netmask}` tuples like the ones from
+  `VintageNet.Connectivity.Inspector`.
+  """
+  @spec tcp_counters([{:inet.ip_address(), :inet.ip_address()}]) ::
+          {:ok, [counters()]} | :unavailable
+  def tcp_counters(subnets) when length(subnets) > @max_subnets, do: :unavailable
+
+  def tcp_counters(subnets) do
+    GenServer.call(__MODULE__, {:tcp_counters, subnets})
+  catch
+    :exit, _reason -> :unavailable
+  end
+
+  @impl GenServer
+  def init(_args) do
+    executable = :code.priv_dir(:vintage_net) ++ ~c"/sock_diag"
+    enabled? = Application.get_env(:vintage_net, :native_sock_diag, false)
+
+    if enabled? and File.exists?(executable) do
+      # Responses can have thousands of sockets, so use 4 byte lengths
+      port =
+        Port.open({:spawn_executable, executable}, [
+          {:packet, 4},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      {:ok, %{port: port, waiters: :queue.new()}}
+    else
+      :ignore
+    end
+  end
+
+  @impl GenServer
+  def handle_call({:tcp_counters, subnets}, from, state) do
+    Port.command(state.port, :erlang.term_to_binary({:tcp_counters, subnets}))
+    {:noreply, %{state | waiters: :queue.in(from, state.waiters)}}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_response}}, %{port: port} = state) do
+    {{:value, from}, waiters} = :queue.out(state.waiters)
+
+    reply =
+      case :erlang.binary_to_term(raw_response) do
+        {:ok, records} ->
+          {:ok, for(<<cookie::64, tx::64, rx::64 <- records>>, do: {cookie, tx, rx})}
+
+        {:error, reason} ->
+          # E.g., CONFIG_INET_DIAG isn't enabled
+          Logger.debug("sock_diag failed: #{reason}")
+          :unavailable
+      end
+
+    GenServer.reply(from, reply)
+    {:noreply, %{state | waiters: waiters}}
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("sock_diag exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+end
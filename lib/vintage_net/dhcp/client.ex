@@ -0,0 +1,178 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.Client do
+  @moduledoc false
+
+  # Run DHCP for every interface with the `dhcp_client` port
+  #
+  # This replaces running a `udhcpc` per interface. Lease events have the same
+  # ops and options as `udhcpc` reports, so they go to the
+  # `VintageNet.OSEventDispatcher.UdhcpcHandler` in the same way. Interfaces
+  # are stopped if the process that started them exits.
+  #
+  # `VintageNet.Interface.DHCPClient` calls this. It's only used if the
+  # `:native_dhcp` application environment key is `true` and the port was
+  # built. Otherwise, `udhcpc` is used.
+
+  use GenServer
+
+  alias VintageNet.DHCP.EventChannel
+  alias VintageNet.DHCP.Options
+  alias VintageNet.OSEventDispatcher
+  require Logger
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Return whether DHCP should be handled by the port
+  """
+  @spec available?() :: boolean()
+  def available?() do
+    Application.get_env(:vintage_net, :native_dhcp, false) and File.exists?(executable())
+  end
+
+  @doc """
+  Start DHCP on an interface
+
+  `request_options` are option names or numbers like `udhcpc -O` takes. DHCP
+  is stopped when the calling process exits.
+  """
+  @spec start(VintageNet.ifname(), String.t(), [String.t()]) :: :ok | :unavailable
+  def start(ifname, hostname, request_options) do
+    GenServer.call(__MODULE__, {:start, ifname, hostname, request_options})
+  catch
+    :exit, _reason -> :unavailable
+  end
+
+  @doc """
+  Stop DHCP on an interface
+  """
+  @spec stop(VintageNet.ifname()) :: :ok
+  def stop(ifname) do
+    GenServer.call(__MODULE__, {:stop, ifname})
+  catch
+    :exit, _reason -> :ok
+  end
+
+  @impl GenServer
+  def init(_args) do
+    # Option keys must already exist as atoms for the :safe decode
+    {:module, Options} = Code.ensure_loaded(Options)
+
+    if available?() do
+      port =
+        Port.open({:spawn_executable, executable()}, [
+          {:packet, 2},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      {:ok, %{port: port, monitors: %{}, last: %{}}}
+    else
+      {:ok, %{port: nil, monitors: %{}, last: %{}}}
+    end
+  end
+
+  @impl GenServer
+  def handle_call({:start, _ifname, _hostname, _request_options}, _from, %{port: nil} = state) do
+    {:reply, :unavailable, state}
+  end
+
+  def handle_call({:start, ifname, hostname, request_options}, {pid, _tag}, state) do
+    Port.command(state.port, :erlang.term_to_binary({:start, ifname, hostname, request_options}))
+
+    state = demonitor(state, ifname)
+    ref = Process.monitor(pid)
+    {:reply, :ok, %{state | monitors: Map.put(state.monitors, ifname, ref)}}
+  end
+
+  def handle_call({:stop, ifname}, _from, state) do
+    {:reply, :ok, stop_interface(state, ifname)}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_event}}, %{port: port} = state) do
+    case decode(raw_event) do
+      {:ok, event} ->
+        # Replayed reports are dropped like they are for udhcpc_notify
+        {events, last} = EventChannel.filter_events([event], state.last)
+
+        Enum.each(events, fn {_seq, op, ifname, options} ->
+          OSEventDispatcher.dispatch_udhcpc(op, ifname, options)
+        end)
+
+        {:noreply, %{state | last: last}}
+
+      {:error, ifname, reason} ->
+        Logger.error("dhcp_client(#{ifname}): #{reason}")
+        {:noreply, state}
+
+      :error ->
+        Logger.warning("dhcp_client: dropping unexpected report")
+        {:noreply, state}
+    end
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, _reason}, state) do
+    case Enum.find(state.monitors, fn {_ifname, r} -> r == ref end) do
+      {ifname, _ref} -> {:noreply, stop_interface(state, ifname)}
+      nil -> {:noreply, state}
+    end
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("dhcp_client exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  defp decode(data) do
+    case :erlang.binary_to_term(data, [:safe]) do
+      {:dhcp, seq, op, ifname, options}
+      when is_integer(seq) and op in ["deconfig", "leasefail", "nak", "renew", "bound"] and
+             is_binary(ifname) and is_map(options) ->
+        {:ok, {seq, op, ifname, options}}
+
+      {:error, ifname, reason} when is_binary(ifname) and is_binary(reason) ->
+        {:error, ifname, reason}
+
+      _ ->
+        :error
+    end
+  rescue
+    ArgumentError -> :error
+  end
+
+  defp stop_interface(%{port: nil} = state, _ifname), do: state
+
+  defp stop_interface(state, ifname) do
+    Port.command(state.port, :erlang.term_to_binary({:stop, ifname}))
+
+    state = demonitor(state, ifname)
+    %{state | last: Map.delete(state.last, ifname)}
+  end
+
+  defp demonitor(state, ifname) do
+    case Map.pop(state.monitors, ifname) do
+      {nil, _monitors} ->
+        state
+
+      {ref, monitors} ->
+        Process.demonitor(ref, [:flush])
+        %{state | monitors: monitors}
+    end
+  end
+
+  defp executable() do
+    Application.app_dir(:vintage_net, ["priv", "dhcp_client"])
+  end
+end
@@ -0,0 +1,137 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.EventChannel do
+  @moduledoc false
+
+  # Receive udhcpc lease events from the `udhcpc_notify` script
+  #
+  # udhcpc runs its script for every lease event. `udhcpc_notify` only sends
+  # the options in `VintageNet.DHCP.Options`, parses them before sending, and
+  # tags each event with a monotonic sequence number. Events go to a Unix
+  # domain socket that stays open for the life of this GenServer.
+  #
+  # Events that arrive together are handled as a batch in sequence order.
+  # Replayed or out of order events are dropped. Renewals are always passed on
+  # even if nothing changed, since handlers use them to reapply routes and name
+  # servers.
+
+  use GenServer
+
+  alias VintageNet.DHCP.Options
+  alias VintageNet.OSEventDispatcher
+  require Logger
+
+  @type event() :: {non_neg_integer(), String.t(), VintageNet.ifname(), Options.t()}
+
+  @type last_events() :: %{VintageNet.ifname() => non_neg_integer()}
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Return the script and environment for running udhcpc
+
+  BEAMNotify is used if `udhcpc_notify` wasn't built or the socket couldn't
+  be opened.
+  """
+  @spec udhcpc_script() :: {String.t(), Enumerable.t()}
+  def udhcpc_script() do
+    script = Application.app_dir(:vintage_net, ["priv", "udhcpc_notify"])
+    path = socket_path()
+
+    if File.exists?(script) and File.exists?(path) do
+      {script, [{"VINTAGE_NET_DHCP_SOCKET", path}]}
+    else
+      {BEAMNotify.bin_path(), BEAMNotify.env(name: "vintage_net_comm", report_env: true)}
+    end
+  end
+
+  @doc """
+  Path to the Unix domain socket that receives events
+  """
+  @spec socket_path() :: Path.t()
+  def socket_path() do
+    Path.join(Application.get_env(:vintage_net, :tmpdir), "udhcpc_events")
+  end
+
+  @doc false
+  @spec filter_events([event()], last_events()) :: {[event()], last_events()}
+  def filter_events(events, last) do
+    {keep, last} =
+      events
+      |> Enum.sort()
+      |> Enum.reduce({[], last}, fn {seq, _op, ifname, _options} = event, {keep, last} ->
+        case last[ifname] do
+          last_seq when is_integer(last_seq) and seq <= last_seq -> {keep, last}
+          _ -> {[event | keep], Map.put(last, ifname, seq)}
+        end
+      end)
+
+    {Enum.reverse(keep), last}
+  end
+
+  @impl GenServer
+  def init(_args) do
+    # Event option keys must already exist as atoms for the :safe decode
+    {:module, Options} = Code.ensure_loaded(Options)
+
+    path = socket_path()
+    _ = File.mkdir_p(Path.dirname(path))
+    _ = File.rm(path)
+
+    case :gen_udp.open(0, [:local, :binary, {:active, true}, {:ifaddr, {:local, path}}]) do
+      {:ok, socket} ->
+        {:ok, %{socket: socket, pending: [], last: %{}}}
+
+      {:error, reason} ->
+        Logger.warning("Can't open #{path} (#{inspect(reason)}). Using BEAMNotify for udhcpc.")
+        {:ok, %{socket: nil, pending: [], last: %{}}}
+    end
+  end
+
+  @impl GenServer
+  def handle_info({:udp, socket, _from, _port, data}, %{socket: socket} = state) do
+    case decode(data) do
+      {:ok, event} ->
+        # Handle everything that's already in the mailbox before flushing
+        if state.pending == [], do: send(self(), :flush)
+        {:noreply, %{state | pending: [event | state.pending]}}
+
+      :error ->
+        Logger.warning("VintageNet: dropping unexpected udhcpc event: #{inspect(data)}")
+        {:noreply, state}
+    end
+  end
+
+  def handle_info(:flush, state) do
+    {events, last} = filter_events(state.pending, state.last)
+
+    Enum.each(events, fn {_seq, op, ifname, options} ->
+      OSEventDispatcher.dispatch_udhcpc(op, ifname, options)
+    end)
+
+    {:noreply, %{state | pending: [], last: last}}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  defp decode(data) do
+    case :erlang.binary_to_term(data, [:safe]) do
+      {:udhcpc, seq, op, ifname, options}
+      when is_integer(seq) and op in ["deconfig", "leasefail", "nak", "renew", "bound"] and
+             is_binary(ifname) and is_map(options) ->
+        {:ok, {seq, op, ifname, options}}
+
+      _ ->
+        :error
+    end
+  rescue
+    ArgumentError -> :error
+  end
+end
@@ -0,0 +1,152 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.LeaseWatcher do
+  @moduledoc false
+
+  # Track udhcpd leases with the `lease_watcher` port
+  #
+  # udhcpd rewrites its lease file each time that it saves leases. Without
+  # this, `notify_file` runs a program each time so that
+  # `VintageNet.Interface.Udhcpd` can parse the whole file again. The port
+  # watches the files with inotify and only reports leases that were added,
+  # removed or renewed, so the `["interface", ifname, "dhcpd", "leases"]`
+  # property is updated from those.
+  #
+  # `VintageNet.IP.DhcpdConfig` only uses this if the `:native_lease_watcher`
+  # application environment key is `true` and the port was built. Custom
+  # `:udhcpd_handler`s still need `notify_file`, so it's only dropped for the
+  # default handler.
+
+  use GenServer
+  require Logger
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Return whether udhcpd leases should be tracked by the port
+  """
+  @spec available?() :: boolean()
+  def available?() do
+    Application.get_env(:vintage_net, :native_lease_watcher, false) and File.exists?(executable())
+  end
+
+  @doc """
+  Return whether udhcpd needs to run `notify_file` when it saves leases
+
+  This is the case when the port isn't used or when there's a custom
+  `:udhcpd_handler` to call.
+  """
+  @spec notify_file?() :: boolean()
+  def notify_file?() do
+    not available?() or
+      Application.get_env(:vintage_net, :udhcpd_handler) != VintageNet.Interface.Udhcpd
+  end
+
+  @doc """
+  Start tracking the udhcpd leases for an interface
+
+  It's ok to call this before udhcpd creates the lease file.
+  """
+  @spec watch(VintageNet.ifname(), Path.t()) :: :ok
+  def watch(ifname, lease_file) do
+    GenServer.call(__MODULE__, {:watch, ifname, lease_file})
+  catch
+    :exit, _reason ->
+      Logger.error("[vintage_net(#{ifname})] lease_watcher isn't running")
+      :ok
+  end
+
+  @doc """
+  Stop tracking leases and clear the leases property
+  """
+  @spec unwatch(VintageNet.ifname()) :: :ok
+  def unwatch(ifname) do
+    GenServer.call(__MODULE__, {:unwatch, ifname})
+  catch
+    :exit, _reason -> :ok
+  end
+
+  @impl GenServer
+  def init(_args) do
+    port =
+      if available?() do
+        Port.open({:spawn_executable, executable()}, [
+          {:packet, 4},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+      end
+
+    {:ok, %{port: port, leases: %{}}}
+  end
+
+  @impl GenServer
+  def handle_call({:watch, ifname, _lease_file}, _from, %{port: nil} = state) do
+    Logger.error("[vintage_net(#{ifname})] lease_watcher isn't available")
+    {:reply, :ok, state}
+  end
+
+  def handle_call({:watch, ifname, lease_file}, _from, state) do
+    Port.command(state.port, :erlang.term_to_binary({:watch, ifname, lease_file}))
+    {:reply, :ok, %{state | leases: Map.put(state.leases, ifname, %{})}}
+  end
+
+  def handle_call({:unwatch, ifname}, _from, state) do
+    if state.port, do: Port.command(state.port, :erlang.term_to_binary({:unwatch, ifname}))
+
+    PropertyTable.delete(VintageNet, leases_property(ifname))
+    {:reply, :ok, %{state | leases: Map.delete(state.leases, ifname)}}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_event}}, %{port: port} = state) do
+    case :erlang.binary_to_term(raw_event) do
+      {:leases, ifname, added, removed, renewed} ->
+        {:noreply, update_leases(state, ifname, added, removed, renewed)}
+
+      {:error, ifname, reason} ->
+        Logger.error("lease_watcher(#{ifname}): #{reason}")
+        {:noreply, state}
+    end
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("lease_watcher exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  defp update_leases(state, ifname, added, removed, renewed) do
+    case Map.fetch(state.leases, ifname) do
+      {:ok, leases} ->
+        leases =
+          leases
+          |> Map.drop(Enum.map(removed, &lease_key/1))
+          |> Map.merge(Map.new(added ++ renewed, &{lease_key(&1), &1}))
+
+        PropertyTable.put(VintageNet, leases_property(ifname), Map.values(leases))
+        %{state | leases: Map.put(state.leases, ifname, leases)}
+
+      :error ->
+        # Changes can race an unwatch
+        state
+    end
+  end
+
+  defp lease_key(lease), do: {lease.lease_nip, lease.lease_mac}
+
+  defp leases_property(ifname), do: ["interface", ifname, "dhcpd", "leases"]
+
+  defp executable() do
+    Application.app_dir(:vintage_net, ["priv", "lease_watcher"])
+  end
+end
@@ -228,6 +228,11 @@ defmodule VintageNet.Info do
     |> Enum.intersperse(", ")
   end
 
+  defp pretty_address(%{address: address, prefix_length: bits, state: state})
+       when state != :preferred do
+    [VintageNet.IP.cidr_to_string(address, bits), " (", to_string(state), ")"]
+  end
+
   defp pretty_address(%{address: address, prefix_length: bits}) do
     VintageNet.IP.cidr_to_string(address, bits)
   end
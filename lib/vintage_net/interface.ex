@@ -18,6 +18,7 @@ defmodule VintageNet.Interface do
 
   alias VintageNet.Interface.CommandRunner
   alias VintageNet.Interface.RawConfig
+  alias VintageNet.Interface.RawConfigDiff
   alias VintageNet.Persistence
   alias VintageNet.PowerManager.PMControl
   alias VintageNet.PredictableInterfaceName
@@ -30,6 +31,7 @@ defmodule VintageNet.Interface do
   defstruct ifname: nil,
             config: nil,
             next_config: nil,
+            update: nil,
             command_runner: nil,
             waiters: [],
             inflight_ioctls: %{}
@@ -111,6 +113,12 @@ defmodule VintageNet.Interface do
   don't raise, but it should be due to something in the environment.
   For example, a network cable isn't plugged in or a WiFi access point
   is out of range.
+
+  If the interface is already configured and only things like files, child
+  processes, routes or name servers changed, it's updated in place instead of
+  being taken down and brought back up. Its state is `:updating` while that
+  happens. If the update fails, the interface is taken down and configured
+  from scratch.
   """
   @spec configure(VintageNet.ifname(), map(), VintageNet.configure_options()) ::
           :ok | {:error, any()}
@@ -348,7 +356,7 @@ defmodule VintageNet.Interface do
 
     {new_data, actions} = cancel_ioctls(data)
     VintageNet.Interface.Supervisor.clear_technology(data.ifname)
-    new_data = run_commands(new_data, old_config.down_cmds)
+    new_data = run_commands(new_data, :down, old_config.down_cmds)
 
     actions = [
       {:state_timeout, old_config.down_cmd_millis, :unconfiguring_timeout} | actions
@@ -364,19 +372,27 @@ defmodule VintageNet.Interface do
         :configured,
         %__MODULE__{config: old_config} = data
       ) do
-    debug(data, ":configured -> configure (#{inspect(new_config.type)})")
-
     {new_data, actions} = cancel_ioctls(data)
-    VintageNet.Interface.Supervisor.clear_technology(data.ifname)
-    new_data = run_commands(new_data, old_config.down_cmds)
+    actions = [{:reply, from, :ok} | actions]
 
-    actions = [
-      {:reply, from, :ok},
-      {:state_timeout, old_config.down_cmd_millis, :unconfiguring_timeout} | actions
-    ]
+    case RawConfigDiff.diff(old_config, new_config) do
+      {:ok, update} ->
+        debug(data, ":configured -> update (#{inspect(new_config.type)})")
+        start_updating(update, %{new_data | next_config: new_config}, actions)
 
-    update_properties(:reconfiguring, new_data)
-    {:next_state, :reconfiguring, %{new_data | next_config: new_config}, actions}
+      :full ->
+        debug(data, ":configured -> configure (#{inspect(new_config.type)})")
+
+        VintageNet.Interface.Supervisor.clear_technology(data.ifname)
+        new_data = run_commands(new_data, :down, old_config.down_cmds)
+
+        actions = [
+          {:state_timeout, old_config.down_cmd_millis, :unconfiguring_timeout} | actions
+        ]
+
+        update_properties(:reconfiguring, new_data)
+        {:next_state, :reconfiguring, %{new_data | next_config: new_config}, actions}
+    end
   end
 
   def handle_event(
@@ -441,7 +457,7 @@ defmodule VintageNet.Interface do
 
     {new_data, actions} = cancel_ioctls(data)
     VintageNet.Interface.Supervisor.clear_technology(data.ifname)
-    new_data = run_commands(new_data, config.down_cmds)
+    new_data = run_commands(new_data, :down, config.down_cmds)
 
     actions = [
       {:state_timeout, config.down_cmd_millis, :unconfiguring_timeout} | actions
@@ -558,6 +574,80 @@ defmodule VintageNet.Interface do
     end
   end
 
+  # :updating
+
+  def handle_event(
+        :info,
+        {:commands_done, :ok},
+        :updating,
+        %__MODULE__{next_config: new_config, update: update} = data
+      ) do
+    # debug(data, ":updating -> done success")
+    {new_data, actions} = reply_to_waiters(data)
+
+    new_data = %{
+      new_data
+      | config: new_config,
+        next_config: nil,
+        command_runner: nil,
+        update: nil
+    }
+
+    update_properties(:configured, new_data)
+
+    VintageNet.Interface.Supervisor.update_technology(
+      data.ifname,
+      update.children,
+      new_config.restart_strategy,
+      new_config.child_specs
+    )
+
+    {:next_state, :configured, new_data, actions}
+  end
+
+  def handle_event(:info, {:commands_done, {:error, _reason}}, :updating, data) do
+    debug(data, ":updating -> done error: reconfiguring")
+    abandon_update(%{data | command_runner: nil}, [])
+  end
+
+  def handle_event(
+        :info,
+        {:EXIT, pid, reason},
+        :updating,
+        %__MODULE__{command_runner: pid} = data
+      ) do
+    debug(data, ":updating -> done crash (#{inspect(reason)}): reconfiguring")
+    abandon_update(%{data | command_runner: nil}, [])
+  end
+
+  def handle_event(:state_timeout, _event, :updating, %__MODULE__{command_runner: pid} = data) do
+    debug(data, ":updating -> recovering from hang: reconfiguring")
+    Process.exit(pid, :kill)
+    abandon_update(%{data | command_runner: nil}, [])
+  end
+
+  def handle_event(
+        {:call, from},
+        {:configure, new_config},
+        :updating,
+        %__MODULE__{command_runner: pid} = data
+      ) do
+    debug(data, ":updating -> configure (stopping the update)")
+    Process.exit(pid, :kill)
+    abandon_update(%{data | next_config: new_config, command_runner: nil}, [{:reply, from, :ok}])
+  end
+
+  def handle_event(
+        :info,
+        {VintageNet, ["interface", an_ifname, "present"], _old_value, nil, _meta},
+        :updating,
+        %__MODULE__{command_runner: pid} = data
+      ) do
+    debug(data, ":updating -> #{an_ifname} removed")
+    Process.exit(pid, :kill)
+    abandon_update(%{data | command_runner: nil}, [])
+  end
+
   # :retrying
 
   def handle_event(:state_timeout, _event, :retrying, %__MODULE__{config: new_config} = data) do
@@ -657,7 +747,7 @@ defmodule VintageNet.Interface do
     rm(new_config.cleanup_files)
     cleanup_interface(data.ifname)
     CommandRunner.create_files(new_config.files)
-    new_data = run_commands(data, new_config.up_cmds)
+    new_data = run_commands(data, :up, new_config.up_cmds)
 
     actions = [
       {:state_timeout, new_config.up_cmd_millis, :configuring_timeout} | actions
@@ -667,19 +757,64 @@ defmodule VintageNet.Interface do
     {:next_state, :configuring, new_data, actions}
   end
 
+  # Update a configured interface in place. The old configuration stays in
+  # `:config` until the update finishes so that it can be taken down if the
+  # update doesn't work out.
+  defp start_updating(update, %__MODULE__{next_config: new_config} = data, actions) do
+    CommandRunner.remove_files(update.removed_files)
+    CommandRunner.create_files(update.files)
+    new_data = run_commands(%{data | update: update}, :update, update.up_cmds)
+
+    actions = [
+      {:state_timeout, new_config.up_cmd_millis, :updating_timeout} | actions
+    ]
+
+    update_properties(:updating, new_data)
+    {:next_state, :updating, new_data, actions}
+  end
+
+  # Run the old configuration's down_cmds when an update fails. The
+  # `:reconfiguring` state then fully configures `next_config`.
+  defp abandon_update(%__MODULE__{config: old_config, update: update} = data, actions) do
+    VintageNet.Interface.Supervisor.clear_technology(data.ifname)
+    CommandRunner.remove_files(update.files)
+
+    new_data = run_commands(%{data | update: nil}, :down, old_config.down_cmds)
+
+    actions = [
+      {:state_timeout, old_config.down_cmd_millis, :unconfiguring_timeout} | actions
+    ]
+
+    update_properties(:reconfiguring, new_data)
+    {:next_state, :reconfiguring, new_data, actions}
+  end
+
   defp reply_to_waiters(data) do
     actions = for from <- data.waiters, do: {:reply, from, :ok}
     {%{data | waiters: []}, actions}
   end
 
-  defp run_commands(data, commands) do
+  defp run_commands(data, phase, commands) do
     interface_pid = self()
-    {:ok, pid} = Task.start_link(fn -> run_commands_and_report(commands, interface_pid) end)
+    metadata = %{ifname: data.ifname, phase: phase}
+
+    {:ok, pid} =
+      Task.start_link(fn -> run_commands_and_report(commands, metadata, interface_pid) end)
+
     %{data | command_runner: pid}
   end
 
-  defp run_commands_and_report(commands, interface_pid) do
+  defp run_commands_and_report(commands, metadata, interface_pid) do
+    start = System.monotonic_time()
     result = CommandRunner.run(commands)
+    outcome = if result == :ok, do: :ok, else: :error
+
+    :telemetry.execute(
+      [:vintage_net, :interface, :commands],
+      %{duration: System.monotonic_time() - start, count: length(commands)},
+      Map.put(metadata, :result, outcome)
+    )
+
     send(interface_pid, {:commands_done, result})
   end
 
@@ -708,7 +843,7 @@ defmodule VintageNet.Interface do
       {["interface", ifname, "state"], state}
     ])
 
-    if state != :configured do
+    if state not in [:configured, :updating] do
       # Once a state is `:configured`, then the configuration provides the connection
       # status. When not configured, make sure there are no routing tables entries or
       # stale properties.
@@ -16,12 +16,13 @@ defmodule VintageNet.Interface.CommandRunner do
   * `{:fun, module, function_name, args}` - Run a function by MFArgs
   * `{:fun, fun}` - Run a function. Using the MFArgs form is preferred since it's
                     easier to verify in unit tests.
+  * `{:link_ops, ops}` - Make link and address changes with netlink. See `LinkOps`.
 
   CommandRunner also implements RawConfig's file creation and
   cleanup logic.
   """
   alias VintageNet.Command
-  alias VintageNet.Interface.{OutputLogger, RawConfig}
+  alias VintageNet.Interface.{LinkOps, OutputLogger, RawConfig}
   require Logger
 
   @doc """
@@ -79,6 +80,13 @@ defmodule VintageNet.Interface.CommandRunner do
     fun.()
   end
 
+  def run({:link_ops, ops}) do
+    case LinkOps.run(ops) do
+      :unavailable -> run(LinkOps.to_commands(ops))
+      result -> result
+    end
+  end
+
   @doc """
   Create a list of files
   """
@@ -0,0 +1,145 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Interface.DHCPClient do
+  @moduledoc false
+
+  # Run DHCP on an interface with `VintageNet.DHCP.Client`
+  #
+  # This takes the place of running `udhcpc` with `VintageNet.Interface.IfupDaemon`
+  # and, like it, only runs DHCP while the interface's physical layer is up.
+  # If `VintageNet.DHCP.Client` isn't running or restarts, DHCP is started
+  # again once it's back.
+
+  use GenServer
+  require Logger
+
+  alias VintageNet.DHCP.Client
+
+  @retry_interval 1000
+
+  @typedoc false
+  @type init_args :: [
+          ifname: VintageNet.ifname(),
+          hostname: String.t(),
+          request_options: [String.t()]
+        ]
+
+  @spec start_link(init_args()) :: GenServer.on_start()
+  def start_link(init_args) do
+    GenServer.start_link(__MODULE__, init_args)
+  end
+
+  @impl GenServer
+  def init(init_args) do
+    # Trap exits so that DHCP is stopped when the interface is deconfigured
+    Process.flag(:trap_exit, true)
+
+    state = %{
+      ifname: Keyword.fetch!(init_args, :ifname),
+      hostname: Keyword.fetch!(init_args, :hostname),
+      request_options: Keyword.get(init_args, :request_options, []),
+      running?: false,
+      client_ref: nil,
+      retry_timer: nil
+    }
+
+    {:ok, state, {:continue, :continue}}
+  end
+
+  @impl GenServer
+  def handle_continue(:continue, %{ifname: ifname} = state) do
+    VintageNet.subscribe(lower_up_property(ifname))
+
+    new_state =
+      case VintageNet.get(lower_up_property(ifname)) do
+        true -> start_dhcp(state)
+        _not_true -> state
+      end
+
+    {:noreply, new_state}
+  end
+
+  @impl GenServer
+  def handle_info(
+        {VintageNet, ["interface", ifname, "lower_up"], _old_value, true, _meta},
+        %{ifname: ifname} = state
+      ) do
+    {:noreply, start_dhcp(state)}
+  end
+
+  def handle_info(
+        {VintageNet, ["interface", ifname, "lower_up"], _old_value, _false_or_nil, _meta},
+        %{ifname: ifname} = state
+      ) do
+    {:noreply, stop_dhcp(state)}
+  end
+
+  def handle_info(:retry, %{retry_timer: timer} = state) when timer != nil do
+    {:noreply, start_dhcp(state)}
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, _reason}, %{client_ref: ref} = state) do
+    Logger.warning("[vintage_net(#{state.ifname})] dhcp_client exited. Restarting DHCP.")
+    {:noreply, start_dhcp(%{state | running?: false, client_ref: nil})}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  @impl GenServer
+  def terminate(_reason, state) do
+    _ = stop_dhcp(state)
+    :ok
+  end
+
+  defp start_dhcp(%{running?: false} = state) do
+    Logger.debug("[vintage_net(#{state.ifname})] starting DHCP")
+
+    retrying? = state.retry_timer != nil
+    state = cancel_retry(state)
+
+    # Monitor first so that a restart between the two calls isn't missed
+    ref = Process.monitor(Client)
+
+    case Client.start(state.ifname, state.hostname, state.request_options) do
+      :ok ->
+        %{state | running?: true, client_ref: ref}
+
+      :unavailable ->
+        Process.demonitor(ref, [:flush])
+
+        if not retrying? do
+          Logger.error("[vintage_net(#{state.ifname})] dhcp_client isn't running. Retrying.")
+        end
+
+        timer = Process.send_after(self(), :retry, @retry_interval)
+        %{state | retry_timer: timer}
+    end
+  end
+
+  defp start_dhcp(state), do: state
+
+  defp stop_dhcp(%{running?: true} = state) do
+    Logger.debug("[vintage_net(#{state.ifname})] stopping DHCP")
+
+    Process.demonitor(state.client_ref, [:flush])
+    :ok = Client.stop(state.ifname)
+    %{state | running?: false, client_ref: nil}
+  end
+
+  defp stop_dhcp(state), do: cancel_retry(state)
+
+  defp cancel_retry(%{retry_timer: nil} = state), do: state
+
+  defp cancel_retry(state) do
+    _ = Process.cancel_timer(state.retry_timer)
+    %{state | retry_timer: nil}
+  end
+
+  defp lower_up_property(ifname) do
+    ["interface", ifname, "lower_up"]
+  end
+end
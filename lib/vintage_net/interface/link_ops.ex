@@ -0,0 +1,109 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Interface.LinkOps do
+  @moduledoc """
+  Link and address changes for the `{:link_ops, ops}` RawConfig command
+
+  All of the operations in a command are sent to the kernel together using
+  the `netlink_ctl` port. If it's not available, the equivalent `ip` commands
+  are run instead.
+
+  The following operations are supported:
+
+  * `{:link_up, ifname}` - Bring the interface up (`ip link set <ifname> up`)
+  * `{:link_down, ifname}` - Bring the interface down (`ip link set <ifname> down`)
+  * `{:add_address, ifname, address, prefix_length, opts}` - Add an address.
+    Options are `:broadcast` and `:label`. (`ip addr add`)
+  * `{:flush_addresses, ifname, label}` - Remove all addresses on the interface
+    with the label. Addresses without labels use the interface name as their
+    label. Errors are ignored. (`ip addr flush dev <ifname> label <label>`)
+  """
+
+  alias VintageNet.{IP, NetlinkCtl}
+  alias VintageNet.Interface.RawConfig
+  require Logger
+
+  @type op() ::
+          {:link_up, VintageNet.ifname()}
+          | {:link_down, VintageNet.ifname()}
+          | {:add_address, VintageNet.ifname(), :inet.ip_address(), VintageNet.prefix_length(),
+             keyword()}
+          | {:flush_addresses, VintageNet.ifname(), String.t()}
+
+  @doc """
+  Apply a list of operations
+
+  Returns `:unavailable` if `netlink_ctl` isn't running so that the caller
+  can run the commands from `to_commands/1` instead.
+  """
+  @spec run([op()]) :: :ok | {:error, any()} | :unavailable
+  def run(ops) do
+    case NetlinkCtl.run(Enum.map(ops, &to_netlink/1)) do
+      {:ok, results} -> check_results(ops, results)
+      :unavailable -> :unavailable
+    end
+  end
+
+  defp check_results(ops, results) do
+    Enum.zip(ops, results)
+    |> Enum.find_value(:ok, fn
+      {_op, :ok} ->
+        nil
+
+      {{:flush_addresses, _ifname, _label}, _error} ->
+        nil
+
+      {op, {:error, reason}} ->
+        Logger.error("Netlink error from #{inspect(op)}: #{reason}")
+        {:error, reason}
+    end)
+  end
+
+  defp to_netlink({:link_up, ifname}), do: {:setlink, %{ifname: ifname, up: true}}
+  defp to_netlink({:link_down, ifname}), do: {:setlink, %{ifname: ifname, up: false}}
+
+  defp to_netlink({:add_address, ifname, address, prefix_length, opts}) do
+    args =
+      opts
+      |> Keyword.take([:broadcast, :label])
+      |> Map.new()
+      |> Map.merge(%{ifname: ifname, address: address, prefix_len: prefix_length})
+
+    {:newaddr, args}
+  end
+
+  defp to_netlink({:flush_addresses, ifname, label}),
+    do: {:flushaddr, %{ifname: ifname, label: label}}
+
+  @doc """
+  Return the `ip` commands that do the same thing as the operations
+  """
+  @spec to_commands([op()]) :: [RawConfig.command()]
+  def to_commands(ops), do: Enum.map(ops, &to_command/1)
+
+  defp to_command({:link_up, ifname}), do: {:run, "ip", ["link", "set", ifname, "up"]}
+  defp to_command({:link_down, ifname}), do: {:run, "ip", ["link", "set", ifname, "down"]}
+
+  defp to_command({:add_address, ifname, address, prefix_length, opts}) do
+    broadcast =
+      case opts[:broadcast] do
+        nil -> []
+        broadcast -> ["broadcast", IP.ip_to_string(broadcast)]
+      end
+
+    label =
+      case opts[:label] do
+        nil -> []
+        label -> ["label", label]
+      end
+
+    {:run, "ip",
+     ["addr", "add", IP.cidr_to_string(address, prefix_length), "dev", ifname] ++
+       broadcast ++ label}
+  end
+
+  defp to_command({:flush_addresses, ifname, label}),
+    do: {:run_ignore_errors, "ip", ["addr", "flush", "dev", ifname, "label", label]}
+end
@@ -35,6 +35,7 @@ defmodule VintageNet.Interface.RawConfig do
           | {:run_ignore_errors, String.t(), [String.t()]}
           | {:fun, (-> :ok | {:error, any()})}
           | {:fun, module(), atom(), list()}
+          | {:link_ops, [VintageNet.Interface.LinkOps.op()]}
 
   @type file_contents :: {Path.t(), String.t()}
 
@@ -0,0 +1,185 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Interface.RawConfigDiff do
+  @moduledoc false
+
+  # Figure out how to update a configured interface to a new RawConfig
+  #
+  # Reconfiguring normally runs all of the old `down_cmds` and then all of the
+  # new `up_cmds`. That takes the link down, flushes addresses and restarts
+  # every child process even when only a name server changed. If the two
+  # configurations only differ in the following ways, the interface is updated
+  # in place instead:
+  #
+  # * File contents - changed files are rewritten and the children and commands
+  #   that refer to them are restarted or run again
+  # * Child specs - changed children are restarted as their `restart_strategy`
+  #   would restart them
+  # * Arguments to commands that replace what an earlier call did, like
+  #   `VintageNet.RouteManager.set_route/3` - only the changed ones are run
+  #
+  # Anything else, like different `:link_ops` or `:run` commands, requires the
+  # full reconfiguration.
+
+  alias VintageNet.Interface.RawConfig
+
+  # Commands that replace the effect of earlier calls in the same group, so
+  # running the new one is enough to update them
+  @replacing_commands %{
+    {VintageNet.RouteManager, :set_route} => :route,
+    {VintageNet.RouteManager, :clear_route} => :route,
+    {VintageNet.NameResolver, :setup} => :name_servers,
+    {VintageNet.NameResolver, :clear} => :name_servers
+  }
+
+  defstruct files: [], removed_files: [], up_cmds: [], children: :unchanged
+
+  @typedoc """
+  How to restart the technology's children
+
+  * `:unchanged` - leave them alone
+  * `:restart` - restart all of them
+  * `{stop_ids, start_specs}` - stop the children with these ids and then start
+    these children
+  """
+  @type children() :: :unchanged | :restart | {[term()], [Supervisor.child_spec()]}
+
+  @typedoc """
+  Changes to make to update an interface
+
+  * `:files` - files to write
+  * `:removed_files` - files to delete
+  * `:up_cmds` - commands to run
+  * `:children` - how to update child processes
+  """
+  @type t() :: %__MODULE__{
+          files: [RawConfig.file_contents()],
+          removed_files: [RawConfig.file_contents()],
+          up_cmds: [RawConfig.command()],
+          children: children()
+        }
+
+  @doc """
+  Return the changes to update an interface from one configuration to another
+
+  `:full` is returned if the interface needs to be fully reconfigured.
+  """
+  @spec diff(RawConfig.t(), RawConfig.t()) :: {:ok, t()} | :full
+  def diff(%RawConfig{} = old_config, %RawConfig{} = new_config) do
+    changed_files = new_config.files -- old_config.files
+    new_paths = Enum.map(new_config.files, &elem(&1, 0))
+    removed_files = Enum.reject(old_config.files, &(elem(&1, 0) in new_paths))
+    changed_paths = Enum.map(changed_files ++ removed_files, &elem(&1, 0))
+
+    with :ok <- check_same(old_config, new_config),
+         {:ok, up_cmds} <- diff_commands(old_config.up_cmds, new_config.up_cmds, changed_paths),
+         {:ok, _} <- diff_commands(old_config.down_cmds, new_config.down_cmds, []) do
+      {:ok,
+       %__MODULE__{
+         files: changed_files,
+         removed_files: removed_files,
+         up_cmds: up_cmds,
+         children: diff_children(old_config, new_config, changed_paths)
+       }}
+    end
+  end
+
+  defp check_same(old_config, new_config) do
+    same? =
+      old_config.ifname == new_config.ifname and old_config.type == new_config.type and
+        old_config.required_ifnames == new_config.required_ifnames and
+        old_config.cleanup_files == new_config.cleanup_files
+
+    if same?, do: :ok, else: :full
+  end
+
+  # Commands need to be the same except for the arguments to replacing
+  # commands. Commands that use changed files are run again if they're
+  # replacing commands and cause a full reconfigure otherwise.
+  defp diff_commands(old_cmds, new_cmds, changed_paths) do
+    if Enum.map(old_cmds, &command_key/1) == Enum.map(new_cmds, &command_key/1) do
+      Enum.zip(old_cmds, new_cmds)
+      |> Enum.reduce_while({:ok, []}, fn {old_cmd, new_cmd}, {:ok, acc} ->
+        cond do
+          refers_to_any?(new_cmd, changed_paths) and command_key(new_cmd) == new_cmd ->
+            {:halt, :full}
+
+          old_cmd != new_cmd or refers_to_any?(new_cmd, changed_paths) ->
+            {:cont, {:ok, [new_cmd | acc]}}
+
+          true ->
+            {:cont, {:ok, acc}}
+        end
+      end)
+      |> reverse_ok()
+    else
+      :full
+    end
+  end
+
+  defp reverse_ok({:ok, list}), do: {:ok, Enum.reverse(list)}
+  defp reverse_ok(other), do: other
+
+  defp command_key({:fun, module, function_name, _args} = command) do
+    case Map.fetch(@replacing_commands, {module, function_name}) do
+      {:ok, group} -> {:replacing, module, group}
+      :error -> command
+    end
+  end
+
+  defp command_key(command), do: command
+
+  defp diff_children(old_config, new_config, changed_paths) do
+    old_children = Enum.map(old_config.child_specs, &Supervisor.child_spec(&1, []))
+    new_children = Enum.map(new_config.child_specs, &Supervisor.child_spec(&1, []))
+
+    changed =
+      Enum.zip(old_children, new_children)
+      |> Enum.map(fn {old, new} -> old != new or refers_to_any?(new, changed_paths) end)
+
+    cond do
+      old_children == [] and new_children == [] ->
+        :unchanged
+
+      old_config.restart_strategy != new_config.restart_strategy or
+        Enum.map(old_children, & &1.id) != Enum.map(new_children, & &1.id) ->
+        :restart
+
+      not Enum.any?(changed) ->
+        :unchanged
+
+      true ->
+        restart_changed(new_config.restart_strategy, new_children, changed)
+    end
+  end
+
+  defp restart_changed(:one_for_all, _children, _changed), do: :restart
+
+  defp restart_changed(:one_for_one, children, changed) do
+    restarts = for {child, true} <- Enum.zip(children, changed), do: child
+    {Enum.map(restarts, & &1.id), restarts}
+  end
+
+  defp restart_changed(:rest_for_one, children, changed) do
+    # Restart the first changed child and everything after it
+    restarts = Enum.drop(children, Enum.find_index(changed, & &1))
+    {restarts |> Enum.reverse() |> Enum.map(& &1.id), restarts}
+  end
+
+  defp refers_to_any?(_term, []), do: false
+  defp refers_to_any?(term, paths), do: Enum.any?(paths, &refers_to?(term, &1))
+
+  defp refers_to?(term, path) when is_binary(term), do: String.contains?(term, path)
+
+  defp refers_to?(term, path) when is_tuple(term),
+    do: term |> Tuple.to_list() |> refers_to?(path)
+
+  defp refers_to?([head | tail], path), do: refers_to?(head, path) or refers_to?(tail, path)
+
+  defp refers_to?(term, path) when is_map(term),
+    do: term |> Map.to_list() |> refers_to?(path)
+
+  defp refers_to?(_term, _path), do: false
+end
@@ -52,6 +52,56 @@ defmodule VintageNet.Interface.Supervisor do
     :ok
   end
 
+  @doc """
+  Update the technology's children without restarting the ones that didn't change
+
+  See `VintageNet.Interface.RawConfigDiff` for what to restart. If a child
+  can't be started, the whole technology is restarted.
+  """
+  @spec update_technology(
+          VintageNet.ifname(),
+          VintageNet.Interface.RawConfigDiff.children(),
+          Supervisor.strategy(),
+          [:supervisor.child_spec() | {module(), term()} | module()]
+        ) :: :ok
+  def update_technology(_ifname, :unchanged, _restart_strategy, _child_specs), do: :ok
+
+  def update_technology(ifname, :restart, restart_strategy, child_specs) do
+    set_technology(ifname, restart_strategy, child_specs)
+  end
+
+  def update_technology(ifname, {stop_ids, start_specs}, restart_strategy, child_specs) do
+    case technology_pid(ifname) do
+      nil ->
+        set_technology(ifname, restart_strategy, child_specs)
+
+      pid ->
+        Enum.each(stop_ids, fn id ->
+          _ = Supervisor.terminate_child(pid, id)
+          _ = Supervisor.delete_child(pid, id)
+        end)
+
+        if Enum.all?(start_specs, &started?(Supervisor.start_child(pid, &1))) do
+          :ok
+        else
+          # Don't leave the technology half updated
+          set_technology(ifname, restart_strategy, child_specs)
+        end
+    end
+  end
+
+  defp started?({:ok, _pid}), do: true
+  defp started?({:ok, _pid, _info}), do: true
+  defp started?(_error), do: false
+
+  defp technology_pid(ifname) do
+    Supervisor.which_children(via_name(ifname))
+    |> Enum.find_value(fn
+      {:technology, pid, _type, _modules} when is_pid(pid) -> pid
+      _other -> nil
+    end)
+  end
+
   @doc """
   Clear out children and child_specs from a technology
   """
@@ -27,18 +27,20 @@ defmodule VintageNet.Interface.Udhcpd do
   """
   @spec parse_leases(Path.t()) :: {:ok, [map()]} | {:error, File.posix()}
   def parse_leases(path) do
-    with {:ok, <<_timestamp::binary-size(8), rest::binary>>} <- File.read(path) do
-      do_parse_leases(rest, [])
+    with {:ok, <<timestamp::64, rest::binary>>} <- File.read(path) do
+      do_parse_leases(rest, timestamp, [])
     end
   end
 
   defp do_parse_leases(
          <<leasetime::32, ip1, ip2, ip3, ip4, mac1, mac2, mac3, mac4, mac5, mac6,
            hostname::20-bytes, _pad::2-bytes, rest::binary>>,
+         timestamp,
          acc
        ) do
     lease = %{
       leasetime: leasetime,
+      expires: timestamp + leasetime,
       lease_nip: Enum.join([ip1, ip2, ip3, ip4], "."),
       lease_mac:
         Enum.join(
@@ -55,8 +57,8 @@ defmodule VintageNet.Interface.Udhcpd do
       hostname: String.trim(hostname, <<0>>)
     }
 
-    do_parse_leases(rest, [lease | acc])
+    do_parse_leases(rest, timestamp, [lease | acc])
   end
 
-  defp do_parse_leases(<<>>, acc), do: {:ok, acc}
+  defp do_parse_leases(<<>>, _timestamp, acc), do: {:ok, acc}
 end
@@ -14,11 +14,31 @@ defmodule VintageNet.InterfacesMonitor do
   use GenServer
 
   alias VintageNet.InterfacesMonitor.{HWPath, Info}
+  alias VintageNet.Route.Observed
 
   require Logger
 
+  # Must match MAX_STATS_WATCHES in if_monitor_lib.h
+  @max_stats_watches 32
+
+  # Interfaces are indexed by both ifindex and name since if_monitor reports
+  # use the ifindex and the public API uses names. Address properties are
+  # built once at the end of each batch for the interfaces in
+  # `dirty_addresses` rather than after every address report. Linux doesn't
+  # report when router advertisement prefixes expire, so `prefix_timer` is
+  # for removing the next one.
   defstruct port: nil,
-            interface_info: %{}
+            interface_info: %{},
+            ifindex_by_name: %{},
+            dirty_addresses: MapSet.new(),
+            resync_seen: nil,
+            synced?: false,
+            routes: MapSet.new(),
+            route_waiters: [],
+            counter_waiters: [],
+            netlink_stats_waiters: [],
+            stats_watchers: %{},
+            prefix_timer: nil
 
   @spec start_link(any()) :: GenServer.on_start()
   def start_link(args) do
@@ -37,15 +57,95 @@ defmodule VintageNet.InterfacesMonitor do
     GenServer.call(__MODULE__, {:force_clear_ipv4_addresses, ifname})
   end
 
+  @doc """
+  Ask if_monitor to report the current state of all interfaces
+
+  Interfaces and addresses that aren't reported again are removed. This
+  recovers from any notifications that were missed.
+  """
+  @spec resync() :: :ok
+  def resync() do
+    GenServer.cast(__MODULE__, :resync)
+  end
+
+  @doc """
+  Return the routes and rules in the Linux routing tables
+
+  Only entries that look like ones VintageNet manages are returned. See
+  `VintageNet.Route.Observed`. This waits for if_monitor to finish reporting
+  the initial routing tables. `:unknown` is returned if that's not possible.
+  """
+  @spec observed_routes() :: {:ok, Observed.t()} | :unknown
+  def observed_routes() do
+    GenServer.call(__MODULE__, :observed_routes)
+  catch
+    :exit, _reason -> :unknown
+  end
+
+  @doc """
+  Periodically publish stats for an interface
+
+  While the calling process is alive, `["interface", ifname, "stats"]` is
+  updated with 64-bit counters and rates every `:stats_interval_millis`
+  milliseconds. Stats are only sampled for interfaces that have watchers.
+  Up to 32 interfaces can be watched at a time. `{:error, :too_many_watches}`
+  is returned when watching another one would go over that.
+  """
+  @spec watch_stats(VintageNet.ifname()) :: :ok | {:error, :too_many_watches}
+  def watch_stats(ifname) do
+    GenServer.call(__MODULE__, {:watch_stats, ifname, self()})
+  end
+
+  @doc """
+  Stop publishing stats for the calling process
+  """
+  @spec unwatch_stats(VintageNet.ifname()) :: :ok
+  def unwatch_stats(ifname) do
+    GenServer.call(__MODULE__, {:unwatch_stats, ifname, self()})
+  end
+
+  @doc """
+  Return counts of events that if_monitor didn't report individually
+
+  If VintageNet falls behind, if_monitor holds reports and replaces old link
+  reports with newer ones (`:collapsed`). If it falls too far behind, reports
+  are dropped (`:dropped`, `:overflows`) and a resync is done once it catches
+  up. `:netlink_overruns` counts the times the kernel dropped notifications,
+  which also causes a resync. `:max_queued_bytes` is the most that has been
+  waiting to be sent.
+  """
+  @spec counters() :: {:ok, map()} | :unknown
+  def counters() do
+    GenServer.call(__MODULE__, :counters)
+  catch
+    :exit, _reason -> :unknown
+  end
+
+  @doc """
+  Return counts of netlink messages that if_monitor received
+
+  The map has the total `:receives` and `:bytes` and then a map with the
+  `:messages`, `:bytes` and `:parse_errors` for each type of message. Messages
+  that can't be parsed are skipped.
+  """
+  @spec netlink_stats() :: {:ok, map()} | :unknown
+  def netlink_stats() do
+    GenServer.call(__MODULE__, :netlink_stats)
+  catch
+    :exit, _reason -> :unknown
+  end
+
   @impl GenServer
   def init(_args) do
     executable = :code.priv_dir(:vintage_net) ++ ~c"/if_monitor"
+    coalesce_millis = Application.get_env(:vintage_net, :link_coalesce_millis, 0)
 
     case File.exists?(executable) do
       true ->
         port =
           Port.open({:spawn_executable, executable}, [
-            {:packet, 2},
+            {:packet, 4},
+            {:args, port_args(coalesce_millis)},
             :use_stdio,
             :binary,
             :exit_status
@@ -59,27 +159,129 @@ defmodule VintageNet.InterfacesMonitor do
     end
   end
 
+  # if_monitor always batches. Coalescing delays reports, so it's opt-in.
+  defp port_args(coalesce_millis) when coalesce_millis > 0, do: ["-c", to_string(coalesce_millis)]
+  defp port_args(_coalesce_millis), do: ["-b"]
+
   @impl GenServer
   def handle_call({:force_clear_ipv4_addresses, ifname}, _from, state) do
     with {ifindex, old_info} <- get_by_ifname(state, ifname),
          new_info = Info.delete_ipv4_addresses(old_info),
          true <- old_info != new_info do
-      new_info = Info.update_address_properties(new_info)
+      Info.publish(Info.address_properties(new_info))
 
-      new_state = %{state | interface_info: Map.put(state.interface_info, ifindex, new_info)}
-      {:reply, :ok, new_state}
+      {:reply, :ok, put_info(state, ifindex, new_info)}
     else
       _ -> {:reply, :ok, state}
     end
   end
 
+  def handle_call(:observed_routes, _from, %{port: nil} = state) do
+    {:reply, :unknown, state}
+  end
+
+  def handle_call(:observed_routes, _from, %{synced?: true} = state) do
+    {:reply, {:ok, state.routes}, state}
+  end
+
+  def handle_call(:observed_routes, from, state) do
+    {:noreply, %{state | route_waiters: [from | state.route_waiters]}}
+  end
+
+  def handle_call(:counters, _from, %{port: nil} = state) do
+    {:reply, :unknown, state}
+  end
+
+  def handle_call(:counters, from, state) do
+    if state.counter_waiters == [] do
+      Port.command(state.port, :erlang.term_to_binary(:counters))
+    end
+
+    {:noreply, %{state | counter_waiters: [from | state.counter_waiters]}}
+  end
+
+  def handle_call(:netlink_stats, _from, %{port: nil} = state) do
+    {:reply, :unknown, state}
+  end
+
+  def handle_call(:netlink_stats, from, state) do
+    if state.netlink_stats_waiters == [] do
+      Port.command(state.port, :erlang.term_to_binary(:netlink_stats))
+    end
+
+    {:noreply, %{state | netlink_stats_waiters: [from | state.netlink_stats_waiters]}}
+  end
+
+  def handle_call({:watch_stats, ifname, pid}, _from, state) do
+    ifnames = watched_ifnames(state.stats_watchers)
+
+    if ifname in ifnames or length(ifnames) < @max_stats_watches do
+      watchers =
+        Map.put_new_lazy(state.stats_watchers, {pid, ifname}, fn -> Process.monitor(pid) end)
+
+      {:reply, :ok, update_stats_watchers(state, watchers)}
+    else
+      {:reply, {:error, :too_many_watches}, state}
+    end
+  end
+
+  def handle_call({:unwatch_stats, ifname, pid}, _from, state) do
+    {ref, watchers} = Map.pop(state.stats_watchers, {pid, ifname})
+    if ref, do: Process.demonitor(ref, [:flush])
+
+    {:reply, :ok, update_stats_watchers(state, watchers)}
+  end
+
+  @impl GenServer
+  def handle_cast(:resync, %{port: nil} = state) do
+    {:noreply, state}
+  end
+
+  def handle_cast(:resync, state) do
+    Port.command(state.port, :erlang.term_to_binary(:resync))
+    {:noreply, state}
+  end
+
   @impl GenServer
   def handle_info({port, {:data, raw_report}}, %{port: port} = state) do
-    report = :erlang.binary_to_term(raw_report)
+    start = System.monotonic_time()
+
+    # Batches start with when if_monitor received the oldest netlink message
+    # in them
+    {received_usec, reports} =
+      case :erlang.binary_to_term(raw_report) do
+        [{:received, usec} | batch] -> {usec, batch}
+        batch when is_list(batch) -> {0, batch}
+        report -> {0, [report]}
+      end
+
+    decoded = System.monotonic_time()
+
+    #  Logger.debug("if_monitor: #{inspect(reports, limit: :infinity)}")
 
-    #  Logger.debug("if_monitor: #{inspect(report, limit: :infinity)}")
+    # Collect the property changes from the whole batch so that each
+    # property is only updated once with its final value.
+    {new_state, changes} =
+      Enum.reduce(reports, {state, %{}}, fn report, {acc_state, acc_changes} ->
+        {next_state, report_changes} = handle_report(acc_state, report)
+        {next_state, Enum.into(report_changes, acc_changes)}
+      end)
 
-    new_state = handle_report(state, report)
+    {new_state, address_changes} = take_address_changes(new_state)
+    Info.publish(Enum.into(address_changes, changes))
+
+    measurements = %{
+      reports: length(reports),
+      bytes: byte_size(raw_report),
+      decode_duration: decoded - start,
+      update_duration: System.monotonic_time() - decoded
+    }
+
+    :telemetry.execute(
+      [:vintage_net, :interfaces_monitor, :batch],
+      put_latency(measurements, received_usec),
+      %{}
+    )
 
     {:noreply, new_state}
   end
@@ -89,72 +291,386 @@ defmodule VintageNet.InterfacesMonitor do
     {:stop, {:port_exited, status}, state}
   end
 
+  def handle_info(:expire_prefixes, state) do
+    now = System.monotonic_time(:millisecond)
+
+    {interface_info, changes} =
+      Enum.reduce(state.interface_info, {%{}, []}, fn {ifindex, info}, {acc, changes} ->
+        new_info = Info.expire_prefixes(info, now)
+        {Map.put(acc, ifindex, new_info), prefix_changes(info, new_info) ++ changes}
+      end)
+
+    Info.publish(changes)
+
+    {:noreply, schedule_prefix_expiry(%{state | interface_info: interface_info})}
+  end
+
+  def handle_info({:DOWN, _ref, :process, pid, _reason}, state) do
+    watchers = Map.reject(state.stats_watchers, fn {{watcher, _}, _ref} -> watcher == pid end)
+    {:noreply, update_stats_watchers(state, watchers)}
+  end
+
   def handle_info(_message, state) do
     {:noreply, state}
   end
 
   defp handle_report(state, {:newlink, ifname, ifindex, link_report}) do
-    new_info =
-      get_or_create_info(state, ifindex, ifname)
-      |> Info.newlink(link_report)
-      |> Info.update_link_properties()
+    {info, changes} = get_or_create_info(state, ifindex, ifname, link_report)
+    new_info = Info.newlink(info, link_report)
+
+    {put_info(state, ifindex, new_info) |> mark_seen(ifindex),
+     changes ++ Info.link_properties(new_info)}
+  end
+
+  defp handle_report(state, {:updatelink, ifname, ifindex, link_changes}) do
+    {info, changes} = get_or_create_info(state, ifindex, ifname, link_changes)
+    new_info = Info.updatelink(info, link_changes)
 
-    %{state | interface_info: Map.put(state.interface_info, ifindex, new_info)}
+    {put_info(state, ifindex, new_info) |> mark_seen(ifindex),
+     changes ++ Info.link_properties(new_info)}
   end
 
   defp handle_report(state, {:dellink, ifname, ifindex, _link_report}) do
-    Info.clear_properties(ifname)
+    new_state =
+      state
+      |> delete_info(ifindex)
+      |> forget_routes(ifname)
 
-    %{state | interface_info: Map.delete(state.interface_info, ifindex)}
+    {new_state, Info.clear_properties(ifname)}
   end
 
   defp handle_report(state, {:newaddr, ifindex, address_report}) do
-    new_info =
-      get_or_create_info(state, ifindex)
-      |> Info.newaddr(address_report)
-      |> Info.update_address_properties()
+    info = get_or_create_info(state, ifindex)
+    new_info = Info.newaddr(info, address_report, System.monotonic_time(:millisecond))
 
-    %{state | interface_info: Map.put(state.interface_info, ifindex, new_info)}
+    {update_addresses(state, ifindex, info, new_info)
+     |> mark_seen(ifindex, Info.address_key(address_report)), []}
   end
 
   defp handle_report(state, {:deladdr, ifindex, address_report}) do
+    info = get_or_create_info(state, ifindex)
+    new_info = Info.deladdr(info, address_report)
+
+    {update_addresses(state, ifindex, info, new_info), []}
+  end
+
+  defp handle_report(state, {:newprefix, ifindex, prefix_report}) do
+    info = get_or_create_info(state, ifindex)
+    new_info = Info.newprefix(info, prefix_report, System.monotonic_time(:millisecond))
+
+    {put_info(state, ifindex, new_info) |> schedule_prefix_expiry(),
+     prefix_changes(info, new_info)}
+  end
+
+  defp handle_report(state, {:gateway, ifindex, gateway_report}) do
     new_info =
       get_or_create_info(state, ifindex)
-      |> Info.deladdr(address_report)
-      |> Info.update_address_properties()
+      |> Info.gateway(gateway_report)
+
+    # if_monitor reports every gateway again during a resync, so wait for
+    # the end to avoid publishing intermediate values
+    changes = if state.resync_seen, do: [], else: Info.gateway_properties(new_info)
 
-    %{state | interface_info: Map.put(state.interface_info, ifindex, new_info)}
+    {put_info(state, ifindex, new_info), changes}
   end
 
-  defp get_by_ifname(state, ifname) do
-    Enum.find_value(state.interface_info, fn {ifindex, info} ->
+  defp handle_report(state, {:newroute, route_report}) do
+    {observe(state, :add, Observed.route_entry(route_report, oif_ifname(state, route_report))),
+     []}
+  end
+
+  defp handle_report(state, {:delroute, route_report}) do
+    {observe(state, :del, Observed.route_entry(route_report, oif_ifname(state, route_report))),
+     []}
+  end
+
+  defp handle_report(state, {:newrule, rule_report}) do
+    {observe(state, :add, Observed.rule_entry(rule_report)), []}
+  end
+
+  defp handle_report(state, {:delrule, rule_report}) do
+    {observe(state, :del, Observed.rule_entry(rule_report)), []}
+  end
+
+  defp handle_report(state, {:stats, ifname, _ifindex, sample}) do
+    # Drop samples that were sent before the last watcher went away
+    if ifname in watched_ifnames(state.stats_watchers) do
+      {state, Info.stats_properties(ifname, sample)}
+    else
+      {state, []}
+    end
+  end
+
+  defp handle_report(state, {:counters, counters}) do
+    Enum.each(state.counter_waiters, &GenServer.reply(&1, {:ok, counters}))
+    {%{state | counter_waiters: []}, []}
+  end
+
+  defp handle_report(state, {:netlink_stats, stats}) do
+    Enum.each(state.netlink_stats_waiters, &GenServer.reply(&1, {:ok, stats}))
+    {%{state | netlink_stats_waiters: []}, []}
+  end
+
+  defp handle_report(state, :resync) do
+    interface_info = Map.new(state.interface_info, fn {k, v} -> {k, Info.clear_gateways(v)} end)
+
+    {%{state | resync_seen: %{}, routes: MapSet.new(), interface_info: interface_info}, []}
+  end
+
+  defp handle_report(%{resync_seen: nil} = state, :synced) do
+    {state, []}
+  end
+
+  defp handle_report(state, :synced) do
+    # Remove everything that wasn't reported during the resync
+    {interface_info, changes} =
+      Enum.reduce(state.interface_info, {%{}, []}, fn {ifindex, info}, {acc, changes} ->
+        case Map.fetch(state.resync_seen, ifindex) do
+          {:ok, address_keys} ->
+            new_info = Info.retain_addresses(info, address_keys)
+
+            {Map.put(acc, ifindex, new_info),
+             address_changes(info, new_info) ++ Info.gateway_properties(new_info) ++ changes}
+
+          :error ->
+            {acc, Info.clear_properties(info.ifname) ++ changes}
+        end
+      end)
+
+    ifindex_by_name = Map.new(interface_info, fn {ifindex, info} -> {info.ifname, ifindex} end)
+
+    # The routing tables are complete now too
+    Enum.each(state.route_waiters, &GenServer.reply(&1, {:ok, state.routes}))
+
+    new_state = %{
+      state
+      | interface_info: interface_info,
+        ifindex_by_name: ifindex_by_name,
+        resync_seen: nil,
+        synced?: true,
+        route_waiters: []
+    }
+
+    {new_state, changes}
+  end
+
+  # The latency is from when if_monitor received the netlink message to now.
+  # if_monitor uses CLOCK_MONOTONIC, so compare against the OS's monotonic
+  # time rather than Erlang's. It's unknown for the initial reports.
+  defp put_latency(measurements, 0), do: measurements
+
+  defp put_latency(measurements, received_usec) do
+    source = :erlang.system_info(:os_monotonic_time_source)
+
+    if source[:clock_id] == :CLOCK_MONOTONIC do
+      now_usec = System.convert_time_unit(source[:time], :native, :microsecond)
+      latency = System.convert_time_unit(now_usec - received_usec, :microsecond, :native)
+      Map.put(measurements, :latency, latency)
+    else
+      measurements
+    end
+  end
+
+  defp address_changes(info, info), do: []
+  defp address_changes(_old_info, new_info), do: Info.address_properties(new_info)
+
+  # Routers repeat their prefixes every few minutes, so only publish when
+  # the property would change
+  defp prefix_changes(old_info, new_info) do
+    new_changes = Info.prefix_properties(new_info)
+    if Info.prefix_properties(old_info) == new_changes, do: [], else: new_changes
+  end
+
+  defp schedule_prefix_expiry(state) do
+    if state.prefix_timer, do: Process.cancel_timer(state.prefix_timer)
+
+    next_expiry =
+      state.interface_info
+      |> Enum.map(fn {_ifindex, info} -> Info.next_prefix_expiry(info) end)
+      |> Enum.reject(&is_nil/1)
+      |> Enum.min(fn -> nil end)
+
+    timer = next_expiry && Process.send_after(self(), :expire_prefixes, next_expiry, abs: true)
+    %{state | prefix_timer: timer}
+  end
+
+  defp mark_seen(%{resync_seen: nil} = state, _ifindex), do: state
+
+  defp mark_seen(state, ifindex) do
+    %{state | resync_seen: Map.put_new(state.resync_seen, ifindex, MapSet.new())}
+  end
+
+  defp mark_seen(%{resync_seen: nil} = state, _ifindex, _address_key), do: state
+
+  defp mark_seen(state, ifindex, address_key) do
+    resync_seen =
+      Map.update(
+        state.resync_seen,
+        ifindex,
+        MapSet.new([address_key]),
+        &MapSet.put(&1, address_key)
+      )
+
+    %{state | resync_seen: resync_seen}
+  end
+
+  # Nothing to publish if the report didn't change anything. This is common
+  # since Linux repeats IPv6 address reports when lifetimes get refreshed.
+  defp update_addresses(state, _ifindex, info, info), do: state
+
+  defp update_addresses(state, ifindex, _info, new_info) do
+    new_state = put_info(state, ifindex, new_info)
+    %{new_state | dirty_addresses: MapSet.put(new_state.dirty_addresses, ifindex)}
+  end
+
+  defp take_address_changes(state) do
+    changes =
+      Enum.flat_map(state.dirty_addresses, fn ifindex ->
+        case Map.fetch(state.interface_info, ifindex) do
+          {:ok, info} -> Info.address_properties(info)
+          :error -> []
+        end
+      end)
+
+    {%{state | dirty_addresses: MapSet.new()}, changes}
+  end
+
+  defp oif_ifname(state, route_report) do
+    case Map.fetch(state.interface_info, route_report[:oif]) do
+      {:ok, info} -> info.ifname
+      :error -> nil
+    end
+  end
+
+  defp observe(state, _op, nil), do: state
+
+  defp observe(state, op, entry) do
+    %{state | routes: Observed.apply_changes(state.routes, [{op, entry}])}
+  end
+
+  # Linux removes routes when their interface goes away without sending
+  # notifications for them
+  defp forget_routes(state, ifname) do
+    state.routes
+    |> Enum.filter(fn entry -> elem(entry, 0) != :rule and elem(entry, 1) == ifname end)
+    |> Enum.reduce(state, &observe(&2, :del, &1))
+  end
+
+  # Tell if_monitor when the set of watched interfaces changes
+  defp update_stats_watchers(state, watchers) do
+    old_ifnames = watched_ifnames(state.stats_watchers)
+    new_ifnames = watched_ifnames(watchers)
+
+    if old_ifnames != new_ifnames do
+      send_watch_stats(state.port, new_ifnames)
+
+      # Remove stale stats so that nobody mistakes them for current ones
+      old_ifnames
+      |> Enum.reject(&(&1 in new_ifnames))
+      |> Enum.each(&PropertyTable.delete(VintageNet, ["interface", &1, "stats"]))
+    end
+
+    %{state | stats_watchers: watchers}
+  end
+
+  defp watched_ifnames(watchers) do
+    watchers |> Map.keys() |> Enum.map(&elem(&1, 1)) |> Enum.uniq() |> Enum.sort()
+  end
+
+  defp send_watch_stats(nil, _ifnames), do: :ok
+
+  defp send_watch_stats(port, ifnames) do
+    interval = Application.get_env(:vintage_net, :stats_interval_millis, 1000)
+    Port.command(port, :erlang.term_to_binary({:watch_stats, interval, ifnames}))
+  end
+
+  defp put_info(state, ifindex, info) do
+    ifindex_by_name =
+      case state.interface_info do
+        %{^ifindex => %{ifname: old_ifname}} when old_ifname != info.ifname ->
+          state.ifindex_by_name
+          |> delete_name(old_ifname, ifindex)
+          |> Map.put(info.ifname, ifindex)
+
+        %{^ifindex => _same_name} ->
+          state.ifindex_by_name
+
+        _ ->
+          Map.put(state.ifindex_by_name, info.ifname, ifindex)
+      end
+
+    %{
+      state
+      | interface_info: Map.put(state.interface_info, ifindex, info),
+        ifindex_by_name: ifindex_by_name
+    }
+  end
+
+  defp delete_info(state, ifindex) do
+    {info, interface_info} = Map.pop(state.interface_info, ifindex)
+
+    ifindex_by_name =
       case info do
-        %{ifname: ^ifname} -> {ifindex, info}
-        _ -> nil
+        %{ifname: ifname} -> delete_name(state.ifindex_by_name, ifname, ifindex)
+        nil -> state.ifindex_by_name
       end
-    end)
+
+    %{
+      state
+      | interface_info: interface_info,
+        ifindex_by_name: ifindex_by_name,
+        dirty_addresses: MapSet.delete(state.dirty_addresses, ifindex)
+    }
   end
 
-  defp get_or_create_info(state, ifindex, ifname) do
+  # Only remove the name if it's for this interface. Renames can briefly
+  # make two interfaces have the same name.
+  defp delete_name(ifindex_by_name, ifname, ifindex) do
+    case ifindex_by_name do
+      %{^ifname => ^ifindex} -> Map.delete(ifindex_by_name, ifname)
+      _ -> ifindex_by_name
+    end
+  end
+
+  defp get_by_ifname(state, ifname) do
+    with {:ok, ifindex} <- Map.fetch(state.ifindex_by_name, ifname) do
+      {ifindex, Map.fetch!(state.interface_info, ifindex)}
+    end
+  end
+
+  # if_monitor includes the hardware path in link reports, so sysfs only
+  # needs to be read here when it couldn't
+  defp get_or_create_info(state, ifindex, ifname, link_report) do
     case Map.fetch(state.interface_info, ifindex) do
       {:ok, %{ifname: ^ifname} = info} ->
-        info
+        update_hw_path(info, link_report[:hw_path])
 
       {:ok, %{ifname: old_ifname} = info} ->
-        Info.clear_properties(old_ifname)
+        new_info = %{info | ifname: ifname, hw_path: link_report[:hw_path] || info.hw_path}
 
-        %{info | ifname: ifname}
-        |> Info.update_present()
-        |> Info.update_address_properties()
+        {new_info,
+         Info.clear_properties(old_ifname) ++
+           Info.present_properties(new_info) ++
+           Info.address_properties(new_info) ++
+           Info.gateway_properties(new_info) ++ Info.prefix_properties(new_info)}
 
       _missing ->
-        hw_path = HWPath.query(ifname)
+        hw_path = link_report[:hw_path] || HWPath.query(ifname)
+        new_info = Info.new(ifname, hw_path)
 
-        Info.new(ifname, hw_path)
-        |> Info.update_present()
+        {new_info, Info.present_properties(new_info)}
     end
   end
 
+  defp update_hw_path(%{hw_path: hw_path} = info, new_hw_path)
+       when new_hw_path in [nil, hw_path],
+       do: {info, []}
+
+  defp update_hw_path(info, new_hw_path) do
+    new_info = %{info | hw_path: new_hw_path}
+    {new_info, Info.present_properties(new_info)}
+  end
+
   defp get_or_create_info(state, ifindex) do
     case Map.fetch(state.interface_info, ifindex) do
       {:ok, info} ->
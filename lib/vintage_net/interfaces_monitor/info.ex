@@ -9,19 +9,50 @@ defmodule VintageNet.InterfacesMonitor.Info do
 
   @link_if_properties [:lower_up, :mac_address]
   @address_if_properties [:addresses]
+  @prefix_if_properties [:ipv6_prefixes]
 
-  @all_if_properties [:present, :hw_path] ++ @link_if_properties ++ @address_if_properties
+  # Lifetimes are whole seconds, so deadlines computed from reports of the
+  # same lifetime can differ by this much
+  @lifetime_slack_ms 2000
+
+  @all_if_properties [:present, :hw_path, :stats, :gateway_reachability] ++
+                       @link_if_properties ++ @address_if_properties ++ @prefix_if_properties
 
   defstruct ifname: nil,
             hw_path: "",
             link: %{},
-            addresses: []
+            addresses: %{},
+            next_address_seq: 0,
+            gateways: %{},
+            prefixes: %{}
+
+  @typedoc """
+  Neighbor table state of a default gateway
+  """
+  @type reachability() :: :reachable | :stale | :failed | :unknown
+
+  @typedoc """
+  Addresses are identified the same way that Linux identifies them
+  """
+  @type address_key() :: {:inet | :inet6, :inet.ip_address(), non_neg_integer()}
+
+  @typedoc """
+  Router advertisement prefixes are identified by the prefix and its length
+  """
+  @type prefix_key() :: {:inet.ip6_address(), non_neg_integer()}
 
+  # Addresses are kept in a map so that adding and removing them doesn't
+  # depend on how many there are. The sequence number remembers the order
+  # that they were added so that properties list the newest first. Prefixes
+  # are stored with when they expire in monotonic milliseconds.
   @type t() :: %__MODULE__{
           ifname: VintageNet.ifname(),
           hw_path: String.t(),
           link: map(),
-          addresses: [map()]
+          addresses: %{address_key() => {non_neg_integer(), map()}},
+          next_address_seq: non_neg_integer(),
+          gateways: %{:inet.ip_address() => reachability()},
+          prefixes: %{prefix_key() => {map(), integer() | :infinity}}
         }
 
   @doc """
@@ -63,12 +94,33 @@ defmodule VintageNet.InterfacesMonitor.Info do
     up: true
   }
   ```
+
+  Depending on the interface and the kernel version, link reports also have
+  `:hw_path`, `:perm_mac_address`, `:parent_dev`, `:parent_bus`, `:kind`
+  (e.g., `"vlan"` or `"bridge"`) and `:alt_ifnames`.
   """
   @spec newlink(t(), map()) :: t()
   def newlink(info, link_report) do
     %{info | link: link_report}
   end
 
+  @doc """
+  Merge a partial link report into the interface info
+
+  `if_monitor` only sends the fields that changed. Fields that are no longer
+  reported have `nil` values.
+  """
+  @spec updatelink(t(), map()) :: t()
+  def updatelink(info, link_changes) do
+    new_link =
+      Enum.reduce(link_changes, info.link, fn
+        {key, nil}, acc -> Map.delete(acc, key)
+        {key, value}, acc -> Map.put(acc, key, value)
+      end)
+
+    %{info | link: new_link}
+  end
+
   @doc """
   Add/replace an address report to the interface info
 
@@ -106,14 +158,71 @@ defmodule VintageNet.InterfacesMonitor.Info do
   ```elixir
   %{address: {0, 0, 0, 0, 0, 0, 0, 1}, family: :inet6, permanent: true, prefixlen: 128, scope: :host}
   ```
+
+  IPv6 address reports also have the duplicate address detection state and,
+  if Linux provided them, the preferred and valid lifetimes in seconds:
+
+  ```elixir
+  %{
+    address: {65152, 0, 0, 0, 26862, 36095, 65112, 5455},
+    dadfailed: false,
+    deprecated: false,
+    family: :inet6,
+    permanent: true,
+    preferred_lft: :infinity,
+    prefixlen: 64,
+    scope: :link,
+    tentative: false,
+    valid_lft: :infinity
+  }
+  ```
+
+  The lifetimes count down, so they're replaced with `:preferred_until` and
+  `:valid_until` deadlines using `now` in monotonic milliseconds. Deadlines
+  are only updated when a lifetime is extended or shortened. Otherwise every
+  refresh would look like a change.
   """
-  @spec newaddr(t(), map()) :: t()
-  def newaddr(info, address_report) do
-    info = deladdr(info, address_report)
+  @spec newaddr(t(), map(), integer()) :: t()
+  def newaddr(info, address_report, now) do
+    key = address_key(address_report)
+
+    previous_report =
+      case info.addresses do
+        %{^key => {_seq, report}} -> report
+        _ -> %{}
+      end
+
+    address_report =
+      address_report
+      |> Map.drop([:preferred_lft, :valid_lft])
+      |> put_deadline(:preferred_until, address_report[:preferred_lft], previous_report, now)
+      |> put_deadline(:valid_until, address_report[:valid_lft], previous_report, now)
+
+    if address_report == previous_report do
+      info
+    else
+      %{
+        info
+        | addresses: Map.put(info.addresses, key, {info.next_address_seq, address_report}),
+          next_address_seq: info.next_address_seq + 1
+      }
+    end
+  end
+
+  defp put_deadline(report, _key, nil, _previous_report, _now), do: report
 
-    new_addresses = [address_report | info.addresses]
+  defp put_deadline(report, key, lifetime, previous_report, now) do
+    deadline = if lifetime == :infinity, do: :infinity, else: now + lifetime * 1000
 
-    %{info | addresses: new_addresses}
+    case previous_report do
+      %{^key => previous}
+      when is_integer(previous) and is_integer(deadline) and
+             abs(previous - deadline) <= @lifetime_slack_ms ->
+        Map.put(report, key, previous)
+
+      _ ->
+        Map.put(report, key, deadline)
+    end
   end
 
   @doc """
@@ -121,11 +230,39 @@ defmodule VintageNet.InterfacesMonitor.Info do
   """
   @spec deladdr(t(), map()) :: t()
   def deladdr(info, address_report) do
-    new_addresses =
-      info.addresses
-      |> Enum.filter(fn entry -> entry.address != address_report.address end)
+    key = address_key(address_report)
+
+    if Map.has_key?(info.addresses, key) do
+      %{info | addresses: Map.delete(info.addresses, key)}
+    else
+      info
+    end
+  end
+
+  @doc """
+  Return the key that identifies an address report
+  """
+  @spec address_key(map()) :: address_key()
+  def address_key(address_report) do
+    {address_report.family, address_report.address, address_report.prefixlen}
+  end
+
+  @doc """
+  Return the address reports with the most recently added first
+  """
+  @spec addresses(t()) :: [map()]
+  def addresses(info) do
+    info.addresses
+    |> Enum.sort_by(fn {_key, {seq, _report}} -> seq end, :desc)
+    |> Enum.map(fn {_key, {_seq, report}} -> report end)
+  end
 
-    %{info | addresses: new_addresses}
+  @doc """
+  Remove all addresses whose keys aren't in the set
+  """
+  @spec retain_addresses(t(), MapSet.t(address_key())) :: t()
+  def retain_addresses(info, keys) do
+    filter_addresses(info, fn {key, _value} -> MapSet.member?(keys, key) end)
   end
 
   @doc """
@@ -133,64 +270,232 @@ defmodule VintageNet.InterfacesMonitor.Info do
   """
   @spec delete_ipv4_addresses(t()) :: t()
   def delete_ipv4_addresses(info) do
-    new_addresses =
-      info.addresses
-      |> Enum.filter(fn entry -> tuple_size(entry.address) != 4 end)
+    filter_addresses(info, fn {{family, _address, _prefixlen}, _value} -> family != :inet end)
+  end
+
+  # Return the same info if nothing was removed so that callers can
+  # cheaply tell that there's nothing to publish
+  defp filter_addresses(info, fun) do
+    new_addresses = Map.filter(info.addresses, fun)
+
+    if map_size(new_addresses) == map_size(info.addresses) do
+      info
+    else
+      %{info | addresses: new_addresses}
+    end
+  end
+
+  @doc """
+  Update the reachability of a default gateway
 
-    %{info | addresses: new_addresses}
+  Gateway reports have the form `%{address: {192, 168, 1, 1}, state: :reachable}`.
+  The state is `nil` when the address isn't a default gateway anymore.
+  """
+  @spec gateway(t(), map()) :: t()
+  def gateway(info, %{address: address, state: nil}) do
+    %{info | gateways: Map.delete(info.gateways, address)}
+  end
+
+  def gateway(info, %{address: address, state: state}) do
+    %{info | gateways: Map.put(info.gateways, address, state)}
   end
 
   @doc """
-  Clear out all properties exported by this module
+  Forget all gateways
   """
-  @spec clear_properties(VintageNet.ifname()) :: :ok
+  @spec clear_gateways(t()) :: t()
+  def clear_gateways(info) do
+    %{info | gateways: %{}}
+  end
+
+  @doc """
+  Add/replace a router advertisement prefix
+
+  Prefix reports have the form:
+
+  ```elixir
+  %{
+    autoconf: true,
+    family: :inet6,
+    on_link: true,
+    preferred_lft: 3600,
+    prefix: {8193, 3512, 1, 0, 0, 0, 0, 0},
+    prefixlen: 64,
+    valid_lft: 7200
+  }
+  ```
+
+  Linux doesn't report when prefixes expire, so the valid lifetime is turned
+  into a deadline using `now` in monotonic milliseconds. A valid lifetime of
+  0 removes the prefix.
+  """
+  @spec newprefix(t(), map(), integer()) :: t()
+  def newprefix(info, prefix_report, now) do
+    key = {prefix_report.prefix, prefix_report.prefixlen}
+    report = Map.drop(prefix_report, [:preferred_lft, :valid_lft])
+
+    case Map.get(prefix_report, :valid_lft, :infinity) do
+      0 -> %{info | prefixes: Map.delete(info.prefixes, key)}
+      :infinity -> %{info | prefixes: Map.put(info.prefixes, key, {report, :infinity})}
+      seconds -> %{info | prefixes: Map.put(info.prefixes, key, {report, now + seconds * 1000})}
+    end
+  end
+
+  @doc """
+  Remove prefixes that expired at or before `now`
+  """
+  @spec expire_prefixes(t(), integer()) :: t()
+  def expire_prefixes(info, now) do
+    new_prefixes =
+      Map.filter(info.prefixes, fn {_key, {_report, expires}} ->
+        expires == :infinity or expires > now
+      end)
+
+    if map_size(new_prefixes) == map_size(info.prefixes) do
+      info
+    else
+      %{info | prefixes: new_prefixes}
+    end
+  end
+
+  @doc """
+  Return when the next prefix expires or `nil` if none do
+  """
+  @spec next_prefix_expiry(t()) :: integer() | nil
+  def next_prefix_expiry(info) do
+    info.prefixes
+    |> Enum.map(fn {_key, {_report, expires}} -> expires end)
+    |> Enum.filter(&is_integer/1)
+    |> Enum.min(fn -> nil end)
+  end
+
+  @typedoc """
+  A property update
+
+  A `nil` value means that the property should be deleted.
+  """
+  @type property_change() :: {PropertyTable.property(), PropertyTable.value() | nil}
+
+  @doc """
+  Return property changes that clear out all properties exported by this module
+  """
+  @spec clear_properties(VintageNet.ifname()) :: [property_change()]
   def clear_properties(ifname) do
-    Enum.each(@all_if_properties, fn property ->
-      PropertyTable.delete(VintageNet, ["interface", ifname, to_string(property)])
-    end)
+    for property <- @all_if_properties do
+      {["interface", ifname, to_string(property)], nil}
+    end
   end
 
   @doc """
-  Report that the interface is present
+  Return property changes that report that the interface is present
   """
-  @spec update_present(t()) :: t()
-  def update_present(%__MODULE__{ifname: ifname} = info) do
-    PropertyTable.put_many(VintageNet, [
+  @spec present_properties(t()) :: [property_change()]
+  def present_properties(%__MODULE__{ifname: ifname} = info) do
+    [
       {["interface", ifname, "present"], true},
       {["interface", ifname, "hw_path"], info.hw_path}
-    ])
+    ]
+  end
+
+  @doc """
+  Return property changes for link-specific properties
+  """
+  @spec link_properties(t()) :: [property_change()]
+  def link_properties(%__MODULE__{ifname: ifname, link: link_report}) do
+    for property <- @link_if_properties do
+      {["interface", ifname, to_string(property)], Map.get(link_report, property)}
+    end
+  end
 
-    info
+  @doc """
+  Return property changes for address-specific properties
+  """
+  @spec address_properties(t()) :: [property_change()]
+  def address_properties(%__MODULE__{ifname: ifname} = info) do
+    [{["interface", ifname, "addresses"], address_reports_to_property(addresses(info))}]
   end
 
   @doc """
-  Update link-specific properties
+  Return the property change for router advertisement prefixes
+
+  The property is removed when there aren't any prefixes.
   """
-  @spec update_link_properties(t()) :: t()
-  def update_link_properties(%__MODULE__{ifname: ifname, link: link_report} = info) do
-    Enum.each(@link_if_properties, fn property ->
-      update_link_property(ifname, property, Map.get(link_report, property))
-    end)
+  @spec prefix_properties(t()) :: [property_change()]
+  def prefix_properties(%__MODULE__{ifname: ifname, prefixes: prefixes}) do
+    value =
+      if prefixes != %{} do
+        for {_key, {report, _expires}} <- Enum.sort(prefixes) do
+          %{
+            prefix: report.prefix,
+            prefix_length: report.prefixlen,
+            on_link: report.on_link,
+            autoconf: report.autoconf
+          }
+        end
+      end
 
-    info
+    [{["interface", ifname, "ipv6_prefixes"], value}]
   end
 
-  defp update_link_property(ifname, property, nil) do
-    PropertyTable.delete(VintageNet, ["interface", ifname, to_string(property)])
+  @doc """
+  Return the property change for gateway reachability
+
+  Interfaces with more than one default gateway, like ones with IPv4 and IPv6
+  routes, report the best state. The property is removed when there aren't
+  any default gateways.
+  """
+  @spec gateway_properties(t()) :: [property_change()]
+  def gateway_properties(%__MODULE__{ifname: ifname, gateways: gateways}) do
+    value =
+      [:reachable, :stale, :unknown, :failed]
+      |> Enum.find(fn state -> state in Map.values(gateways) end)
+
+    [{["interface", ifname, "gateway_reachability"], value}]
   end
 
-  defp update_link_property(ifname, property, value) do
-    PropertyTable.put(VintageNet, ["interface", ifname, to_string(property)], value)
+  @doc """
+  Return the property change for a stats sample from `if_monitor`
+
+  Samples are big endian 64-bit counters followed by rates that were computed
+  from the previous sample. Rates are 0 for the first sample.
+  """
+  @spec stats_properties(VintageNet.ifname(), binary()) :: [property_change()]
+  def stats_properties(
+        ifname,
+        <<rx_bytes::64, tx_bytes::64, rx_packets::64, tx_packets::64, rx_errors::64,
+          tx_errors::64, rx_dropped::64, tx_dropped::64, rx_bytes_per_sec::64,
+          tx_bytes_per_sec::64, rx_packets_per_sec::64, tx_packets_per_sec::64>>
+      ) do
+    stats = %{
+      rx_bytes: rx_bytes,
+      tx_bytes: tx_bytes,
+      rx_packets: rx_packets,
+      tx_packets: tx_packets,
+      rx_errors: rx_errors,
+      tx_errors: tx_errors,
+      rx_dropped: rx_dropped,
+      tx_dropped: tx_dropped,
+      rx_bytes_per_sec: rx_bytes_per_sec,
+      tx_bytes_per_sec: tx_bytes_per_sec,
+      rx_packets_per_sec: rx_packets_per_sec,
+      tx_packets_per_sec: tx_packets_per_sec
+    }
+
+    [{["interface", ifname, "stats"], stats}]
   end
 
   @doc """
-  Update address-specific properties
+  Apply property changes to the property table
+
+  Puts are batched into one `PropertyTable.put_many/2` call.
   """
-  @spec update_address_properties(t()) :: t()
-  def update_address_properties(%__MODULE__{ifname: ifname, addresses: address_reports} = info) do
-    addresses = address_reports_to_property(address_reports)
-    PropertyTable.put(VintageNet, ["interface", ifname, "addresses"], addresses)
-    info
+  @spec publish(Enumerable.t(property_change())) :: :ok
+  def publish(changes) do
+    {deletes, puts} = Enum.split_with(changes, fn {_property, value} -> value == nil end)
+
+    if puts != [], do: PropertyTable.put_many(VintageNet, puts)
+
+    Enum.each(deletes, fn {property, _value} -> PropertyTable.delete(VintageNet, property) end)
   end
 
   defp address_reports_to_property(address_reports) do
@@ -208,6 +513,24 @@ defmodule VintageNet.InterfacesMonitor.Info do
         prefix_length: report.prefixlen,
         netmask: IP.prefix_length_to_subnet_mask(report.family, report.prefixlen)
       }
+      |> put_address_state(report)
+      |> Map.merge(Map.take(report, [:preferred_until, :valid_until]))
     end
   end
+
+  # Only IPv6 reports have duplicate address detection state. Addresses
+  # shouldn't be used as sources until they're preferred.
+  defp put_address_state(address_info, %{dadfailed: true}),
+    do: Map.put(address_info, :state, :dad_failed)
+
+  defp put_address_state(address_info, %{tentative: true}),
+    do: Map.put(address_info, :state, :tentative)
+
+  defp put_address_state(address_info, %{deprecated: true}),
+    do: Map.put(address_info, :state, :deprecated)
+
+  defp put_address_state(address_info, %{tentative: false}),
+    do: Map.put(address_info, :state, :preferred)
+
+  defp put_address_state(address_info, _report), do: address_info
 end
@@ -63,6 +63,7 @@ defmodule VintageNet.IP.DhcpdConfig do
   """
 
   alias VintageNet.{Command, IP}
+  alias VintageNet.DHCP.LeaseWatcher
   alias VintageNet.Interface.RawConfig
 
   @ip_list_options [:dns, :router]
@@ -210,23 +211,44 @@ defmodule VintageNet.IP.DhcpdConfig do
         ]
 
     %{raw_config | files: new_files, child_specs: new_child_specs}
+    |> add_lease_watcher(ifname, tmpdir)
   end
 
   def add_config(raw_config, _config_without_dhcpd, _opts), do: raw_config
 
+  # The lease_watcher port reports lease changes. See `notify_file/0` for
+  # when udhcpd still notifies the `:udhcpd_handler`.
+  defp add_lease_watcher(raw_config, ifname, tmpdir) do
+    if LeaseWatcher.available?() do
+      lease_file = lease_file_path(ifname, tmpdir)
+
+      %{
+        raw_config
+        | up_cmds: raw_config.up_cmds ++ [{:fun, LeaseWatcher, :watch, [ifname, lease_file]}],
+          down_cmds: raw_config.down_cmds ++ [{:fun, LeaseWatcher, :unwatch, [ifname]}]
+      }
+    else
+      raw_config
+    end
+  end
+
+  defp lease_file_path(ifname, tmpdir), do: Path.join(tmpdir, "udhcpd.#{ifname}.leases")
+
   defp udhcpd_contents(ifname, dhcpd, tmpdir) do
     pidfile = Path.join(tmpdir, "udhcpd.#{ifname}.pid")
-    lease_file = Path.join(tmpdir, "udhcpd.#{ifname}.leases")
 
     initial = """
     interface #{ifname}
     pidfile #{pidfile}
-    lease_file #{lease_file}
-    notify_file #{BEAMNotify.bin_path()}
+    lease_file #{lease_file_path(ifname, tmpdir)}
     """
 
     config = dhcpd |> Enum.sort() |> Enum.map(&to_udhcpd_string/1)
-    IO.chardata_to_string([initial, "\n", config, "\n"])
+    IO.chardata_to_string([initial, notify_file(), "\n", config, "\n"])
+  end
+
+  defp notify_file() do
+    if LeaseWatcher.notify_file?(), do: ["notify_file ", BEAMNotify.bin_path(), "\n"], else: []
   end
 
   defp to_udhcpd_string({:start, val}) do
@@ -19,8 +19,10 @@ defmodule VintageNet.IP.IPv4Config do
     request from the DHCP server beyond udhcpc's defaults. Each entry is passed
     through to udhcpc as `-O <entry>`. Either symbolic names ("wpad", "sipsrv")
     or numeric option codes ("252") are accepted; what's recognized depends on
-    the busybox version in use. Defaults to `[]`. Values that the DHCP server
-    returns are parsed by `VintageNet.DHCP.Options` and exposed via the
+    the busybox version in use. The built-in `dhcp_client` accepts the names of
+    options that `VintageNet.DHCP.Options` knows about and numbers. Defaults to
+    `[]`. Values that the DHCP server returns are parsed by
+    `VintageNet.DHCP.Options` and exposed via the
     `["interface", ifname, "dhcp_options"]` property. Requesting additional
     options changes the contents of the DHCP request, which some networks use
     to classify or segment clients (for example, fingerprint-based VLAN
@@ -40,6 +42,8 @@ defmodule VintageNet.IP.IPv4Config do
   """
 
   alias VintageNet.Command
+  alias VintageNet.DHCP.Client
+  alias VintageNet.DHCP.EventChannel
   alias VintageNet.Interface.RawConfig
   alias VintageNet.IP
 
@@ -148,14 +152,11 @@ defmodule VintageNet.IP.IPv4Config do
         _opts
       ) do
     # Even though IPv4 is disabled, the interface is still brought up
-    new_up_cmds = up_cmds ++ [{:run, "ip", ["link", "set", ifname, "up"]}]
+    new_up_cmds = up_cmds ++ [{:link_ops, [{:link_up, ifname}]}]
 
     new_down_cmds =
       down_cmds ++
-        [
-          {:run_ignore_errors, "ip", ["addr", "flush", "dev", ifname, "label", ifname]},
-          {:run, "ip", ["link", "set", ifname, "down"]}
-        ]
+        [{:link_ops, [{:flush_addresses, ifname, ifname}, {:link_down, ifname}]}]
 
     %{raw_config | up_cmds: new_up_cmds, down_cmds: new_down_cmds}
   end
@@ -170,50 +171,19 @@ defmodule VintageNet.IP.IPv4Config do
         %{ipv4: %{method: :dhcp}} = config,
         _opts
       ) do
-    new_up_cmds = up_cmds ++ [{:run, "ip", ["link", "set", ifname, "up"]}]
+    new_up_cmds = up_cmds ++ [{:link_ops, [{:link_up, ifname}]}]
 
     new_down_cmds =
       down_cmds ++
-        [
-          {:run_ignore_errors, "ip", ["addr", "flush", "dev", ifname, "label", ifname]},
-          {:run, "ip", ["link", "set", ifname, "down"]}
-        ]
+        [{:link_ops, [{:flush_addresses, ifname, ifname}, {:link_down, ifname}]}]
 
     hostname = config[:hostname] || get_hostname()
-
-    request_option_args =
-      config.ipv4
-      |> Map.get(:dhcp_request_options, [])
-      |> Enum.flat_map(&["-O", &1])
+    request_options = Map.get(config.ipv4, :dhcp_request_options, [])
 
     new_child_specs =
       child_specs ++
         [
-          Supervisor.child_spec(
-            {VintageNet.Interface.IfupDaemon,
-             [
-               ifname: ifname,
-               command: "udhcpc",
-               args:
-                 [
-                   "-f",
-                   "-i",
-                   ifname,
-                   "-x",
-                   "hostname:#{hostname}",
-                   "-s",
-                   BEAMNotify.bin_path()
-                 ] ++ request_option_args,
-               opts:
-                 Command.add_muon_options(
-                   stderr_to_stdout: true,
-                   log_output: :debug,
-                   log_prefix: "udhcpc(#{ifname}): ",
-                   env: BEAMNotify.env(name: "vintage_net_comm", report_env: true)
-                 )
-             ]},
-            id: :udhcpc
-          ),
+          dhcp_child_spec(ifname, hostname, request_options),
           {VintageNet.Connectivity.InternetChecker, ifname}
         ]
 
@@ -230,10 +200,7 @@ defmodule VintageNet.IP.IPv4Config do
         %{ipv4: %{method: :static} = ipv4},
         _opts
       ) do
-    addr_subnet = IP.cidr_to_string(ipv4.address, ipv4.prefix_length)
-
-    broadcast_addr =
-      IP.ipv4_broadcast_address(ipv4.address, ipv4.prefix_length) |> IP.ip_to_string()
+    broadcast_addr = IP.ipv4_broadcast_address(ipv4.address, ipv4.prefix_length)
 
     route_manager_up =
       case ipv4[:gateway] do
@@ -255,20 +222,13 @@ defmodule VintageNet.IP.IPv4Config do
     new_up_cmds =
       up_cmds ++
         [
-          {:run_ignore_errors, "ip", ["addr", "flush", "dev", ifname, "label", ifname]},
-          {:run, "ip",
+          {:link_ops,
            [
-             "addr",
-             "add",
-             addr_subnet,
-             "dev",
-             ifname,
-             "broadcast",
-             broadcast_addr,
-             "label",
-             ifname
+             {:flush_addresses, ifname, ifname},
+             {:add_address, ifname, ipv4.address, ipv4.prefix_length,
+              broadcast: broadcast_addr, label: ifname},
+             {:link_up, ifname}
            ]},
-          {:run, "ip", ["link", "set", ifname, "up"]},
           route_manager_up,
           resolver_up
         ]
@@ -278,8 +238,7 @@ defmodule VintageNet.IP.IPv4Config do
         [
           {:fun, VintageNet.RouteManager, :clear_route, [ifname]},
           {:fun, VintageNet.NameResolver, :clear, [ifname]},
-          {:run_ignore_errors, "ip", ["addr", "flush", "dev", ifname, "label", ifname]},
-          {:run, "ip", ["link", "set", ifname, "down"]}
+          {:link_ops, [{:flush_addresses, ifname, ifname}, {:link_down, ifname}]}
         ]
 
     # If there's a default gateway, then check for internet connectivity.
@@ -294,6 +253,49 @@ defmodule VintageNet.IP.IPv4Config do
     %{raw_config | up_cmds: new_up_cmds, down_cmds: new_down_cmds, child_specs: new_child_specs}
   end
 
+  defp dhcp_child_spec(ifname, hostname, request_options) do
+    if Client.available?() do
+      Supervisor.child_spec(
+        {VintageNet.Interface.DHCPClient,
+         [ifname: ifname, hostname: hostname, request_options: request_options]},
+        id: :dhcp_client
+      )
+    else
+      udhcpc_child_spec(ifname, hostname, request_options)
+    end
+  end
+
+  defp udhcpc_child_spec(ifname, hostname, request_options) do
+    {script, script_env} = EventChannel.udhcpc_script()
+    request_option_args = Enum.flat_map(request_options, &["-O", &1])
+
+    Supervisor.child_spec(
+      {VintageNet.Interface.IfupDaemon,
+       [
+         ifname: ifname,
+         command: "udhcpc",
+         args:
+           [
+             "-f",
+             "-i",
+             ifname,
+             "-x",
+             "hostname:#{hostname}",
+             "-s",
+             script
+           ] ++ request_option_args,
+         opts:
+           Command.add_muon_options(
+             stderr_to_stdout: true,
+             log_output: :debug,
+             log_prefix: "udhcpc(#{ifname}): ",
+             env: script_env
+           )
+       ]},
+      id: :udhcpc
+    )
+  end
+
   defp get_hostname() do
     {:ok, hostname} = :inet.gethostname()
     to_string(hostname)
@@ -21,16 +21,22 @@ defmodule VintageNet.NameResolver do
   It is expected that each network interface provides a configuration. This
   module will track configurations to network interfaces so that it can reflect
   which resolvers are around. Resolver order isn't handled.
+
+  If the `:dns_cache` application environment key is `true`, "/etc/resolv.conf"
+  only lists 127.0.0.1 and `VintageNet.Resolver.DNSCache` forwards queries to
+  the name servers in priority order. The name servers are listed like usual
+  if the cache isn't running.
   """
   use GenServer
   alias VintageNet.IP
-  alias VintageNet.Resolver.ResolvConf
+  alias VintageNet.Resolver.{DNSCache, ResolvConf}
   require Logger
 
   @type state() :: %{
           path: String.t(),
           entries: ResolvConf.entry_map(),
-          additional_name_servers: ResolvConf.additional_name_servers()
+          additional_name_servers: ResolvConf.additional_name_servers(),
+          dns_cache?: boolean()
         }
 
   @doc """
@@ -40,10 +46,11 @@ defmodule VintageNet.NameResolver do
 
   * `resolvconf` - path to the resolvconf file
   * `additional_name_servers` - list of additional servers
+  * `dns_cache` - `true` to send queries to the local DNS cache
   """
   @spec start_link(keyword) :: GenServer.on_start()
   def start_link(args) do
-    relevant_args = Keyword.take(args, [:resolvconf, :additional_name_servers])
+    relevant_args = Keyword.take(args, [:resolvconf, :additional_name_servers, :dns_cache])
     GenServer.start_link(__MODULE__, relevant_args, name: __MODULE__)
   end
 
@@ -82,6 +89,14 @@ defmodule VintageNet.NameResolver do
     GenServer.call(__MODULE__, :clear_all)
   end
 
+  @doc """
+  List the name servers in "/etc/resolv.conf" since the DNS cache stopped
+  """
+  @spec dns_cache_stopped() :: :ok
+  def dns_cache_stopped() do
+    GenServer.cast(__MODULE__, :dns_cache_stopped)
+  end
+
   ## GenServer
 
   @impl GenServer
@@ -96,7 +111,8 @@ defmodule VintageNet.NameResolver do
     state = %{
       path: resolvconf_path,
       entries: %{},
-      additional_name_servers: additional_name_servers
+      additional_name_servers: additional_name_servers,
+      dns_cache?: DNSCache.available?(args) and DNSCache.running?()
     }
 
     refresh(state)
@@ -126,13 +142,28 @@ defmodule VintageNet.NameResolver do
     {:reply, :ok, state}
   end
 
+  @impl GenServer
+  def handle_cast(:dns_cache_stopped, state) do
+    state = %{state | dns_cache?: false}
+    refresh(state)
+    {:noreply, state}
+  end
+
   defp refresh(%{
          path: path,
          entries: entries,
-         additional_name_servers: additional_name_servers
+         additional_name_servers: additional_name_servers,
+         dns_cache?: dns_cache?
        }) do
+    contents =
+      if dns_cache? do
+        ResolvConf.to_dns_cache_config(entries)
+      else
+        ResolvConf.to_config(entries, additional_name_servers)
+      end
+
     # Update the resolv.conf file and ensure world readable for other programs
-    File.write!(path, ResolvConf.to_config(entries, additional_name_servers))
+    File.write!(path, contents)
     File.chmod!(path, 0o644)
 
     # Let VintageNet users know the latest
@@ -0,0 +1,125 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.NetlinkCtl do
+  @moduledoc false
+
+  # Apply link, address and routing table changes with the `netlink_ctl` port
+  #
+  # All of the operations passed to `run/1` are sent to the kernel together
+  # and a result is returned for each one. This avoids starting an `ip`
+  # process per change. Callers should fall back to `ip` when this returns
+  # `:unavailable`. The port is only used when the `:native_routes`
+  # application environment key is `true`.
+
+  use GenServer
+
+  require Logger
+
+  # Must match MAX_OPS in netlink_ctl.c
+  @max_ops 256
+
+  @typedoc """
+  A netlink operation
+
+  Route maps support `:ifname`, `:dst`, `:dst_len`, `:gateway`, `:prefsrc`,
+  `:priority`, `:scope` and `:table`. Rule maps support `:src`, `:src_len`,
+  `:priority` and `:table`. Link maps support `:ifname` and `:up`. Address
+  maps support `:ifname`, `:address`, `:prefix_len`, `:broadcast` and
+  `:label`. Flushes remove every address on `:ifname` that has `:label`.
+  """
+  @type op() :: {op_name(), map()}
+
+  @type op_name() ::
+          :newroute
+          | :delroute
+          | :newrule
+          | :delrule
+          | :setlink
+          | :newaddr
+          | :deladdr
+          | :flushaddr
+
+  @type result() :: :ok | {:error, String.t()}
+
+  defstruct port: nil, waiters: :queue.new()
+
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @doc """
+  Run a list of operations and return their results in order
+  """
+  @spec run([op()]) :: {:ok, [result()]} | :unavailable
+  def run([]), do: {:ok, []}
+
+  def run(ops) do
+    # netlink_ctl bounds how long the kernel has to respond, so there's no
+    # timeout here. Timing out and then running `ip` would apply the changes
+    # twice.
+    GenServer.call(__MODULE__, {:run, ops}, :infinity)
+  catch
+    :exit, {:noproc, _} -> :unavailable
+  end
+
+  @impl GenServer
+  def init(_args) do
+    executable = :code.priv_dir(:vintage_net) ++ ~c"/netlink_ctl"
+    enabled? = Application.get_env(:vintage_net, :native_routes, false)
+
+    if enabled? and File.exists?(executable) do
+      port =
+        Port.open({:spawn_executable, executable}, [
+          {:packet, 2},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      {:ok, %__MODULE__{port: port}}
+    else
+      {:ok, %__MODULE__{}}
+    end
+  end
+
+  @impl GenServer
+  def handle_call({:run, _ops}, _from, %{port: nil} = state) do
+    {:reply, :unavailable, state}
+  end
+
+  def handle_call({:run, ops}, from, state) do
+    chunks = Enum.chunk_every(ops, @max_ops)
+    Enum.each(chunks, &Port.command(state.port, :erlang.term_to_binary(&1)))
+
+    {:noreply, %{state | waiters: :queue.in({from, length(chunks), []}, state.waiters)}}
+  end
+
+  @impl GenServer
+  def handle_info({port, {:data, raw_results}}, %{port: port} = state) do
+    results = :erlang.binary_to_term(raw_results)
+    {{:value, {from, chunks_left, acc}}, waiters} = :queue.out(state.waiters)
+
+    # Responses come back in the order that requests were sent
+    waiters =
+      if chunks_left == 1 do
+        GenServer.reply(from, {:ok, acc ++ results})
+        waiters
+      else
+        :queue.in_r({from, chunks_left - 1, acc ++ results}, waiters)
+      end
+
+    {:noreply, %{state | waiters: waiters}}
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("netlink_ctl exited with status #{status}")
+    {:stop, {:port_exited, status}, state}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+end
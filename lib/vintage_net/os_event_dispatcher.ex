@@ -8,6 +8,8 @@ defmodule VintageNet.OSEventDispatcher do
   alias VintageNet.DHCP.Options
   require Logger
 
+  @udhcpc_ops ["deconfig", "leasefail", "nak", "renew", "bound"]
+
   @doc """
   Called by BEAMNotify to report OS events
 
@@ -20,19 +22,9 @@ defmodule VintageNet.OSEventDispatcher do
   OS environment.
   """
   @spec dispatch([String.t()], %{String.t() => String.t()}) :: :ok
-  def dispatch([op], %{"interface" => ifname} = info)
-      when op in ["deconfig", "leasefail", "nak", "renew", "bound"] do
+  def dispatch([op], %{"interface" => ifname} = info) when op in @udhcpc_ops do
     # udhcpc update
-    handler = Application.get_env(:vintage_net, :udhcpc_handler)
-    dhcp_options = Options.udhcpc_to_options(info)
-
-    if op in ["deconfig", "leasefail", "nak"] do
-      PropertyTable.delete(VintageNet, ["interface", ifname, "dhcp_options"])
-    else
-      PropertyTable.put(VintageNet, ["interface", ifname, "dhcp_options"], dhcp_options)
-    end
-
-    apply(handler, String.to_atom(op), [ifname, dhcp_options])
+    dispatch_udhcpc(op, ifname, Options.udhcpc_to_options(info))
   end
 
   def dispatch([lease_file], _env) do
@@ -51,6 +43,24 @@ defmodule VintageNet.OSEventDispatcher do
     Logger.warning("VintageNet: dropping unexpected notification: #{inspect(args)}")
   end
 
+  @doc """
+  Report a udhcpc event whose options have already been parsed
+
+  `VintageNet.DHCP.EventChannel` calls this for reports from `udhcpc_notify`.
+  """
+  @spec dispatch_udhcpc(String.t(), VintageNet.ifname(), Options.t()) :: :ok
+  def dispatch_udhcpc(op, ifname, dhcp_options) when op in @udhcpc_ops do
+    handler = Application.get_env(:vintage_net, :udhcpc_handler)
+
+    if op in ["deconfig", "leasefail", "nak"] do
+      PropertyTable.delete(VintageNet, ["interface", ifname, "dhcp_options"])
+    else
+      PropertyTable.put(VintageNet, ["interface", ifname, "dhcp_options"], dhcp_options)
+    end
+
+    apply(handler, String.to_atom(op), [ifname, dhcp_options])
+  end
+
   defp extract_lease_file_ifname(path) do
     # "/tmp/vintage_net/udhcpd.wlan0.leases"
     base = Path.basename(path)
@@ -26,6 +26,9 @@ defmodule VintageNet.OSEventDispatcher.UdhcpdHandler do
   # ```elixir
   # config :vintage_net, udhcpd_handler: MyApp.UdhcpdHandler
   # ```
+  #
+  # Custom handlers are still called when `:native_lease_watcher` is enabled.
+  # Only the default handler is replaced by `VintageNet.DHCP.LeaseWatcher`.
 
   @doc """
   The DHCP lease file was updated
@@ -5,6 +5,9 @@
 defmodule VintageNet.Persistence do
   @moduledoc """
   Customize the way VintageNet saves and loads configurations
+
+  Implementations that need a process can define `child_spec/1`. VintageNet
+  starts it before network interfaces and stops it after them.
   """
 
   @doc """
@@ -29,6 +32,46 @@ defmodule VintageNet.Persistence do
   """
   @callback clear(ifname :: String.t()) :: :ok
 
+  @doc """
+  Load the configurations of several interfaces
+
+  This is called when VintageNet starts. It's optional and only needed if
+  loading the configurations together is faster than calling `load/1` for each
+  one. For example, if they're all saved in one file.
+  """
+  @callback load_all(ifnames :: [String.t()]) :: [
+              {String.t(), {:ok, map()} | {:error, reason :: any()}}
+            ]
+
+  @optional_callbacks load_all: 1
+
+  @doc false
+  @spec child_specs(keyword()) :: [Supervisor.child_spec()]
+  def child_specs(args) do
+    module = Application.get_env(:vintage_net, :persistence)
+
+    if Code.ensure_loaded?(module) and function_exported?(module, :child_spec, 1) do
+      [module.child_spec(args)]
+    else
+      []
+    end
+  end
+
+  @doc false
+  @spec load_all([VintageNet.ifname()]) :: [{VintageNet.ifname(), {:ok, map()} | {:error, any()}}]
+  def load_all(ifnames) do
+    module = Application.get_env(:vintage_net, :persistence)
+
+    if Code.ensure_loaded?(module) and function_exported?(module, :load_all, 1) do
+      module.load_all(ifnames)
+    else
+      # Decrypting saved configurations is slow enough to do them in parallel
+      ifnames
+      |> Task.async_stream(&{&1, module.load(&1)}, timeout: :infinity)
+      |> Enum.map(fn {:ok, result} -> result end)
+    end
+  end
+
   @spec call(atom(), [any()]) :: any()
   def call(fun, args) do
     Application.get_env(:vintage_net, :persistence)
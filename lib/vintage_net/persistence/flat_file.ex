@@ -53,16 +53,20 @@ defmodule VintageNet.Persistence.FlatFile do
   def enumerate() do
     case File.ls(persistence_dir()) do
       {:ok, files} ->
-        # Sorting the filenames is mostly for the unit tests, but it feels
-        # good making this deterministic.
-        Enum.sort(files)
+        # Hidden files aren't configurations. Sorting the filenames is mostly
+        # for the unit tests, but it feels good making this deterministic.
+        files
+        |> Enum.reject(&String.starts_with?(&1, "."))
+        |> Enum.sort()
 
       _other ->
         []
     end
   end
 
-  defp serialize_config(config) do
+  @doc false
+  @spec serialize_config(map()) :: binary()
+  def serialize_config(config) do
     secret_key = good_secret_key()
     plaintext = :erlang.term_to_binary(config)
     iv = :crypto.strong_rand_bytes(16)
@@ -70,7 +74,9 @@ defmodule VintageNet.Persistence.FlatFile do
     <<@version, iv::16-bytes, tag::16-bytes, ciphertext::binary>>
   end
 
-  defp deserialize_config(<<@version, iv::16-bytes, tag::16-bytes, ciphertext::binary>>) do
+  @doc false
+  @spec deserialize_config(binary()) :: {:ok, map()} | {:error, atom()}
+  def deserialize_config(<<@version, iv::16-bytes, tag::16-bytes, ciphertext::binary>>) do
     secret_key = good_secret_key()
 
     case decrypt(secret_key, iv, ciphertext, tag) do
@@ -82,7 +88,7 @@ defmodule VintageNet.Persistence.FlatFile do
     end
   end
 
-  defp deserialize_config(_anything_else), do: {:error, :corrupt}
+  def deserialize_config(_anything_else), do: {:error, :corrupt}
 
   if :erlang.system_info(:otp_release) == ~c"21" do
     # Remove when OTP 21 is no longer supported.
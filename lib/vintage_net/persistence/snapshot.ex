@@ -0,0 +1,258 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Persistence.Snapshot do
+  @moduledoc """
+  Save configurations to one file with batched writes
+
+  This is an alternative to `VintageNet.Persistence.FlatFile` for devices that
+  save several configurations at once, like when being provisioned. Saves are
+  collected for a short time and then written together to a temporary file
+  that is synced and renamed over the snapshot. That's one fsync per batch and
+  the snapshot is never partially written. Configurations are encrypted the
+  same way as `FlatFile` encrypts them.
+
+  Since writes are delayed, a configuration saved right before power is lost
+  may not be on disk. Call `flush/0` to write pending changes immediately.
+  Pending changes are also written when VintageNet stops. The rename isn't
+  followed by syncing the directory since Erlang can't open directories, so
+  on some filesystems, power loss right after a write can leave the previous
+  snapshot in place.
+
+  To use, configure `vintage_net` like this:
+
+  ```elixir
+  config :vintage_net,
+    persistence: VintageNet.Persistence.Snapshot
+  ```
+
+  Configurations that `FlatFile` saved in the `persistence_dir` are still
+  loaded until they're saved again.
+  """
+  @behaviour VintageNet.Persistence
+
+  use GenServer
+  require Logger
+  alias VintageNet.Persistence.FlatFile
+
+  # The snapshot is :erlang.term_to_binary of a map of interface names to
+  # configurations encrypted by FlatFile, so enumerating doesn't decrypt
+  # anything. The name is hidden so that FlatFile doesn't list it.
+  @snapshot_name ".snapshot"
+
+  # How long to collect saves before writing them
+  @write_delay 250
+
+  @typedoc """
+  Write statistics
+
+  * `:saves` - number of saves and clears
+  * `:writes` - number of times the snapshot was written
+  * `:last_write_usec` - how long the last write took
+  * `:max_write_usec` - how long the slowest write took
+  """
+  @type stats() :: %{
+          saves: non_neg_integer(),
+          writes: non_neg_integer(),
+          last_write_usec: non_neg_integer() | nil,
+          max_write_usec: non_neg_integer()
+        }
+
+  @doc false
+  @spec start_link(any()) :: GenServer.on_start()
+  def start_link(args) do
+    GenServer.start_link(__MODULE__, args, name: __MODULE__)
+  end
+
+  @impl VintageNet.Persistence
+  def save(ifname, config) do
+    encrypted = FlatFile.serialize_config(config)
+    call({:save, ifname, encrypted}, &Map.put(&1, ifname, encrypted))
+  end
+
+  @impl VintageNet.Persistence
+  def load(ifname), do: load_entry(entries(), ifname)
+
+  @impl VintageNet.Persistence
+  def load_all(ifnames) do
+    # This runs before the GenServer starts, so read the snapshot once here
+    # rather than for each interface
+    entries = entries()
+
+    ifnames
+    |> Task.async_stream(&{&1, load_entry(entries, &1)}, timeout: :infinity)
+    |> Enum.map(fn {:ok, result} -> result end)
+  end
+
+  defp load_entry(entries, ifname) do
+    case Map.fetch(entries, ifname) do
+      {:ok, encrypted} -> FlatFile.deserialize_config(encrypted)
+      :error -> FlatFile.load(ifname)
+    end
+  end
+
+  @impl VintageNet.Persistence
+  def clear(ifname) do
+    :ok = FlatFile.clear(ifname)
+    call({:clear, ifname}, &Map.delete(&1, ifname))
+  end
+
+  @impl VintageNet.Persistence
+  def enumerate() do
+    (Map.keys(entries()) ++ FlatFile.enumerate())
+    |> Enum.uniq()
+    |> Enum.sort()
+  end
+
+  @doc """
+  Write pending changes now
+  """
+  @spec flush() :: :ok | {:error, File.posix()}
+  def flush() do
+    GenServer.call(__MODULE__, :flush)
+  end
+
+  @doc """
+  Return write statistics
+  """
+  @spec stats() :: stats()
+  def stats() do
+    GenServer.call(__MODULE__, :stats)
+  end
+
+  # Changes are written immediately if the GenServer isn't running. This
+  # happens before VintageNet starts and in unit tests.
+  defp call(request, update_fun) do
+    GenServer.call(__MODULE__, request)
+  catch
+    :exit, {:noproc, _} -> read_entries() |> update_fun.() |> write_entries()
+  end
+
+  defp entries() do
+    GenServer.call(__MODULE__, :entries)
+  catch
+    :exit, {:noproc, _} -> read_entries()
+  end
+
+  @impl GenServer
+  def init(_args) do
+    # Trap exits so that pending changes are written on shutdown
+    Process.flag(:trap_exit, true)
+
+    state = %{
+      entries: read_entries(),
+      dirty?: false,
+      timer: nil,
+      stats: %{saves: 0, writes: 0, last_write_usec: nil, max_write_usec: 0}
+    }
+
+    {:ok, state}
+  end
+
+  @impl GenServer
+  def handle_call({:save, ifname, encrypted}, _from, state) do
+    {:reply, :ok, changed(state, Map.put(state.entries, ifname, encrypted))}
+  end
+
+  def handle_call({:clear, ifname}, _from, state) do
+    if Map.has_key?(state.entries, ifname) do
+      {:reply, :ok, changed(state, Map.delete(state.entries, ifname))}
+    else
+      {:reply, :ok, state}
+    end
+  end
+
+  def handle_call(:entries, _from, state) do
+    {:reply, state.entries, state}
+  end
+
+  def handle_call(:flush, _from, state) do
+    {result, state} = write(state)
+    {:reply, result, state}
+  end
+
+  def handle_call(:stats, _from, state) do
+    {:reply, state.stats, state}
+  end
+
+  @impl GenServer
+  def handle_info(:write, state) do
+    {_result, state} = write(%{state | timer: nil})
+    {:noreply, state}
+  end
+
+  @impl GenServer
+  def terminate(_reason, state) do
+    _ = write(state)
+    :ok
+  end
+
+  defp changed(state, entries) do
+    timer = state.timer || Process.send_after(self(), :write, @write_delay)
+    stats = %{state.stats | saves: state.stats.saves + 1}
+    %{state | entries: entries, dirty?: true, timer: timer, stats: stats}
+  end
+
+  defp write(%{dirty?: false} = state), do: {:ok, state}
+
+  defp write(state) do
+    if state.timer, do: Process.cancel_timer(state.timer)
+
+    start = System.monotonic_time(:microsecond)
+    result = write_entries(state.entries)
+    elapsed = System.monotonic_time(:microsecond) - start
+
+    stats = %{
+      state.stats
+      | writes: state.stats.writes + 1,
+        last_write_usec: elapsed,
+        max_write_usec: max(state.stats.max_write_usec, elapsed)
+    }
+
+    case result do
+      :ok ->
+        Logger.debug("VintageNet: saved configurations in #{elapsed} us")
+        {:ok, %{state | dirty?: false, timer: nil, stats: stats}}
+
+      {:error, reason} ->
+        # Leave it dirty so that the next save tries again
+        Logger.error("VintageNet: failed to save configurations: #{inspect(reason)}")
+        {result, %{state | timer: nil, stats: stats}}
+    end
+  end
+
+  defp read_entries() do
+    with {:ok, contents} <- File.read(snapshot_path()),
+         {:ok, entries} when is_map(entries) <- non_raising_binary_to_term(contents) do
+      entries
+    else
+      {:error, :enoent} ->
+        %{}
+
+      _error ->
+        Logger.warning("VintageNet: ignoring corrupt configuration snapshot")
+        %{}
+    end
+  end
+
+  defp write_entries(entries) do
+    path = snapshot_path()
+    tmp_path = path <> ".tmp"
+
+    with :ok <- File.mkdir_p(Path.dirname(path)),
+         :ok <- File.write(tmp_path, :erlang.term_to_binary(entries), [:sync]) do
+      File.rename(tmp_path, path)
+    end
+  end
+
+  defp non_raising_binary_to_term(bin) do
+    {:ok, :erlang.binary_to_term(bin, [:safe])}
+  catch
+    _, _ -> {:error, :corrupt}
+  end
+
+  defp snapshot_path() do
+    Path.join(Application.get_env(:vintage_net, :persistence_dir), @snapshot_name)
+  end
+end
@@ -0,0 +1,171 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Resolver.DNSCache do
+  @moduledoc false
+
+  # Run the `dns_cache` port to answer DNS queries on 127.0.0.1
+  #
+  # The port caches answers and forwards everything else to the name servers
+  # in the `["name_servers"]` property. Name servers that aren't global are
+  # tried in the order that their interfaces are in `["available_interfaces"]`
+  # so that the interface that RouteManager prefers gets used first.
+  # `VintageNet.NameResolver` points `/etc/resolv.conf` here when this is
+  # enabled. If the port exits, like when it can't listen on its port, this
+  # keeps running without it and `VintageNet.NameResolver` goes back to
+  # listing the name servers.
+  #
+  # Options:
+  #
+  # * `:dns_cache` - `true` to run the cache
+  # * `:dns_cache_port` - UDP port to listen on (defaults to 53)
+  # * `:dns_cache_upstream_port` - UDP port of the name servers (defaults to 53)
+
+  use GenServer
+  alias VintageNet.NameResolver
+  alias VintageNet.Resolver.ResolvConf
+  require Logger
+
+  @type upstream_server() :: {:inet.ip_address(), VintageNet.ifname() | String.t()}
+
+  @spec start_link(keyword()) :: GenServer.on_start()
+  def start_link(args) do
+    relevant_args = Keyword.take(args, [:dns_cache, :dns_cache_port, :dns_cache_upstream_port])
+    GenServer.start_link(__MODULE__, relevant_args, name: __MODULE__)
+  end
+
+  @doc """
+  Return whether the cache should be run
+  """
+  @spec available?(keyword()) :: boolean()
+  def available?(args) do
+    Keyword.get(args, :dns_cache, false) == true and File.exists?(executable())
+  end
+
+  @doc """
+  Return whether the cache is answering queries
+  """
+  @spec running?() :: boolean()
+  def running?() do
+    GenServer.call(__MODULE__, :running?)
+  catch
+    :exit, _reason -> false
+  end
+
+  @doc """
+  Order name servers for the cache
+
+  Global name servers are first. The rest are ordered by the priority of the
+  first available interface that supplied them. The interface is returned
+  with each one so that queries are sent on it. It's `""` for global ones.
+  """
+  @spec upstream_servers([ResolvConf.name_server_info()], [VintageNet.ifname()]) ::
+          [upstream_server()]
+  def upstream_servers(name_servers, available_interfaces) do
+    name_servers
+    |> Enum.map(&rank_name_server(&1, available_interfaces))
+    |> Enum.with_index()
+    |> Enum.sort_by(fn {{rank, _server}, index} -> {rank, index} end)
+    |> Enum.map(fn {{_rank, server}, _index} -> server end)
+  end
+
+  @impl GenServer
+  def init(args) do
+    if available?(args) do
+      listen_port = Keyword.get(args, :dns_cache_port, 53)
+      upstream_port = Keyword.get(args, :dns_cache_upstream_port, 53)
+
+      port =
+        Port.open({:spawn_executable, executable()}, [
+          {:args, [to_string(listen_port), to_string(upstream_port)]},
+          {:packet, 2},
+          :use_stdio,
+          :binary,
+          :exit_status
+        ])
+
+      VintageNet.subscribe(["name_servers"])
+      VintageNet.subscribe(["available_interfaces"])
+
+      state = %{
+        port: port,
+        name_servers: VintageNet.get(["name_servers"]) || [],
+        available_interfaces: VintageNet.get(["available_interfaces"]) || [],
+        servers: nil
+      }
+
+      {:ok, update_servers(state)}
+    else
+      :ignore
+    end
+  end
+
+  @impl GenServer
+  def handle_call(:running?, _from, state) do
+    {:reply, state.port != nil, state}
+  end
+
+  @impl GenServer
+  def handle_info({VintageNet, ["name_servers"], _old_value, name_servers, _meta}, state) do
+    {:noreply, update_servers(%{state | name_servers: name_servers || []})}
+  end
+
+  def handle_info({VintageNet, ["available_interfaces"], _old_value, ifnames, _meta}, state) do
+    {:noreply, update_servers(%{state | available_interfaces: ifnames || []})}
+  end
+
+  def handle_info({port, {:data, raw_message}}, %{port: port} = state) do
+    {:error, reason} = :erlang.binary_to_term(raw_message)
+    Logger.error("dns_cache: #{reason}")
+    {:noreply, state}
+  end
+
+  def handle_info({port, {:exit_status, status}}, %{port: port} = state) do
+    Logger.error("dns_cache exited with status #{status}. Using name servers directly.")
+    NameResolver.dns_cache_stopped()
+    {:noreply, %{state | port: nil}}
+  end
+
+  def handle_info(_message, state) do
+    {:noreply, state}
+  end
+
+  defp update_servers(%{port: nil} = state), do: state
+
+  defp update_servers(state) do
+    case upstream_servers(state.name_servers, state.available_interfaces) do
+      servers when servers == state.servers ->
+        state
+
+      servers ->
+        Port.command(state.port, :erlang.term_to_binary({:servers, servers}))
+        %{state | servers: servers}
+    end
+  end
+
+  defp rank_name_server(%{address: address, from: from}, available_interfaces) do
+    if :global in from do
+      {0, {address, ""}}
+    else
+      {rank, ifname} =
+        from
+        |> Enum.map(&{interface_rank(&1, available_interfaces), &1})
+        |> Enum.min()
+
+      {rank, {address, ifname}}
+    end
+  end
+
+  # Interfaces that aren't available go last
+  defp interface_rank(ifname, available_interfaces) do
+    case Enum.find_index(available_interfaces, &(&1 == ifname)) do
+      nil -> length(available_interfaces) + 1
+      index -> index + 1
+    end
+  end
+
+  defp executable() do
+    Application.app_dir(:vintage_net, ["priv", "dns_cache"])
+  end
+end
@@ -39,6 +39,20 @@ defmodule VintageNet.Resolver.ResolvConf do
     ]
   end
 
+  @doc """
+  Convert the search domains to resolv.conf contents that use the local DNS cache
+  """
+  @spec to_dns_cache_config(entry_map()) :: iolist()
+  def to_dns_cache_config(entries) do
+    domains = Enum.reduce(entries, %{}, &add_domain/2)
+
+    [
+      "# This file is managed by VintageNet. Do not edit.\n\n",
+      Enum.map(domains, &domain_text/1),
+      "nameserver 127.0.0.1 # From dns_cache\n"
+    ]
+  end
+
   @spec to_name_server_list(entry_map(), additional_name_servers) :: [name_server_info()]
   def to_name_server_list(entries, additional_name_servers) do
     # This is trickier than it looks since we want the ordering of name
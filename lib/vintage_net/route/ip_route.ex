@@ -6,9 +6,105 @@
 defmodule VintageNet.Route.IPRoute do
   @moduledoc """
   This module knows how to invoke the `ip` command to modify the Linux routing tables
+
+  `run_all/1` applies a list of changes at once using the `netlink_ctl` port
+  when it's available.
   """
 
-  alias VintageNet.{Command, IP, Route}
+  alias VintageNet.{Command, IP, NetlinkCtl, Route}
+
+  @typedoc """
+  A routing table change for `run_all/1`
+
+  Each one is named after the function in this module that makes the change.
+  """
+  @type op() ::
+          {:add_default_route, VintageNet.ifname(), :inet.ip_address(), Route.metric(),
+           Route.table_index()}
+          | {:add_local_route, VintageNet.ifname(), :inet.ip_address(),
+             VintageNet.prefix_length(), Route.metric(), Route.table_index()}
+          | {:add_rule, :inet.ip_address(), Route.table_index()}
+          | {:clear_a_route, VintageNet.ifname(), Route.table_index()}
+          | {:clear_a_local_route, VintageNet.ifname(), :inet.ip_address(),
+             VintageNet.prefix_length(), Route.metric(), Route.table_index()}
+          | {:clear_a_rule, Route.table_index()}
+
+  @doc """
+  Apply a list of changes and return the result of each one
+
+  The changes are made in order. When `netlink_ctl` is running, they're all
+  sent to the kernel together. Otherwise, `ip` is run for each one.
+  """
+  @spec run_all([op()]) :: [:ok | {:error, any()}]
+  def run_all(ops) do
+    case NetlinkCtl.run(Enum.map(ops, &to_netlink/1)) do
+      {:ok, results} -> results
+      :unavailable -> Enum.map(ops, &run/1)
+    end
+  end
+
+  defp run(op) do
+    [function | args] = Tuple.to_list(op)
+    apply(__MODULE__, function, args)
+  end
+
+  defp to_netlink({:add_default_route, ifname, route, metric, table_index}) do
+    {:newroute,
+     %{
+       ifname: ifname,
+       dst: {0, 0, 0, 0},
+       dst_len: 0,
+       gateway: route,
+       priority: metric,
+       table: table_index_to_number(table_index)
+     }}
+  end
+
+  defp to_netlink({:add_local_route, ifname, ip, subnet_bits, metric, table_index}) do
+    {:newroute,
+     %{
+       ifname: ifname,
+       dst: IP.to_subnet(ip, subnet_bits),
+       dst_len: subnet_bits,
+       prefsrc: ip,
+       scope: :link,
+       priority: metric,
+       table: table_index_to_number(table_index)
+     }}
+  end
+
+  defp to_netlink({:add_rule, ip_address, table_index}) do
+    {:newrule,
+     %{
+       src: ip_address,
+       src_len: address_bits(ip_address),
+       table: table_index_to_number(table_index)
+     }}
+  end
+
+  defp to_netlink({:clear_a_route, ifname, table_index}) do
+    {:delroute,
+     %{ifname: ifname, dst: {0, 0, 0, 0}, dst_len: 0, table: table_index_to_number(table_index)}}
+  end
+
+  defp to_netlink({:clear_a_local_route, ifname, ip, subnet_bits, metric, table_index}) do
+    {:delroute,
+     %{
+       ifname: ifname,
+       dst: IP.to_subnet(ip, subnet_bits),
+       dst_len: subnet_bits,
+       scope: :link,
+       priority: metric,
+       table: table_index_to_number(table_index)
+     }}
+  end
+
+  defp to_netlink({:clear_a_rule, table_index}) do
+    {:delrule, %{table: table_index_to_number(table_index)}}
+  end
+
+  defp address_bits({_, _, _, _}), do: 32
+  defp address_bits({_, _, _, _, _, _, _, _}), do: 128
 
   @doc """
   Add a default route
@@ -178,6 +274,14 @@ defmodule VintageNet.Route.IPRoute do
     ip_cmd(["rule", "del", "lookup", table_index_string])
   end
 
+  # See enum rt_class_t in linux/rtnetlink.h
+  defp table_index_to_number(:default), do: 253
+  defp table_index_to_number(:main), do: 254
+  defp table_index_to_number(:local), do: 255
+
+  defp table_index_to_number(table_index) when table_index >= 0 and table_index <= 255,
+    do: table_index
+
   defp table_index_to_string(:main), do: "main"
 
   defp table_index_to_string(table_index) when table_index >= 0 and table_index <= 255,
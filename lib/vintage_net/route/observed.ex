@@ -0,0 +1,83 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Route.Observed do
+  @moduledoc false
+
+  # Convert route and rule reports from `if_monitor` into routing table entries
+  #
+  # Entries have the same form as the ones from `VintageNet.Route.Calculator`
+  # so that they can be compared. Routes and rules that VintageNet doesn't
+  # create are ignored except for default routes in the main table. Those are
+  # kept so that they can be cleaned up on start. Default routes without a
+  # gateway have a `nil` gateway.
+
+  alias VintageNet.Route
+
+  @typedoc """
+  An entry seen in the Linux routing tables
+  """
+  @type entry() ::
+          Route.entry()
+          | {:default_route, VintageNet.ifname(), nil, Route.metric(), Route.table_index()}
+
+  @type t() :: MapSet.t(entry())
+
+  # FR_ACT_TO_TBL in linux/fib_rules.h
+  @fr_act_to_tbl 1
+
+  @doc """
+  Return the entry for a route report or nil if it's not one that's tracked
+  """
+  @spec route_entry(map(), VintageNet.ifname() | nil) :: entry() | nil
+  def route_entry(_report, nil), do: nil
+
+  def route_entry(%{family: :inet, type: :unicast, dst_len: 0} = report, ifname) do
+    {:default_route, ifname, report[:gateway], metric(report), table_index(report.table)}
+  end
+
+  def route_entry(
+        %{family: :inet, type: :unicast, scope: :link, prefsrc: address} = report,
+        ifname
+      ) do
+    {:local_route, ifname, address, report.dst_len, metric(report), table_index(report.table)}
+  end
+
+  def route_entry(_report, _ifname), do: nil
+
+  @doc """
+  Return the entry for a rule report or nil if it's not one that's tracked
+  """
+  @spec rule_entry(map()) :: Route.rule() | nil
+  def rule_entry(%{
+        family: :inet,
+        action: @fr_act_to_tbl,
+        src: address,
+        src_len: 32,
+        dst_len: 0,
+        table: table
+      }) do
+    {:rule, table_index(table), address}
+  end
+
+  def rule_entry(_report), do: nil
+
+  @doc """
+  Apply a list of additions and removals
+  """
+  @spec apply_changes(t(), [{:add | :del, entry()}]) :: t()
+  def apply_changes(observed, changes) do
+    Enum.reduce(changes, observed, fn
+      {:add, entry}, acc -> MapSet.put(acc, entry)
+      {:del, entry}, acc -> MapSet.delete(acc, entry)
+    end)
+  end
+
+  defp metric(report), do: Map.get(report, :priority, 0)
+
+  defp table_index(253), do: :default
+  defp table_index(254), do: :main
+  defp table_index(255), do: :local
+  defp table_index(index), do: index
+end
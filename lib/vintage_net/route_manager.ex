@@ -38,7 +38,7 @@ defmodule VintageNet.RouteManager do
   use GenServer
 
   alias VintageNet.Interface.NameUtilities
-  alias VintageNet.Route
+  alias VintageNet.{InterfacesMonitor, Route}
   alias VintageNet.Route.{Calculator, DefaultMetric, InterfaceInfo, IPRoute, Properties}
   require Logger
 
@@ -146,8 +146,10 @@ defmodule VintageNet.RouteManager do
     route_metric_fun = args[:route_metric_fun] |> check_compute_metric()
 
     # Fresh slate
-    IPRoute.clear_all_routes()
-    IPRoute.clear_all_rules(Calculator.rule_table_index_range())
+    case InterfacesMonitor.observed_routes() do
+      {:ok, observed} -> clear_observed_routes(observed)
+      :unknown -> clear_all_routes()
+    end
 
     state =
       %{
@@ -161,6 +163,28 @@ defmodule VintageNet.RouteManager do
     {:ok, state}
   end
 
+  defp clear_all_routes() do
+    IPRoute.clear_all_routes()
+    IPRoute.clear_all_rules(Calculator.rule_table_index_range())
+  end
+
+  # Only delete what's really there rather than running `ip` until it fails
+  defp clear_observed_routes(observed) do
+    rule_tables = Calculator.rule_table_index_range()
+
+    stale =
+      Enum.filter(observed, fn
+        {:default_route, _ifname, _gateway, _metric, :main} -> true
+        {:rule, table_index, _address} -> table_index in rule_tables
+        _ -> false
+      end)
+
+    stale
+    |> Enum.flat_map(&delete_ops/1)
+    |> Enum.map(fn {op, _check} -> op end)
+    |> IPRoute.run_all()
+  end
+
   defp check_compute_metric({m, f, 2}), do: Function.capture(m, f, 2)
   defp check_compute_metric(fun) when is_function(fun, 2), do: fun
 
@@ -304,14 +328,18 @@ defmodule VintageNet.RouteManager do
   end
 
   defp update_route_tables(state) do
+    start = System.monotonic_time()
+
     # See what changed and then run it.
     {new_route_state, new_routes} =
       Calculator.compute(state.route_state, state.interfaces, state.route_metric_fun)
 
     route_delta = List.myers_difference(state.routes, new_routes)
 
-    # Update Linux's routing tables
-    Enum.each(route_delta, &handle_delta/1)
+    # Update Linux's routing tables all at once
+    ops = Enum.flat_map(route_delta, &plan_delta/1)
+    results = IPRoute.run_all(Enum.map(ops, fn {op, _check} -> op end))
+    Enum.zip_with(ops, results, &check_result(&1, ignore_exists(&2)))
 
     # Update the global routing properties in the property table
     # NOTE: These next three calls can update zero or more entries
@@ -326,64 +354,93 @@ defmodule VintageNet.RouteManager do
     Properties.update_best_connection(state.interfaces)
     Properties.update_connection_status(state.interfaces)
 
+    :telemetry.execute(
+      [:vintage_net, :route_manager, :update],
+      %{duration: System.monotonic_time() - start, ops: length(ops)},
+      %{}
+    )
+
     %{state | route_state: new_route_state, routes: new_routes}
   end
 
-  defp handle_delta({:eq, _anything}), do: :ok
+  # Deletes and inserts are always sent. Linux can remove entries on its own,
+  # e.g., when an interface goes away, so what's there isn't known for sure.
+  # Entries that are already gone or already there aren't errors.
+  defp plan_delta({:eq, _anything}), do: []
+  defp plan_delta({:del, deletes}), do: Enum.flat_map(deletes, &delete_ops/1)
+  defp plan_delta({:ins, inserts}), do: Enum.flat_map(inserts, &insert_ops/1)
 
-  defp handle_delta({:del, deletes}) do
-    Enum.each(deletes, &handle_delete/1)
+  # Each IPRoute operation is paired with how to handle its result
+  defp delete_ops({:default_route, ifname, _default_gateway, _metric, table_index}) do
+    [{{:clear_a_route, ifname, table_index}, :ignore_missing}]
   end
 
-  defp handle_delta({:ins, inserts}) do
-    Enum.each(inserts, &handle_insert/1)
+  defp delete_ops({:local_route, ifname, address, subnet_bits, metric, table_index}) do
+    [{{:clear_a_local_route, ifname, address, subnet_bits, metric, table_index}, :ignore_missing}]
   end
 
-  defp handle_delete({:default_route, ifname, _default_gateway, _metric, table_index}) do
-    IPRoute.clear_a_route(ifname, table_index)
-    |> warn_on_error("clear_a_route")
+  defp delete_ops({:rule, table_index, _address}) do
+    [{{:clear_a_rule, table_index}, :ignore_missing}]
   end
 
-  defp handle_delete({:local_route, ifname, address, subnet_bits, metric, table_index}) do
-    IPRoute.clear_a_local_route(ifname, address, subnet_bits, metric, table_index)
-    |> warn_on_error("clear_a_local_route")
+  defp insert_ops({:default_route, ifname, default_gateway, metric, table_index}) do
+    [{{:add_default_route, ifname, default_gateway, metric, table_index}, :warn}]
   end
 
-  defp handle_delete({:rule, table_index, _address}) do
-    IPRoute.clear_a_rule(table_index)
-    |> warn_on_error("clear_a_rule")
+  defp insert_ops({:rule, table_index, address}) do
+    [{{:add_rule, address, table_index}, :raise}]
   end
 
-  defp handle_insert({:default_route, ifname, default_gateway, metric, table_index}) do
-    IPRoute.add_default_route(ifname, default_gateway, metric, table_index)
-    |> warn_on_error("add_default_route")
+  defp insert_ops({:local_route, ifname, address, subnet_bits, metric, :main}) do
+    # HACK: Delete automatically created local routes that have a 0 metric
+    [
+      {{:clear_a_local_route, ifname, address, subnet_bits, 0, :main}, :ignore},
+      {{:add_local_route, ifname, address, subnet_bits, metric, :main}, :must_succeed}
+    ]
   end
 
-  defp handle_insert({:rule, table_index, address}) do
-    with {:error, reason} <- IPRoute.add_rule(address, table_index) do
-      Logger.error("""
-      Failed to update IP routing table due to #{reason}.
+  defp insert_ops({:local_route, ifname, address, subnet_bits, metric, table_index}) do
+    [{{:add_local_route, ifname, address, subnet_bits, metric, table_index}, :must_succeed}]
+  end
 
-      Check that your Linux config includes:
-      CONFIG_IP_ADVANCED_ROUTER=y
-      CONFIG_IP_MULTIPLE_TABLES=y
-      """)
+  defp check_result({_op, :ignore}, _result), do: :ok
+  defp check_result({_op, :must_succeed}, result), do: :ok = result
+  defp check_result({op, :warn}, result), do: warn_on_error(result, to_string(elem(op, 0)))
 
-      # Keep behavior of crashing
-      raise RuntimeError, message: reason
-    end
+  defp check_result({op, :ignore_missing}, result) do
+    if not missing?(result), do: warn_on_error(result, to_string(elem(op, 0)))
+    :ok
   end
 
-  defp handle_insert({:local_route, ifname, address, subnet_bits, metric, table_index}) do
-    if table_index == :main do
-      # HACK: Delete automatically created local routes that have a 0 metric
-      _ = IPRoute.clear_a_local_route(ifname, address, subnet_bits, 0, :main)
-      :ok
-    end
+  defp check_result({_op, :raise}, {:error, reason}) do
+    Logger.error("""
+    Failed to update IP routing table due to #{reason}.
+
+    Check that your Linux config includes:
+    CONFIG_IP_ADVANCED_ROUTER=y
+    CONFIG_IP_MULTIPLE_TABLES=y
+    """)
 
-    :ok = IPRoute.add_local_route(ifname, address, subnet_bits, metric, table_index)
+    # Keep behavior of crashing
+    raise RuntimeError, message: reason
   end
 
+  defp check_result({_op, :raise}, :ok), do: :ok
+
+  # Linux reports ESRCH for routes and ENOENT for rules that aren't there.
+  # `ip` and `netlink_ctl` both use strerror(3) for the reason.
+  defp missing?({:error, reason}) when is_binary(reason),
+    do: String.contains?(reason, ["No such process", "No such file or directory"])
+
+  defp missing?(_result), do: false
+
+  # Linux reports EEXIST when adding a route or rule that's already there
+  defp ignore_exists({:error, reason} = result) when is_binary(reason) do
+    if String.contains?(reason, "File exists"), do: :ok, else: result
+  end
+
+  defp ignore_exists(result), do: result
+
   defp warn_on_error(:ok, _label), do: :ok
 
   defp warn_on_error({:error, reason}, label) do
@@ -0,0 +1,66 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Telemetry do
+  @moduledoc """
+  Telemetry events
+
+  VintageNet emits the following `:telemetry` events. Durations are in
+  `:native` time units like other libraries that use `:telemetry`.
+
+  * `[:vintage_net, :interfaces_monitor, :batch]` - a batch of reports from
+    `if_monitor` was handled
+    * Measurements:
+      * `:reports` - number of reports in the batch
+      * `:bytes` - size of the batch
+      * `:decode_duration` - time to decode the batch
+      * `:update_duration` - time to update properties and routes
+      * `:latency` - time from when `if_monitor` received the oldest netlink
+        message in the batch until its properties were updated. This is
+        missing when it's unknown, like for the reports at startup.
+    * Metadata: none
+
+  * `[:vintage_net, :route_manager, :update]` - the routing tables were
+    recomputed
+    * Measurements:
+      * `:duration` - time to compute and apply the changes
+      * `:ops` - number of route and rule changes made
+    * Metadata: none
+
+  * `[:vintage_net, :interface, :commands]` - an interface ran its commands
+    * Measurements:
+      * `:duration` - time to run the commands
+      * `:count` - number of commands
+    * Metadata:
+      * `:ifname` - the interface
+      * `:phase` - `:up`, `:down`, or `:update` for in-place updates
+      * `:result` - `:ok` or `:error`
+
+  For example, to make a histogram of how long it takes from a cable being
+  unplugged to `["interface", ifname, "lower_up"]` changing with
+  `Telemetry.Metrics`:
+
+  ```elixir
+  Telemetry.Metrics.distribution("vintage_net.interfaces_monitor.batch.latency",
+    unit: {:native, :millisecond},
+    reporter_options: [buckets: [1, 5, 10, 50, 100, 500]]
+  )
+  ```
+
+  Counts of the netlink messages behind these are available from
+  `VintageNet.InterfacesMonitor.netlink_stats/0`.
+  """
+
+  @doc """
+  Return all of the events that VintageNet emits
+  """
+  @spec events() :: [:telemetry.event_name()]
+  def events() do
+    [
+      [:vintage_net, :interfaces_monitor, :batch],
+      [:vintage_net, :route_manager, :update],
+      [:vintage_net, :interface, :commands]
+    ]
+  end
+end
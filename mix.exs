@@ -60,7 +60,30 @@ defmodule VintageNet.MixProject do
         #   [cgroup_base: "vintage_net", cgroup_controllers: ["cpu"]]
         muontrap_options: [],
         power_managers: [],
-        route_metric_fun: {VintageNet.Route.DefaultMetric, :compute_metric, 2}
+        route_metric_fun: {VintageNet.Route.DefaultMetric, :compute_metric, 2},
+        # Set to a positive number of milliseconds to collapse link flaps
+        link_coalesce_millis: 0,
+        # Set to true to modify links, addresses and routing tables with netlink
+        # requests instead of `ip`
+        native_routes: false,
+        # Set to true to run DHCP for all interfaces in one `dhcp_client` process
+        # instead of a busybox udhcpc each
+        native_dhcp: false,
+        # Set to true to only report udhcpd lease changes instead of parsing the
+        # whole lease file on each save
+        native_lease_watcher: false,
+        # Set to true to answer DNS queries with a local caching forwarder
+        dns_cache: false,
+        # Set to true to start commands from a spawner process instead of forking the BEAM
+        native_spawn: false,
+        # Set to true to check Internet connectivity with the `prober` port instead
+        # of one TCP connection at a time
+        native_prober: false,
+        # Set to true to find TCP sockets for connectivity checks with the
+        # `sock_diag` port instead of only looking at Erlang's sockets
+        native_sock_diag: false,
+        # How often to sample stats for interfaces passed to InterfacesMonitor.watch_stats/1
+        stats_interval_millis: 1000
       ],
       extra_applications: [:logger, :crypto],
       mod: {VintageNet.Application, []}
@@ -109,6 +132,7 @@ defmodule VintageNet.MixProject do
       {:beam_notify, "~> 1.0 or ~> 0.2.0"},
       {:muontrap, "~> 1.0 or ~> 0.5.1 or ~> 0.6.0"},
       {:property_table, "~> 0.2.0 or ~> 0.3.0"},
+      {:telemetry, "~> 1.0"},
       # Build dependencies
       {:credo, "~> 1.2", only: :test, runtime: false},
       {:credo_binary_patterns, "~> 0.2.2", only: :test, runtime: false},
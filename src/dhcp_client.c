@@ -0,0 +1,1320 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// DHCPv4 client for all of the interfaces that VintageNet configures
+//
+// This replaces running one udhcpc per interface. Each interface gets an
+// AF_PACKET socket so that it can send and receive before it has an address.
+// Everything else is handled from one epoll loop.
+//
+// Requests from Elixir are:
+//
+//   {:start, ifname, hostname, request_options}
+//   {:stop, ifname}
+//
+// `request_options` is a list of option names like udhcpc's `-O` takes. They
+// can be names from the table below or numbers. Starting an interface that's
+// already running starts it over.
+//
+// Lease events are sent to Elixir like udhcpc_notify sends them:
+//
+//   {:dhcp, sequence_number, op, ifname, %{option => value}}
+//
+// `op` is "deconfig", "leasefail", "nak", "bound" or "renew" and the options
+// have the same keys and types as VintageNet.DHCP.Options. Like udhcpc,
+// "deconfig" is sent when an interface starts and when a lease expires, and
+// "leasefail" is sent after three DISCOVERs go unanswered.
+
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <asm/socket.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <ei.h>
+
+// Erlang's {:packet, 2} framing limits each message to 64 KB
+#define MAX_PACKET_LEN 65535
+
+// Limit on interfaces. Starting more fails with EBUSY.
+#define MAX_CLIENTS 128
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_CLIENT_PORT 68
+#define DHCP_MAGIC 0x63825363
+
+#define IP_HEADER_LEN 20
+#define UDP_HEADER_LEN 8
+
+// Offsets into the BOOTP message
+#define BOOTP_XID 4
+#define BOOTP_CIADDR 12
+#define BOOTP_YIADDR 16
+#define BOOTP_SIADDR 20
+#define BOOTP_CHADDR 28
+#define BOOTP_SNAME 44
+#define BOOTP_FILE 108
+#define BOOTP_COOKIE 236
+#define DHCP_OPTIONS 240
+
+// Messages are sized so the IP datagram is 576 bytes like udhcpc sends
+#define DHCP_MESSAGE_LEN 548
+
+#define DHCPDISCOVER 1
+#define DHCPOFFER 2
+#define DHCPREQUEST 3
+#define DHCPACK 5
+#define DHCPNAK 6
+
+#define OPTION_SUBNET 1
+#define OPTION_HOSTNAME 12
+#define OPTION_REQUESTED_IP 50
+#define OPTION_LEASE 51
+#define OPTION_OVERLOAD 52
+#define OPTION_MESSAGE_TYPE 53
+#define OPTION_SERVER_ID 54
+#define OPTION_PARAM_REQUEST 55
+#define OPTION_MAX_SIZE 57
+#define OPTION_RENEWAL_TIME 58
+#define OPTION_REBIND_TIME 59
+#define OPTION_CLIENT_ID 61
+#define OPTION_END 255
+
+// Timing follows udhcpc's defaults: 3 tries 3 seconds apart and then wait
+// 20 seconds before trying again
+#define MAX_TRIES 3
+#define RETRY_MS 3000
+#define TRY_AGAIN_MS 20000
+
+// RFC 2131 says to retry renewals at half the remaining time, but not more
+// often than once a minute
+#define MIN_RENEW_RETRY_MS 60000
+
+#define DEFAULT_LEASE_SECONDS 3600
+#define MIN_LEASE_SECONDS 16
+
+#ifndef SOL_PACKET
+#define SOL_PACKET 263
+#endif
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+enum option_type
+{
+    OPTION_IP,
+    OPTION_IP_LIST,
+    OPTION_IP_STRING,
+    OPTION_STRING,
+    OPTION_UINT,
+    OPTION_UINT_STRING,
+    OPTION_S32_STRING,
+    OPTION_HEX_STRING,
+    OPTION_DNS_LIST
+};
+
+struct option_info
+{
+    unsigned char code;
+    const char *name;
+    const char *key;
+    enum option_type type;
+};
+
+// Keep in sync with VintageNet.DHCP.Options. Names match udhcpc's so that
+// `:dhcp_request_options` works the same. Values are formatted the same way
+// udhcpc formats them, e.g., the timezone offset is a string.
+static const struct option_info options[] =
+{
+    {1, "subnet", "subnet", OPTION_IP},
+    {2, "timezone", "timezone", OPTION_S32_STRING},
+    {3, "router", "router", OPTION_IP_LIST},
+    {6, "dns", "dns", OPTION_IP_LIST},
+    {9, "lprsrv", "lprsrv", OPTION_IP_LIST},
+    {12, "hostname", "hostname", OPTION_STRING},
+    {13, "bootsize", "bootsize", OPTION_UINT_STRING},
+    {15, "domain", "domain", OPTION_STRING},
+    {16, "swapsrv", "swapsrv", OPTION_IP},
+    {17, "rootpath", "rootpath", OPTION_STRING},
+    {23, "ipttl", "ipttl", OPTION_UINT},
+    {26, "mtu", "mtu", OPTION_UINT},
+    {28, "broadcast", "broadcast", OPTION_IP},
+    {33, "routes", "routes", OPTION_IP_LIST},
+    {40, "nisdomain", "nisdomain", OPTION_STRING},
+    {41, "nissrv", "nissrv", OPTION_IP_LIST},
+    {42, "ntpsrv", "ntpsrv", OPTION_IP_LIST},
+    {44, "wins", "wins", OPTION_IP_STRING},
+    {51, "lease", "lease", OPTION_UINT},
+    {54, "serverid", "serverid", OPTION_IP},
+    {56, "message", "message", OPTION_STRING},
+    {58, "opt58", "renewal_time", OPTION_UINT},
+    {59, "opt59", "rebind_time", OPTION_UINT},
+    {60, "vendor", "vendor", OPTION_STRING},
+    {66, "tftp", "tftp", OPTION_STRING},
+    {67, "bootfile", "bootfile", OPTION_STRING},
+    {77, "opt77", "userclass", OPTION_HEX_STRING},
+    {100, "tzstr", "tzstr", OPTION_STRING},
+    {101, "tzdbstr", "tzdbstr", OPTION_STRING},
+    {119, "search", "search", OPTION_DNS_LIST},
+    {132, "vlanid", "vlanid", OPTION_UINT_STRING},
+    {133, "vlanpriority", "vlanpriority", OPTION_UINT},
+    {209, "pxeconffile", "pxeconffile", OPTION_STRING},
+    {210, "pxepathprefix", "pxepathprefix", OPTION_STRING},
+    {211, "reboottime", "reboottime", OPTION_UINT_STRING},
+    {252, "wpad", "wpad", OPTION_STRING}
+};
+#define NUM_OPTIONS (sizeof(options) / sizeof(options[0]))
+
+// Requested when Elixir doesn't ask for more
+static const unsigned char default_request_options[] = {1, 3, 6, 12, 15, 28, 42, 119};
+
+enum client_state
+{
+    STATE_INIT,
+    STATE_REQUESTING,
+    STATE_BOUND,
+    STATE_RENEWING,
+    STATE_REBINDING
+};
+
+struct client
+{
+    int in_use;
+    int fd;
+    char ifname[IF_NAMESIZE];
+    int ifindex;
+    unsigned char mac[ETH_ALEN];
+
+    char hostname[256];
+    unsigned char request_options[255];
+    int request_option_count;
+
+    enum client_state state;
+    uint32_t xid;
+    int tries;
+    int64_t deadline_ms;
+
+    // Network byte order
+    uint32_t address;
+    uint32_t server_id;
+    unsigned char server_mac[ETH_ALEN];
+
+    int64_t t1_ms;
+    int64_t t2_ms;
+    int64_t expire_ms;
+};
+
+struct dhcp_client
+{
+    int epfd;
+    unsigned long long seq;
+
+    char request[MAX_PACKET_LEN + 2];
+    size_t request_len;
+
+    struct client clients[MAX_CLIENTS];
+
+    ei_x_buff event;
+    ei_x_buff map;
+};
+
+// Options found in a received message. Pointers are into the message.
+struct dhcp_options
+{
+    const unsigned char *data[256];
+    unsigned char len[256];
+};
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void put16(unsigned char *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static uint16_t get16(const unsigned char *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t checksum_add(const unsigned char *data, size_t len, uint32_t sum)
+{
+    size_t i;
+    for (i = 0; i + 1 < len; i += 2)
+        sum += get16(&data[i]);
+    if (len & 1)
+        sum += data[len - 1] << 8;
+    return sum;
+}
+
+static uint16_t checksum_finish(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// UDP checksums include a pseudo header with the addresses and length
+static uint32_t udp_pseudo_sum(const unsigned char *ip_header, uint16_t udp_len)
+{
+    uint32_t sum = checksum_add(&ip_header[12], 8, 0);
+    return sum + IPPROTO_UDP + udp_len;
+}
+
+static void dhcp_client_init(struct dhcp_client *d)
+{
+    memset(d, 0, sizeof(*d));
+
+    d->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (d->epfd < 0)
+        err(EXIT_FAILURE, "epoll_create1");
+
+    // Stdin is registered with a NULL pointer to tell it apart from clients
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) < 0)
+        err(EXIT_FAILURE, "epoll_ctl(stdin)");
+
+    if (ei_x_new(&d->event) < 0 || ei_x_new(&d->map) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+
+    srandom((unsigned int)(now_ms() ^ getpid()));
+}
+
+static void write_packet(const char *data, int len)
+{
+    if (len > MAX_PACKET_LEN)
+        errx(EXIT_FAILURE, "event too large to send: %d bytes", len);
+
+    uint16_t be_len = htons(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+// Return the option code for a udhcpc name or number or -1 if unknown
+static int option_code(const char *name)
+{
+    size_t i;
+    for (i = 0; i < NUM_OPTIONS; i++)
+    {
+        if (strcmp(options[i].name, name) == 0)
+            return options[i].code;
+    }
+
+    char *end;
+    unsigned long code = strtoul(name, &end, 0);
+    if (*name != '\0' && *end == '\0' && code > 0 && code < OPTION_END)
+        return (int)code;
+
+    return -1;
+}
+
+static void encode_ip(ei_x_buff *buff, const unsigned char *ip)
+{
+    ei_x_encode_tuple_header(buff, 4);
+
+    int i;
+    for (i = 0; i < 4; i++)
+        ei_x_encode_long(buff, ip[i]);
+}
+
+static void encode_string(ei_x_buff *buff, const char *str)
+{
+    ei_x_encode_binary(buff, str, strlen(str));
+}
+
+// Decode RFC 1035 names with RFC 3397 compression into "a.com b.com"
+static int decode_dns_list(const unsigned char *data, int len, char *out, size_t out_len)
+{
+    size_t n = 0;
+    int pos = 0;
+    while (pos < len)
+    {
+        int p = pos;
+        int jumps = 0;
+        int labels = 0;
+
+        if (n > 0)
+        {
+            if (n + 1 >= out_len)
+                return -1;
+            out[n++] = ' ';
+        }
+
+        for (;;)
+        {
+            if (p >= len)
+                return -1;
+
+            int label_len = data[p];
+            if (label_len == 0)
+            {
+                if (jumps == 0)
+                    pos = p + 1;
+                break;
+            }
+
+            if ((label_len & 0xc0) == 0xc0)
+            {
+                // Limit pointers to protect against loops
+                if (p + 1 >= len || ++jumps > 32)
+                    return -1;
+                if (jumps == 1)
+                    pos = p + 2;
+                p = ((label_len & 0x3f) << 8) | data[p + 1];
+                continue;
+            }
+
+            if (label_len > 63 || p + 1 + label_len > len || n + label_len + 2 >= out_len)
+                return -1;
+
+            if (labels++ > 0)
+                out[n++] = '.';
+            memcpy(&out[n], &data[p + 1], label_len);
+            n += label_len;
+            p += 1 + label_len;
+        }
+    }
+
+    out[n] = '\0';
+    return 0;
+}
+
+// Encode one option value. Returns -1 if the value is malformed so that the
+// option can be skipped.
+static int encode_value(ei_x_buff *buff, enum option_type type, const unsigned char *data, int len)
+{
+    char str[1024];
+    int i;
+
+    switch (type)
+    {
+    case OPTION_IP:
+        if (len != 4)
+            return -1;
+        encode_ip(buff, data);
+        return 0;
+
+    case OPTION_IP_LIST:
+        if (len == 0 || len % 4 != 0)
+            return -1;
+        ei_x_encode_list_header(buff, len / 4);
+        for (i = 0; i < len; i += 4)
+            encode_ip(buff, &data[i]);
+        ei_x_encode_empty_list(buff);
+        return 0;
+
+    case OPTION_IP_STRING:
+        if (len == 0 || len % 4 != 0)
+            return -1;
+        str[0] = '\0';
+        for (i = 0; i < len; i += 4)
+        {
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &data[i], ip, sizeof(ip));
+            if (i > 0)
+                strcat(str, " ");
+            strcat(str, ip);
+        }
+        encode_string(buff, str);
+        return 0;
+
+    case OPTION_STRING:
+        // Stop at a NUL like udhcpc does
+        for (i = 0; i < len && data[i] != '\0'; i++)
+            ;
+        ei_x_encode_binary(buff, data, i);
+        return 0;
+
+    case OPTION_UINT:
+        if (len == 1)
+            ei_x_encode_ulong(buff, data[0]);
+        else if (len == 2)
+            ei_x_encode_ulong(buff, get16(data));
+        else if (len == 4)
+            ei_x_encode_ulong(buff, get32(data));
+        else
+            return -1;
+        return 0;
+
+    case OPTION_UINT_STRING:
+        if (len == 1)
+            sprintf(str, "%u", data[0]);
+        else if (len == 2)
+            sprintf(str, "%u", get16(data));
+        else if (len == 4)
+            sprintf(str, "%lu", (unsigned long)get32(data));
+        else
+            return -1;
+        encode_string(buff, str);
+        return 0;
+
+    case OPTION_S32_STRING:
+        if (len != 4)
+            return -1;
+        sprintf(str, "%ld", (long)(int32_t)get32(data));
+        encode_string(buff, str);
+        return 0;
+
+    case OPTION_HEX_STRING:
+        for (i = 0; i < len; i++)
+            sprintf(&str[2 * i], "%02x", data[i]);
+        str[2 * len] = '\0';
+        encode_string(buff, str);
+        return 0;
+
+    case OPTION_DNS_LIST:
+    default:
+        if (decode_dns_list(data, len, str, sizeof(str)) < 0)
+            return -1;
+        encode_string(buff, str);
+        return 0;
+    }
+}
+
+// Build the option map for an event the same way udhcpc sets environment
+// variables for its script
+static int encode_options(ei_x_buff *buff, const unsigned char *msg, const struct dhcp_options *opts)
+{
+    int count = 0;
+
+    if (get32(&msg[BOOTP_YIADDR]) != 0)
+    {
+        ei_x_encode_atom(buff, "ip");
+        encode_ip(buff, &msg[BOOTP_YIADDR]);
+        count++;
+    }
+
+    if (get32(&msg[BOOTP_SIADDR]) != 0)
+    {
+        ei_x_encode_atom(buff, "siaddr");
+        encode_ip(buff, &msg[BOOTP_SIADDR]);
+        count++;
+    }
+
+    if (opts->data[OPTION_SUBNET] && opts->len[OPTION_SUBNET] == 4)
+    {
+        uint32_t mask = get32(opts->data[OPTION_SUBNET]);
+        int prefix_length = 0;
+        while (mask & 0x80000000)
+        {
+            prefix_length++;
+            mask <<= 1;
+        }
+        ei_x_encode_atom(buff, "mask");
+        ei_x_encode_long(buff, prefix_length);
+        count++;
+    }
+
+    size_t i;
+    for (i = 0; i < NUM_OPTIONS; i++)
+    {
+        const struct option_info *option = &options[i];
+        if (!opts->data[option->code])
+            continue;
+
+        // Rewind if the value can't be parsed so that the option is dropped
+        int start = buff->index;
+        ei_x_encode_atom(buff, option->key);
+        if (encode_value(buff, option->type, opts->data[option->code], opts->len[option->code]) < 0)
+            buff->index = start;
+        else
+            count++;
+    }
+    return count;
+}
+
+static void send_event(struct dhcp_client *d, struct client *c, const char *op,
+                       const unsigned char *msg, const struct dhcp_options *opts)
+{
+    debug("%s: %s", c->ifname, op);
+
+    d->map.index = 0;
+    int count = msg ? encode_options(&d->map, msg, opts) : 0;
+
+    ei_x_buff *buff = &d->event;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 5);
+    ei_x_encode_atom(buff, "dhcp");
+    ei_x_encode_ulonglong(buff, ++d->seq);
+    encode_string(buff, op);
+    encode_string(buff, c->ifname);
+    ei_x_encode_map_header(buff, count);
+    ei_x_append(buff, &d->map);
+
+    write_packet(buff->buff, buff->index);
+}
+
+static void send_error(struct dhcp_client *d, const char *ifname, int error)
+{
+    ei_x_buff *buff = &d->event;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 3);
+    ei_x_encode_atom(buff, "error");
+    encode_string(buff, ifname);
+    encode_string(buff, strerror(error));
+
+    write_packet(buff->buff, buff->index);
+}
+
+// Only pass UDP packets to the DHCP client port that aren't fragments.
+// Offsets are from the IP header since the socket is SOCK_DGRAM.
+static struct sock_filter filter_code[] =
+{
+    BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 5),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),
+    BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 3, 0),
+    BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),
+    BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, DHCP_CLIENT_PORT, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+    BPF_STMT(BPF_RET | BPF_K, 0x0fffffff)
+};
+
+static void close_socket(struct client *c)
+{
+    // Closing the socket also removes it from epoll
+    if (c->fd >= 0)
+    {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+static int open_socket(struct dhcp_client *d, struct client *c)
+{
+    c->ifindex = if_nametoindex(c->ifname);
+    if (c->ifindex == 0)
+        return -1;
+
+    c->fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, htons(ETH_P_IP));
+    if (c->fd < 0)
+        return -1;
+
+    struct sock_fprog filter;
+    filter.len = sizeof(filter_code) / sizeof(filter_code[0]);
+    filter.filter = filter_code;
+
+    // Checksums aren't filled in yet for packets from the same host, e.g.,
+    // over a veth pair. PACKET_AUXDATA says when that's the case.
+    int one = 1;
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = c->ifindex;
+    socklen_t sll_len = sizeof(sll);
+    if (setsockopt(c->fd, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) < 0 ||
+        setsockopt(c->fd, SOL_PACKET, PACKET_AUXDATA, &one, sizeof(one)) < 0 ||
+        bind(c->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0 ||
+        getsockname(c->fd, (struct sockaddr *)&sll, &sll_len) < 0)
+        goto fail;
+
+    if (sll.sll_halen != ETH_ALEN)
+    {
+        errno = EAFNOSUPPORT;
+        goto fail;
+    }
+    memcpy(c->mac, sll.sll_addr, ETH_ALEN);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0)
+        err(EXIT_FAILURE, "epoll_ctl");
+
+    return 0;
+
+fail:
+    {
+        int error = errno;
+        close_socket(c);
+        errno = error;
+    }
+    return -1;
+}
+
+static int add_option(unsigned char *msg, int len, int code, const void *data, int data_len)
+{
+    if (len + 2 + data_len >= DHCP_MESSAGE_LEN)
+        return len;
+
+    msg[len] = code;
+    msg[len + 1] = data_len;
+    memcpy(&msg[len + 2], data, data_len);
+    return len + 2 + data_len;
+}
+
+// Build a DISCOVER or REQUEST for the client's state and send it
+static void send_message(struct client *c, int type)
+{
+    unsigned char packet[IP_HEADER_LEN + UDP_HEADER_LEN + DHCP_MESSAGE_LEN];
+    unsigned char *ip = packet;
+    unsigned char *udp = &packet[IP_HEADER_LEN];
+    unsigned char *msg = &packet[IP_HEADER_LEN + UDP_HEADER_LEN];
+    memset(packet, 0, sizeof(packet));
+
+    // Renewals are unicast to the server that gave the lease
+    int renewing = (c->state == STATE_RENEWING);
+    int has_address = (c->state == STATE_RENEWING || c->state == STATE_REBINDING);
+
+    msg[0] = 1; // BOOTREQUEST
+    msg[1] = 1; // Ethernet
+    msg[2] = ETH_ALEN;
+    memcpy(&msg[BOOTP_XID], &c->xid, 4);
+    if (has_address)
+        memcpy(&msg[BOOTP_CIADDR], &c->address, 4);
+    memcpy(&msg[BOOTP_CHADDR], c->mac, ETH_ALEN);
+    msg[BOOTP_COOKIE] = 0x63;
+    msg[BOOTP_COOKIE + 1] = 0x82;
+    msg[BOOTP_COOKIE + 2] = 0x53;
+    msg[BOOTP_COOKIE + 3] = 0x63;
+
+    unsigned char message_type = type;
+    unsigned char client_id[1 + ETH_ALEN];
+    unsigned char max_size[2];
+    client_id[0] = 1;
+    memcpy(&client_id[1], c->mac, ETH_ALEN);
+    put16(max_size, sizeof(packet));
+
+    int len = DHCP_OPTIONS;
+    len = add_option(msg, len, OPTION_MESSAGE_TYPE, &message_type, 1);
+    len = add_option(msg, len, OPTION_CLIENT_ID, client_id, sizeof(client_id));
+    if (type == DHCPREQUEST && c->state == STATE_REQUESTING)
+    {
+        len = add_option(msg, len, OPTION_REQUESTED_IP, &c->address, 4);
+        len = add_option(msg, len, OPTION_SERVER_ID, &c->server_id, 4);
+    }
+    len = add_option(msg, len, OPTION_MAX_SIZE, max_size, 2);
+    if (c->hostname[0] != '\0')
+        len = add_option(msg, len, OPTION_HOSTNAME, c->hostname, strlen(c->hostname));
+    len = add_option(msg, len, OPTION_PARAM_REQUEST, c->request_options, c->request_option_count);
+    msg[len] = OPTION_END;
+
+    uint16_t udp_len = UDP_HEADER_LEN + DHCP_MESSAGE_LEN;
+    ip[0] = 0x45;
+    put16(&ip[2], sizeof(packet));
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    if (has_address)
+        memcpy(&ip[12], &c->address, 4);
+    if (renewing)
+        memcpy(&ip[16], &c->server_id, 4);
+    else
+        memset(&ip[16], 0xff, 4);
+    put16(&ip[10], checksum_finish(checksum_add(ip, IP_HEADER_LEN, 0)));
+
+    put16(&udp[0], DHCP_CLIENT_PORT);
+    put16(&udp[2], DHCP_SERVER_PORT);
+    put16(&udp[4], udp_len);
+    put16(&udp[6], checksum_finish(checksum_add(udp, udp_len, udp_pseudo_sum(ip, udp_len))));
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = c->ifindex;
+    sll.sll_halen = ETH_ALEN;
+    if (renewing)
+        memcpy(sll.sll_addr, c->server_mac, ETH_ALEN);
+    else
+        memset(sll.sll_addr, 0xff, ETH_ALEN);
+
+    debug("%s: sending %s", c->ifname, type == DHCPDISCOVER ? "DISCOVER" : "REQUEST");
+    if (sendto(c->fd, packet, sizeof(packet), 0, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+        warn("%s: sendto", c->ifname);
+}
+
+// Retry at half the time that's left, but not too often or past the limit
+static int64_t renew_retry(int64_t now, int64_t limit)
+{
+    int64_t wait = (limit - now) / 2;
+    if (wait < MIN_RENEW_RETRY_MS)
+        wait = MIN_RENEW_RETRY_MS;
+    return now + wait < limit ? now + wait : limit;
+}
+
+static void restart_discovery(struct client *c, int64_t when)
+{
+    c->state = STATE_INIT;
+    c->tries = 0;
+    c->deadline_ms = when;
+}
+
+static void handle_timeout(struct dhcp_client *d, struct client *c, int64_t now)
+{
+    if (c->state == STATE_BOUND)
+        c->state = STATE_RENEWING;
+    if (c->state == STATE_RENEWING && now >= c->t2_ms)
+        c->state = STATE_REBINDING;
+
+    switch (c->state)
+    {
+    case STATE_INIT:
+        if (c->tries == MAX_TRIES)
+        {
+            send_event(d, c, "leasefail", NULL, NULL);
+            c->tries = 0;
+            c->deadline_ms = now + TRY_AGAIN_MS;
+            break;
+        }
+
+        if (c->fd < 0 && open_socket(d, c) < 0)
+        {
+            warn("%s: can't open DHCP socket", c->ifname);
+            send_event(d, c, "leasefail", NULL, NULL);
+            c->deadline_ms = now + TRY_AGAIN_MS;
+            break;
+        }
+
+        if (c->tries == 0)
+            c->xid = (uint32_t)random();
+        send_message(c, DHCPDISCOVER);
+        c->tries++;
+        c->deadline_ms = now + RETRY_MS;
+        break;
+
+    case STATE_REQUESTING:
+        if (c->tries == MAX_TRIES)
+        {
+            restart_discovery(c, now);
+            handle_timeout(d, c, now);
+            break;
+        }
+
+        send_message(c, DHCPREQUEST);
+        c->tries++;
+        c->deadline_ms = now + RETRY_MS;
+        break;
+
+    case STATE_RENEWING:
+        send_message(c, DHCPREQUEST);
+        c->deadline_ms = renew_retry(now, c->t2_ms);
+        break;
+
+    case STATE_REBINDING:
+    default:
+        if (now >= c->expire_ms)
+        {
+            send_event(d, c, "deconfig", NULL, NULL);
+            restart_discovery(c, now);
+            handle_timeout(d, c, now);
+            break;
+        }
+
+        send_message(c, DHCPREQUEST);
+        c->deadline_ms = renew_retry(now, c->expire_ms);
+        break;
+    }
+}
+
+static void scan_options(const unsigned char *data, int len, struct dhcp_options *opts)
+{
+    int i = 0;
+    while (i < len)
+    {
+        int code = data[i];
+        if (code == 0)
+        {
+            i++;
+            continue;
+        }
+        if (code == OPTION_END || i + 1 >= len)
+            break;
+
+        int option_len = data[i + 1];
+        if (i + 2 + option_len > len)
+            break;
+
+        if (!opts->data[code])
+        {
+            opts->data[code] = &data[i + 2];
+            opts->len[code] = option_len;
+        }
+        i += 2 + option_len;
+    }
+}
+
+static void parse_options(const unsigned char *msg, int len, struct dhcp_options *opts)
+{
+    memset(opts, 0, sizeof(*opts));
+    scan_options(&msg[DHCP_OPTIONS], len - DHCP_OPTIONS, opts);
+
+    // Servers can put more options in the file and sname fields
+    if (opts->data[OPTION_OVERLOAD] && opts->len[OPTION_OVERLOAD] == 1)
+    {
+        int overload = opts->data[OPTION_OVERLOAD][0];
+        if (overload & 1)
+            scan_options(&msg[BOOTP_FILE], BOOTP_COOKIE - BOOTP_FILE, opts);
+        if (overload & 2)
+            scan_options(&msg[BOOTP_SNAME], BOOTP_FILE - BOOTP_SNAME, opts);
+    }
+}
+
+static uint32_t option_u32(const struct dhcp_options *opts, int code, uint32_t default_value)
+{
+    if (opts->data[code] && opts->len[code] == 4)
+        return get32(opts->data[code]);
+    return default_value;
+}
+
+static void handle_ack(struct dhcp_client *d, struct client *c, const unsigned char *msg,
+                       const struct dhcp_options *opts, const unsigned char *from_mac)
+{
+    int64_t now = now_ms();
+    const char *op = c->state == STATE_REQUESTING ? "bound" : "renew";
+
+    uint32_t lease = option_u32(opts, OPTION_LEASE, DEFAULT_LEASE_SECONDS);
+    if (lease < MIN_LEASE_SECONDS)
+        lease = MIN_LEASE_SECONDS;
+    uint32_t t1 = option_u32(opts, OPTION_RENEWAL_TIME, lease / 2);
+    uint32_t t2 = option_u32(opts, OPTION_REBIND_TIME, lease / 8 * 7);
+    if (t2 > lease)
+        t2 = lease;
+    if (t1 > t2)
+        t1 = t2;
+
+    memcpy(&c->address, &msg[BOOTP_YIADDR], 4);
+    if (opts->data[OPTION_SERVER_ID] && opts->len[OPTION_SERVER_ID] == 4)
+        memcpy(&c->server_id, opts->data[OPTION_SERVER_ID], 4);
+    memcpy(c->server_mac, from_mac, ETH_ALEN);
+
+    c->state = STATE_BOUND;
+    c->tries = 0;
+    c->t1_ms = now + (int64_t)t1 * 1000;
+    c->t2_ms = now + (int64_t)t2 * 1000;
+    c->expire_ms = now + (int64_t)lease * 1000;
+    c->deadline_ms = c->t1_ms;
+
+    send_event(d, c, op, msg, opts);
+}
+
+static void handle_message(struct dhcp_client *d, struct client *c, const unsigned char *msg, int len,
+                           const unsigned char *from_mac)
+{
+    struct dhcp_options opts;
+    parse_options(msg, len, &opts);
+    if (!opts.data[OPTION_MESSAGE_TYPE] || opts.len[OPTION_MESSAGE_TYPE] != 1)
+        return;
+
+    int type = opts.data[OPTION_MESSAGE_TYPE][0];
+    debug("%s: received type %d in state %d", c->ifname, type, c->state);
+    switch (type)
+    {
+    case DHCPOFFER:
+        if (c->state != STATE_INIT || get32(&msg[BOOTP_YIADDR]) == 0 ||
+            !opts.data[OPTION_SERVER_ID] || opts.len[OPTION_SERVER_ID] != 4)
+            break;
+
+        memcpy(&c->address, &msg[BOOTP_YIADDR], 4);
+        memcpy(&c->server_id, opts.data[OPTION_SERVER_ID], 4);
+        c->state = STATE_REQUESTING;
+        c->tries = 0;
+        handle_timeout(d, c, now_ms());
+        break;
+
+    case DHCPACK:
+        if (c->state == STATE_REQUESTING || c->state == STATE_RENEWING ||
+            c->state == STATE_REBINDING)
+            handle_ack(d, c, msg, &opts, from_mac);
+        break;
+
+    case DHCPNAK:
+        if (c->state == STATE_REQUESTING || c->state == STATE_RENEWING ||
+            c->state == STATE_REBINDING)
+        {
+            int had_lease = c->state != STATE_REQUESTING;
+            send_event(d, c, "nak", msg, &opts);
+            if (had_lease)
+                send_event(d, c, "deconfig", NULL, NULL);
+
+            // Wait a little before starting over like udhcpc
+            restart_discovery(c, now_ms() + RETRY_MS);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Check the IP and UDP headers and return the offset to the DHCP message
+static int check_packet(const unsigned char *packet, int len, int checksum_ok, const struct client *c)
+{
+    if (len < IP_HEADER_LEN || (packet[0] >> 4) != 4)
+        return -1;
+
+    int ip_header_len = (packet[0] & 0xf) * 4;
+    int total_len = get16(&packet[2]);
+    if (ip_header_len < IP_HEADER_LEN || total_len > len ||
+        total_len < ip_header_len + UDP_HEADER_LEN + DHCP_OPTIONS ||
+        checksum_finish(checksum_add(packet, ip_header_len, 0)) != 0)
+        return -1;
+
+    const unsigned char *udp = &packet[ip_header_len];
+    int udp_len = get16(&udp[4]);
+    if (get16(&udp[2]) != DHCP_CLIENT_PORT || udp_len > total_len - ip_header_len ||
+        udp_len < UDP_HEADER_LEN + DHCP_OPTIONS)
+        return -1;
+
+    if (!checksum_ok && get16(&udp[6]) != 0 &&
+        checksum_finish(checksum_add(udp, udp_len, udp_pseudo_sum(packet, udp_len))) != 0)
+        return -1;
+
+    const unsigned char *msg = &udp[UDP_HEADER_LEN];
+    if (msg[0] != 2 || // BOOTREPLY
+        memcmp(&msg[BOOTP_XID], &c->xid, 4) != 0 ||
+        memcmp(&msg[BOOTP_CHADDR], c->mac, ETH_ALEN) != 0 ||
+        get32(&msg[BOOTP_COOKIE]) != DHCP_MAGIC)
+        return -1;
+
+    return ip_header_len + UDP_HEADER_LEN;
+}
+
+static void client_ready(struct dhcp_client *d, struct client *c)
+{
+    for (;;)
+    {
+        unsigned char packet[2048];
+        union
+        {
+            struct cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(struct tpacket_auxdata))];
+        } control;
+        struct sockaddr_ll from;
+        struct iovec iov;
+        iov.iov_base = packet;
+        iov.iov_len = sizeof(packet);
+
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_name = &from;
+        mh.msg_namelen = sizeof(from);
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = &control;
+        mh.msg_controllen = sizeof(control);
+
+        ssize_t len = recvmsg(c->fd, &mh, 0);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                // E.g., the interface went away. Start over once it's back.
+                warn("%s: recvmsg", c->ifname);
+                close_socket(c);
+                restart_discovery(c, now_ms() + TRY_AGAIN_MS);
+            }
+            return;
+        }
+
+        int checksum_ok = 0;
+        struct cmsghdr *cmsg;
+        for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_PACKET && cmsg->cmsg_type == PACKET_AUXDATA)
+            {
+                struct tpacket_auxdata aux;
+                memcpy(&aux, CMSG_DATA(cmsg), sizeof(aux));
+                checksum_ok = (aux.tp_status & TP_STATUS_CSUMNOTREADY) != 0;
+            }
+        }
+
+        int offset = check_packet(packet, (int)len, checksum_ok, c);
+        if (offset < 0)
+            continue;
+
+        int total_len = get16(&packet[2]);
+        handle_message(d, c, &packet[offset], total_len - offset, from.sll_addr);
+
+        // Handling the message may have closed the socket
+        if (c->fd < 0)
+            return;
+    }
+}
+
+static struct client *find_client(struct dhcp_client *d, const char *ifname)
+{
+    int i;
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (d->clients[i].in_use && strcmp(d->clients[i].ifname, ifname) == 0)
+            return &d->clients[i];
+    }
+    return NULL;
+}
+
+static struct client *alloc_client(struct dhcp_client *d)
+{
+    int i;
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (!d->clients[i].in_use)
+            return &d->clients[i];
+    }
+    return NULL;
+}
+
+static void stop_client(struct client *c)
+{
+    close_socket(c);
+    c->in_use = 0;
+}
+
+static int decode_string(const char *buf, int *index, char *str, size_t max_len)
+{
+    int type;
+    int size;
+    long len;
+    if (ei_get_type(buf, index, &type, &size) < 0 || size < 0 || (size_t)size >= max_len ||
+        ei_decode_binary(buf, index, str, &len) < 0)
+        return -1;
+
+    str[len] = '\0';
+    return 0;
+}
+
+static void start_client(struct dhcp_client *d, const char *buf, int *index)
+{
+    char ifname[IF_NAMESIZE];
+    char hostname[256];
+    int count;
+    if (decode_string(buf, index, ifname, sizeof(ifname)) < 0 ||
+        decode_string(buf, index, hostname, sizeof(hostname)) < 0 ||
+        ei_decode_list_header(buf, index, &count) < 0)
+        errx(EXIT_FAILURE, "Expecting {:start, ifname, hostname, request_options} from Elixir");
+
+    struct client *c = find_client(d, ifname);
+    if (c)
+        stop_client(c);
+    else
+        c = alloc_client(d);
+
+    if (!c)
+    {
+        send_error(d, ifname, EBUSY);
+        return;
+    }
+
+    memset(c, 0, sizeof(*c));
+    c->in_use = 1;
+    c->fd = -1;
+    strcpy(c->ifname, ifname);
+    strcpy(c->hostname, hostname);
+    memcpy(c->request_options, default_request_options, sizeof(default_request_options));
+    c->request_option_count = sizeof(default_request_options);
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        char name[32];
+        if (decode_string(buf, index, name, sizeof(name)) < 0)
+            errx(EXIT_FAILURE, "Expecting request options to be strings");
+
+        int code = option_code(name);
+        if (code < 0)
+        {
+            warnx("%s: ignoring unknown DHCP option '%s'", ifname, name);
+            continue;
+        }
+
+        if (memchr(c->request_options, code, c->request_option_count) == NULL &&
+            c->request_option_count < (int)sizeof(c->request_options))
+            c->request_options[c->request_option_count++] = code;
+    }
+
+    // udhcpc reports a deconfig when it starts
+    send_event(d, c, "deconfig", NULL, NULL);
+    restart_discovery(c, now_ms());
+}
+
+static void process_request(struct dhcp_client *d, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    char cmd[MAXATOMLEN];
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+        ei_decode_atom(buf, &index, cmd) < 0)
+        errx(EXIT_FAILURE, "Expecting a command tuple from Elixir");
+
+    if (strcmp(cmd, "start") == 0 && arity == 4)
+    {
+        start_client(d, buf, &index);
+    }
+    else if (strcmp(cmd, "stop") == 0 && arity == 2)
+    {
+        char ifname[IF_NAMESIZE];
+        if (decode_string(buf, &index, ifname, sizeof(ifname)) < 0)
+            errx(EXIT_FAILURE, "Expecting {:stop, ifname} from Elixir");
+
+        struct client *c = find_client(d, ifname);
+        if (c)
+            stop_client(c);
+    }
+    else
+    {
+        errx(EXIT_FAILURE, "Unexpected command from Elixir: %s", cmd);
+    }
+}
+
+static int stdin_process(struct dhcp_client *d)
+{
+    ssize_t amount = read(STDIN_FILENO, d->request + d->request_len, sizeof(d->request) - d->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    d->request_len += amount;
+
+    size_t offset = 0;
+    while (d->request_len - offset >= 2)
+    {
+        size_t len = ((unsigned char)d->request[offset] << 8) | (unsigned char)d->request[offset + 1];
+        if (d->request_len - offset < len + 2)
+            break;
+
+        process_request(d, &d->request[offset + 2]);
+        offset += len + 2;
+    }
+
+    d->request_len -= offset;
+    memmove(d->request, &d->request[offset], d->request_len);
+    return 0;
+}
+
+// Milliseconds until the next timer or -1 if nothing is running
+static int next_timeout(struct dhcp_client *d)
+{
+    int64_t now = now_ms();
+    int64_t next = -1;
+    int i;
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (!d->clients[i].in_use)
+            continue;
+
+        int64_t remaining = d->clients[i].deadline_ms - now;
+        if (remaining < 0)
+            remaining = 0;
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
+    return (int)next;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct dhcp_client d;
+    dhcp_client_init(&d);
+
+    int i;
+    for (;;)
+    {
+        struct epoll_event events[MAX_CLIENTS + 1];
+
+        int rc = epoll_wait(d.epfd, events, sizeof(events) / sizeof(events[0]), next_timeout(&d));
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "epoll_wait");
+        }
+
+        for (i = 0; i < rc; i++)
+        {
+            struct client *c = events[i].data.ptr;
+            if (c == NULL)
+            {
+                if (stdin_process(&d) < 0)
+                    goto done;
+            }
+            else if (c->in_use && c->fd >= 0)
+            {
+                // Stopped clients can still show up later in this batch
+                client_ready(&d, c);
+            }
+        }
+
+        int64_t now = now_ms();
+        for (i = 0; i < MAX_CLIENTS; i++)
+        {
+            struct client *c = &d.clients[i];
+            if (c->in_use && now >= c->deadline_ms)
+                handle_timeout(&d, c, now);
+        }
+    }
+
+done:
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (d.clients[i].in_use)
+            stop_client(&d.clients[i]);
+    }
+    close(d.epfd);
+    ei_x_free(&d.event);
+    ei_x_free(&d.map);
+    return 0;
+}
@@ -0,0 +1,1313 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Caching DNS forwarder for looking up names on the device
+//
+// Usage: dns_cache <listen port> <upstream port>
+//
+// This answers UDP DNS queries on 127.0.0.1. Answers come from a cache when
+// possible. Otherwise queries are forwarded to the name servers that Elixir
+// supplies in priority order:
+//
+//   {:servers, [{address, ifname}]}
+//
+// `ifname` is the interface that supplied the name server or "" for ones
+// that aren't tied to an interface. Sockets to name servers are bound to
+// their interface so that queries use the network that supplied them.
+//
+// Each query sent upstream gets its own socket on a random source port and
+// a random ID. Spoofed answers would need to guess both.
+//
+// If a name server doesn't respond in time, the query is sent to the next
+// one. Name servers that keep timing out are skipped until they respond again.
+// Identical queries are only sent upstream once while one is in progress.
+//
+// Answers are cached for the smallest TTL of their records. Negative answers
+// (NXDOMAIN and NODATA) are cached for the SOA record's TTL or minimum
+// field, whichever is smaller, as RFC 2308 describes. Answers without an SOA,
+// server failures and truncated answers aren't cached. TTLs are decremented
+// when answering from the cache.
+//
+// Only UDP is supported. Truncated answers are passed to the client as is.
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <asm/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <ei.h>
+
+// Erlang's {:packet, 2} framing limits each message to 64 KB
+#define MAX_PACKET_LEN 65535
+
+#define MAX_SERVERS 8
+
+// Queries in progress and the clients waiting on each. Queries over the
+// limits are dropped and clients retry. Each query in progress has a socket.
+#define MAX_PENDING 128
+#define MAX_WAITERS 8
+
+// Cached answers. The entry closest to expiring is evicted when full.
+#define CACHE_SIZE 1024
+#define CACHE_BUCKETS 2048
+
+#define DNS_HEADER_LEN 12
+#define MAX_QUERY_LEN 512
+#define MAX_MESSAGE_LEN 65535
+#define MAX_NAME_LEN 255
+
+// Cache key: flags byte and the lowercased question
+#define MAX_KEY_LEN (1 + MAX_NAME_LEN + 4)
+
+#define QUERY_TIMEOUT_MS 1000
+#define MAX_ATTEMPTS 4
+
+// Skip name servers after this many timeouts in a row
+#define MAX_SERVER_FAILURES 3
+
+#define MAX_TTL 86400
+#define MAX_NEGATIVE_TTL 3600
+
+#define DNS_TYPE_SOA 6
+#define DNS_TYPE_OPT 41
+
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP 4
+#define DNS_RCODE_REFUSED 5
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+struct server
+{
+    unsigned char family;
+    unsigned char address[16];
+    char ifname[IF_NAMESIZE];
+    int failures;
+};
+
+struct waiter
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    uint16_t id;
+    size_t max_len;
+};
+
+struct pending
+{
+    int in_use;
+    uint16_t id;
+    int fd;
+    int server;
+    int attempts;
+    int64_t deadline_us;
+
+    unsigned char key[MAX_KEY_LEN];
+    size_t key_len;
+
+    unsigned char query[MAX_QUERY_LEN];
+    size_t query_len;
+
+    struct waiter waiters[MAX_WAITERS];
+    int waiter_count;
+};
+
+struct cache_entry
+{
+    int in_use;
+    int next;
+    uint32_t hash;
+
+    unsigned char key[MAX_KEY_LEN];
+    size_t key_len;
+
+    int64_t stored_us;
+    int64_t expires_us;
+
+    unsigned char *response;
+    size_t response_len;
+};
+
+struct dns_cache
+{
+    int listen_fd;
+    unsigned int upstream_port;
+    uint64_t random_state;
+
+    struct server servers[MAX_SERVERS];
+    int server_count;
+
+    struct pending pending[MAX_PENDING];
+
+    struct cache_entry entries[CACHE_SIZE];
+    int buckets[CACHE_BUCKETS];
+    int free_entry;
+
+    char request[MAX_PACKET_LEN + 2];
+    size_t request_len;
+
+    unsigned char message[MAX_MESSAGE_LEN];
+    unsigned char answer[MAX_MESSAGE_LEN];
+};
+
+// Parsed client query
+struct query
+{
+    uint16_t id;
+    size_t question_end;
+    size_t max_len;
+    unsigned char key[MAX_KEY_LEN];
+    size_t key_len;
+};
+
+// One resource record in a message
+struct record
+{
+    uint16_t type;
+    uint32_t ttl;
+    size_t ttl_offset;
+    size_t rdata_offset;
+    uint16_t rdata_len;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint16_t get16(const unsigned char *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put16(unsigned char *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+// Upstream IDs need to be hard to guess so that answers can't be spoofed
+static uint16_t random_id(struct dns_cache *dc)
+{
+    // xorshift64*
+    dc->random_state ^= dc->random_state >> 12;
+    dc->random_state ^= dc->random_state << 25;
+    dc->random_state ^= dc->random_state >> 27;
+    return (uint16_t)((dc->random_state * 2685821657736338717ULL) >> 48);
+}
+
+// Source ports are picked from outside of the well-known range
+static uint16_t random_port(struct dns_cache *dc)
+{
+    return 1024 + random_id(dc) % (65536 - 1024);
+}
+
+static void write_packet(const char *data, int len)
+{
+    if (len > MAX_PACKET_LEN)
+        errx(EXIT_FAILURE, "response too large to send: %d bytes", len);
+
+    uint16_t be_len = htons(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static void send_error(const char *reason)
+{
+    ei_x_buff buff;
+    if (ei_x_new_with_version(&buff) < 0)
+        err(EXIT_FAILURE, "ei_x_new_with_version");
+    ei_x_encode_tuple_header(&buff, 2);
+    ei_x_encode_atom(&buff, "error");
+    ei_x_encode_binary(&buff, reason, strlen(reason));
+    write_packet(buff.buff, buff.index);
+    ei_x_free(&buff);
+}
+
+// Return the offset after a possibly compressed name or 0 if it's bad
+static size_t skip_name(const unsigned char *msg, size_t len, size_t offset)
+{
+    while (offset < len)
+    {
+        unsigned char c = msg[offset];
+        if (c == 0)
+            return offset + 1;
+        if ((c & 0xc0) == 0xc0)
+            return offset + 2 <= len ? offset + 2 : 0;
+        if (c & 0xc0)
+            return 0;
+        offset += c + 1;
+    }
+    return 0;
+}
+
+// Return the offset after the question section or 0 if it's bad
+static size_t skip_questions(const unsigned char *msg, size_t len)
+{
+    size_t offset = DNS_HEADER_LEN;
+    int count = get16(&msg[4]);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        offset = skip_name(msg, len, offset);
+        if (offset == 0 || offset + 4 > len)
+            return 0;
+        offset += 4;
+    }
+    return offset;
+}
+
+// Parse the record at *offset and advance past it
+static int next_record(const unsigned char *msg, size_t len, size_t *offset, struct record *rr)
+{
+    size_t o = skip_name(msg, len, *offset);
+    if (o == 0 || o + 10 > len)
+        return -1;
+
+    rr->type = get16(&msg[o]);
+    rr->ttl_offset = o + 4;
+    rr->ttl = get32(&msg[o + 4]);
+    rr->rdata_len = get16(&msg[o + 8]);
+    rr->rdata_offset = o + 10;
+    if (rr->rdata_offset + rr->rdata_len > len)
+        return -1;
+
+    // RFC 2181: TTLs with the top bit set are treated as zero
+    if (rr->ttl & 0x80000000)
+        rr->ttl = 0;
+
+    *offset = rr->rdata_offset + rr->rdata_len;
+    return 0;
+}
+
+static int record_count(const unsigned char *msg)
+{
+    return get16(&msg[6]) + get16(&msg[8]) + get16(&msg[10]);
+}
+
+// Make a cache key from the question. The name is lowercased since lookups
+// are case-insensitive. Label lengths are at most 63, so only label bytes
+// can be letters. The type and class at the end are copied as is.
+static size_t make_key(const unsigned char *msg, size_t question_end, unsigned char flags, unsigned char *key)
+{
+    size_t len = question_end - DNS_HEADER_LEN;
+    if (len < 5 || len + 1 > MAX_KEY_LEN)
+        return 0;
+
+    key[0] = flags;
+    size_t name_len = len - 4;
+    size_t i;
+    for (i = 0; i < name_len; i++)
+    {
+        unsigned char c = msg[DNS_HEADER_LEN + i];
+        key[i + 1] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    memcpy(&key[name_len + 1], &msg[DNS_HEADER_LEN + name_len], 4);
+    return len + 1;
+}
+
+// Parse a client's query. Returns a DNS rcode for queries that can't be
+// handled.
+static int parse_query(const unsigned char *msg, size_t len, struct query *q)
+{
+    q->id = get16(msg);
+    q->max_len = 512;
+
+    int opcode = (msg[2] >> 3) & 0xf;
+    if (opcode != 0)
+        return DNS_RCODE_NOTIMP;
+
+    if (get16(&msg[4]) != 1 || get16(&msg[6]) != 0 || get16(&msg[8]) != 0)
+        return DNS_RCODE_FORMERR;
+
+    // Names in the question aren't compressed
+    size_t offset = DNS_HEADER_LEN;
+    while (offset < len && msg[offset] != 0)
+    {
+        if (msg[offset] & 0xc0)
+            return DNS_RCODE_FORMERR;
+        offset += msg[offset] + 1;
+    }
+    if (offset + 5 > len || offset + 1 - DNS_HEADER_LEN > MAX_NAME_LEN)
+        return DNS_RCODE_FORMERR;
+    q->question_end = offset + 5;
+
+    // Answers differ depending on the RD and CD flags and EDNS, so they're in
+    // the key too.
+    unsigned char flags = 0;
+    if (msg[2] & 0x01)
+        flags |= 0x01;
+    if (msg[3] & 0x10)
+        flags |= 0x02;
+
+    offset = q->question_end;
+    int count = get16(&msg[10]);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        struct record rr;
+        if (next_record(msg, len, &offset, &rr) < 0)
+            return DNS_RCODE_FORMERR;
+
+        if (rr.type == DNS_TYPE_OPT)
+        {
+            // The OPT record's class is the client's UDP payload size and the
+            // TTL holds the DO bit
+            uint16_t payload_size = get16(&msg[rr.ttl_offset - 2]);
+            if (payload_size > q->max_len)
+                q->max_len = payload_size;
+
+            flags |= 0x04;
+            if (msg[rr.ttl_offset + 2] & 0x80)
+                flags |= 0x08;
+        }
+    }
+
+    q->key_len = make_key(msg, q->question_end, flags, q->key);
+    return q->key_len > 0 ? DNS_RCODE_NOERROR : DNS_RCODE_FORMERR;
+}
+
+static void send_to_client(struct dns_cache *dc, const struct waiter *w, unsigned char *msg, size_t len)
+{
+    put16(msg, w->id);
+
+    // Send just the question with TC set if the answer is too big. The client
+    // can retry with a larger EDNS payload size.
+    if (len > w->max_len)
+    {
+        size_t question_end = skip_questions(msg, len);
+        if (question_end == 0)
+            return;
+
+        msg[2] |= 0x02;
+        put16(&msg[6], 0);
+        put16(&msg[8], 0);
+        put16(&msg[10], 0);
+        len = question_end;
+    }
+
+    if (sendto(dc->listen_fd, msg, len, 0, (const struct sockaddr *)&w->addr, w->addr_len) < 0)
+    {
+        debug("sendto(client): %s", strerror(errno));
+    }
+}
+
+// Reply with just a header and the question
+static void send_rcode(struct dns_cache *dc, const struct waiter *w, const unsigned char *query, size_t question_end, int rcode)
+{
+    unsigned char msg[MAX_QUERY_LEN];
+    if (question_end > sizeof(msg) || question_end < DNS_HEADER_LEN)
+        question_end = DNS_HEADER_LEN;
+
+    memcpy(msg, query, question_end);
+    msg[2] = 0x80 | (query[2] & 0x79); // QR, opcode and RD
+    msg[3] = 0x80 | rcode;             // RA
+    if (question_end == DNS_HEADER_LEN)
+        put16(&msg[4], 0);
+    put16(&msg[6], 0);
+    put16(&msg[8], 0);
+    put16(&msg[10], 0);
+
+    send_to_client(dc, w, msg, question_end);
+}
+
+// How long an answer can be cached in seconds or 0 if it can't be
+static uint32_t cache_ttl(const unsigned char *msg, size_t len)
+{
+    // Don't cache truncated answers
+    if (msg[2] & 0x02)
+        return 0;
+
+    int rcode = msg[3] & 0xf;
+    if (rcode != DNS_RCODE_NOERROR && rcode != DNS_RCODE_NXDOMAIN)
+        return 0;
+
+    size_t offset = skip_questions(msg, len);
+    if (offset == 0)
+        return 0;
+
+    int negative = rcode == DNS_RCODE_NXDOMAIN || get16(&msg[6]) == 0;
+    int answer_count = get16(&msg[6]);
+    int authority_end = answer_count + get16(&msg[8]);
+    int count = record_count(msg);
+    uint32_t ttl = MAX_TTL;
+    int found_soa = 0;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        struct record rr;
+        if (next_record(msg, len, &offset, &rr) < 0)
+            return 0;
+
+        if (rr.type == DNS_TYPE_OPT)
+            continue;
+
+        if (negative)
+        {
+            if (rr.type != DNS_TYPE_SOA || i < answer_count || i >= authority_end)
+                continue;
+
+            // The minimum field is the last 4 bytes after two names
+            size_t o = skip_name(msg, len, rr.rdata_offset);
+            if (o != 0)
+                o = skip_name(msg, len, o);
+            if (o == 0 || o + 20 > rr.rdata_offset + rr.rdata_len)
+                return 0;
+
+            uint32_t minimum = get32(&msg[o + 16]);
+            if (minimum < ttl)
+                ttl = minimum;
+            found_soa = 1;
+        }
+
+        if (rr.ttl < ttl)
+            ttl = rr.ttl;
+    }
+
+    if (negative)
+    {
+        if (!found_soa)
+            return 0;
+        if (ttl > MAX_NEGATIVE_TTL)
+            ttl = MAX_NEGATIVE_TTL;
+    }
+    return ttl;
+}
+
+// Take the time in the cache off of each TTL
+static void age_ttls(unsigned char *msg, size_t len, uint32_t elapsed)
+{
+    size_t offset = skip_questions(msg, len);
+    if (offset == 0)
+        return;
+
+    int count = record_count(msg);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        struct record rr;
+        if (next_record(msg, len, &offset, &rr) < 0)
+            return;
+
+        if (rr.type != DNS_TYPE_OPT)
+            put32(&msg[rr.ttl_offset], rr.ttl > elapsed ? rr.ttl - elapsed : 0);
+    }
+}
+
+static uint32_t hash_key(const unsigned char *key, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        hash ^= key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void cache_init(struct dns_cache *dc)
+{
+    int i;
+    for (i = 0; i < CACHE_BUCKETS; i++)
+        dc->buckets[i] = -1;
+
+    // Unused entries are linked through next
+    for (i = 0; i < CACHE_SIZE; i++)
+        dc->entries[i].next = i + 1 < CACHE_SIZE ? i + 1 : -1;
+    dc->free_entry = 0;
+}
+
+static void cache_remove(struct dns_cache *dc, int ix)
+{
+    struct cache_entry *e = &dc->entries[ix];
+    int *link = &dc->buckets[e->hash % CACHE_BUCKETS];
+    while (*link != ix)
+        link = &dc->entries[*link].next;
+    *link = e->next;
+
+    free(e->response);
+    e->response = NULL;
+    e->in_use = 0;
+    e->next = dc->free_entry;
+    dc->free_entry = ix;
+}
+
+static void cache_flush(struct dns_cache *dc)
+{
+    int i;
+    for (i = 0; i < CACHE_SIZE; i++)
+    {
+        if (dc->entries[i].in_use)
+            cache_remove(dc, i);
+    }
+}
+
+static struct cache_entry *cache_lookup(struct dns_cache *dc, const unsigned char *key, size_t key_len, int64_t now)
+{
+    uint32_t hash = hash_key(key, key_len);
+    int ix = dc->buckets[hash % CACHE_BUCKETS];
+    while (ix >= 0)
+    {
+        struct cache_entry *e = &dc->entries[ix];
+        if (e->hash == hash && e->key_len == key_len && memcmp(e->key, key, key_len) == 0)
+        {
+            if (e->expires_us > now)
+                return e;
+
+            cache_remove(dc, ix);
+            return NULL;
+        }
+        ix = e->next;
+    }
+    return NULL;
+}
+
+static void cache_insert(struct dns_cache *dc, const unsigned char *key, size_t key_len,
+                         const unsigned char *msg, size_t len, uint32_t ttl, int64_t now)
+{
+    struct cache_entry *e = cache_lookup(dc, key, key_len, now);
+    if (e)
+        cache_remove(dc, e - dc->entries);
+
+    if (dc->free_entry < 0)
+    {
+        int oldest = 0;
+        int i;
+        for (i = 1; i < CACHE_SIZE; i++)
+        {
+            if (dc->entries[i].expires_us < dc->entries[oldest].expires_us)
+                oldest = i;
+        }
+        cache_remove(dc, oldest);
+    }
+
+    int ix = dc->free_entry;
+    e = &dc->entries[ix];
+    dc->free_entry = e->next;
+
+    e->response = malloc(len);
+    if (!e->response)
+        err(EXIT_FAILURE, "malloc");
+    memcpy(e->response, msg, len);
+    e->response_len = len;
+
+    memcpy(e->key, key, key_len);
+    e->key_len = key_len;
+    e->hash = hash_key(key, key_len);
+    e->stored_us = now;
+    e->expires_us = now + (int64_t)ttl * 1000000;
+    e->in_use = 1;
+
+    int *bucket = &dc->buckets[e->hash % CACHE_BUCKETS];
+    e->next = *bucket;
+    *bucket = ix;
+}
+
+static socklen_t server_sockaddr(const struct dns_cache *dc, const struct server *s, struct sockaddr_storage *ss)
+{
+    memset(ss, 0, sizeof(*ss));
+    if (s->family == AF_INET)
+    {
+        struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(dc->upstream_port);
+        memcpy(&sin->sin_addr, s->address, 4);
+        return sizeof(*sin);
+    }
+    else
+    {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(dc->upstream_port);
+        memcpy(&sin6->sin6_addr, s->address, 16);
+
+        // Link-local name servers need to know the interface
+        if (s->address[0] == 0xfe && (s->address[1] & 0xc0) == 0x80 && s->ifname[0])
+            sin6->sin6_scope_id = if_nametoindex(s->ifname);
+        return sizeof(*sin6);
+    }
+}
+
+static void pending_close(struct pending *p)
+{
+    if (p->fd >= 0)
+    {
+        close(p->fd);
+        p->fd = -1;
+    }
+}
+
+// Bind to a random source port. If the random ones are in use, the kernel
+// picks one when the socket is connected.
+static void bind_random_port(struct dns_cache *dc, int fd, unsigned char family)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        struct sockaddr_storage ss;
+        socklen_t ss_len;
+        memset(&ss, 0, sizeof(ss));
+        if (family == AF_INET)
+        {
+            struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+            sin->sin_family = AF_INET;
+            sin->sin_port = htons(random_port(dc));
+            ss_len = sizeof(*sin);
+        }
+        else
+        {
+            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+            sin6->sin6_family = AF_INET6;
+            sin6->sin6_port = htons(random_port(dc));
+            ss_len = sizeof(*sin6);
+        }
+
+        if (bind(fd, (const struct sockaddr *)&ss, ss_len) == 0 || errno != EADDRINUSE)
+            return;
+    }
+}
+
+// Open a new socket to send a query to a name server. This can fail until
+// the interface has an address.
+static int pending_open(struct dns_cache *dc, struct pending *p, const struct server *s)
+{
+    pending_close(p);
+
+    int fd = socket(s->family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    if (s->ifname[0] &&
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, s->ifname, strlen(s->ifname)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    bind_random_port(dc, fd, s->family);
+
+    // Connecting filters out datagrams from anyone else
+    struct sockaddr_storage ss;
+    socklen_t ss_len = server_sockaddr(dc, s, &ss);
+    if (connect(fd, (const struct sockaddr *)&ss, ss_len) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    p->fd = fd;
+    return 0;
+}
+
+// Pick the first name server that hasn't been timing out
+static int first_server(struct dns_cache *dc)
+{
+    int i;
+    for (i = 0; i < dc->server_count; i++)
+    {
+        if (dc->servers[i].failures < MAX_SERVER_FAILURES)
+            return i;
+    }
+    return 0;
+}
+
+static void finish_pending(struct dns_cache *dc, struct pending *p, unsigned char *msg, size_t len)
+{
+    int i;
+    for (i = 0; i < p->waiter_count; i++)
+        send_to_client(dc, &p->waiters[i], msg, len);
+
+    pending_close(p);
+    p->in_use = 0;
+}
+
+static void fail_pending(struct dns_cache *dc, struct pending *p)
+{
+    debug("query %04x failed", p->id);
+
+    size_t question_end = skip_questions(p->query, p->query_len);
+    int i;
+    for (i = 0; i < p->waiter_count; i++)
+        send_rcode(dc, &p->waiters[i], p->query, question_end, DNS_RCODE_SERVFAIL);
+
+    pending_close(p);
+    p->in_use = 0;
+}
+
+// Send the query to the next name server on a new socket. Late answers from
+// the previous name server are dropped with its socket. If no name servers
+// are left, the clients get SERVFAIL.
+static void send_pending(struct dns_cache *dc, struct pending *p, int server)
+{
+    while (dc->server_count > 0 && p->attempts < MAX_ATTEMPTS)
+    {
+        struct server *s = &dc->servers[server];
+        p->attempts++;
+        p->server = server;
+        p->deadline_us = now_us() + QUERY_TIMEOUT_MS * 1000;
+
+        if (pending_open(dc, p, s) == 0 && send(p->fd, p->query, p->query_len, 0) >= 0)
+        {
+            debug("query %04x sent to server %d", p->id, server);
+            return;
+        }
+
+        debug("query %04x couldn't be sent to server %d: %s", p->id, server, strerror(errno));
+        s->failures++;
+        server = (server + 1) % dc->server_count;
+    }
+
+    fail_pending(dc, p);
+}
+
+static struct pending *find_pending(struct dns_cache *dc, const unsigned char *key, size_t key_len)
+{
+    int i;
+    for (i = 0; i < MAX_PENDING; i++)
+    {
+        struct pending *p = &dc->pending[i];
+        if (p->in_use && p->key_len == key_len && memcmp(p->key, key, key_len) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+static struct pending *alloc_pending(struct dns_cache *dc)
+{
+    struct pending *p = NULL;
+    int i;
+    for (i = 0; i < MAX_PENDING && !p; i++)
+    {
+        if (!dc->pending[i].in_use)
+            p = &dc->pending[i];
+    }
+    if (!p)
+        return NULL;
+
+    // IDs are unique so that answers can't go to the wrong query
+    uint16_t id;
+    int unique;
+    do
+    {
+        id = random_id(dc);
+        unique = 1;
+        for (i = 0; i < MAX_PENDING; i++)
+        {
+            if (dc->pending[i].in_use && dc->pending[i].id == id)
+                unique = 0;
+        }
+    } while (!unique);
+
+    memset(p, 0, sizeof(*p));
+    p->in_use = 1;
+    p->id = id;
+    p->fd = -1;
+    return p;
+}
+
+static void client_process(struct dns_cache *dc)
+{
+    struct waiter w;
+    w.addr_len = sizeof(w.addr);
+    ssize_t len = recvfrom(dc->listen_fd, dc->message, sizeof(dc->message), 0, (struct sockaddr *)&w.addr, &w.addr_len);
+    if (len < 0)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+            warn("recvfrom(client)");
+        return;
+    }
+
+    // Ignore junk and anything that's not a query
+    if (len < DNS_HEADER_LEN || len > MAX_QUERY_LEN || (dc->message[2] & 0x80))
+        return;
+
+    struct query q;
+    int rcode = parse_query(dc->message, len, &q);
+    w.id = q.id;
+    w.max_len = q.max_len;
+    if (rcode != DNS_RCODE_NOERROR)
+    {
+        send_rcode(dc, &w, dc->message, 0, rcode);
+        return;
+    }
+
+    int64_t now = now_us();
+    struct cache_entry *e = cache_lookup(dc, q.key, q.key_len, now);
+    if (e)
+    {
+        debug("cache hit");
+        unsigned char *answer = dc->answer;
+        memcpy(answer, e->response, e->response_len);
+
+        // Use the client's question so that the case of the name matches
+        memcpy(&answer[DNS_HEADER_LEN], &dc->message[DNS_HEADER_LEN], q.question_end - DNS_HEADER_LEN);
+        age_ttls(answer, e->response_len, (uint32_t)((now - e->stored_us) / 1000000));
+
+        send_to_client(dc, &w, answer, e->response_len);
+        return;
+    }
+
+    if (dc->server_count == 0)
+    {
+        send_rcode(dc, &w, dc->message, q.question_end, DNS_RCODE_SERVFAIL);
+        return;
+    }
+
+    struct pending *p = find_pending(dc, q.key, q.key_len);
+    if (p)
+    {
+        // Clients retry on the same ID, so only answer them once
+        int i;
+        for (i = 0; i < p->waiter_count; i++)
+        {
+            if (p->waiters[i].id == w.id && p->waiters[i].addr_len == w.addr_len &&
+                memcmp(&p->waiters[i].addr, &w.addr, w.addr_len) == 0)
+                return;
+        }
+
+        if (p->waiter_count < MAX_WAITERS)
+            p->waiters[p->waiter_count++] = w;
+        return;
+    }
+
+    p = alloc_pending(dc);
+    if (!p)
+    {
+        debug("too many queries in progress");
+        return;
+    }
+
+    memcpy(p->key, q.key, q.key_len);
+    p->key_len = q.key_len;
+    memcpy(p->query, dc->message, len);
+    p->query_len = len;
+    put16(p->query, p->id);
+    p->waiters[0] = w;
+    p->waiter_count = 1;
+
+    send_pending(dc, p, first_server(dc));
+}
+
+// Check that an answer came from the name server's address and port. The
+// socket is connected, so this is just in case.
+static int from_server(struct dns_cache *dc, const struct server *s, const struct sockaddr_storage *from, socklen_t from_len)
+{
+    struct sockaddr_storage ss;
+    socklen_t ss_len = server_sockaddr(dc, s, &ss);
+    if (from_len < ss_len || from->ss_family != ss.ss_family)
+        return 0;
+
+    if (ss.ss_family == AF_INET)
+    {
+        const struct sockaddr_in *a = (const struct sockaddr_in *)from;
+        const struct sockaddr_in *b = (const struct sockaddr_in *)&ss;
+        return a->sin_port == b->sin_port && memcmp(&a->sin_addr, &b->sin_addr, 4) == 0;
+    }
+    else
+    {
+        const struct sockaddr_in6 *a = (const struct sockaddr_in6 *)from;
+        const struct sockaddr_in6 *b = (const struct sockaddr_in6 *)&ss;
+        return a->sin6_port == b->sin6_port && memcmp(&a->sin6_addr, &b->sin6_addr, 16) == 0;
+    }
+}
+
+static void pending_process(struct dns_cache *dc, struct pending *p)
+{
+    int server = p->server;
+    struct server *s = &dc->servers[server];
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len = recvfrom(p->fd, dc->message, sizeof(dc->message), 0, (struct sockaddr *)&from, &from_len);
+    if (len < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return;
+
+        // ICMP errors show up here. Move the query on to the next server
+        // rather than waiting for it to time out.
+        debug("recv(server %d): %s", server, strerror(errno));
+        s->failures++;
+        send_pending(dc, p, (server + 1) % dc->server_count);
+        return;
+    }
+
+    if (len < DNS_HEADER_LEN || !(dc->message[2] & 0x80) || get16(dc->message) != p->id ||
+        !from_server(dc, s, &from, from_len))
+        return;
+
+    // Make sure that the answer is for the question that was asked
+    size_t question_end = skip_questions(dc->message, len);
+    unsigned char key[MAX_KEY_LEN];
+    if (get16(&dc->message[4]) != 1 || question_end == 0 ||
+        make_key(dc->message, question_end, p->key[0], key) != p->key_len ||
+        memcmp(key, p->key, p->key_len) != 0)
+    {
+        debug("answer doesn't match question");
+        return;
+    }
+
+    s->failures = 0;
+
+    // Give other name servers a chance before returning these
+    int rcode = dc->message[3] & 0xf;
+    if ((rcode == DNS_RCODE_SERVFAIL || rcode == DNS_RCODE_REFUSED) &&
+        p->attempts < MAX_ATTEMPTS && dc->server_count > 1)
+    {
+        send_pending(dc, p, (server + 1) % dc->server_count);
+        return;
+    }
+
+    uint32_t ttl = cache_ttl(dc->message, len);
+    debug("query %04x answered by server %d, rcode %d, ttl %u", p->id, server, rcode, ttl);
+    if (ttl > 0)
+        cache_insert(dc, p->key, p->key_len, dc->message, len, ttl, now_us());
+
+    finish_pending(dc, p, dc->message, len);
+}
+
+static void check_timeouts(struct dns_cache *dc)
+{
+    int64_t now = now_us();
+    int i;
+    for (i = 0; i < MAX_PENDING; i++)
+    {
+        struct pending *p = &dc->pending[i];
+        if (!p->in_use || p->deadline_us > now)
+            continue;
+
+        dc->servers[p->server].failures++;
+        send_pending(dc, p, (p->server + 1) % dc->server_count);
+    }
+}
+
+static int decode_address(const char *buf, int *index, unsigned char *family, unsigned char *addr)
+{
+    int arity;
+    if (ei_decode_tuple_header(buf, index, &arity) < 0)
+        return -1;
+
+    int i;
+    switch (arity)
+    {
+    case 4:
+        for (i = 0; i < 4; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 255)
+                return -1;
+            addr[i] = v;
+        }
+        *family = AF_INET;
+        return 0;
+
+    case 8:
+        for (i = 0; i < 8; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 65535)
+                return -1;
+            addr[2 * i] = v >> 8;
+            addr[2 * i + 1] = v & 0xff;
+        }
+        *family = AF_INET6;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+static int decode_server(const char *buf, int *index, struct server *s)
+{
+    int arity;
+    int type;
+    int size;
+    long len;
+    memset(s, 0, sizeof(*s));
+
+    if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity != 2 ||
+        decode_address(buf, index, &s->family, s->address) < 0 ||
+        ei_get_type(buf, index, &type, &size) < 0 || size >= IF_NAMESIZE ||
+        ei_decode_binary(buf, index, s->ifname, &len) < 0)
+        return -1;
+
+    s->ifname[len] = '\0';
+    return 0;
+}
+
+static int same_server_set(const struct server *a, int a_count, const struct server *b, int b_count)
+{
+    if (a_count != b_count)
+        return 0;
+
+    int i;
+    for (i = 0; i < a_count; i++)
+    {
+        int found = 0;
+        int j;
+        for (j = 0; j < b_count && !found; j++)
+            found = a[i].family == b[j].family && memcmp(a[i].address, b[j].address, 16) == 0;
+        if (!found)
+            return 0;
+    }
+    return 1;
+}
+
+static void set_servers(struct dns_cache *dc, struct server *servers, int count)
+{
+    // Answers from one network's name servers may not be right for another's
+    if (!same_server_set(dc->servers, dc->server_count, servers, count))
+        cache_flush(dc);
+
+    memcpy(dc->servers, servers, count * sizeof(struct server));
+    dc->server_count = count;
+    debug("%d name servers", count);
+
+    // Restart queries in progress on the new name servers
+    int i;
+    for (i = 0; i < MAX_PENDING; i++)
+    {
+        struct pending *p = &dc->pending[i];
+        if (!p->in_use)
+            continue;
+
+        p->attempts = 0;
+        send_pending(dc, p, first_server(dc));
+    }
+}
+
+static void process_request(struct dns_cache *dc, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    int count;
+    char cmd[MAXATOMLEN];
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 || arity != 2 ||
+        ei_decode_atom(buf, &index, cmd) < 0 || strcmp(cmd, "servers") != 0 ||
+        ei_decode_list_header(buf, &index, &count) < 0)
+        errx(EXIT_FAILURE, "Expecting {:servers, servers} from Elixir");
+
+    struct server servers[MAX_SERVERS];
+    int used = 0;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        struct server s;
+        if (decode_server(buf, &index, &s) < 0)
+            errx(EXIT_FAILURE, "Expecting {address, ifname} from Elixir");
+
+        // Extras are ignored like with resolv.conf
+        if (used < MAX_SERVERS)
+            servers[used++] = s;
+    }
+    if (used < count)
+        send_error("too many name servers");
+
+    set_servers(dc, servers, used);
+}
+
+static int stdin_process(struct dns_cache *dc)
+{
+    ssize_t amount = read(STDIN_FILENO, dc->request + dc->request_len, sizeof(dc->request) - dc->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    dc->request_len += amount;
+
+    size_t offset = 0;
+    while (dc->request_len - offset >= 2)
+    {
+        size_t len = ((unsigned char)dc->request[offset] << 8) | (unsigned char)dc->request[offset + 1];
+        if (dc->request_len - offset < len + 2)
+            break;
+
+        process_request(dc, &dc->request[offset + 2]);
+        offset += len + 2;
+    }
+
+    dc->request_len -= offset;
+    memmove(dc->request, &dc->request[offset], dc->request_len);
+    return 0;
+}
+
+// Milliseconds until the next query times out or -1 if nothing is in progress
+static int next_timeout(struct dns_cache *dc)
+{
+    int64_t now = now_us();
+    int64_t next = -1;
+    int i;
+    for (i = 0; i < MAX_PENDING; i++)
+    {
+        if (!dc->pending[i].in_use)
+            continue;
+
+        int64_t remaining = dc->pending[i].deadline_us - now;
+        if (remaining < 0)
+            remaining = 0;
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
+
+    // Round up so that the deadline has passed when poll returns
+    return next < 0 ? -1 : (int)((next + 999) / 1000);
+}
+
+static void dns_cache_init(struct dns_cache *dc, unsigned int listen_port, unsigned int upstream_port)
+{
+    memset(dc, 0, sizeof(*dc));
+    dc->upstream_port = upstream_port;
+    cache_init(dc);
+
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, &dc->random_state, sizeof(dc->random_state)) != sizeof(dc->random_state))
+        err(EXIT_FAILURE, "/dev/urandom");
+    close(fd);
+    if (dc->random_state == 0)
+        dc->random_state = 1;
+
+    dc->listen_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (dc->listen_fd < 0)
+        err(EXIT_FAILURE, "socket");
+
+    int one = 1;
+    setsockopt(dc->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(listen_port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(dc->listen_fd, (const struct sockaddr *)&sin, sizeof(sin)) < 0)
+        err(EXIT_FAILURE, "bind(127.0.0.1:%u)", listen_port);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+        errx(EXIT_FAILURE, "Usage: %s <listen port> <upstream port>", argv[0]);
+
+    static struct dns_cache dc;
+    dns_cache_init(&dc, strtoul(argv[1], NULL, 0), strtoul(argv[2], NULL, 0));
+
+    for (;;)
+    {
+        struct pollfd fdset[2 + MAX_PENDING];
+
+        fdset[0].fd = STDIN_FILENO;
+        fdset[0].events = POLLIN;
+        fdset[0].revents = 0;
+
+        fdset[1].fd = dc.listen_fd;
+        fdset[1].events = POLLIN;
+        fdset[1].revents = 0;
+
+        // Negative fds are skipped by poll
+        int i;
+        for (i = 0; i < MAX_PENDING; i++)
+        {
+            fdset[2 + i].fd = dc.pending[i].in_use ? dc.pending[i].fd : -1;
+            fdset[2 + i].events = POLLIN;
+            fdset[2 + i].revents = 0;
+        }
+
+        int rc = poll(fdset, 2 + MAX_PENDING, next_timeout(&dc));
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "poll");
+        }
+
+        // Handle name server changes first since they reopen query sockets
+        if (fdset[0].revents & (POLLIN | POLLHUP))
+        {
+            if (stdin_process(&dc) < 0)
+                break;
+        }
+        else
+        {
+            for (i = 0; i < MAX_PENDING; i++)
+            {
+                struct pending *p = &dc.pending[i];
+                if (p->in_use && p->fd == fdset[2 + i].fd &&
+                    (fdset[2 + i].revents & (POLLIN | POLLERR)))
+                    pending_process(&dc, p);
+            }
+        }
+
+        if (fdset[1].revents & POLLIN)
+            client_process(&dc);
+
+        check_timeouts(&dc);
+    }
+
+    close(dc.listen_fd);
+    return 0;
+}
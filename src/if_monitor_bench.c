@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Microbenchmark for if_monitor's report encoding
+//
+// This encodes link and address reports into a reused buffer the same way
+// if_monitor stages batches and prints the throughput and memory use. Run it
+// with `make bench` and MIX_APP_PATH set like mix does. Pass a report count to
+// change the default of 5 million.
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <net/if.h>
+#include <linux/if.h>
+#include <linux/rtnetlink.h>
+
+#include "if_monitor_encode.h"
+
+// Reports per simulated batch before the buffer is reset
+#define BATCH_SIZE 64
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void init_link(struct link_state *state)
+{
+    static const unsigned char mac[6] = {0x02, 0x42, 0xac, 0x11, 0x00, 0x02};
+
+    memset(state, 0, sizeof(*state));
+    strcpy(state->ifname, "eth0");
+    state->is_ethernet = 1;
+    state->flags = IFF_UP | IFF_BROADCAST | IFF_RUNNING | WORKAROUND_IFF_LOWER_UP | IFF_MULTICAST;
+    state->present = LINK_MTU | LINK_MAC_ADDRESS | LINK_MAC_BROADCAST | LINK_OPERSTATE | LINK_STATS;
+    state->mtu = 1500;
+    memcpy(state->mac_address, mac, sizeof(mac));
+    memset(state->mac_broadcast, 0xff, sizeof(state->mac_broadcast));
+    state->operstate = IF_OPER_UP;
+    state->stats.rx_packets = 123456789;
+    state->stats.tx_packets = 98765432;
+    state->stats.rx_bytes = 123456789012ULL;
+    state->stats.tx_bytes = 98765432109ULL;
+}
+
+static struct nlmsghdr *build_ipv6_addr(char *buf, struct nlattr **tb)
+{
+    static const unsigned char address[16] =
+    {
+        0x20, 0x01, 0x0d, 0xb8, 0x12, 0x34, 0x56, 0x78,
+        0x02, 0x42, 0xac, 0xff, 0xfe, 0x11, 0x00, 0x02
+    };
+
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+    nlh->nlmsg_type = RTM_NEWADDR;
+
+    struct ifaddrmsg *ifa = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifaddrmsg));
+    ifa->ifa_family = AF_INET6;
+    ifa->ifa_prefixlen = 64;
+    ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa->ifa_index = 2;
+
+    mnl_attr_put(nlh, IFA_ADDRESS, sizeof(address), address);
+    mnl_attr_put_u32(nlh, IFA_FLAGS, IFA_F_PERMANENT);
+
+    memset(tb, 0, (IFA_MAX + 1) * sizeof(struct nlattr *));
+    struct nlattr *attr;
+    mnl_attr_for_each(attr, nlh, sizeof(struct ifaddrmsg))
+    {
+        tb[mnl_attr_get_type(attr)] = attr;
+    }
+
+    return nlh;
+}
+
+int main(int argc, char *argv[])
+{
+    long count = argc > 1 ? strtol(argv[1], NULL, 0) : 5000000;
+    if (count <= 0)
+        errx(EXIT_FAILURE, "Usage: if_monitor_bench [report count]");
+
+    struct link_state link;
+    init_link(&link);
+
+    char nlbuf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlattr *tb[IFA_MAX + 1];
+    struct nlmsghdr *nlh = build_ipv6_addr(nlbuf, tb);
+    const struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
+
+    ei_x_buff buff;
+    if (ei_x_new(&buff) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+
+    // Let the buffer grow to its working size before measuring
+    int i;
+    for (i = 0; i < BATCH_SIZE; i++)
+        netif_build_link(&buff, ATOM_NEWLINK, 2, &link, LINK_REQUIRED_FIELDS | link.present);
+    buff.index = 0;
+
+    long rss_before = max_rss_kb();
+    int buffsz_before = buff.buffsz;
+    long long bytes = 0;
+    int64_t start = now_ns();
+
+    long n;
+    for (n = 0; n < count; n++)
+    {
+        // Mix of full link reports, small updates and IPv6 address reports
+        switch (n % 4)
+        {
+        case 0:
+            netif_build_link(&buff, ATOM_NEWLINK, 2, &link, LINK_REQUIRED_FIELDS | link.present);
+            break;
+        case 1:
+        case 2:
+            link.stats.rx_packets++;
+            netif_build_link(&buff, ATOM_UPDATELINK, 2, &link, LINK_RUNNING | LINK_OPERSTATE | LINK_STATS);
+            break;
+        default:
+            netif_build_addr(&buff, ATOM_NEWADDR, ifa, tb);
+            break;
+        }
+
+        if ((n + 1) % BATCH_SIZE == 0)
+        {
+            bytes += buff.index;
+            buff.index = 0;
+        }
+    }
+    bytes += buff.index;
+
+    int64_t elapsed_ns = now_ns() - start;
+    double seconds = elapsed_ns / 1e9;
+
+    printf("reports:          %ld\n", count);
+    printf("elapsed:          %.3f s\n", seconds);
+    printf("reports/sec:      %.0f\n", count / seconds);
+    printf("ns/report:        %.1f\n", (double) elapsed_ns / count);
+    printf("bytes encoded:    %lld (%.1f MB/s)\n", bytes, bytes / seconds / 1e6);
+    printf("buffer size:      %d -> %d bytes\n", buffsz_before, buff.buffsz);
+    printf("max RSS:          %ld -> %ld KB\n", rss_before, max_rss_kb());
+
+    ei_x_free(&buff);
+    return 0;
+}
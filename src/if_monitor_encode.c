@@ -0,0 +1,533 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Erlang term encoding for if_monitor reports
+//
+// Reports are encoded into buffers that if_monitor reuses, so nothing here
+// allocates once the buffers have grown to fit. Atoms are stored as complete
+// external term format byte sequences so that encoding one is a single copy.
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if.h>
+#include <linux/rtnetlink.h>
+
+#include "if_monitor_encode.h"
+
+// Longest atom text plus room to spare. Atoms are ASCII, so SMALL_ATOM_UTF8_EXT
+// is the same as what ei_x_encode_atom produces.
+#define MAX_ATOM_TEXT 24
+
+struct atom_bytes
+{
+    unsigned char tag;
+    unsigned char len;
+    char text[MAX_ATOM_TEXT];
+};
+
+static const struct atom_bytes atoms[ATOM_COUNT] =
+{
+#define IF_MONITOR_ATOM_BYTES(id, text) {ERL_SMALL_ATOM_UTF8_EXT, sizeof(text) - 1, text},
+    IF_MONITOR_ATOMS(IF_MONITOR_ATOM_BYTES)
+#undef IF_MONITOR_ATOM_BYTES
+};
+
+// Address families that aren't here are reported as "unknown" (index 0)
+static const unsigned char family_atoms[] =
+{
+    [AF_UNSPEC] = ATOM_UNSPEC,
+    [AF_UNIX] = ATOM_UNIX,
+    [AF_INET] = ATOM_INET,
+    [AF_AX25] = ATOM_AX25,
+    [AF_IPX] = ATOM_IPX,
+    [AF_APPLETALK] = ATOM_APPLETALK,
+    [AF_NETROM] = ATOM_NETROM,
+    [AF_BRIDGE] = ATOM_BRIDGE,
+    [AF_ATMPVC] = ATOM_ATMPVC,
+    [AF_X25] = ATOM_X25,
+    [AF_INET6] = ATOM_INET6,
+    [AF_ROSE] = ATOM_ROSE,
+    [AF_DECnet] = ATOM_DECNET,
+    [AF_NETBEUI] = ATOM_NETBEUI,
+    [AF_SECURITY] = ATOM_SECURITY,
+    [AF_KEY] = ATOM_KEY,
+    [AF_NETLINK] = ATOM_NETLINK,
+    [AF_PACKET] = ATOM_PACKET,
+    [AF_ASH] = ATOM_ASH,
+    [AF_ECONET] = ATOM_ECONET,
+    [AF_ATMSVC] = ATOM_ATMSVC,
+    [AF_RDS] = ATOM_RDS,
+    [AF_SNA] = ATOM_SNA,
+    [AF_IRDA] = ATOM_IRDA,
+    [AF_PPPOX] = ATOM_PPPOX,
+    [AF_WANPIPE] = ATOM_WANPIPE,
+    [AF_LLC] = ATOM_LLC,
+    [AF_IB] = ATOM_IB,
+    [AF_MPLS] = ATOM_MPLS,
+    [AF_CAN] = ATOM_CAN,
+    [AF_TIPC] = ATOM_TIPC,
+    [AF_BLUETOOTH] = ATOM_BLUETOOTH,
+    [AF_IUCV] = ATOM_IUCV,
+    [AF_RXRPC] = ATOM_RXRPC,
+    [AF_ISDN] = ATOM_ISDN,
+    [AF_PHONET] = ATOM_PHONET,
+    [AF_IEEE802154] = ATOM_IEEE802154,
+    [AF_CAIF] = ATOM_CAIF,
+    [AF_ALG] = ATOM_ALG,
+    [AF_NFC] = ATOM_NFC,
+    [AF_VSOCK] = ATOM_VSOCK,
+    [AF_KCM] = ATOM_KCM,
+#ifdef AF_QIPCRTR
+    [AF_QIPCRTR] = ATOM_QIPCRTR,
+#endif
+#ifdef AF_SMC
+    [AF_SMC] = ATOM_SMC,
+#endif
+};
+
+// Refer to RFC2863 for state descriptions (or the kernel docs)
+static const unsigned char operstate_atoms[] =
+{
+    [IF_OPER_UNKNOWN] = ATOM_UNKNOWN,
+    [IF_OPER_NOTPRESENT] = ATOM_NOTPRESENT,
+    [IF_OPER_DOWN] = ATOM_DOWN,
+    [IF_OPER_LOWERLAYERDOWN] = ATOM_LOWERLAYERDOWN,
+    [IF_OPER_TESTING] = ATOM_TESTING,
+    [IF_OPER_DORMANT] = ATOM_DORMANT,
+    [IF_OPER_UP] = ATOM_UP,
+};
+
+// Route types without atoms are reported as integers (index 0)
+static const unsigned char route_type_atoms[] =
+{
+    [RTN_UNICAST] = ATOM_UNICAST,
+    [RTN_LOCAL] = ATOM_LOCAL,
+    [RTN_BROADCAST] = ATOM_BROADCAST,
+    [RTN_ANYCAST] = ATOM_ANYCAST,
+    [RTN_MULTICAST] = ATOM_MULTICAST,
+    [RTN_BLACKHOLE] = ATOM_BLACKHOLE,
+    [RTN_UNREACHABLE] = ATOM_UNREACHABLE,
+    [RTN_PROHIBIT] = ATOM_PROHIBIT,
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+void encode_atom(ei_x_buff *buff, enum if_monitor_atom atom)
+{
+    ei_x_append_buf(buff, (const char *) &atoms[atom], atoms[atom].len + 2);
+}
+
+void encode_string(ei_x_buff *buff, const char *str)
+{
+    // Encode strings as binaries so that we get Elixir strings
+    // NOTE: the strings that we encounter here are expected to be ASCII to
+    //       my knowledge
+    ei_x_encode_binary(buff, str, strlen(str));
+}
+
+void encode_kv_ulong(ei_x_buff *buff, enum if_monitor_atom key, unsigned long value)
+{
+    encode_atom(buff, key);
+    ei_x_encode_ulong(buff, value);
+}
+
+void encode_kv_ulonglong(ei_x_buff *buff, enum if_monitor_atom key, unsigned long long value)
+{
+    encode_atom(buff, key);
+    ei_x_encode_ulonglong(buff, value);
+}
+
+void encode_kv_bool(ei_x_buff *buff, enum if_monitor_atom key, int value)
+{
+    encode_atom(buff, key);
+    encode_atom(buff, value ? ATOM_TRUE : ATOM_FALSE);
+}
+
+void encode_kv_nil(ei_x_buff *buff, enum if_monitor_atom key)
+{
+    encode_atom(buff, key);
+    encode_atom(buff, ATOM_NIL);
+}
+
+void encode_kv_string(ei_x_buff *buff, enum if_monitor_atom key, const char *value)
+{
+    encode_atom(buff, key);
+    encode_string(buff, value);
+}
+
+// Encode count NUL-terminated strings that are packed one after the other
+void encode_kv_string_list(ei_x_buff *buff, enum if_monitor_atom key, const char *values, int count)
+{
+    encode_atom(buff, key);
+    if (count > 0)
+    {
+        ei_x_encode_list_header(buff, count);
+
+        int i;
+        for (i = 0; i < count; i++)
+        {
+            encode_string(buff, values);
+            values += strlen(values) + 1;
+        }
+    }
+    ei_x_encode_empty_list(buff);
+}
+
+void encode_kv_macaddr(ei_x_buff *buff, enum if_monitor_atom key, const unsigned char *macaddr)
+{
+    encode_atom(buff, key);
+
+    // Only handle 6 byte mac addresses (to my knowledge, this is the only case).
+    // The result is a BINARY_EXT with "aa:bb:cc:dd:ee:ff".
+    char bytes[5 + 17] = {ERL_BINARY_EXT, 0, 0, 0, 17};
+    char *p = &bytes[5];
+    int i;
+    for (i = 0; i < 6; i++)
+    {
+        if (i > 0)
+            *p++ = ':';
+        *p++ = hex_digits[macaddr[i] >> 4];
+        *p++ = hex_digits[macaddr[i] & 0xf];
+    }
+    ei_x_append_buf(buff, bytes, sizeof(bytes));
+}
+
+static char *put_small_uint(char *p, unsigned int value)
+{
+    // Same encodings as ei_x_encode_ulong for values up to 65535
+    if (value < 256)
+    {
+        *p++ = ERL_SMALL_INTEGER_EXT;
+        *p++ = value;
+    }
+    else
+    {
+        *p++ = ERL_INTEGER_EXT;
+        *p++ = 0;
+        *p++ = 0;
+        *p++ = value >> 8;
+        *p++ = value & 0xff;
+    }
+    return p;
+}
+
+void encode_kv_raw_address(ei_x_buff *buff, enum if_monitor_atom key, const uint8_t *addr, uint16_t len)
+{
+    encode_atom(buff, key);
+
+    // IPv4 and IPv6 addresses are tuples like :inet uses and are built on the
+    // stack so that they can be added with one copy.
+    char bytes[2 + 8 * 5];
+    char *p = bytes;
+    uint16_t i;
+    switch (len)
+    {
+    case 16: // IPv6
+        *p++ = ERL_SMALL_TUPLE_EXT;
+        *p++ = 8;
+        for (i = 0; i < 16; i += 2)
+            p = put_small_uint(p, (addr[i] << 8) | addr[i + 1]);
+        ei_x_append_buf(buff, bytes, p - bytes);
+        break;
+    case 4: // IPv4
+        *p++ = ERL_SMALL_TUPLE_EXT;
+        *p++ = 4;
+        for (i = 0; i < 4; i++)
+            p = put_small_uint(p, addr[i]);
+        ei_x_append_buf(buff, bytes, p - bytes);
+        break;
+    default:
+        ei_x_encode_tuple_header(buff, len);
+        for (i = 0; i < len; i++)
+            ei_x_encode_ulong(buff, addr[i]);
+        break;
+    }
+}
+
+void encode_kv_scope(ei_x_buff *buff, enum if_monitor_atom key, uint8_t scope)
+{
+    encode_atom(buff, key);
+
+    switch (scope)
+    {
+    case RT_SCOPE_UNIVERSE:
+        encode_atom(buff, ATOM_UNIVERSE);
+        break;
+    case RT_SCOPE_SITE:
+        encode_atom(buff, ATOM_SITE);
+        break;
+    case RT_SCOPE_LINK:
+        encode_atom(buff, ATOM_LINK);
+        break;
+    case RT_SCOPE_HOST:
+        encode_atom(buff, ATOM_HOST);
+        break;
+    case RT_SCOPE_NOWHERE:
+        encode_atom(buff, ATOM_NOWHERE);
+        break;
+    default:
+        ei_x_encode_ulong(buff, scope);
+        break;
+    }
+}
+
+void encode_kv_route_type(ei_x_buff *buff, enum if_monitor_atom key, uint8_t type)
+{
+    encode_atom(buff, key);
+
+    if (type < ARRAY_SIZE(route_type_atoms) && route_type_atoms[type] != ATOM_UNKNOWN)
+        encode_atom(buff, route_type_atoms[type]);
+    else
+        ei_x_encode_ulong(buff, type);
+}
+
+void encode_kv_family(ei_x_buff *buff, enum if_monitor_atom key, uint8_t family)
+{
+    encode_atom(buff, key);
+    encode_atom(buff, family < ARRAY_SIZE(family_atoms) ? family_atoms[family] : ATOM_UNKNOWN);
+}
+
+static void encode_kv_stats(ei_x_buff *buff, enum if_monitor_atom key, const struct rtnl_link_stats64 *stats)
+{
+    encode_atom(buff, key);
+    ei_x_encode_map_header(buff, 10);
+    encode_kv_ulonglong(buff, ATOM_RX_PACKETS, stats->rx_packets);
+    encode_kv_ulonglong(buff, ATOM_TX_PACKETS, stats->tx_packets);
+    encode_kv_ulonglong(buff, ATOM_RX_BYTES, stats->rx_bytes);
+    encode_kv_ulonglong(buff, ATOM_TX_BYTES, stats->tx_bytes);
+    encode_kv_ulonglong(buff, ATOM_RX_ERRORS, stats->rx_errors);
+    encode_kv_ulonglong(buff, ATOM_TX_ERRORS, stats->tx_errors);
+    encode_kv_ulonglong(buff, ATOM_RX_DROPPED, stats->rx_dropped);
+    encode_kv_ulonglong(buff, ATOM_TX_DROPPED, stats->tx_dropped);
+    encode_kv_ulonglong(buff, ATOM_MULTICAST, stats->multicast);
+    encode_kv_ulonglong(buff, ATOM_COLLISIONS, stats->collisions);
+}
+
+static void encode_kv_operstate(ei_x_buff *buff, uint32_t operstate)
+{
+    encode_atom(buff, ATOM_OPERSTATE);
+    encode_atom(buff, operstate < ARRAY_SIZE(operstate_atoms) ? operstate_atoms[operstate] : ATOM_UNKNOWN);
+}
+
+static int count_bits(uint32_t v)
+{
+    int count = 0;
+    while (v)
+    {
+        v &= v - 1;
+        count++;
+    }
+    return count;
+}
+
+void netif_build_link(ei_x_buff *buff, enum if_monitor_atom report, int ifindex, const struct link_state *state, uint32_t fields)
+{
+    ei_x_encode_tuple_header(buff, 4);
+    encode_atom(buff, report);
+    encode_string(buff, state->ifname);
+    ei_x_encode_long(buff, ifindex);
+
+    // The interface name is in the tuple, so it's not in the map
+    ei_x_encode_map_header(buff, count_bits(fields & ~LINK_IFNAME));
+
+    if (fields & LINK_TYPE)
+    {
+        encode_atom(buff, ATOM_TYPE);
+        encode_atom(buff, state->is_ethernet ? ATOM_ETHERNET : ATOM_OTHER);
+    }
+
+    if (fields & LINK_UP)
+        encode_kv_bool(buff, ATOM_UP, state->flags & IFF_UP);
+    if (fields & LINK_BROADCAST)
+        encode_kv_bool(buff, ATOM_BROADCAST, state->flags & IFF_BROADCAST);
+    if (fields & LINK_RUNNING)
+        encode_kv_bool(buff, ATOM_RUNNING, state->flags & IFF_RUNNING);
+    if (fields & LINK_LOWER_UP)
+        encode_kv_bool(buff, ATOM_LOWER_UP, state->flags & WORKAROUND_IFF_LOWER_UP);
+    if (fields & LINK_MULTICAST)
+        encode_kv_bool(buff, ATOM_MULTICAST, state->flags & IFF_MULTICAST);
+
+    // Optional fields that went away are reported as nil
+    uint32_t removed = fields & ~state->present;
+    if (removed & LINK_MTU)
+        encode_kv_nil(buff, ATOM_MTU);
+    else if (fields & LINK_MTU)
+        encode_kv_ulong(buff, ATOM_MTU, state->mtu);
+    if (removed & LINK_MAC_ADDRESS)
+        encode_kv_nil(buff, ATOM_MAC_ADDRESS);
+    else if (fields & LINK_MAC_ADDRESS)
+        encode_kv_macaddr(buff, ATOM_MAC_ADDRESS, state->mac_address);
+    if (removed & LINK_MAC_BROADCAST)
+        encode_kv_nil(buff, ATOM_MAC_BROADCAST);
+    else if (fields & LINK_MAC_BROADCAST)
+        encode_kv_macaddr(buff, ATOM_MAC_BROADCAST, state->mac_broadcast);
+    if (removed & LINK_LINK)
+        encode_kv_nil(buff, ATOM_LINK);
+    else if (fields & LINK_LINK)
+        encode_kv_ulong(buff, ATOM_LINK, state->link);
+    if (removed & LINK_OPERSTATE)
+        encode_kv_nil(buff, ATOM_OPERSTATE);
+    else if (fields & LINK_OPERSTATE)
+        encode_kv_operstate(buff, state->operstate);
+    if (removed & LINK_PERM_ADDRESS)
+        encode_kv_nil(buff, ATOM_PERM_MAC_ADDRESS);
+    else if (fields & LINK_PERM_ADDRESS)
+        encode_kv_macaddr(buff, ATOM_PERM_MAC_ADDRESS, state->perm_address);
+    if (removed & LINK_PARENT_DEV)
+        encode_kv_nil(buff, ATOM_PARENT_DEV);
+    else if (fields & LINK_PARENT_DEV)
+        encode_kv_string(buff, ATOM_PARENT_DEV, state->parent_dev);
+    if (removed & LINK_PARENT_BUS)
+        encode_kv_nil(buff, ATOM_PARENT_BUS);
+    else if (fields & LINK_PARENT_BUS)
+        encode_kv_string(buff, ATOM_PARENT_BUS, state->parent_bus);
+    if (removed & LINK_KIND)
+        encode_kv_nil(buff, ATOM_KIND);
+    else if (fields & LINK_KIND)
+        encode_kv_string(buff, ATOM_KIND, state->kind);
+    if (removed & LINK_ALT_IFNAMES)
+        encode_kv_nil(buff, ATOM_ALT_IFNAMES);
+    else if (fields & LINK_ALT_IFNAMES)
+        encode_kv_string_list(buff, ATOM_ALT_IFNAMES, state->alt_ifnames, state->alt_ifname_count);
+    if (removed & LINK_HW_PATH)
+        encode_kv_nil(buff, ATOM_HW_PATH);
+    else if (fields & LINK_HW_PATH)
+        encode_kv_string(buff, ATOM_HW_PATH, state->hw_path);
+    if (removed & LINK_STATS)
+        encode_kv_nil(buff, ATOM_STATS);
+    else if (fields & LINK_STATS)
+        encode_kv_stats(buff, ATOM_STATS, &state->stats);
+}
+
+void encode_kv_address_attr(ei_x_buff *buff, enum if_monitor_atom key, const struct nlattr *attr)
+{
+    encode_kv_raw_address(buff, key, mnl_attr_get_payload(attr), mnl_attr_get_payload_len(attr));
+}
+
+// Lifetimes are in seconds. All ones means that the address doesn't expire.
+#define INFINITY_LIFE_TIME 0xFFFFFFFFU
+
+// Prefix flags from include/net/if_inet6.h in the Linux source. They're not
+// in the user-space headers. Linux 6.7 and later pass the L and A bits from
+// the router advertisement's prefix option instead, so check for both.
+#define WORKAROUND_IF_PREFIX_ONLINK (0x01 | 0x80)
+#define WORKAROUND_IF_PREFIX_AUTOCONF (0x02 | 0x40)
+
+static void encode_kv_lifetime(ei_x_buff *buff, enum if_monitor_atom key, uint32_t seconds)
+{
+    if (seconds == INFINITY_LIFE_TIME)
+    {
+        encode_atom(buff, key);
+        encode_atom(buff, ATOM_INFINITY);
+    }
+    else
+    {
+        encode_kv_ulong(buff, key, seconds);
+    }
+}
+
+// The lifetimes are encoded last and the index where they start is returned.
+// They're the only thing that changes when Linux refreshes an address, so
+// callers that compare reports can skip them.
+int netif_build_addr(ei_x_buff *buff, enum if_monitor_atom report, const struct ifaddrmsg *ifa, struct nlattr **tb)
+{
+    ei_x_encode_tuple_header(buff, 3);
+    encode_atom(buff, report);
+
+    ei_x_encode_long(buff, ifa->ifa_index);
+
+    int count = 4; // Base number of fields
+    int i;
+    for (i = 0; i <= IFA_MAX; i++)
+        if (tb[i])
+            count++;
+
+    uint32_t flags;
+    if (tb[IFA_FLAGS])
+    {
+        flags = mnl_attr_get_u32(tb[IFA_FLAGS]);
+        count--;
+    }
+    else
+    {
+        flags = ifa->ifa_flags;
+    }
+
+    // Duplicate address detection only applies to IPv6
+    int is_inet6 = ifa->ifa_family == AF_INET6;
+    if (is_inet6)
+        count += 3;
+
+    // The cache info is reported as two lifetimes
+    if (tb[IFA_CACHEINFO])
+        count++;
+
+    ei_x_encode_map_header(buff, count);
+
+    encode_kv_family(buff, ATOM_FAMILY, ifa->ifa_family);
+    encode_kv_ulong(buff, ATOM_PREFIXLEN, ifa->ifa_prefixlen);
+    encode_kv_bool(buff, ATOM_PERMANENT, flags & IFA_F_PERMANENT);
+    encode_kv_scope(buff, ATOM_SCOPE, ifa->ifa_scope);
+
+    if (tb[IFA_ADDRESS])
+        encode_kv_address_attr(buff, ATOM_ADDRESS, tb[IFA_ADDRESS]);
+    if (tb[IFA_LOCAL])
+        encode_kv_address_attr(buff, ATOM_LOCAL, tb[IFA_LOCAL]);
+    if (tb[IFA_LABEL])
+        encode_kv_string(buff, ATOM_LABEL, mnl_attr_get_payload(tb[IFA_LABEL]));
+    if (tb[IFA_BROADCAST])
+        encode_kv_address_attr(buff, ATOM_BROADCAST, tb[IFA_BROADCAST]);
+    if (tb[IFA_ANYCAST])
+        encode_kv_address_attr(buff, ATOM_ANYCAST, tb[IFA_ANYCAST]);
+    if (tb[IFA_MULTICAST])
+        encode_kv_address_attr(buff, ATOM_MULTICAST, tb[IFA_MULTICAST]);
+    if (is_inet6)
+    {
+        encode_kv_bool(buff, ATOM_TENTATIVE, flags & IFA_F_TENTATIVE);
+        encode_kv_bool(buff, ATOM_DADFAILED, flags & IFA_F_DADFAILED);
+        encode_kv_bool(buff, ATOM_DEPRECATED, flags & IFA_F_DEPRECATED);
+    }
+
+    int lifetimes = buff->index;
+    if (tb[IFA_CACHEINFO])
+    {
+        const struct ifa_cacheinfo *ci = mnl_attr_get_payload(tb[IFA_CACHEINFO]);
+        encode_kv_lifetime(buff, ATOM_PREFERRED_LFT, ci->ifa_prefered);
+        encode_kv_lifetime(buff, ATOM_VALID_LFT, ci->ifa_valid);
+    }
+    return lifetimes;
+}
+
+void netif_build_prefix(ei_x_buff *buff, const struct prefixmsg *pm, struct nlattr **tb)
+{
+    ei_x_encode_tuple_header(buff, 3);
+    encode_atom(buff, ATOM_NEWPREFIX);
+
+    ei_x_encode_long(buff, pm->prefix_ifindex);
+
+    int count = 5;
+    if (tb[PREFIX_CACHEINFO])
+        count += 2;
+
+    ei_x_encode_map_header(buff, count);
+
+    encode_kv_family(buff, ATOM_FAMILY, pm->prefix_family);
+    encode_kv_address_attr(buff, ATOM_PREFIX, tb[PREFIX_ADDRESS]);
+    encode_kv_ulong(buff, ATOM_PREFIXLEN, pm->prefix_len);
+    encode_kv_bool(buff, ATOM_ON_LINK, pm->prefix_flags & WORKAROUND_IF_PREFIX_ONLINK);
+    encode_kv_bool(buff, ATOM_AUTOCONF, pm->prefix_flags & WORKAROUND_IF_PREFIX_AUTOCONF);
+
+    if (tb[PREFIX_CACHEINFO])
+    {
+        const struct prefix_cacheinfo *ci = mnl_attr_get_payload(tb[PREFIX_CACHEINFO]);
+        encode_kv_lifetime(buff, ATOM_PREFERRED_LFT, ci->preferred_time);
+        encode_kv_lifetime(buff, ATOM_VALID_LFT, ci->valid_time);
+    }
+}
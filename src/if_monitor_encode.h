@@ -0,0 +1,258 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#ifndef IF_MONITOR_ENCODE_H
+#define IF_MONITOR_ENCODE_H
+
+#include <stdint.h>
+
+#include <net/if.h>
+#include <linux/if_addr.h>
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+#include <libmnl/libmnl.h>
+
+#include <ei.h>
+
+// In Ubuntu 16.04, it seems that the new compat logic handling is preventing
+// IFF_LOWER_UP from being defined properly. It looks like a bug, so define it
+// here so that this file compiles.  A scan of all Nerves platforms and Ubuntu
+// 16.04 has IFF_LOWER_UP always being set to 0x10000.
+#define WORKAROUND_IFF_LOWER_UP (0x10000)
+
+// Fields in link reports. These track what changed since the last report.
+#define LINK_IFNAME (1 << 0)
+#define LINK_TYPE (1 << 1)
+#define LINK_UP (1 << 2)
+#define LINK_BROADCAST (1 << 3)
+#define LINK_RUNNING (1 << 4)
+#define LINK_LOWER_UP (1 << 5)
+#define LINK_MULTICAST (1 << 6)
+#define LINK_MTU (1 << 7)
+#define LINK_MAC_ADDRESS (1 << 8)
+#define LINK_MAC_BROADCAST (1 << 9)
+#define LINK_LINK (1 << 10)
+#define LINK_OPERSTATE (1 << 11)
+#define LINK_PERM_ADDRESS (1 << 12)
+#define LINK_PARENT_DEV (1 << 13)
+#define LINK_PARENT_BUS (1 << 14)
+#define LINK_KIND (1 << 15)
+#define LINK_ALT_IFNAMES (1 << 16)
+#define LINK_HW_PATH (1 << 17)
+#define LINK_STATS (1 << 18)
+
+// Fields that are always in a full link report
+#define LINK_REQUIRED_FIELDS (LINK_IFNAME | LINK_TYPE | LINK_UP | LINK_BROADCAST | LINK_RUNNING | LINK_LOWER_UP | LINK_MULTICAST)
+
+// Stats change constantly and aren't worth a report on their own
+#define LINK_VISIBLE_FIELDS (LINK_STATS - 1)
+
+// Every atom that if_monitor sends. The first one is the default for lookup
+// tables so it must be "unknown".
+#define IF_MONITOR_ATOMS(X)                 \
+    X(UNKNOWN, "unknown")                   \
+    X(NIL, "nil")                           \
+    X(TRUE, "true")                         \
+    X(FALSE, "false")                       \
+    X(NEWLINK, "newlink")                   \
+    X(UPDATELINK, "updatelink")             \
+    X(DELLINK, "dellink")                   \
+    X(NEWADDR, "newaddr")                   \
+    X(DELADDR, "deladdr")                   \
+    X(NEWROUTE, "newroute")                 \
+    X(DELROUTE, "delroute")                 \
+    X(NEWRULE, "newrule")                   \
+    X(DELRULE, "delrule")                   \
+    X(RESYNC, "resync")                     \
+    X(SYNCED, "synced")                     \
+    X(STATS, "stats")                       \
+    X(STATE, "state")                       \
+    X(REACHABLE, "reachable")               \
+    X(STALE, "stale")                       \
+    X(FAILED, "failed")                     \
+    X(COUNTERS, "counters")                 \
+    X(COLLAPSED, "collapsed")               \
+    X(DROPPED, "dropped")                   \
+    X(OVERFLOWS, "overflows")               \
+    X(NETLINK_OVERRUNS, "netlink_overruns") \
+    X(MAX_QUEUED_BYTES, "max_queued_bytes") \
+    X(RECEIVED, "received")                 \
+    X(NETLINK_STATS, "netlink_stats")       \
+    X(RECEIVES, "receives")                 \
+    X(BYTES, "bytes")                       \
+    X(MESSAGES, "messages")                 \
+    X(PARSE_ERRORS, "parse_errors")         \
+    X(NEWNEIGH, "newneigh")                 \
+    X(DELNEIGH, "delneigh")                 \
+    X(TYPE, "type")                         \
+    X(ETHERNET, "ethernet")                 \
+    X(OTHER, "other")                       \
+    X(UP, "up")                             \
+    X(BROADCAST, "broadcast")               \
+    X(RUNNING, "running")                   \
+    X(LOWER_UP, "lower_up")                 \
+    X(MULTICAST, "multicast")               \
+    X(MTU, "mtu")                           \
+    X(MAC_ADDRESS, "mac_address")           \
+    X(MAC_BROADCAST, "mac_broadcast")       \
+    X(LINK, "link")                         \
+    X(OPERSTATE, "operstate")               \
+    X(PERM_MAC_ADDRESS, "perm_mac_address") \
+    X(PARENT_DEV, "parent_dev")             \
+    X(PARENT_BUS, "parent_bus")             \
+    X(KIND, "kind")                         \
+    X(ALT_IFNAMES, "alt_ifnames")           \
+    X(HW_PATH, "hw_path")                   \
+    X(RX_PACKETS, "rx_packets")             \
+    X(TX_PACKETS, "tx_packets")             \
+    X(RX_BYTES, "rx_bytes")                 \
+    X(TX_BYTES, "tx_bytes")                 \
+    X(RX_ERRORS, "rx_errors")               \
+    X(TX_ERRORS, "tx_errors")               \
+    X(RX_DROPPED, "rx_dropped")             \
+    X(TX_DROPPED, "tx_dropped")             \
+    X(COLLISIONS, "collisions")             \
+    X(NOTPRESENT, "notpresent")             \
+    X(DOWN, "down")                         \
+    X(LOWERLAYERDOWN, "lowerlayerdown")     \
+    X(TESTING, "testing")                   \
+    X(DORMANT, "dormant")                   \
+    X(FAMILY, "family")                     \
+    X(PREFIXLEN, "prefixlen")               \
+    X(PERMANENT, "permanent")               \
+    X(TENTATIVE, "tentative")               \
+    X(DADFAILED, "dadfailed")               \
+    X(DEPRECATED, "deprecated")             \
+    X(PREFERRED_LFT, "preferred_lft")       \
+    X(VALID_LFT, "valid_lft")               \
+    X(INFINITY, "infinity")                 \
+    X(NEWPREFIX, "newprefix")               \
+    X(PREFIX, "prefix")                     \
+    X(ON_LINK, "on_link")                   \
+    X(AUTOCONF, "autoconf")                 \
+    X(SCOPE, "scope")                       \
+    X(ADDRESS, "address")                   \
+    X(LOCAL, "local")                       \
+    X(LABEL, "label")                       \
+    X(ANYCAST, "anycast")                   \
+    X(UNIVERSE, "universe")                 \
+    X(SITE, "site")                         \
+    X(HOST, "host")                         \
+    X(NOWHERE, "nowhere")                   \
+    X(TABLE, "table")                       \
+    X(DST, "dst")                           \
+    X(DST_LEN, "dst_len")                   \
+    X(SRC, "src")                           \
+    X(SRC_LEN, "src_len")                   \
+    X(GATEWAY, "gateway")                   \
+    X(PREFSRC, "prefsrc")                   \
+    X(OIF, "oif")                           \
+    X(PRIORITY, "priority")                 \
+    X(PROTOCOL, "protocol")                 \
+    X(ACTION, "action")                     \
+    X(UNICAST, "unicast")                   \
+    X(BLACKHOLE, "blackhole")               \
+    X(UNREACHABLE, "unreachable")           \
+    X(PROHIBIT, "prohibit")                 \
+    X(UNSPEC, "unspec")                     \
+    X(UNIX, "unix")                         \
+    X(INET, "inet")                         \
+    X(AX25, "ax25")                         \
+    X(IPX, "ipx")                           \
+    X(APPLETALK, "appletalk")               \
+    X(NETROM, "netrom")                     \
+    X(BRIDGE, "bridge")                     \
+    X(ATMPVC, "atmpvc")                     \
+    X(X25, "x25")                           \
+    X(INET6, "inet6")                       \
+    X(ROSE, "rose")                         \
+    X(DECNET, "decnet")                     \
+    X(NETBEUI, "netbeui")                   \
+    X(SECURITY, "security")                 \
+    X(KEY, "key")                           \
+    X(NETLINK, "netlink")                   \
+    X(PACKET, "packet")                     \
+    X(ASH, "ash")                           \
+    X(ECONET, "econet")                     \
+    X(ATMSVC, "atmsvc")                     \
+    X(RDS, "rds")                           \
+    X(SNA, "sna")                           \
+    X(IRDA, "irda")                         \
+    X(PPPOX, "pppox")                       \
+    X(WANPIPE, "wanpipe")                   \
+    X(LLC, "llc")                           \
+    X(IB, "ib")                             \
+    X(MPLS, "mpls")                         \
+    X(CAN, "can")                           \
+    X(TIPC, "tipc")                         \
+    X(BLUETOOTH, "bluetooth")               \
+    X(IUCV, "iucv")                         \
+    X(RXRPC, "rxrpc")                       \
+    X(ISDN, "isdn")                         \
+    X(PHONET, "phonet")                     \
+    X(IEEE802154, "iee802154")              \
+    X(CAIF, "caif")                         \
+    X(ALG, "alg")                           \
+    X(NFC, "nfc")                           \
+    X(VSOCK, "vsock")                       \
+    X(KCM, "kcm")                           \
+    X(QIPCRTR, "qipcrtr")                   \
+    X(SMC, "smc")
+
+enum if_monitor_atom
+{
+#define IF_MONITOR_ATOM_ENUM(id, text) ATOM_##id,
+    IF_MONITOR_ATOMS(IF_MONITOR_ATOM_ENUM)
+#undef IF_MONITOR_ATOM_ENUM
+    ATOM_COUNT
+};
+
+// Last reported state of a link
+struct link_state
+{
+    char ifname[IF_NAMESIZE];
+    int is_ethernet;
+    unsigned int flags;
+    uint32_t present; // LINK_* bits for the optional fields that were reported
+    uint32_t mtu;
+    unsigned char mac_address[6];
+    unsigned char mac_broadcast[6];
+    uint32_t link;
+    uint32_t operstate;
+    unsigned char perm_address[6];
+    char parent_dev[64];
+    char parent_bus[32];
+    char kind[32];
+
+    // NUL-separated list of alternative names
+    char alt_ifnames[256];
+    int alt_ifnames_len;
+    int alt_ifname_count;
+
+    // sysfs device path without the "/net/<ifname>" part. See HWPath.
+    char hw_path[256];
+
+    struct rtnl_link_stats64 stats;
+};
+
+void encode_atom(ei_x_buff *buff, enum if_monitor_atom atom);
+void encode_string(ei_x_buff *buff, const char *str);
+void encode_kv_ulong(ei_x_buff *buff, enum if_monitor_atom key, unsigned long value);
+void encode_kv_ulonglong(ei_x_buff *buff, enum if_monitor_atom key, unsigned long long value);
+void encode_kv_bool(ei_x_buff *buff, enum if_monitor_atom key, int value);
+void encode_kv_nil(ei_x_buff *buff, enum if_monitor_atom key);
+void encode_kv_string(ei_x_buff *buff, enum if_monitor_atom key, const char *value);
+void encode_kv_string_list(ei_x_buff *buff, enum if_monitor_atom key, const char *values, int count);
+void encode_kv_macaddr(ei_x_buff *buff, enum if_monitor_atom key, const unsigned char *macaddr);
+void encode_kv_raw_address(ei_x_buff *buff, enum if_monitor_atom key, const uint8_t *addr, uint16_t len);
+void encode_kv_address_attr(ei_x_buff *buff, enum if_monitor_atom key, const struct nlattr *attr);
+void encode_kv_scope(ei_x_buff *buff, enum if_monitor_atom key, uint8_t scope);
+void encode_kv_route_type(ei_x_buff *buff, enum if_monitor_atom key, uint8_t type);
+void encode_kv_family(ei_x_buff *buff, enum if_monitor_atom key, uint8_t family);
+
+void netif_build_link(ei_x_buff *buff, enum if_monitor_atom report, int ifindex, const struct link_state *state, uint32_t fields);
+int netif_build_addr(ei_x_buff *buff, enum if_monitor_atom report, const struct ifaddrmsg *ifa, struct nlattr **tb);
+void netif_build_prefix(ei_x_buff *buff, const struct prefixmsg *pm, struct nlattr **tb);
+
+#endif // IF_MONITOR_ENCODE_H
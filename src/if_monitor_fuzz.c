@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// libFuzzer target for if_monitor's netlink parsing
+//
+// The first byte of each input picks the reporting mode and the rest is one
+// netlink read. Everything that would be sent to Elixir is checked to be a
+// complete Erlang term. Build and run it with `make fuzz CC=clang`.
+//
+// Compile with -DFUZZ_STANDALONE to replay crash files without libFuzzer,
+// for example with gcc and -fsanitize=address.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "if_monitor_lib.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void check_output(struct netif *nb, const char *data, int len)
+{
+    int index = 0;
+    int version;
+    if (ei_decode_version(data, &index, &version) < 0 ||
+        ei_skip_term(data, &index) < 0 ||
+        index != len)
+        abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static struct netif nb;
+
+    if (size < 1 || size - 1 > sizeof(nb.nlbuf))
+        return 0;
+
+    int batch_mode = data[0] & 1;
+    int coalesce_ms = (data[0] & 2) ? 1 : 0;
+    netif_init(&nb, batch_mode || coalesce_ms, coalesce_ms);
+    nb.output = check_output;
+
+    // Netlink messages need to be aligned, so copy to the netlink buffer
+    memcpy(nb.nlbuf, data + 1, size - 1);
+
+    // Run it twice to exercise the caches
+    netif_process(&nb, nb.nlbuf, size - 1);
+    netif_process(&nb, nb.nlbuf, size - 1);
+    flush_reports(&nb);
+    netif_cleanup(&nb);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int main(int argc, char *argv[])
+{
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        FILE *fp = fopen(argv[i], "rb");
+        if (!fp)
+        {
+            perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+
+        static uint8_t buf[NLBUF_LEN + 1];
+        size_t len = fread(buf, 1, sizeof(buf), fp);
+        fclose(fp);
+
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    return 0;
+}
+#endif
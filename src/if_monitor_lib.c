@@ -0,0 +1,2223 @@
+// SPDX-FileCopyrightText: 2019 Frank Hunleth
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Netlink parsing and report generation for if_monitor
+//
+// This is everything but the main loop so that the replay benchmark and the
+// fuzzer can feed netlink messages through the same code.
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <libmnl/libmnl.h>
+#include <net/if_arp.h>
+#include <net/if.h>
+#include <net/route.h>
+#include <linux/fib_rules.h>
+#include <linux/if.h>
+#include <linux/neighbour.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <ei.h>
+
+#include "if_monitor_lib.h"
+
+// Batches are split into messages of about this size so that Elixir can
+// start on them sooner. One report can be bigger.
+#define MAX_PACKET_LEN 65535
+
+// {:packet, 4} length header
+#define PACKET_HEADER_LEN 4
+
+// Size of the {:received, microseconds} tuple at the start of each batch
+#define RECEIVED_LEN (2 + 10 + 11)
+
+// Overhead for the version, list header, receive time and list tail around
+// batched reports
+#define BATCH_OVERHEAD (1 + 5 + RECEIVED_LEN + 1)
+
+// Room for bursts of notifications before the kernel drops them
+#define NL_RCVBUF_LEN (1024 * 1024)
+
+// Address reports larger than this aren't cached and are always sent
+#define MAX_ADDR_REPORT_LEN 256
+
+// Stats samples are 12 big endian 64-bit counters and rates. See send_stats().
+#define STATS_SAMPLE_LEN (12 * 8)
+
+// Link attributes from Linux 5.5 and 5.16. These are defined by number so
+// that if_monitor still builds with older kernel headers. Older kernels
+// don't send them.
+#define WORKAROUND_IFLA_PROP_LIST 52
+#define WORKAROUND_IFLA_ALT_IFNAME 53
+#define WORKAROUND_IFLA_PERM_ADDRESS 54
+#define WORKAROUND_IFLA_PARENT_DEV_NAME 56
+#define WORKAROUND_IFLA_PARENT_DEV_BUS_NAME 57
+#define LINK_ATTR_MAX WORKAROUND_IFLA_PARENT_DEV_BUS_NAME
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+struct link_cache_entry
+{
+    int ifindex;
+
+    // What Elixir will know after all staged reports are sent
+    struct link_state latest;
+
+    // What Elixir knows from reports that have already been sent. This is
+    // what the link is compared against when a staged report gets collapsed.
+    struct link_state base;
+    int base_valid;
+    int staged;
+};
+
+// Last reported address. Addresses are identified the same way as in Elixir.
+// See Info.address_key/1.
+struct addr_cache_entry
+{
+    int ifindex;
+    int family;
+    int prefixlen;
+    int address_len;
+    unsigned char address[16];
+    int report_len;
+    char report[MAX_ADDR_REPORT_LEN];
+
+    // When the last reported lifetimes run out in monotonic milliseconds or
+    // -1 if they don't
+    int64_t preferred_until;
+    int64_t valid_until;
+};
+
+// Lifetimes are whole seconds, so deadlines computed from reports of the
+// same lifetime can differ by this much. Keep in sync with Info.
+#define LIFETIME_SLACK_MS 2000
+
+// Default route with a gateway. The same gateway is usually in more than one
+// routing table, so routes are tracked separately from gateways.
+struct default_route
+{
+    uint32_t table;
+    uint32_t priority;
+    int ifindex;
+    int family;
+    unsigned char gateway[16];
+};
+
+// ARP or NDP entry
+struct neigh_cache_entry
+{
+    int ifindex;
+    int family;
+    unsigned char address[16];
+    uint16_t nud_state;
+};
+
+// Last reported reachability of a default gateway
+struct gateway_entry
+{
+    int ifindex;
+    int family;
+    unsigned char address[16];
+    enum if_monitor_atom state;
+};
+
+struct staged_report
+{
+    int offset;
+    int len;
+    int ifindex;
+    int is_newlink;
+    int dropped;
+    int64_t received_us;
+};
+
+static void outq_put(struct netif *nb, const void *data, size_t len)
+{
+    size_t tail = (nb->outq_head + nb->outq_len) % OUTPUT_QUEUE_LEN;
+    size_t first = OUTPUT_QUEUE_LEN - tail;
+    if (first > len)
+        first = len;
+
+    memcpy(nb->outq + tail, data, first);
+    memcpy(nb->outq, (const char *)data + first, len - first);
+    nb->outq_len += len;
+}
+
+static void queue_packet(struct netif *nb, const char *data, int len)
+{
+    if (!nb->outq)
+    {
+        nb->outq = malloc(OUTPUT_QUEUE_LEN);
+        if (!nb->outq)
+            err(EXIT_FAILURE, "malloc");
+    }
+
+    // Callers check for room with can_send()
+    uint32_t be_len = htonl(len);
+    outq_put(nb, &be_len, sizeof(be_len));
+    outq_put(nb, data, len);
+
+    if (nb->outq_len > nb->counters.max_queued_bytes)
+        nb->counters.max_queued_bytes = nb->outq_len;
+}
+
+// Elixir is way behind, so drop reports until the output queue empties.
+// Then a resync gets Elixir back to the current state.
+static void start_overflow(struct netif *nb)
+{
+    if (!nb->overflowed)
+    {
+        warnx("Elixir isn't keeping up. Dropping reports until it does and then resyncing.");
+        nb->overflowed = 1;
+        nb->counters.overflows++;
+    }
+}
+
+// Check that a message fits in the output queue
+static int can_send(struct netif *nb, int len, int reports)
+{
+    if (!nb->overflowed && (size_t) len + PACKET_HEADER_LEN <= OUTPUT_QUEUE_LEN - nb->outq_len)
+        return 1;
+
+    start_overflow(nb);
+    nb->counters.dropped += reports;
+    return 0;
+}
+
+void netif_init(struct netif *nb, int batch_mode, int coalesce_ms)
+{
+    memset(nb, 0, sizeof(*nb));
+    nb->seq = 10;
+    nb->batch_mode = batch_mode;
+    nb->coalesce_ms = coalesce_ms;
+    nb->flush_deadline = -1;
+    nb->stats_deadline = -1;
+    nb->output = queue_packet;
+
+    if (ei_x_new(&nb->staged) < 0 || ei_x_new(&nb->out) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+}
+
+void netif_open(struct netif *nb)
+{
+    nb->nl = mnl_socket_open(NETLINK_ROUTE);
+    if (!nb->nl)
+        err(EXIT_FAILURE, "mnl_socket_open (NETLINK_ROUTE)");
+
+    unsigned int groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                          RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE | RTMGRP_NEIGH |
+                          RTMGRP_IPV4_RULE | RTMGRP_IPV6_PREFIX;
+    if (mnl_socket_bind(nb->nl, groups, MNL_SOCKET_AUTOPID) < 0)
+        err(EXIT_FAILURE, "mnl_socket_bind(RTMGRP_LINK)");
+
+    // There's no legacy group bit for IPv6 rules
+    int group = RTNLGRP_IPV6_RULE;
+    if (mnl_socket_setsockopt(nb->nl, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) < 0)
+        warn("NETLINK_ADD_MEMBERSHIP(RTNLGRP_IPV6_RULE)");
+
+    // Try to make the receive buffer big enough to ride out event storms.
+    // SO_RCVBUFFORCE ignores rmem_max, but needs CAP_NET_ADMIN. If the buffer
+    // still overflows, ENOBUFS is reported and a resync fixes things up. That's
+    // why NETLINK_NO_ENOBUFS isn't set.
+    int fd = mnl_socket_get_fd(nb->nl);
+    int rcvbuf = NL_RCVBUF_LEN;
+#ifdef SO_RCVBUFFORCE
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) == 0)
+        return;
+#endif
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0)
+        warn("setsockopt(SO_RCVBUF)");
+}
+
+void netif_cleanup(struct netif *nb)
+{
+    if (nb->nl)
+        mnl_socket_close(nb->nl);
+    nb->nl = NULL;
+
+    ei_x_free(&nb->staged);
+    ei_x_free(&nb->out);
+    free(nb->outq);
+    nb->outq = NULL;
+    free(nb->reports);
+    nb->reports = NULL;
+    free(nb->links);
+    nb->links = NULL;
+    free(nb->addrs);
+    nb->addrs = NULL;
+    free(nb->default_routes);
+    nb->default_routes = NULL;
+    free(nb->neighs);
+    nb->neighs = NULL;
+    free(nb->gateways);
+    nb->gateways = NULL;
+}
+
+// Check that an attribute's payload is what the encode logic expects. The
+// kernel always gets this right, but a bad length would otherwise read past
+// the attribute.
+static int attr_has_type(const struct nlattr *attr, enum mnl_attr_data_type type)
+{
+    if (mnl_attr_validate(attr, type) < 0)
+    {
+        debug("Skipping malformed attribute %d", mnl_attr_get_type(attr));
+        return 0;
+    }
+    return 1;
+}
+
+static int collect_ifla_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    // Skip unsupported attributes in user-space
+    if (mnl_attr_type_valid(attr, LINK_ATTR_MAX) < 0)
+        return MNL_CB_OK;
+
+    // Only save supported attributes (see encode logic)
+    switch (type)
+    {
+    case IFLA_MTU:
+    case IFLA_LINK:
+        if (attr_has_type(attr, MNL_TYPE_U32))
+            tb[type] = attr;
+        break;
+
+    case IFLA_OPERSTATE:
+        if (attr_has_type(attr, MNL_TYPE_U8))
+            tb[type] = attr;
+        break;
+
+    case IFLA_IFNAME:
+    case WORKAROUND_IFLA_PARENT_DEV_NAME:
+    case WORKAROUND_IFLA_PARENT_DEV_BUS_NAME:
+        if (attr_has_type(attr, MNL_TYPE_NUL_STRING))
+            tb[type] = attr;
+        break;
+
+    case IFLA_LINKINFO:
+    case WORKAROUND_IFLA_PROP_LIST:
+        if (attr_has_type(attr, MNL_TYPE_NESTED))
+            tb[type] = attr;
+        break;
+
+    case IFLA_ADDRESS:
+    case IFLA_BROADCAST:
+    case IFLA_STATS:
+    case IFLA_STATS64:
+    case WORKAROUND_IFLA_PERM_ADDRESS:
+        tb[type] = attr;
+        break;
+
+    default:
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+static int attr_has_len(const struct nlattr *attr, size_t len)
+{
+    if (mnl_attr_validate2(attr, MNL_TYPE_UNSPEC, len) < 0)
+    {
+        debug("Skipping short attribute %d", mnl_attr_get_type(attr));
+        return 0;
+    }
+    return 1;
+}
+
+static int collect_ifa_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    // Skip unsupported attributes in user-space
+    if (mnl_attr_type_valid(attr, IFA_MAX) < 0)
+        return MNL_CB_OK;
+
+    // Only save supported attributes (see encode logic)
+    switch (type)
+    {
+    case IFA_ADDRESS:
+    case IFA_LOCAL:
+    case IFA_BROADCAST:
+    case IFA_ANYCAST:
+    case IFA_MULTICAST:
+        tb[type] = attr;
+        break;
+
+    case IFA_LABEL:
+        if (attr_has_type(attr, MNL_TYPE_NUL_STRING))
+            tb[type] = attr;
+        break;
+
+    case IFA_FLAGS:
+        if (attr_has_type(attr, MNL_TYPE_U32))
+            tb[type] = attr;
+        break;
+
+    case IFA_CACHEINFO:
+        if (attr_has_len(attr, sizeof(struct ifa_cacheinfo)))
+            tb[type] = attr;
+        break;
+
+    case IFA_UNSPEC: // not supported
+    default:
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+static int collect_rta_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    // Skip unsupported attributes in user-space
+    if (mnl_attr_type_valid(attr, RTA_MAX) < 0)
+        return MNL_CB_OK;
+
+    // Only save supported attributes (see encode logic)
+    switch (type)
+    {
+    case RTA_DST:
+    case RTA_SRC:
+    case RTA_GATEWAY:
+    case RTA_PREFSRC:
+        tb[type] = attr;
+        break;
+
+    case RTA_OIF:
+    case RTA_PRIORITY:
+    case RTA_TABLE:
+        if (attr_has_type(attr, MNL_TYPE_U32))
+            tb[type] = attr;
+        break;
+
+    default:
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+static int collect_fra_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    // Skip unsupported attributes in user-space
+    if (mnl_attr_type_valid(attr, FRA_MAX) < 0)
+        return MNL_CB_OK;
+
+    // Only save supported attributes (see encode logic)
+    switch (type)
+    {
+    case FRA_SRC:
+    case FRA_DST:
+        tb[type] = attr;
+        break;
+
+    case FRA_PRIORITY:
+    case FRA_TABLE:
+        if (attr_has_type(attr, MNL_TYPE_U32))
+            tb[type] = attr;
+        break;
+
+    default:
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+static void copy_attr_payload(void *dest, size_t dest_len, const struct nlattr *attr)
+{
+    size_t len = mnl_attr_get_payload_len(attr);
+    if (len > dest_len)
+        len = dest_len;
+
+    memset(dest, 0, dest_len);
+    memcpy(dest, mnl_attr_get_payload(attr), len);
+}
+
+static void copy_attr_string(char *dest, size_t dest_len, const struct nlattr *attr)
+{
+    strncpy(dest, mnl_attr_get_str(attr), dest_len - 1);
+    dest[dest_len - 1] = '\0';
+}
+
+static void parse_link_kind(const struct nlattr *linkinfo, struct link_state *state)
+{
+    const struct nlattr *attr;
+    mnl_attr_for_each_nested(attr, linkinfo)
+    {
+        if (mnl_attr_get_type(attr) == IFLA_INFO_KIND && attr_has_type(attr, MNL_TYPE_NUL_STRING))
+        {
+            state->present |= LINK_KIND;
+            copy_attr_string(state->kind, sizeof(state->kind), attr);
+        }
+    }
+}
+
+static void parse_alt_ifnames(const struct nlattr *prop_list, struct link_state *state)
+{
+    const struct nlattr *attr;
+    mnl_attr_for_each_nested(attr, prop_list)
+    {
+        if (mnl_attr_get_type(attr) != WORKAROUND_IFLA_ALT_IFNAME || !attr_has_type(attr, MNL_TYPE_NUL_STRING))
+            continue;
+
+        // Names that don't fit are left off
+        const char *name = mnl_attr_get_str(attr);
+        size_t len = strlen(name) + 1;
+        if (state->alt_ifnames_len + len > sizeof(state->alt_ifnames))
+            break;
+
+        memcpy(state->alt_ifnames + state->alt_ifnames_len, name, len);
+        state->alt_ifnames_len += len;
+        state->alt_ifname_count++;
+        state->present |= LINK_ALT_IFNAMES;
+    }
+}
+
+static int parse_link(const struct nlmsghdr *nlh, struct link_state *state)
+{
+    struct nlattr *tb[LINK_ATTR_MAX + 1];
+    memset(tb, 0, sizeof(tb));
+    struct ifinfomsg *ifm = mnl_nlmsg_get_payload(nlh);
+
+    if (mnl_attr_parse(nlh, sizeof(*ifm), collect_ifla_attrs, tb) != MNL_CB_OK)
+    {
+        debug("Error from mnl_attr_parse");
+        return MNL_CB_ERROR;
+    }
+
+    if (!tb[IFLA_IFNAME])
+    {
+        debug("IFLA_IFNAME missing and it shouldn't be");
+        return MNL_CB_ERROR;
+    }
+
+    memset(state, 0, sizeof(*state));
+    strncpy(state->ifname, mnl_attr_get_str(tb[IFLA_IFNAME]), sizeof(state->ifname) - 1);
+    state->is_ethernet = (ifm->ifi_type == ARPHRD_ETHER);
+    state->flags = ifm->ifi_flags & (IFF_UP | IFF_BROADCAST | IFF_RUNNING | WORKAROUND_IFF_LOWER_UP | IFF_MULTICAST);
+
+    if (tb[IFLA_MTU])
+    {
+        state->present |= LINK_MTU;
+        state->mtu = mnl_attr_get_u32(tb[IFLA_MTU]);
+    }
+    if (tb[IFLA_ADDRESS])
+    {
+        state->present |= LINK_MAC_ADDRESS;
+        copy_attr_payload(state->mac_address, sizeof(state->mac_address), tb[IFLA_ADDRESS]);
+    }
+    if (tb[IFLA_BROADCAST])
+    {
+        state->present |= LINK_MAC_BROADCAST;
+        copy_attr_payload(state->mac_broadcast, sizeof(state->mac_broadcast), tb[IFLA_BROADCAST]);
+    }
+    if (tb[IFLA_LINK])
+    {
+        state->present |= LINK_LINK;
+        state->link = mnl_attr_get_u32(tb[IFLA_LINK]);
+    }
+    if (tb[IFLA_OPERSTATE])
+    {
+        state->present |= LINK_OPERSTATE;
+        state->operstate = mnl_attr_get_u8(tb[IFLA_OPERSTATE]);
+    }
+    if (tb[WORKAROUND_IFLA_PERM_ADDRESS])
+    {
+        state->present |= LINK_PERM_ADDRESS;
+        copy_attr_payload(state->perm_address, sizeof(state->perm_address), tb[WORKAROUND_IFLA_PERM_ADDRESS]);
+    }
+    if (tb[WORKAROUND_IFLA_PARENT_DEV_NAME])
+    {
+        state->present |= LINK_PARENT_DEV;
+        copy_attr_string(state->parent_dev, sizeof(state->parent_dev), tb[WORKAROUND_IFLA_PARENT_DEV_NAME]);
+    }
+    if (tb[WORKAROUND_IFLA_PARENT_DEV_BUS_NAME])
+    {
+        state->present |= LINK_PARENT_BUS;
+        copy_attr_string(state->parent_bus, sizeof(state->parent_bus), tb[WORKAROUND_IFLA_PARENT_DEV_BUS_NAME]);
+    }
+    if (tb[IFLA_LINKINFO])
+        parse_link_kind(tb[IFLA_LINKINFO], state);
+    if (tb[WORKAROUND_IFLA_PROP_LIST])
+        parse_alt_ifnames(tb[WORKAROUND_IFLA_PROP_LIST], state);
+    if (tb[IFLA_STATS64])
+    {
+        state->present |= LINK_STATS;
+        copy_attr_payload(&state->stats, sizeof(state->stats), tb[IFLA_STATS64]);
+    }
+    else if (tb[IFLA_STATS])
+    {
+        // The 32-bit counters wrap quickly, but they're all that some kernels have
+        struct rtnl_link_stats stats32;
+        copy_attr_payload(&stats32, sizeof(stats32), tb[IFLA_STATS]);
+
+        state->present |= LINK_STATS;
+        state->stats.rx_packets = stats32.rx_packets;
+        state->stats.tx_packets = stats32.tx_packets;
+        state->stats.rx_bytes = stats32.rx_bytes;
+        state->stats.tx_bytes = stats32.tx_bytes;
+        state->stats.rx_errors = stats32.rx_errors;
+        state->stats.tx_errors = stats32.tx_errors;
+        state->stats.rx_dropped = stats32.rx_dropped;
+        state->stats.tx_dropped = stats32.tx_dropped;
+        state->stats.multicast = stats32.multicast;
+        state->stats.collisions = stats32.collisions;
+    }
+
+    return MNL_CB_OK;
+}
+
+static uint32_t link_full_fields(const struct link_state *state)
+{
+    return LINK_REQUIRED_FIELDS | state->present;
+}
+
+static uint32_t link_changes(const struct link_state *old, const struct link_state *new)
+{
+    uint32_t changes = old->present ^ new->present;
+    uint32_t both = old->present & new->present;
+    unsigned int flag_changes = old->flags ^ new->flags;
+
+    if (strcmp(old->ifname, new->ifname) != 0)
+        changes |= LINK_IFNAME;
+    if (old->is_ethernet != new->is_ethernet)
+        changes |= LINK_TYPE;
+    if (flag_changes & IFF_UP)
+        changes |= LINK_UP;
+    if (flag_changes & IFF_BROADCAST)
+        changes |= LINK_BROADCAST;
+    if (flag_changes & IFF_RUNNING)
+        changes |= LINK_RUNNING;
+    if (flag_changes & WORKAROUND_IFF_LOWER_UP)
+        changes |= LINK_LOWER_UP;
+    if (flag_changes & IFF_MULTICAST)
+        changes |= LINK_MULTICAST;
+    if ((both & LINK_MTU) && old->mtu != new->mtu)
+        changes |= LINK_MTU;
+    if ((both & LINK_MAC_ADDRESS) && memcmp(old->mac_address, new->mac_address, sizeof(new->mac_address)) != 0)
+        changes |= LINK_MAC_ADDRESS;
+    if ((both & LINK_MAC_BROADCAST) && memcmp(old->mac_broadcast, new->mac_broadcast, sizeof(new->mac_broadcast)) != 0)
+        changes |= LINK_MAC_BROADCAST;
+    if ((both & LINK_LINK) && old->link != new->link)
+        changes |= LINK_LINK;
+    if ((both & LINK_OPERSTATE) && old->operstate != new->operstate)
+        changes |= LINK_OPERSTATE;
+    if ((both & LINK_PERM_ADDRESS) && memcmp(old->perm_address, new->perm_address, sizeof(new->perm_address)) != 0)
+        changes |= LINK_PERM_ADDRESS;
+    if ((both & LINK_PARENT_DEV) && strcmp(old->parent_dev, new->parent_dev) != 0)
+        changes |= LINK_PARENT_DEV;
+    if ((both & LINK_PARENT_BUS) && strcmp(old->parent_bus, new->parent_bus) != 0)
+        changes |= LINK_PARENT_BUS;
+    if ((both & LINK_KIND) && strcmp(old->kind, new->kind) != 0)
+        changes |= LINK_KIND;
+    if ((both & LINK_ALT_IFNAMES) &&
+            (old->alt_ifnames_len != new->alt_ifnames_len ||
+             memcmp(old->alt_ifnames, new->alt_ifnames, new->alt_ifnames_len) != 0))
+        changes |= LINK_ALT_IFNAMES;
+    if ((both & LINK_HW_PATH) && strcmp(old->hw_path, new->hw_path) != 0)
+        changes |= LINK_HW_PATH;
+    if ((both & LINK_STATS) && memcmp(&old->stats, &new->stats, sizeof(new->stats)) != 0)
+        changes |= LINK_STATS;
+
+    return changes;
+}
+
+static int collect_prefix_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    // Skip unsupported attributes in user-space
+    if (mnl_attr_type_valid(attr, PREFIX_MAX) < 0)
+        return MNL_CB_OK;
+
+    switch (type)
+    {
+    case PREFIX_ADDRESS:
+        if (attr_has_len(attr, sizeof(struct in6_addr)))
+            tb[type] = attr;
+        break;
+
+    case PREFIX_CACHEINFO:
+        if (attr_has_len(attr, sizeof(struct prefix_cacheinfo)))
+            tb[type] = attr;
+        break;
+
+    default:
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+static int parse_addr(const struct nlmsghdr *nlh, struct nlattr **tb)
+{
+    struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
+
+    memset(tb, 0, (IFA_MAX + 1) * sizeof(struct nlattr *));
+    if (mnl_attr_parse(nlh, sizeof(*ifa), collect_ifa_attrs, tb) != MNL_CB_OK)
+    {
+        debug("Error from mnl_attr_parse");
+        return MNL_CB_ERROR;
+    }
+    return MNL_CB_OK;
+}
+
+int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static struct staged_report *stage_report(struct netif *nb)
+{
+    if (nb->report_count == nb->report_capacity)
+    {
+        nb->report_capacity = nb->report_capacity ? nb->report_capacity * 2 : 64;
+        nb->reports = realloc(nb->reports, nb->report_capacity * sizeof(struct staged_report));
+        if (!nb->reports)
+            err(EXIT_FAILURE, "realloc");
+    }
+
+    struct staged_report *report = &nb->reports[nb->report_count];
+    memset(report, 0, sizeof(*report));
+    return report;
+}
+
+// Only the latest link report for an interface matters, so drop older ones
+// that haven't been sent yet. The index of the first one is returned so that
+// the newer report can take its place. It has to stay ahead of any address
+// reports for the interface that were staged after it.
+static int collapse_newlinks(struct netif *nb, int ifindex)
+{
+    int slot = -1;
+    int i;
+    for (i = 0; i < nb->report_count; i++)
+    {
+        struct staged_report *report = &nb->reports[i];
+        if (report->is_newlink && report->ifindex == ifindex && !report->dropped)
+        {
+            report->dropped = 1;
+            nb->counters.collapsed++;
+            if (slot < 0)
+                slot = i;
+        }
+    }
+    return slot;
+}
+
+// Upper bound on what flush_reports() adds to the output queue
+static size_t staged_output_len(const struct netif *nb)
+{
+    return nb->staged.index + (size_t) nb->report_count * (BATCH_OVERHEAD + PACKET_HEADER_LEN);
+}
+
+void flush_reports(struct netif *nb)
+{
+    nb->flush_deadline = -1;
+
+    // Hold reports while Elixir catches up. They're sent when there's room
+    // in the output queue and newer link reports replace older ones until
+    // then.
+    if (nb->report_count > 0 && nb->outq_len > 0 && !nb->overflowed &&
+            staged_output_len(nb) > OUTPUT_QUEUE_LEN - nb->outq_len)
+    {
+        if (nb->staged.index <= MAX_STAGED_LEN || nb->dump_state != DUMP_IDLE)
+        {
+            nb->backpressured = 1;
+            return;
+        }
+        start_overflow(nb);
+    }
+    nb->backpressured = 0;
+
+    int i = 0;
+    while (i < nb->report_count)
+    {
+        // Pack reports into messages up to MAX_PACKET_LEN
+        int count = 0;
+        int len = BATCH_OVERHEAD;
+        int64_t received_us = 0;
+        int end;
+        for (end = i; end < nb->report_count; end++)
+        {
+            struct staged_report *report = &nb->reports[end];
+            if (report->dropped)
+                continue;
+            if (count > 0 && len + report->len > MAX_PACKET_LEN)
+                break;
+            if (count == 0 || report->received_us < received_us)
+                received_us = report->received_us;
+            len += report->len;
+            count++;
+        }
+
+        if (count > 0 && can_send(nb, len, count))
+        {
+            nb->out.index = 0;
+            ei_x_encode_version(&nb->out);
+            ei_x_encode_list_header(&nb->out, count + 1);
+            ei_x_encode_tuple_header(&nb->out, 2);
+            encode_atom(&nb->out, ATOM_RECEIVED);
+            ei_x_encode_longlong(&nb->out, received_us);
+            for (; i < end; i++)
+            {
+                struct staged_report *report = &nb->reports[i];
+                if (!report->dropped)
+                    ei_x_append_buf(&nb->out, nb->staged.buff + report->offset, report->len);
+            }
+            ei_x_encode_empty_list(&nb->out);
+
+            nb->output(nb, nb->out.buff, nb->out.index);
+        }
+        i = end;
+    }
+
+    nb->staged.index = 0;
+    nb->report_count = 0;
+
+    // Elixir has everything now
+    for (i = 0; i < nb->link_count; i++)
+    {
+        struct link_cache_entry *entry = &nb->links[i];
+        entry->base = entry->latest;
+        entry->base_valid = 1;
+        entry->staged = 0;
+    }
+}
+
+static ei_x_buff *begin_report(struct netif *nb, int *start)
+{
+    ei_x_buff *buff;
+    if (nb->batch_mode)
+    {
+        buff = &nb->staged;
+    }
+    else
+    {
+        buff = &nb->out;
+        buff->index = 0;
+        ei_x_encode_version(buff);
+    }
+    *start = buff->index;
+    return buff;
+}
+
+static void finish_report(struct netif *nb, int start, int ifindex, int is_newlink)
+{
+    if (!nb->batch_mode)
+    {
+        if (can_send(nb, nb->out.index, 1))
+            nb->output(nb, nb->out.buff, nb->out.index);
+        return;
+    }
+
+    if (nb->overflowed)
+    {
+        // It would be dropped anyway
+        nb->staged.index = start;
+        nb->counters.dropped++;
+        return;
+    }
+
+    struct staged_report *report = stage_report(nb);
+    report->offset = start;
+    report->len = nb->staged.index - start;
+    report->ifindex = ifindex;
+    report->is_newlink = is_newlink;
+    report->received_us = nb->received_us;
+    nb->report_count++;
+}
+
+// Put a report in the place of one that collapse_newlinks() dropped
+static void replace_report(struct netif *nb, int slot, int start)
+{
+    struct staged_report *report = &nb->reports[slot];
+    report->offset = start;
+    report->len = nb->staged.index - start;
+    report->dropped = 0;
+}
+
+static void send_marker(struct netif *nb, enum if_monitor_atom marker)
+{
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    encode_atom(buff, marker);
+    finish_report(nb, start, 0, 0);
+}
+
+static struct link_cache_entry *find_link(struct netif *nb, int ifindex)
+{
+    int i;
+    for (i = 0; i < nb->link_count; i++)
+    {
+        if (nb->links[i].ifindex == ifindex)
+            return &nb->links[i];
+    }
+    return NULL;
+}
+
+static struct link_cache_entry *add_link(struct netif *nb, int ifindex)
+{
+    if (nb->link_count == nb->link_capacity)
+    {
+        nb->link_capacity = nb->link_capacity ? nb->link_capacity * 2 : 16;
+        nb->links = realloc(nb->links, nb->link_capacity * sizeof(struct link_cache_entry));
+        if (!nb->links)
+            err(EXIT_FAILURE, "realloc");
+    }
+
+    struct link_cache_entry *entry = &nb->links[nb->link_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->ifindex = ifindex;
+    return entry;
+}
+
+static void remove_link(struct netif *nb, int ifindex)
+{
+    struct link_cache_entry *entry = find_link(nb, ifindex);
+    if (entry)
+        *entry = nb->links[--nb->link_count];
+
+    // The kernel doesn't send deladdr reports when a link goes away
+    int i = 0;
+    while (i < nb->addr_count)
+    {
+        if (nb->addrs[i].ifindex == ifindex)
+            nb->addrs[i] = nb->addrs[--nb->addr_count];
+        else
+            i++;
+    }
+
+    // Or delroute reports. Elixir clears the gateway with the link.
+    i = 0;
+    while (i < nb->default_route_count)
+    {
+        if (nb->default_routes[i].ifindex == ifindex)
+            nb->default_routes[i] = nb->default_routes[--nb->default_route_count];
+        else
+            i++;
+    }
+    i = 0;
+    while (i < nb->neigh_count)
+    {
+        if (nb->neighs[i].ifindex == ifindex)
+            nb->neighs[i] = nb->neighs[--nb->neigh_count];
+        else
+            i++;
+    }
+    i = 0;
+    while (i < nb->gateway_count)
+    {
+        if (nb->gateways[i].ifindex == ifindex)
+            nb->gateways[i] = nb->gateways[--nb->gateway_count];
+        else
+            i++;
+    }
+}
+
+// The report is staged at the end unless there's a slot from
+// collapse_newlinks() to reuse
+static void send_link(struct netif *nb, struct link_cache_entry *entry, enum if_monitor_atom report, uint32_t fields,
+                      int slot)
+{
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    netif_build_link(buff, report, entry->ifindex, &entry->latest, fields);
+    if (slot >= 0)
+        replace_report(nb, slot, start);
+    else
+        finish_report(nb, start, entry->ifindex, 1);
+
+    if (nb->batch_mode)
+        entry->staged = 1;
+}
+
+// Linux's view of where the interface is in the system. This trims
+// "/sys/class/net/<ifname>" the same way as HWPath.symlink_to_hw_path/2.
+static int read_hw_path(const char *ifname, char *hw_path, size_t hw_path_len)
+{
+    char path[32 + IF_NAMESIZE];
+    snprintf(path, sizeof(path), "/sys/class/net/%s", ifname);
+
+    char link_path[512];
+    ssize_t len = readlink(path, link_path, sizeof(link_path) - 1);
+    if (len < 0)
+        return -1;
+    link_path[len] = '\0';
+
+    const char *start = link_path;
+    if (strncmp(start, "../..", 5) == 0)
+        start += 5;
+
+    char suffix[8 + IF_NAMESIZE];
+    snprintf(suffix, sizeof(suffix), "/net/%s", ifname);
+
+    size_t start_len = strlen(start);
+    size_t suffix_len = strlen(suffix);
+    if (start_len >= suffix_len && strcmp(start + start_len - suffix_len, suffix) == 0)
+        start_len -= suffix_len;
+
+    if (start_len >= hw_path_len)
+        return -1;
+
+    memcpy(hw_path, start, start_len);
+    hw_path[start_len] = '\0';
+    return 0;
+}
+
+// The hardware path doesn't change, so sysfs is only read when an interface
+// is first seen. It's tried again if the interface got renamed before it
+// could be read.
+static void resolve_hw_path(const struct link_cache_entry *entry, struct link_state *state)
+{
+    if (entry && (entry->latest.present & LINK_HW_PATH))
+    {
+        state->present |= LINK_HW_PATH;
+        strcpy(state->hw_path, entry->latest.hw_path);
+        return;
+    }
+    if (entry && strcmp(entry->latest.ifname, state->ifname) == 0)
+        return;
+
+    if (read_hw_path(state->ifname, state->hw_path, sizeof(state->hw_path)) == 0)
+        state->present |= LINK_HW_PATH;
+}
+
+static int handle_newlink(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct ifinfomsg *ifm = mnl_nlmsg_get_payload(nlh);
+    struct link_state state;
+    if (parse_link(nlh, &state) != MNL_CB_OK)
+        return MNL_CB_ERROR;
+
+    struct link_cache_entry *entry = find_link(nb, ifm->ifi_index);
+    resolve_hw_path(entry, &state);
+    if (!entry)
+    {
+        entry = add_link(nb, ifm->ifi_index);
+        entry->latest = state;
+        send_link(nb, entry, ATOM_NEWLINK, link_full_fields(&state), -1);
+        return MNL_CB_OK;
+    }
+
+    // When coalescing or waiting on Elixir, replace the staged report rather
+    // than adding to it.
+    const struct link_state *known = &entry->latest;
+    int collapsing = (nb->coalesce_ms > 0 || nb->backpressured) && entry->staged;
+    int slot = -1;
+    if (collapsing)
+    {
+        slot = collapse_newlinks(nb, entry->ifindex);
+        entry->staged = 0;
+
+        if (!entry->base_valid)
+        {
+            // Elixir hasn't heard about this link yet
+            entry->latest = state;
+            send_link(nb, entry, ATOM_NEWLINK, link_full_fields(&state), slot);
+            return MNL_CB_OK;
+        }
+        known = &entry->base;
+    }
+
+    uint32_t changes = link_changes(known, &state);
+    if ((changes & LINK_VISIBLE_FIELDS) == 0)
+    {
+        // Nothing changed that's worth telling Elixir about. Stats are left
+        // alone so that they'll be sent with the next real change.
+        if (collapsing)
+            entry->latest = entry->base;
+        return MNL_CB_OK;
+    }
+
+    entry->latest = state;
+    send_link(nb, entry, ATOM_UPDATELINK, changes, slot);
+    return MNL_CB_OK;
+}
+
+static int handle_dellink(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct ifinfomsg *ifm = mnl_nlmsg_get_payload(nlh);
+    struct link_state state;
+    if (parse_link(nlh, &state) != MNL_CB_OK)
+        return MNL_CB_ERROR;
+
+    remove_link(nb, ifm->ifi_index);
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    netif_build_link(buff, ATOM_DELLINK, ifm->ifi_index, &state, link_full_fields(&state));
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+static struct addr_cache_entry *find_addr(struct netif *nb, const struct ifaddrmsg *ifa, struct nlattr **tb)
+{
+    struct nlattr *attr = tb[IFA_ADDRESS] ? tb[IFA_ADDRESS] : tb[IFA_LOCAL];
+    if (!attr)
+        return NULL;
+
+    int len = mnl_attr_get_payload_len(attr);
+    const void *address = mnl_attr_get_payload(attr);
+
+    int i;
+    for (i = 0; i < nb->addr_count; i++)
+    {
+        struct addr_cache_entry *entry = &nb->addrs[i];
+        if (entry->ifindex == (int)ifa->ifa_index &&
+            entry->family == ifa->ifa_family &&
+            entry->prefixlen == ifa->ifa_prefixlen &&
+            entry->address_len == len &&
+            memcmp(entry->address, address, len) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static struct addr_cache_entry *add_addr(struct netif *nb, const struct ifaddrmsg *ifa, struct nlattr **tb)
+{
+    struct nlattr *attr = tb[IFA_ADDRESS] ? tb[IFA_ADDRESS] : tb[IFA_LOCAL];
+    if (!attr || mnl_attr_get_payload_len(attr) > sizeof(((struct addr_cache_entry *)0)->address))
+        return NULL;
+
+    if (nb->addr_count == nb->addr_capacity)
+    {
+        nb->addr_capacity = nb->addr_capacity ? nb->addr_capacity * 2 : 16;
+        nb->addrs = realloc(nb->addrs, nb->addr_capacity * sizeof(struct addr_cache_entry));
+        if (!nb->addrs)
+            err(EXIT_FAILURE, "realloc");
+    }
+
+    struct addr_cache_entry *entry = &nb->addrs[nb->addr_count++];
+    entry->ifindex = ifa->ifa_index;
+    entry->family = ifa->ifa_family;
+    entry->prefixlen = ifa->ifa_prefixlen;
+    entry->address_len = mnl_attr_get_payload_len(attr);
+    memcpy(entry->address, mnl_attr_get_payload(attr), entry->address_len);
+    entry->report_len = 0;
+    return entry;
+}
+
+static int64_t lifetime_deadline(uint32_t seconds, int64_t now)
+{
+    return seconds == 0xFFFFFFFFU ? -1 : now + (int64_t)seconds * 1000;
+}
+
+static int same_deadline(int64_t a, int64_t b)
+{
+    if (a < 0 || b < 0)
+        return a == b;
+
+    int64_t delta = a > b ? a - b : b - a;
+    return delta <= LIFETIME_SLACK_MS;
+}
+
+static int handle_newaddr(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[IFA_MAX + 1];
+    if (parse_addr(nlh, tb) != MNL_CB_OK)
+        return MNL_CB_ERROR;
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    int lifetimes = netif_build_addr(buff, ATOM_NEWADDR, ifa, tb);
+
+    // Lifetimes count down, so compare when they run out instead. That way
+    // refreshes are only reported if they extend or shorten the lifetimes.
+    const char *report = buff->buff + start;
+    int len = lifetimes - start;
+
+    int64_t preferred_until = -1;
+    int64_t valid_until = -1;
+    if (tb[IFA_CACHEINFO])
+    {
+        const struct ifa_cacheinfo *ci = mnl_attr_get_payload(tb[IFA_CACHEINFO]);
+        int64_t now = now_ms();
+        preferred_until = lifetime_deadline(ci->ifa_prefered, now);
+        valid_until = lifetime_deadline(ci->ifa_valid, now);
+    }
+
+    struct addr_cache_entry *entry = find_addr(nb, ifa, tb);
+    if (entry && entry->report_len == len && memcmp(entry->report, report, len) == 0 &&
+        same_deadline(entry->preferred_until, preferred_until) &&
+        same_deadline(entry->valid_until, valid_until))
+    {
+        // Same as last time
+        buff->index = start;
+        return MNL_CB_OK;
+    }
+
+    if (!entry)
+        entry = add_addr(nb, ifa, tb);
+    if (entry)
+    {
+        entry->preferred_until = preferred_until;
+        entry->valid_until = valid_until;
+        if (len <= MAX_ADDR_REPORT_LEN)
+        {
+            memcpy(entry->report, report, len);
+            entry->report_len = len;
+        }
+        else
+        {
+            entry->report_len = 0;
+        }
+    }
+
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+static int handle_deladdr(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[IFA_MAX + 1];
+    if (parse_addr(nlh, tb) != MNL_CB_OK)
+        return MNL_CB_ERROR;
+
+    struct addr_cache_entry *entry = find_addr(nb, ifa, tb);
+    if (entry)
+        *entry = nb->addrs[--nb->addr_count];
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    netif_build_addr(buff, ATOM_DELADDR, ifa, tb);
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+// Make room for one more entry at the end of a cache
+static void *grow_cache(void *entries, int count, int *capacity, size_t entry_size)
+{
+    if (count < *capacity)
+        return entries;
+
+    *capacity = *capacity ? *capacity * 2 : 16;
+    void *new_entries = realloc(entries, *capacity * entry_size);
+    if (!new_entries)
+        err(EXIT_FAILURE, "realloc");
+    return new_entries;
+}
+
+static int family_address_len(int family)
+{
+    switch (family)
+    {
+    case AF_INET:
+        return 4;
+    case AF_INET6:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+static struct neigh_cache_entry *find_neigh(struct netif *nb, int ifindex, int family, const unsigned char *address)
+{
+    int i;
+    for (i = 0; i < nb->neigh_count; i++)
+    {
+        struct neigh_cache_entry *entry = &nb->neighs[i];
+        if (entry->ifindex == ifindex &&
+            entry->family == family &&
+            memcmp(entry->address, address, family_address_len(family)) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static struct gateway_entry *find_gateway(struct netif *nb, int ifindex, int family, const unsigned char *address)
+{
+    int i;
+    for (i = 0; i < nb->gateway_count; i++)
+    {
+        struct gateway_entry *entry = &nb->gateways[i];
+        if (entry->ifindex == ifindex &&
+            entry->family == family &&
+            memcmp(entry->address, address, family_address_len(family)) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static int is_default_gateway(struct netif *nb, int ifindex, int family, const unsigned char *address)
+{
+    int i;
+    for (i = 0; i < nb->default_route_count; i++)
+    {
+        struct default_route *route = &nb->default_routes[i];
+        if (route->ifindex == ifindex &&
+            route->family == family &&
+            memcmp(route->gateway, address, family_address_len(family)) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static enum if_monitor_atom nud_to_reachability(uint16_t nud_state)
+{
+    if (nud_state & (NUD_REACHABLE | NUD_PERMANENT))
+        return ATOM_REACHABLE;
+    if (nud_state & (NUD_STALE | NUD_DELAY | NUD_PROBE))
+        return ATOM_STALE;
+    if (nud_state & NUD_FAILED)
+        return ATOM_FAILED;
+
+    // Incomplete, noarp and none don't say anything about the gateway
+    return ATOM_UNKNOWN;
+}
+
+static void send_gateway(struct netif *nb, int ifindex, int family, const unsigned char *address, enum if_monitor_atom state)
+{
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 3);
+    encode_atom(buff, ATOM_GATEWAY);
+    ei_x_encode_long(buff, ifindex);
+    ei_x_encode_map_header(buff, 2);
+    encode_kv_raw_address(buff, ATOM_ADDRESS, address, family_address_len(family));
+    encode_atom(buff, ATOM_STATE);
+    encode_atom(buff, state);
+    finish_report(nb, start, 0, 0);
+}
+
+// Report the neighbor state of a gateway if it changed. A nil state means that
+// it's not a default gateway anymore.
+static void update_gateway(struct netif *nb, int ifindex, int family, const unsigned char *address)
+{
+    // Resyncs report every gateway once the neighbor dump finishes
+    if (nb->dump_state == DUMP_ROUTES || nb->dump_state == DUMP_NEIGHS)
+        return;
+
+    enum if_monitor_atom state = ATOM_NIL;
+    if (is_default_gateway(nb, ifindex, family, address))
+    {
+        struct neigh_cache_entry *neigh = find_neigh(nb, ifindex, family, address);
+        state = neigh ? nud_to_reachability(neigh->nud_state) : ATOM_UNKNOWN;
+    }
+
+    struct gateway_entry *gateway = find_gateway(nb, ifindex, family, address);
+    if (state == (gateway ? gateway->state : ATOM_NIL))
+        return;
+
+    if (state == ATOM_NIL)
+    {
+        *gateway = nb->gateways[--nb->gateway_count];
+    }
+    else
+    {
+        if (!gateway)
+        {
+            nb->gateways = grow_cache(nb->gateways, nb->gateway_count, &nb->gateway_capacity, sizeof(struct gateway_entry));
+            gateway = &nb->gateways[nb->gateway_count++];
+            gateway->ifindex = ifindex;
+            gateway->family = family;
+            memcpy(gateway->address, address, family_address_len(family));
+        }
+        gateway->state = state;
+    }
+
+    send_gateway(nb, ifindex, family, address, state);
+}
+
+static void update_all_gateways(struct netif *nb)
+{
+    int i;
+    for (i = 0; i < nb->default_route_count; i++)
+    {
+        struct default_route *route = &nb->default_routes[i];
+        update_gateway(nb, route->ifindex, route->family, route->gateway);
+    }
+}
+
+static void track_default_route(struct netif *nb, int is_new, const struct rtmsg *rtm, struct nlattr **tb, uint32_t table)
+{
+    int len = family_address_len(rtm->rtm_family);
+    if (rtm->rtm_dst_len != 0 ||
+        rtm->rtm_type != RTN_UNICAST ||
+        !tb[RTA_GATEWAY] ||
+        !tb[RTA_OIF] ||
+        len == 0 ||
+        mnl_attr_get_payload_len(tb[RTA_GATEWAY]) != len)
+        return;
+
+    struct default_route key;
+    memset(&key, 0, sizeof(key));
+    key.table = table;
+    key.priority = tb[RTA_PRIORITY] ? mnl_attr_get_u32(tb[RTA_PRIORITY]) : 0;
+    key.ifindex = mnl_attr_get_u32(tb[RTA_OIF]);
+    key.family = rtm->rtm_family;
+    memcpy(key.gateway, mnl_attr_get_payload(tb[RTA_GATEWAY]), len);
+
+    struct default_route *route = NULL;
+    int i;
+    for (i = 0; i < nb->default_route_count; i++)
+    {
+        if (memcmp(&nb->default_routes[i], &key, sizeof(key)) == 0)
+        {
+            route = &nb->default_routes[i];
+            break;
+        }
+    }
+
+    if (is_new && !route)
+    {
+        nb->default_routes = grow_cache(nb->default_routes, nb->default_route_count, &nb->default_route_capacity, sizeof(struct default_route));
+        nb->default_routes[nb->default_route_count++] = key;
+    }
+    else if (!is_new && route)
+    {
+        *route = nb->default_routes[--nb->default_route_count];
+    }
+    else
+    {
+        return;
+    }
+
+    update_gateway(nb, key.ifindex, key.family, key.gateway);
+}
+
+static int handle_neigh(struct netif *nb, int is_new, const struct nlmsghdr *nlh)
+{
+    struct ndmsg *ndm = mnl_nlmsg_get_payload(nlh);
+
+    // Bridge forwarding database entries come through here too
+    int len = family_address_len(ndm->ndm_family);
+    if (len == 0)
+        return MNL_CB_OK;
+
+    const unsigned char *address = NULL;
+    const struct nlattr *attr;
+    mnl_attr_for_each(attr, nlh, sizeof(*ndm))
+    {
+        if (mnl_attr_get_type(attr) == NDA_DST && mnl_attr_get_payload_len(attr) == len)
+        {
+            address = mnl_attr_get_payload(attr);
+            break;
+        }
+    }
+    if (!address)
+        return MNL_CB_OK;
+
+    struct neigh_cache_entry *entry = find_neigh(nb, ndm->ndm_ifindex, ndm->ndm_family, address);
+    if (is_new)
+    {
+        if (!entry)
+        {
+            nb->neighs = grow_cache(nb->neighs, nb->neigh_count, &nb->neigh_capacity, sizeof(struct neigh_cache_entry));
+            entry = &nb->neighs[nb->neigh_count++];
+            entry->ifindex = ndm->ndm_ifindex;
+            entry->family = ndm->ndm_family;
+            memcpy(entry->address, address, len);
+        }
+        entry->nud_state = ndm->ndm_state;
+    }
+    else if (entry)
+    {
+        *entry = nb->neighs[--nb->neigh_count];
+    }
+
+    update_gateway(nb, ndm->ndm_ifindex, ndm->ndm_family, address);
+    return MNL_CB_OK;
+}
+
+static int handle_route(struct netif *nb, enum if_monitor_atom report, const struct nlmsghdr *nlh)
+{
+    struct rtmsg *rtm = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[RTA_MAX + 1];
+    memset(tb, 0, sizeof(tb));
+
+    if (mnl_attr_parse(nlh, sizeof(*rtm), collect_rta_attrs, tb) != MNL_CB_OK)
+    {
+        debug("Error from mnl_attr_parse");
+        return MNL_CB_ERROR;
+    }
+
+    uint32_t table = tb[RTA_TABLE] ? mnl_attr_get_u32(tb[RTA_TABLE]) : rtm->rtm_table;
+
+    // The kernel manages the local table and cached routes
+    if (table == RT_TABLE_LOCAL || (rtm->rtm_flags & RTM_F_CLONED))
+        return MNL_CB_OK;
+
+    track_default_route(nb, report == ATOM_NEWROUTE, rtm, tb, table);
+
+    int count = 6; // Base number of fields
+    int i;
+    for (i = 0; i <= RTA_MAX; i++)
+        if (tb[i] && i != RTA_TABLE)
+            count++;
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 2);
+    encode_atom(buff, report);
+    ei_x_encode_map_header(buff, count);
+
+    encode_kv_family(buff, ATOM_FAMILY, rtm->rtm_family);
+    encode_kv_ulong(buff, ATOM_TABLE, table);
+    encode_kv_ulong(buff, ATOM_DST_LEN, rtm->rtm_dst_len);
+    encode_kv_scope(buff, ATOM_SCOPE, rtm->rtm_scope);
+    encode_kv_route_type(buff, ATOM_TYPE, rtm->rtm_type);
+    encode_kv_ulong(buff, ATOM_PROTOCOL, rtm->rtm_protocol);
+
+    if (tb[RTA_DST])
+        encode_kv_address_attr(buff, ATOM_DST, tb[RTA_DST]);
+    if (tb[RTA_SRC])
+        encode_kv_address_attr(buff, ATOM_SRC, tb[RTA_SRC]);
+    if (tb[RTA_GATEWAY])
+        encode_kv_address_attr(buff, ATOM_GATEWAY, tb[RTA_GATEWAY]);
+    if (tb[RTA_PREFSRC])
+        encode_kv_address_attr(buff, ATOM_PREFSRC, tb[RTA_PREFSRC]);
+    if (tb[RTA_OIF])
+        encode_kv_ulong(buff, ATOM_OIF, mnl_attr_get_u32(tb[RTA_OIF]));
+    if (tb[RTA_PRIORITY])
+        encode_kv_ulong(buff, ATOM_PRIORITY, mnl_attr_get_u32(tb[RTA_PRIORITY]));
+
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+static int handle_rule(struct netif *nb, enum if_monitor_atom report, const struct nlmsghdr *nlh)
+{
+    struct fib_rule_hdr *frh = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[FRA_MAX + 1];
+    memset(tb, 0, sizeof(tb));
+
+    if (mnl_attr_parse(nlh, sizeof(*frh), collect_fra_attrs, tb) != MNL_CB_OK)
+    {
+        debug("Error from mnl_attr_parse");
+        return MNL_CB_ERROR;
+    }
+
+    int count = 5; // Base number of fields
+    int i;
+    for (i = 0; i <= FRA_MAX; i++)
+        if (tb[i] && i != FRA_TABLE)
+            count++;
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 2);
+    encode_atom(buff, report);
+    ei_x_encode_map_header(buff, count);
+
+    encode_kv_family(buff, ATOM_FAMILY, frh->family);
+    encode_kv_ulong(buff, ATOM_TABLE, tb[FRA_TABLE] ? mnl_attr_get_u32(tb[FRA_TABLE]) : frh->table);
+    encode_kv_ulong(buff, ATOM_ACTION, frh->action);
+    encode_kv_ulong(buff, ATOM_SRC_LEN, frh->src_len);
+    encode_kv_ulong(buff, ATOM_DST_LEN, frh->dst_len);
+
+    if (tb[FRA_SRC])
+        encode_kv_address_attr(buff, ATOM_SRC, tb[FRA_SRC]);
+    if (tb[FRA_DST])
+        encode_kv_address_attr(buff, ATOM_DST, tb[FRA_DST]);
+    if (tb[FRA_PRIORITY])
+        encode_kv_ulong(buff, ATOM_PRIORITY, mnl_attr_get_u32(tb[FRA_PRIORITY]));
+
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+static struct stats_watch *find_watch(struct netif *nb, const char *ifname)
+{
+    int i;
+    for (i = 0; i < nb->watch_count; i++)
+    {
+        if (strcmp(nb->watches[i].ifname, ifname) == 0)
+            return &nb->watches[i];
+    }
+    return NULL;
+}
+
+static void put_u64(unsigned char *p, uint64_t v)
+{
+    int i;
+    for (i = 7; i >= 0; i--)
+    {
+        p[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+static uint64_t rate(uint64_t previous, uint64_t current, int64_t elapsed_ms)
+{
+    // Counters start over if the interface is recreated
+    if (elapsed_ms <= 0 || current < previous)
+        return 0;
+
+    return (current - previous) * 1000 / elapsed_ms;
+}
+
+static void send_stats(struct netif *nb, int ifindex, struct stats_watch *watch, const struct rtnl_link_stats64 *stats)
+{
+    int64_t now = now_ms();
+    const struct rtnl_link_stats64 *previous = watch->have_previous ? &watch->previous : stats;
+    int64_t elapsed_ms = now - watch->previous_ms;
+
+    unsigned char sample[STATS_SAMPLE_LEN];
+    put_u64(&sample[0], stats->rx_bytes);
+    put_u64(&sample[8], stats->tx_bytes);
+    put_u64(&sample[16], stats->rx_packets);
+    put_u64(&sample[24], stats->tx_packets);
+    put_u64(&sample[32], stats->rx_errors);
+    put_u64(&sample[40], stats->tx_errors);
+    put_u64(&sample[48], stats->rx_dropped);
+    put_u64(&sample[56], stats->tx_dropped);
+    put_u64(&sample[64], rate(previous->rx_bytes, stats->rx_bytes, elapsed_ms));
+    put_u64(&sample[72], rate(previous->tx_bytes, stats->tx_bytes, elapsed_ms));
+    put_u64(&sample[80], rate(previous->rx_packets, stats->rx_packets, elapsed_ms));
+    put_u64(&sample[88], rate(previous->tx_packets, stats->tx_packets, elapsed_ms));
+
+    watch->previous = *stats;
+    watch->previous_ms = now;
+    watch->have_previous = 1;
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 4);
+    encode_atom(buff, ATOM_STATS);
+    encode_string(buff, watch->ifname);
+    ei_x_encode_long(buff, ifindex);
+    ei_x_encode_binary(buff, sample, sizeof(sample));
+    finish_report(nb, start, 0, 0);
+}
+
+static int handle_stats(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct if_stats_msg *ifsm = mnl_nlmsg_get_payload(nlh);
+
+    // Stats dumps include every interface, so only report the watched ones
+    struct link_cache_entry *entry = find_link(nb, ifsm->ifindex);
+    if (!entry)
+        return MNL_CB_OK;
+
+    struct stats_watch *watch = find_watch(nb, entry->latest.ifname);
+    if (!watch)
+        return MNL_CB_OK;
+
+    const struct nlattr *attr;
+    mnl_attr_for_each(attr, nlh, sizeof(*ifsm))
+    {
+        if (mnl_attr_get_type(attr) == IFLA_STATS_LINK_64)
+        {
+            struct rtnl_link_stats64 stats;
+            copy_attr_payload(&stats, sizeof(stats), attr);
+            send_stats(nb, ifsm->ifindex, watch, &stats);
+            break;
+        }
+    }
+    return MNL_CB_OK;
+}
+
+// Linux sends these when router advertisements are received. There's no way
+// to dump them, so they're not reported again when resyncing.
+static int handle_newprefix(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    struct prefixmsg *pm = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[PREFIX_MAX + 1];
+
+    memset(tb, 0, sizeof(tb));
+    if (mnl_attr_parse(nlh, sizeof(*pm), collect_prefix_attrs, tb) != MNL_CB_OK)
+    {
+        debug("Error from mnl_attr_parse");
+        return MNL_CB_ERROR;
+    }
+
+    if (pm->prefix_family != AF_INET6 || !tb[PREFIX_ADDRESS])
+        return MNL_CB_ERROR;
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    netif_build_prefix(buff, pm, tb);
+    finish_report(nb, start, 0, 0);
+    return MNL_CB_OK;
+}
+
+static size_t header_len(uint16_t type)
+{
+    switch (type)
+    {
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+        return sizeof(struct ifinfomsg);
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+        return sizeof(struct ifaddrmsg);
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+        return sizeof(struct rtmsg);
+    case RTM_NEWNEIGH:
+    case RTM_DELNEIGH:
+        return sizeof(struct ndmsg);
+    case RTM_NEWRULE:
+    case RTM_DELRULE:
+        return sizeof(struct fib_rule_hdr);
+    case RTM_NEWSTATS:
+        return sizeof(struct if_stats_msg);
+    case RTM_NEWPREFIX:
+        return sizeof(struct prefixmsg);
+    default:
+        return 0;
+    }
+}
+
+static enum nl_message_type message_type(uint16_t type)
+{
+    switch (type)
+    {
+    case RTM_NEWLINK:
+        return NL_NEWLINK;
+    case RTM_DELLINK:
+        return NL_DELLINK;
+    case RTM_NEWADDR:
+        return NL_NEWADDR;
+    case RTM_DELADDR:
+        return NL_DELADDR;
+    case RTM_NEWROUTE:
+        return NL_NEWROUTE;
+    case RTM_DELROUTE:
+        return NL_DELROUTE;
+    case RTM_NEWNEIGH:
+        return NL_NEWNEIGH;
+    case RTM_DELNEIGH:
+        return NL_DELNEIGH;
+    case RTM_NEWRULE:
+        return NL_NEWRULE;
+    case RTM_DELRULE:
+        return NL_DELRULE;
+    case RTM_NEWSTATS:
+        return NL_NEWSTATS;
+    case RTM_NEWPREFIX:
+        return NL_NEWPREFIX;
+    default:
+        return NL_OTHER;
+    }
+}
+
+static int build_notification(struct netif *nb, const struct nlmsghdr *nlh)
+{
+    // Don't read past the end of a truncated message
+    if (mnl_nlmsg_get_payload_len(nlh) < header_len(nlh->nlmsg_type))
+    {
+        warnx("Ignoring truncated netlink message type: %d", nlh->nlmsg_type);
+        return MNL_CB_ERROR;
+    }
+
+    switch (nlh->nlmsg_type)
+    {
+    case RTM_NEWLINK:
+        return handle_newlink(nb, nlh);
+    case RTM_DELLINK:
+        return handle_dellink(nb, nlh);
+    case RTM_NEWADDR:
+        return handle_newaddr(nb, nlh);
+    case RTM_DELADDR:
+        return handle_deladdr(nb, nlh);
+    case RTM_NEWROUTE:
+        return handle_route(nb, ATOM_NEWROUTE, nlh);
+    case RTM_DELROUTE:
+        return handle_route(nb, ATOM_DELROUTE, nlh);
+    case RTM_NEWNEIGH:
+        return handle_neigh(nb, 1, nlh);
+    case RTM_DELNEIGH:
+        return handle_neigh(nb, 0, nlh);
+    case RTM_NEWRULE:
+        return handle_rule(nb, ATOM_NEWRULE, nlh);
+    case RTM_DELRULE:
+        return handle_rule(nb, ATOM_DELRULE, nlh);
+    case RTM_NEWSTATS:
+        return handle_stats(nb, nlh);
+    case RTM_NEWPREFIX:
+        return handle_newprefix(nb, nlh);
+    default:
+        warn("Ignoring netlink message type: %d", nlh->nlmsg_type);
+        return MNL_CB_ERROR;
+    }
+}
+
+int netif_build_notification(const struct nlmsghdr *nlh, void *data)
+{
+    struct netif *nb = (struct netif *)data;
+    struct message_counters *counters = &nb->message_counters[message_type(nlh->nlmsg_type)];
+    counters->messages++;
+    counters->bytes += nlh->nlmsg_len;
+
+    // Skip messages that can't be parsed rather than exiting. They're
+    // counted so that they show up in the :netlink_stats report.
+    if (build_notification(nb, nlh) == MNL_CB_ERROR)
+        counters->parse_errors++;
+
+    return MNL_CB_OK;
+}
+
+static void request_dump(struct netif *nb, uint16_t type, size_t header_len, unsigned char family, enum dump_state state)
+{
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(nb->nlbuf);
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh->nlmsg_seq = nb->dump_seq = nb->seq++;
+
+    // The family is the first field in all of the request headers
+    unsigned char *header = mnl_nlmsg_put_extra_header(nlh, header_len);
+    header[0] = family;
+
+    if (mnl_socket_sendto(nb->nl, nlh, nlh->nlmsg_len) < 0)
+        err(EXIT_FAILURE, "mnl_socket_send(dump %d)", type);
+
+    nb->dump_state = state;
+}
+
+static void request_stats_dump(struct netif *nb)
+{
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(nb->nlbuf);
+    nlh->nlmsg_type = RTM_GETSTATS;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh->nlmsg_seq = nb->dump_seq = nb->seq++;
+
+    // Only ask for the 64-bit link counters to keep the dump small
+    struct if_stats_msg *ifsm = mnl_nlmsg_put_extra_header(nlh, sizeof(struct if_stats_msg));
+    ifsm->family = AF_UNSPEC;
+    ifsm->filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    if (mnl_socket_sendto(nb->nl, nlh, nlh->nlmsg_len) < 0)
+        err(EXIT_FAILURE, "mnl_socket_send(RTM_GETSTATS)");
+
+    nb->dump_state = DUMP_STATS;
+}
+
+void start_resync(struct netif *nb)
+{
+    // Staged reports are relative to the caches, so send them first
+    flush_reports(nb);
+
+    nb->link_count = 0;
+    nb->addr_count = 0;
+    nb->default_route_count = 0;
+    nb->neigh_count = 0;
+    nb->gateway_count = 0;
+    nb->resync_requested = 0;
+
+    // Everything between the resync and synced markers is the full state.
+    // Elixir removes anything that it didn't hear about.
+    send_marker(nb, ATOM_RESYNC);
+    request_dump(nb, RTM_GETLINK, sizeof(struct ifinfomsg), AF_PACKET, DUMP_LINKS);
+}
+
+static void request_resync(struct netif *nb)
+{
+    // Let the current dump finish since only one can run at a time
+    if (nb->dump_state != DUMP_IDLE)
+        nb->resync_requested = 1;
+    else
+        start_resync(nb);
+}
+
+static void handle_dump_done(struct netif *nb)
+{
+    switch (nb->dump_state)
+    {
+    case DUMP_LINKS:
+        request_dump(nb, RTM_GETADDR, sizeof(struct ifaddrmsg), AF_UNSPEC, DUMP_ADDRS);
+        break;
+
+    case DUMP_ADDRS:
+        request_dump(nb, RTM_GETROUTE, sizeof(struct rtmsg), AF_UNSPEC, DUMP_ROUTES);
+        break;
+
+    case DUMP_ROUTES:
+        request_dump(nb, RTM_GETNEIGH, sizeof(struct ndmsg), AF_UNSPEC, DUMP_NEIGHS);
+        break;
+
+    case DUMP_NEIGHS:
+        request_dump(nb, RTM_GETRULE, sizeof(struct fib_rule_hdr), AF_UNSPEC, DUMP_RULES);
+        update_all_gateways(nb);
+        break;
+
+    case DUMP_RULES:
+        nb->dump_state = DUMP_IDLE;
+        send_marker(nb, ATOM_SYNCED);
+
+        if (nb->resync_requested)
+            start_resync(nb);
+        break;
+
+    case DUMP_STATS:
+        nb->dump_state = DUMP_IDLE;
+
+        if (nb->resync_requested)
+            start_resync(nb);
+        break;
+
+    case DUMP_IDLE:
+    default:
+        break;
+    }
+}
+
+// Return how much of buf holds complete netlink messages. mnl_nlmsg_ok()
+// casts nlmsg_len to an int, so a corrupt length over 2 GB would look valid
+// and send mnl_cb_run off the end of the buffer.
+static int complete_messages_len(const char *buf, int len)
+{
+    int offset = 0;
+    while (len - offset >= (int)sizeof(struct nlmsghdr))
+    {
+        const struct nlmsghdr *nlh = (const struct nlmsghdr *)(buf + offset);
+        if (nlh->nlmsg_len < sizeof(struct nlmsghdr) || nlh->nlmsg_len > (uint32_t)(len - offset))
+            break;
+
+        offset += NLMSG_ALIGN(nlh->nlmsg_len);
+    }
+    return offset < len ? offset : len;
+}
+
+int netif_process(struct netif *nb, const char *buf, int len)
+{
+    nb->received_us = now_us();
+    nb->receives++;
+    nb->received_bytes += len;
+
+    // Dump responses are sent with the request's sequence number and
+    // multicast notifications have 0, so pass 0 to accept both.
+    return mnl_cb_run(buf, complete_messages_len(buf, len), 0, 0, netif_build_notification, nb);
+}
+
+void netif_capture(FILE *fp, const char *buf, int len)
+{
+    uint32_t be_len = htonl(len);
+    if (fwrite(&be_len, sizeof(be_len), 1, fp) != 1 ||
+        fwrite(buf, 1, len, fp) != (size_t)len ||
+        fflush(fp) != 0)
+        err(EXIT_FAILURE, "capture");
+}
+
+static void schedule_flush(struct netif *nb)
+{
+    if (nb->report_count == 0)
+        return;
+
+    if (nb->coalesce_ms <= 0)
+        flush_reports(nb);
+    else if (nb->flush_deadline < 0)
+        nb->flush_deadline = now_ms() + nb->coalesce_ms;
+}
+
+static void handle_notification(struct netif *nb, int bytecount)
+{
+    int rc = netif_process(nb, nb->nlbuf, bytecount);
+    if (rc == MNL_CB_ERROR && nb->dump_state == DUMP_STATS)
+    {
+        // Kernels before 4.7 don't support RTM_GETSTATS
+        warn("RTM_GETSTATS failed. Disabling stats sampling");
+        nb->stats_interval_ms = 0;
+        nb->stats_deadline = -1;
+        nb->dump_state = DUMP_IDLE;
+        rc = MNL_CB_OK;
+        if (nb->resync_requested)
+            start_resync(nb);
+    }
+    if (rc == MNL_CB_ERROR)
+        err(EXIT_FAILURE, "mnl_cb_run");
+
+    // NLMSG_DONE stops the callbacks. Notifications never share a read with
+    // dump responses, so the first message identifies the dump.
+    const struct nlmsghdr *nlh = (const struct nlmsghdr *)nb->nlbuf;
+    if (rc == MNL_CB_STOP && nb->dump_state != DUMP_IDLE && nlh->nlmsg_seq == nb->dump_seq)
+        handle_dump_done(nb);
+
+    schedule_flush(nb);
+}
+
+void nl_process(struct netif *nb)
+{
+    int bytecount = mnl_socket_recvfrom(nb->nl, nb->nlbuf, sizeof(nb->nlbuf));
+    if (bytecount < 0 && errno == ENOBUFS)
+    {
+        // Notifications were dropped, so nothing can be trusted. Start over.
+        warnx("netlink receive buffer overflowed. Resyncing.");
+        nb->counters.netlink_overruns++;
+        request_resync(nb);
+        return;
+    }
+    if (bytecount <= 0)
+        err(EXIT_FAILURE, "mnl_socket_recvfrom");
+
+    if (nb->capture)
+        netif_capture(nb->capture, nb->nlbuf, bytecount);
+
+    handle_notification(nb, bytecount);
+}
+
+int netif_paused(const struct netif *nb)
+{
+    // The kernel holds the rest of a dump until it's read, so waiting loses
+    // nothing. Dropping dump reports would only cause another resync.
+    return nb->backpressured && nb->dump_state != DUMP_IDLE;
+}
+
+void output_process(struct netif *nb)
+{
+    while (nb->outq_len > 0)
+    {
+        size_t first = OUTPUT_QUEUE_LEN - nb->outq_head;
+        if (first > nb->outq_len)
+            first = nb->outq_len;
+
+        struct iovec iov[2];
+        iov[0].iov_base = nb->outq + nb->outq_head;
+        iov[0].iov_len = first;
+        iov[1].iov_base = nb->outq;
+        iov[1].iov_len = nb->outq_len - first;
+
+        ssize_t rc = writev(STDOUT_FILENO, iov, iov[1].iov_len > 0 ? 2 : 1);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            err(EXIT_FAILURE, "writev");
+        }
+
+        nb->outq_head = (nb->outq_head + rc) % OUTPUT_QUEUE_LEN;
+        nb->outq_len -= rc;
+    }
+
+    if (nb->backpressured)
+        flush_reports(nb);
+
+    if (nb->overflowed && nb->outq_len == 0)
+    {
+        nb->overflowed = 0;
+        request_resync(nb);
+    }
+}
+
+void sample_stats(struct netif *nb)
+{
+    int64_t now = now_ms();
+
+    // Skip this sample if a resync is running. Only one dump can run at a time.
+    if (nb->dump_state == DUMP_IDLE)
+        request_stats_dump(nb);
+
+    nb->stats_deadline = now + nb->stats_interval_ms;
+}
+
+// Bad requests are ignored and the previous watches are kept. Elixir checks
+// the limit, so this shouldn't happen.
+static void watch_stats(struct netif *nb, const char *buf, int *index)
+{
+    long interval_ms;
+    int count;
+    if (ei_decode_long(buf, index, &interval_ms) < 0 ||
+        ei_decode_list_header(buf, index, &count) < 0)
+    {
+        warnx("Expecting {:watch_stats, interval, ifnames} from Elixir");
+        return;
+    }
+    if (count > MAX_STATS_WATCHES)
+    {
+        warnx("Ignoring request to watch %d interfaces. The limit is %d.", count, MAX_STATS_WATCHES);
+        return;
+    }
+
+    struct stats_watch watches[MAX_STATS_WATCHES];
+    memset(watches, 0, sizeof(watches));
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        int type;
+        int size;
+        long len;
+        if (ei_get_type(buf, index, &type, &size) < 0 || size >= IFNAMSIZ ||
+            ei_decode_binary(buf, index, watches[i].ifname, &len) < 0)
+        {
+            warnx("Expecting interface names from Elixir");
+            return;
+        }
+
+        // Keep the previous sample so that rates don't start over
+        struct stats_watch *old = find_watch(nb, watches[i].ifname);
+        if (old)
+            watches[i] = *old;
+    }
+
+    memcpy(nb->watches, watches, sizeof(watches));
+    nb->watch_count = count;
+
+    if (count > 0 && interval_ms > 0)
+    {
+        int restart = nb->stats_interval_ms != interval_ms || nb->stats_deadline < 0;
+        nb->stats_interval_ms = interval_ms;
+        if (restart)
+            nb->stats_deadline = now_ms();
+    }
+    else
+    {
+        nb->stats_interval_ms = 0;
+        nb->stats_deadline = -1;
+    }
+}
+
+static void send_counters(struct netif *nb)
+{
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 2);
+    encode_atom(buff, ATOM_COUNTERS);
+    ei_x_encode_map_header(buff, 5);
+    encode_kv_ulonglong(buff, ATOM_COLLAPSED, nb->counters.collapsed);
+    encode_kv_ulonglong(buff, ATOM_DROPPED, nb->counters.dropped);
+    encode_kv_ulonglong(buff, ATOM_OVERFLOWS, nb->counters.overflows);
+    encode_kv_ulonglong(buff, ATOM_NETLINK_OVERRUNS, nb->counters.netlink_overruns);
+    encode_kv_ulonglong(buff, ATOM_MAX_QUEUED_BYTES, nb->counters.max_queued_bytes);
+    finish_report(nb, start, 0, 0);
+    schedule_flush(nb);
+}
+
+static void send_netlink_stats(struct netif *nb)
+{
+    static const enum if_monitor_atom type_atoms[NL_MESSAGE_TYPE_COUNT] = {
+        ATOM_NEWLINK,
+        ATOM_DELLINK,
+        ATOM_NEWADDR,
+        ATOM_DELADDR,
+        ATOM_NEWROUTE,
+        ATOM_DELROUTE,
+        ATOM_NEWNEIGH,
+        ATOM_DELNEIGH,
+        ATOM_NEWRULE,
+        ATOM_DELRULE,
+        ATOM_STATS,
+        ATOM_NEWPREFIX,
+        ATOM_OTHER};
+
+    int start;
+    ei_x_buff *buff = begin_report(nb, &start);
+    ei_x_encode_tuple_header(buff, 2);
+    encode_atom(buff, ATOM_NETLINK_STATS);
+    ei_x_encode_map_header(buff, 2 + NL_MESSAGE_TYPE_COUNT);
+    encode_kv_ulonglong(buff, ATOM_RECEIVES, nb->receives);
+    encode_kv_ulonglong(buff, ATOM_BYTES, nb->received_bytes);
+
+    int i;
+    for (i = 0; i < NL_MESSAGE_TYPE_COUNT; i++)
+    {
+        const struct message_counters *counters = &nb->message_counters[i];
+        encode_atom(buff, type_atoms[i]);
+        ei_x_encode_map_header(buff, 3);
+        encode_kv_ulonglong(buff, ATOM_MESSAGES, counters->messages);
+        encode_kv_ulonglong(buff, ATOM_BYTES, counters->bytes);
+        encode_kv_ulonglong(buff, ATOM_PARSE_ERRORS, counters->parse_errors);
+    }
+    finish_report(nb, start, 0, 0);
+    schedule_flush(nb);
+}
+
+static void process_command(struct netif *nb, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    char command[MAXATOMLEN];
+    if (ei_decode_version(buf, &index, &version) < 0)
+        errx(EXIT_FAILURE, "Expecting a command from Elixir");
+
+    // Replies are timed from when the command arrived
+    nb->received_us = now_us();
+
+    // Commands are atoms or tuples that start with an atom
+    if (ei_decode_tuple_header(buf, &index, &arity) < 0)
+        arity = 1;
+    if (ei_decode_atom(buf, &index, command) < 0)
+        errx(EXIT_FAILURE, "Expecting an atom command from Elixir");
+
+    if (strcmp(command, "resync") == 0)
+        request_resync(nb);
+    else if (strcmp(command, "watch_stats") == 0 && arity == 3)
+        watch_stats(nb, buf, &index);
+    else if (strcmp(command, "counters") == 0)
+        send_counters(nb);
+    else if (strcmp(command, "netlink_stats") == 0)
+        send_netlink_stats(nb);
+    else
+        warnx("Ignoring unknown command: %s", command);
+}
+
+int stdin_process(struct netif *nb)
+{
+    ssize_t amount = read(STDIN_FILENO, nb->cmdbuf + nb->cmdbuf_len, sizeof(nb->cmdbuf) - nb->cmdbuf_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    nb->cmdbuf_len += amount;
+
+    // Commands use the same {:packet, 4} framing as reports
+    size_t offset = 0;
+    while (nb->cmdbuf_len - offset >= PACKET_HEADER_LEN)
+    {
+        uint32_t be_len;
+        memcpy(&be_len, &nb->cmdbuf[offset], sizeof(be_len));
+        size_t len = ntohl(be_len);
+        if (len + PACKET_HEADER_LEN > sizeof(nb->cmdbuf))
+            errx(EXIT_FAILURE, "Command too long: %d bytes", (int)len);
+        if (nb->cmdbuf_len - offset < len + PACKET_HEADER_LEN)
+            break;
+
+        process_command(nb, &nb->cmdbuf[offset + PACKET_HEADER_LEN]);
+        offset += len + PACKET_HEADER_LEN;
+    }
+
+    nb->cmdbuf_len -= offset;
+    memmove(nb->cmdbuf, &nb->cmdbuf[offset], nb->cmdbuf_len);
+    return 0;
+}
+
@@ -0,0 +1,246 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#ifndef IF_MONITOR_LIB_H
+#define IF_MONITOR_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libmnl/libmnl.h>
+#include <linux/if_link.h>
+
+#include <ei.h>
+
+#include "if_monitor_encode.h"
+
+// Netlink dumps can send up to 32 KB at a time. See NLMSG_GOODSIZE.
+#define NLBUF_LEN 32768
+
+// Limit on interfaces that can have their stats sampled
+#define MAX_STATS_WATCHES 32
+
+// Messages to Elixir are queued here when stdout would block
+#define OUTPUT_QUEUE_LEN (2 * 1024 * 1024)
+
+// Limit on reports that are held while waiting for the output queue. Past
+// this, they're dropped and a resync is done after Elixir catches up. Dumps
+// are never dropped. Reading them pauses instead.
+#define MAX_STAGED_LEN (2 * 1024 * 1024)
+
+struct link_cache_entry;
+struct addr_cache_entry;
+struct staged_report;
+struct default_route;
+struct neigh_cache_entry;
+struct gateway_entry;
+
+enum dump_state
+{
+    DUMP_IDLE,
+    DUMP_LINKS,
+    DUMP_ADDRS,
+    DUMP_ROUTES,
+    DUMP_NEIGHS,
+    DUMP_RULES,
+    DUMP_STATS
+};
+
+// Counts of events that Elixir didn't see individually
+struct output_counters
+{
+    // Link reports replaced by newer ones before they were sent
+    uint64_t collapsed;
+
+    // Reports dropped since Elixir was too far behind. A resync replaces them.
+    uint64_t dropped;
+
+    // Times that reports had to be dropped
+    uint64_t overflows;
+
+    // Times that the kernel dropped netlink notifications (ENOBUFS)
+    uint64_t netlink_overruns;
+
+    // Most bytes waiting to be written to Elixir at once
+    uint64_t max_queued_bytes;
+};
+
+// Netlink message types that are counted separately. Everything else is
+// counted as NL_OTHER.
+enum nl_message_type
+{
+    NL_NEWLINK,
+    NL_DELLINK,
+    NL_NEWADDR,
+    NL_DELADDR,
+    NL_NEWROUTE,
+    NL_DELROUTE,
+    NL_NEWNEIGH,
+    NL_DELNEIGH,
+    NL_NEWRULE,
+    NL_DELRULE,
+    NL_NEWSTATS,
+    NL_NEWPREFIX,
+    NL_OTHER,
+    NL_MESSAGE_TYPE_COUNT
+};
+
+struct message_counters
+{
+    uint64_t messages;
+    uint64_t bytes;
+
+    // Messages that couldn't be parsed and were skipped
+    uint64_t parse_errors;
+};
+
+// Interface that Elixir wants periodic stats for
+struct stats_watch
+{
+    char ifname[IF_NAMESIZE];
+    int have_previous;
+    int64_t previous_ms;
+    struct rtnl_link_stats64 previous;
+};
+
+struct netif
+{
+    // NETLINK_ROUTE socket for link, address, route, neighbor and rule
+    // notifications and dumps
+    struct mnl_socket *nl;
+
+    // Sequence numbers for requests
+    unsigned int seq;
+
+    // Netlink buffering
+    char nlbuf[NLBUF_LEN];
+
+    // Send reports as lists of reports rather than one at a time
+    int batch_mode;
+
+    // Milliseconds to wait for more reports before sending a batch.
+    // Repeated newlink reports in the window are collapsed to the last one.
+    int coalesce_ms;
+
+    // When the pending batch needs to be sent (CLOCK_MONOTONIC milliseconds)
+    int64_t flush_deadline;
+
+    // Encoded reports waiting to be sent. These don't have version headers.
+    ei_x_buff staged;
+    struct staged_report *reports;
+    int report_count;
+    int report_capacity;
+
+    // Reusable buffer for the message that's written to Elixir
+    ei_x_buff out;
+
+    // Send a message to Elixir. This queues {:packet, 4} framed messages for
+    // stdout unless the replay or fuzz drivers replace it.
+    void (*output)(struct netif *nb, const char *data, int len);
+
+    // Ring buffer of framed messages for stdout. stdout is non-blocking so
+    // that the netlink socket keeps being read while Elixir is busy.
+    char *outq;
+    size_t outq_head;
+    size_t outq_len;
+
+    // Set when staged reports are being held for room in the output queue.
+    // Link reports get collapsed while this is set.
+    int backpressured;
+
+    // Set when reports are being dropped. A resync starts when the output
+    // queue empties.
+    int overflowed;
+
+    struct output_counters counters;
+
+    // When the netlink data or command being processed was received
+    // (CLOCK_MONOTONIC microseconds). Batches include the earliest receive
+    // time of their reports so that Elixir can measure latency.
+    int64_t received_us;
+
+    // Netlink receive statistics for the :netlink_stats command
+    uint64_t receives;
+    uint64_t received_bytes;
+    struct message_counters message_counters[NL_MESSAGE_TYPE_COUNT];
+
+    // Caches of what's been reported so that only changes get sent
+    struct link_cache_entry *links;
+    int link_count;
+    int link_capacity;
+    struct addr_cache_entry *addrs;
+    int addr_count;
+    int addr_capacity;
+
+    // Gateway reachability. Default routes and neighbor table entries are
+    // tracked so that the neighbor state of each default gateway can be
+    // reported when either one changes.
+    struct default_route *default_routes;
+    int default_route_count;
+    int default_route_capacity;
+    struct neigh_cache_entry *neighs;
+    int neigh_count;
+    int neigh_capacity;
+    struct gateway_entry *gateways;
+    int gateway_count;
+    int gateway_capacity;
+
+    // Dump tracking for resyncs. Only one dump can run at a time on the
+    // socket, so links are dumped first, then addresses, routes, neighbors
+    // and rules.
+    enum dump_state dump_state;
+    unsigned int dump_seq;
+    int resync_requested;
+
+    // Periodic stats sampling. Disabled when the interval is 0.
+    int stats_interval_ms;
+    int64_t stats_deadline;
+    struct stats_watch watches[MAX_STATS_WATCHES];
+    int watch_count;
+
+    // Optional capture of everything read from the netlink socket for
+    // if_monitor_replay. Each read is saved as a 4-byte big endian length
+    // followed by the data.
+    FILE *capture;
+
+    // Partially received commands from Elixir
+    char cmdbuf[1024];
+    size_t cmdbuf_len;
+};
+
+// Set up everything but the netlink socket
+void netif_init(struct netif *nb, int batch_mode, int coalesce_ms);
+
+// Open and subscribe the NETLINK_ROUTE socket
+void netif_open(struct netif *nb);
+
+void netif_cleanup(struct netif *nb);
+
+// mnl_cb_run callback for all netlink messages
+int netif_build_notification(const struct nlmsghdr *nlh, void *data);
+
+// Run netlink messages in buf through netif_build_notification. Reports are
+// staged or sent, but errors are returned rather than exiting.
+int netif_process(struct netif *nb, const char *buf, int len);
+
+// Save one netlink read in the capture file format
+void netif_capture(FILE *fp, const char *buf, int len);
+
+void flush_reports(struct netif *nb);
+
+// Write queued messages to stdout. This returns when stdout would block.
+void output_process(struct netif *nb);
+
+// True when netlink reads should wait for the output queue to drain
+int netif_paused(const struct netif *nb);
+
+void start_resync(struct netif *nb);
+void nl_process(struct netif *nb);
+void sample_stats(struct netif *nb);
+int stdin_process(struct netif *nb);
+int64_t now_ms(void);
+int64_t now_us(void);
+
+#endif // IF_MONITOR_LIB_H
@@ -0,0 +1,506 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Replay benchmark for if_monitor
+//
+// This feeds netlink reads through the same parsing, caching and encoding
+// code as if_monitor and prints the throughput, bytes sent to Elixir and
+// heap allocations. Reads either come from files recorded with
+// `if_monitor -r <path>` or are generated:
+//
+//   links  RTM_NEWLINK and RTM_NEWADDR dumps for <count> interfaces
+//   flap   <count> carrier changes across 4 interfaces
+//   ipv6   <count> IPv6 addresses on one interface, then the same addresses
+//          again like a lifetime refresh
+//   linkaddr <count> interfaces that get an address and then change state,
+//          all in one read. Use it with -c -o to check that collapsed link
+//          reports stay ahead of the address reports.
+//
+// Run it with `make replay` and MIX_APP_PATH set like mix does.
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <net/if_arp.h>
+#include <net/if.h>
+#include <linux/if.h>
+#include <linux/rtnetlink.h>
+
+#include "if_monitor_lib.h"
+
+// Allocations are counted by linking with -Wl,--wrap=malloc and friends
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static long long allocations;
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+struct capture_read
+{
+    int len;
+    char *data;
+};
+
+struct capture
+{
+    struct capture_read *reads;
+    int count;
+    int capacity;
+};
+
+static long long bytes_sent;
+static long long packets_sent;
+
+// Report order checking for -o
+static int check_order;
+static long long order_errors;
+static unsigned char *linked;
+static long linked_len;
+
+static void set_linked(long ifindex, int value)
+{
+    if (ifindex < 0)
+        return;
+
+    if (ifindex >= linked_len)
+    {
+        long new_len = ifindex + 64;
+        linked = realloc(linked, new_len);
+        if (!linked)
+            err(EXIT_FAILURE, "realloc");
+        memset(linked + linked_len, 0, new_len - linked_len);
+        linked_len = new_len;
+    }
+    linked[ifindex] = value;
+}
+
+static int is_linked(long ifindex)
+{
+    return ifindex >= 0 && ifindex < linked_len && linked[ifindex];
+}
+
+// Elixir needs to hear about a link before its addresses. Otherwise it
+// makes an "__unknown" interface for them.
+static void check_report_order(const char *data, int len)
+{
+    int index = 0;
+    int version;
+    int type;
+    int count;
+    if (ei_decode_version(data, &index, &version) < 0 || ei_get_type(data, &index, &type, &count) < 0)
+        return;
+
+    if (type == ERL_LIST_EXT)
+        ei_decode_list_header(data, &index, &count);
+    else
+        count = 1;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        int next = index;
+        if (ei_skip_term(data, &next) < 0)
+            return;
+
+        int arity;
+        char atom[MAXATOMLEN];
+        long ifindex;
+        if (ei_decode_tuple_header(data, &index, &arity) == 0 &&
+                ei_decode_atom(data, &index, atom) == 0)
+        {
+            if (strcmp(atom, "newlink") == 0 || strcmp(atom, "updatelink") == 0 ||
+                    strcmp(atom, "dellink") == 0)
+            {
+                // Skip the ifname
+                if (ei_skip_term(data, &index) == 0 && ei_decode_long(data, &index, &ifindex) == 0)
+                    set_linked(ifindex, strcmp(atom, "dellink") != 0);
+            }
+            else if (strcmp(atom, "newaddr") == 0)
+            {
+                if (ei_decode_long(data, &index, &ifindex) == 0 && !is_linked(ifindex))
+                    order_errors++;
+            }
+        }
+        index = next;
+    }
+}
+
+static void count_output(struct netif *nb, const char *data, int len)
+{
+    bytes_sent += len;
+    packets_sent++;
+
+    if (check_order)
+        check_report_order(data, len);
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void add_read(struct capture *cap, const char *data, int len)
+{
+    if (cap->count == cap->capacity)
+    {
+        cap->capacity = cap->capacity ? cap->capacity * 2 : 64;
+        cap->reads = realloc(cap->reads, cap->capacity * sizeof(struct capture_read));
+        if (!cap->reads)
+            err(EXIT_FAILURE, "realloc");
+    }
+
+    struct capture_read *read = &cap->reads[cap->count++];
+    read->len = len;
+    read->data = malloc(len);
+    if (!read->data)
+        err(EXIT_FAILURE, "malloc");
+    memcpy(read->data, data, len);
+}
+
+static void load_capture(struct capture *cap, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        err(EXIT_FAILURE, "fopen(%s)", path);
+
+    static char buf[NLBUF_LEN];
+    uint32_t be_len;
+    while (fread(&be_len, sizeof(be_len), 1, fp) == 1)
+    {
+        uint32_t len = ntohl(be_len);
+        if (len > sizeof(buf) || fread(buf, 1, len, fp) != len)
+            errx(EXIT_FAILURE, "%s: truncated or corrupt capture", path);
+
+        add_read(cap, buf, len);
+    }
+    fclose(fp);
+}
+
+// Netlink messages are packed into reads the same way the kernel packs
+// dumps so that mnl_cb_run sees realistic batches.
+struct generator
+{
+    struct capture *cap;
+    char buf[NLBUF_LEN];
+    int len;
+    int per_read;
+    int in_read;
+};
+
+static void gen_flush(struct generator *gen)
+{
+    if (gen->len > 0)
+        add_read(gen->cap, gen->buf, gen->len);
+    gen->len = 0;
+    gen->in_read = 0;
+}
+
+static struct nlmsghdr *gen_message(struct generator *gen, uint16_t type)
+{
+    // Leave plenty of room for one more message
+    if (gen->in_read == gen->per_read || gen->len > NLBUF_LEN - 1024)
+        gen_flush(gen);
+
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(gen->buf + gen->len);
+    nlh->nlmsg_type = type;
+    gen->in_read++;
+    return nlh;
+}
+
+static void gen_done(struct generator *gen, struct nlmsghdr *nlh)
+{
+    gen->len += NLMSG_ALIGN(nlh->nlmsg_len);
+}
+
+static void gen_link(struct generator *gen, int ifindex, int running, int counter)
+{
+    struct nlmsghdr *nlh = gen_message(gen, RTM_NEWLINK);
+    struct ifinfomsg *ifm = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifinfomsg));
+    ifm->ifi_family = AF_UNSPEC;
+    ifm->ifi_type = ARPHRD_ETHER;
+    ifm->ifi_index = ifindex;
+    ifm->ifi_flags = IFF_UP | IFF_BROADCAST | IFF_MULTICAST;
+    if (running)
+        ifm->ifi_flags |= IFF_RUNNING | WORKAROUND_IFF_LOWER_UP;
+
+    char ifname[IF_NAMESIZE];
+    snprintf(ifname, sizeof(ifname), "eth%d", ifindex - 2);
+    unsigned char mac[6] = {0x02, 0x42, 0xac, 0x11, (ifindex >> 8) & 0xff, ifindex & 0xff};
+    unsigned char broadcast[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+    struct rtnl_link_stats64 stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.rx_packets = counter;
+    stats.tx_packets = counter;
+
+    mnl_attr_put_strz(nlh, IFLA_IFNAME, ifname);
+    mnl_attr_put_u32(nlh, IFLA_MTU, 1500);
+    mnl_attr_put(nlh, IFLA_ADDRESS, sizeof(mac), mac);
+    mnl_attr_put(nlh, IFLA_BROADCAST, sizeof(broadcast), broadcast);
+    mnl_attr_put_u8(nlh, IFLA_OPERSTATE, running ? IF_OPER_UP : IF_OPER_DOWN);
+    mnl_attr_put(nlh, IFLA_STATS64, sizeof(stats), &stats);
+    gen_done(gen, nlh);
+}
+
+static void gen_addr(struct generator *gen, int ifindex, int family, const void *address, int prefixlen,
+                     uint32_t lifetime)
+{
+    int len = family == AF_INET ? 4 : 16;
+    struct nlmsghdr *nlh = gen_message(gen, RTM_NEWADDR);
+    struct ifaddrmsg *ifa = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifaddrmsg));
+    ifa->ifa_family = family;
+    ifa->ifa_prefixlen = prefixlen;
+    ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa->ifa_index = ifindex;
+
+    mnl_attr_put(nlh, IFA_ADDRESS, len, address);
+    if (family == AF_INET)
+    {
+        char label[IF_NAMESIZE];
+        snprintf(label, sizeof(label), "eth%d", ifindex - 2);
+        mnl_attr_put(nlh, IFA_LOCAL, len, address);
+        mnl_attr_put_strz(nlh, IFA_LABEL, label);
+    }
+    mnl_attr_put_u32(nlh, IFA_FLAGS, lifetime == 0xFFFFFFFFU ? IFA_F_PERMANENT : 0);
+
+    struct ifa_cacheinfo ci;
+    memset(&ci, 0, sizeof(ci));
+    ci.ifa_prefered = lifetime;
+    ci.ifa_valid = lifetime;
+    mnl_attr_put(nlh, IFA_CACHEINFO, sizeof(ci), &ci);
+    gen_done(gen, nlh);
+}
+
+static void generate(struct capture *cap, const char *scenario, int count)
+{
+    struct generator *gen = calloc(1, sizeof(struct generator));
+    if (!gen)
+        err(EXIT_FAILURE, "calloc");
+    gen->cap = cap;
+    gen->per_read = NLBUF_LEN;
+
+    int i;
+    if (strcmp(scenario, "links") == 0)
+    {
+        for (i = 0; i < count; i++)
+            gen_link(gen, i + 2, 1, 0);
+        gen_flush(gen);
+
+        for (i = 0; i < count; i++)
+        {
+            unsigned char address[4] = {10, (i >> 8) & 0xff, i & 0xff, 1};
+            gen_addr(gen, i + 2, AF_INET, address, 24, 0xFFFFFFFFU);
+        }
+    }
+    else if (strcmp(scenario, "flap") == 0)
+    {
+        // Seed the links and then send notifications one per read like the
+        // kernel does outside of dumps
+        for (i = 0; i < 4; i++)
+            gen_link(gen, i + 2, 1, 0);
+        gen_flush(gen);
+
+        gen->per_read = 1;
+        for (i = 0; i < count; i++)
+            gen_link(gen, (i % 4) + 2, (i / 4) % 2, i);
+    }
+    else if (strcmp(scenario, "linkaddr") == 0)
+    {
+        // The second link report collapses into the first one
+        for (i = 0; i < count; i++)
+        {
+            unsigned char address[4] = {10, (i >> 8) & 0xff, i & 0xff, 1};
+            gen_link(gen, i + 2, 0, 0);
+            gen_addr(gen, i + 2, AF_INET, address, 24, 0xFFFFFFFFU);
+            gen_link(gen, i + 2, 1, 0);
+        }
+    }
+    else if (strcmp(scenario, "ipv6") == 0)
+    {
+        gen_link(gen, 2, 1, 0);
+        gen_flush(gen);
+
+        int pass;
+        for (pass = 0; pass < 2; pass++)
+        {
+            for (i = 0; i < count; i++)
+            {
+                unsigned char address[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                                             0x02, 0x42, 0xac, 0xff, 0xfe, 0x11,
+                                             (i >> 8) & 0xff, i & 0xff
+                                            };
+                gen_addr(gen, 2, AF_INET6, address, 64, 3600 - pass);
+            }
+            gen_flush(gen);
+        }
+    }
+    else
+    {
+        errx(EXIT_FAILURE, "Unknown scenario: %s", scenario);
+    }
+    gen_flush(gen);
+    free(gen);
+}
+
+static long count_messages(const struct capture *cap)
+{
+    long messages = 0;
+    int i;
+    for (i = 0; i < cap->count; i++)
+    {
+        const struct nlmsghdr *nlh = (const struct nlmsghdr *)cap->reads[i].data;
+        int len = cap->reads[i].len;
+        while (mnl_nlmsg_ok(nlh, len))
+        {
+            messages++;
+            nlh = mnl_nlmsg_next(nlh, &len);
+        }
+    }
+    return messages;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: if_monitor_replay [options] [capture files...]\n");
+    fprintf(stderr, "  -g <scenario>  Generate links, flap, linkaddr or ipv6 rather than reading captures\n");
+    fprintf(stderr, "  -n <count>     Interfaces, changes or addresses to generate (default 1000)\n");
+    fprintf(stderr, "  -i <count>     Times to replay everything (default 100)\n");
+    fprintf(stderr, "  -b             Send reports in batches\n");
+    fprintf(stderr, "  -c             Collapse link reports like if_monitor -c (implies -b)\n");
+    fprintf(stderr, "  -w <reads>     Netlink reads per batch (default 1)\n");
+    fprintf(stderr, "  -o             Fail if an address is reported before its link\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *scenario = NULL;
+    int count = 1000;
+    int iterations = 100;
+    int batch_mode = 0;
+    int coalesce_ms = 0;
+    int reads_per_batch = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:n:i:bcw:o")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            scenario = optarg;
+            break;
+        case 'n':
+            count = strtol(optarg, NULL, 0);
+            break;
+        case 'i':
+            iterations = strtol(optarg, NULL, 0);
+            break;
+        case 'b':
+            batch_mode = 1;
+            break;
+        case 'c':
+            batch_mode = 1;
+            coalesce_ms = 1;
+            break;
+        case 'w':
+            reads_per_batch = strtol(optarg, NULL, 0);
+            break;
+        case 'o':
+            check_order = 1;
+            break;
+        default:
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (count <= 0 || iterations <= 0 || reads_per_batch <= 0 || (!scenario && optind == argc))
+    {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    struct capture cap;
+    memset(&cap, 0, sizeof(cap));
+    if (scenario)
+        generate(&cap, scenario, count);
+    for (; optind < argc; optind++)
+        load_capture(&cap, argv[optind]);
+
+    long messages = count_messages(&cap);
+    struct netif *nb = malloc(sizeof(struct netif));
+    if (!nb)
+        err(EXIT_FAILURE, "malloc");
+
+    long long errors = 0;
+    allocations = 0;
+    int64_t start = now_ns();
+
+    int n;
+    for (n = 0; n < iterations; n++)
+    {
+        // Start from empty caches each time like if_monitor does on a resync
+        netif_init(nb, batch_mode, coalesce_ms);
+        nb->output = count_output;
+        if (linked)
+            memset(linked, 0, linked_len);
+
+        int i;
+        for (i = 0; i < cap.count; i++)
+        {
+            if (netif_process(nb, cap.reads[i].data, cap.reads[i].len) == MNL_CB_ERROR)
+                errors++;
+
+            if (nb->batch_mode && (i + 1) % reads_per_batch == 0)
+                flush_reports(nb);
+        }
+        flush_reports(nb);
+        netif_cleanup(nb);
+    }
+
+    int64_t elapsed_ns = now_ns() - start;
+    double seconds = elapsed_ns / 1e9;
+    long long total = (long long)messages * iterations;
+
+    printf("scenario:         %s\n", scenario ? scenario : "capture");
+    printf("netlink reads:    %d\n", cap.count);
+    printf("messages:         %ld x %d\n", messages, iterations);
+    printf("elapsed:          %.3f s\n", seconds);
+    printf("msgs/sec:         %.0f\n", total / seconds);
+    printf("ns/msg:           %.1f\n", (double) elapsed_ns / total);
+    printf("bytes encoded:    %lld (%.1f bytes/msg)\n", bytes_sent, (double) bytes_sent / total);
+    printf("packets sent:     %lld\n", packets_sent);
+    printf("allocations:      %lld (%.3f/msg)\n", allocations, (double) allocations / total);
+    if (errors)
+        printf("callback errors:  %lld\n", errors);
+    if (check_order)
+        printf("order errors:     %lld\n", order_errors);
+
+    free(nb);
+    free(linked);
+    return order_errors ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,613 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Watch udhcpd lease files and report what changed
+//
+// udhcpd rewrites its whole lease file each time it saves leases. Rather than
+// have Elixir parse the whole file each time, this watches the file's
+// directory with inotify, parses the file after it's closed, compares it to
+// the last copy and only sends the differences.
+//
+// Requests from Elixir are:
+//
+//   {:watch, ifname, path}
+//   {:unwatch, ifname}
+//
+// Changes are sent as:
+//
+//   {:leases, ifname, added, removed, renewed}
+//
+// Each list holds leases in the same form as VintageNet.Interface.Udhcpd
+// returns them. Leases are identified by IP and MAC address. A lease is
+// renewed if it expires at a different time or the hostname changed. udhcpd
+// saves the time left on each lease, so the expiration time is found from
+// that and the time that the file was saved. Since leases that weren't
+// renewed aren't sent again, their `:leasetime` is only the time left when
+// they were last sent. The `:expires` time doesn't go stale. The file is read
+// rather than mmap'd since udhcpd truncates it in place.
+//
+// All of the current leases are reported as added when a file is first
+// watched.
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include <ei.h>
+
+// Messages can be larger than {:packet, 2} allows with hundreds of leases
+#define PACKET_HEADER_LEN 4
+#define MAX_REQUEST_LEN 4096
+
+// Limit on watched interfaces. Watching more fails with EBUSY.
+#define MAX_WATCHES 32
+
+// udhcpd's struct dyn_lease after an 8-byte timestamp
+#define LEASE_FILE_HEADER_LEN 8
+#define LEASE_RECORD_LEN 36
+#define LEASE_HOSTNAME_LEN 20
+
+// Leases are at most this large (udhcpd's max_leases is 235 by default)
+#define MAX_LEASE_FILE_LEN (1024 * 1024)
+
+// Expiration times computed from different saves can be off by a second
+#define EXPIRES_SLOP 1
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+struct lease
+{
+    uint32_t leasetime;
+    int64_t expires;
+    unsigned char nip[4];
+    unsigned char mac[6];
+    char hostname[LEASE_HOSTNAME_LEN + 1];
+};
+
+struct watch
+{
+    int in_use;
+    int wd;
+    char ifname[IF_NAMESIZE];
+    char path[PATH_MAX];
+    const char *filename;
+
+    // Sorted by lease_compare()
+    struct lease *leases;
+    int count;
+};
+
+struct lease_watcher
+{
+    int inotify_fd;
+
+    char request[MAX_REQUEST_LEN + PACKET_HEADER_LEN];
+    size_t request_len;
+
+    struct watch watches[MAX_WATCHES];
+
+    ei_x_buff buff;
+};
+
+static void write_packet(const char *data, int len)
+{
+    uint32_t be_len = htonl(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int lease_compare(const void *a, const void *b)
+{
+    const struct lease *la = a;
+    const struct lease *lb = b;
+    int rc = memcmp(la->nip, lb->nip, sizeof(la->nip));
+    if (rc == 0)
+        rc = memcmp(la->mac, lb->mac, sizeof(la->mac));
+    return rc;
+}
+
+static int lease_renewed(const struct lease *old_lease, const struct lease *new_lease)
+{
+    int64_t diff = new_lease->expires - old_lease->expires;
+    return diff > EXPIRES_SLOP || diff < -EXPIRES_SLOP ||
+           strcmp(new_lease->hostname, old_lease->hostname) != 0;
+}
+
+// Read and sort the leases in a file. A missing file has no leases.
+static int read_leases(const char *path, struct lease **leases)
+{
+    *leases = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size > MAX_LEASE_FILE_LEN)
+    {
+        close(fd);
+        return -1;
+    }
+
+    unsigned char *contents = malloc(st.st_size + 1);
+    if (!contents)
+        err(EXIT_FAILURE, "malloc");
+
+    size_t len = 0;
+    for (;;)
+    {
+        ssize_t amount = read(fd, contents + len, st.st_size + 1 - len);
+        if (amount < 0 && errno == EINTR)
+            continue;
+        if (amount <= 0)
+            break;
+
+        len += amount;
+        if (len > (size_t)st.st_size)
+            break;
+    }
+    close(fd);
+
+    if (len < LEASE_FILE_HEADER_LEN)
+    {
+        free(contents);
+        return 0;
+    }
+
+    int64_t written_at = ((int64_t)get32(contents) << 32) | get32(&contents[4]);
+
+    // Ignore a partial record at the end like the Elixir parser does
+    int count = (len - LEASE_FILE_HEADER_LEN) / LEASE_RECORD_LEN;
+    if (count > 0)
+    {
+        *leases = calloc(count, sizeof(struct lease));
+        if (!*leases)
+            err(EXIT_FAILURE, "calloc");
+    }
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        const unsigned char *record = &contents[LEASE_FILE_HEADER_LEN + i * LEASE_RECORD_LEN];
+        struct lease *lease = &(*leases)[i];
+
+        lease->leasetime = get32(record);
+        lease->expires = written_at + lease->leasetime;
+        memcpy(lease->nip, &record[4], 4);
+        memcpy(lease->mac, &record[8], 6);
+        memcpy(lease->hostname, &record[14], LEASE_HOSTNAME_LEN);
+        lease->hostname[LEASE_HOSTNAME_LEN] = '\0';
+    }
+    free(contents);
+
+    qsort(*leases, count, sizeof(struct lease), lease_compare);
+    return count;
+}
+
+static void encode_string(ei_x_buff *buff, const char *str)
+{
+    ei_x_encode_binary(buff, str, strlen(str));
+}
+
+// Match the map from VintageNet.Interface.Udhcpd.parse_leases/1
+static void encode_lease(ei_x_buff *buff, const struct lease *lease)
+{
+    char str[32];
+
+    ei_x_encode_map_header(buff, 5);
+    ei_x_encode_atom(buff, "leasetime");
+    ei_x_encode_ulong(buff, lease->leasetime);
+
+    ei_x_encode_atom(buff, "expires");
+    ei_x_encode_longlong(buff, lease->expires);
+
+    ei_x_encode_atom(buff, "lease_nip");
+    sprintf(str, "%u.%u.%u.%u", lease->nip[0], lease->nip[1], lease->nip[2], lease->nip[3]);
+    encode_string(buff, str);
+
+    // Hex digits aren't zero padded to match Integer.to_string/2
+    ei_x_encode_atom(buff, "lease_mac");
+    sprintf(str, "%X:%X:%X:%X:%X:%X",
+            lease->mac[0], lease->mac[1], lease->mac[2],
+            lease->mac[3], lease->mac[4], lease->mac[5]);
+    encode_string(buff, str);
+
+    ei_x_encode_atom(buff, "hostname");
+    encode_string(buff, lease->hostname);
+}
+
+// Which list a lease goes in when comparing snapshots
+enum lease_change
+{
+    LEASE_ADDED,
+    LEASE_REMOVED,
+    LEASE_RENEWED
+};
+
+// Walk both sorted snapshots and encode one kind of change. Returns the count.
+static int encode_changes(ei_x_buff *buff, enum lease_change kind,
+                          const struct lease *old_leases, int old_count,
+                          const struct lease *new_leases, int new_count)
+{
+    int count = 0;
+    int i = 0;
+    int j = 0;
+    while (i < old_count || j < new_count)
+    {
+        int rc;
+        if (i == old_count)
+            rc = 1;
+        else if (j == new_count)
+            rc = -1;
+        else
+            rc = lease_compare(&old_leases[i], &new_leases[j]);
+
+        if (rc < 0)
+        {
+            if (kind == LEASE_REMOVED)
+            {
+                encode_lease(buff, &old_leases[i]);
+                count++;
+            }
+            i++;
+        }
+        else if (rc > 0)
+        {
+            if (kind == LEASE_ADDED)
+            {
+                encode_lease(buff, &new_leases[j]);
+                count++;
+            }
+            j++;
+        }
+        else
+        {
+            if (kind == LEASE_RENEWED && lease_renewed(&old_leases[i], &new_leases[j]))
+            {
+                encode_lease(buff, &new_leases[j]);
+                count++;
+            }
+            i++;
+            j++;
+        }
+    }
+    return count;
+}
+
+static void send_changes(struct lease_watcher *lw, struct watch *w,
+                         const struct lease *new_leases, int new_count)
+{
+    ei_x_buff *buff = &lw->buff;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 5);
+    ei_x_encode_atom(buff, "leases");
+    encode_string(buff, w->ifname);
+
+    // Each list is encoded to find its length and then again after the header
+    int total = 0;
+    enum lease_change kind;
+    for (kind = LEASE_ADDED; kind <= LEASE_RENEWED; kind++)
+    {
+        int start = buff->index;
+        int count = encode_changes(buff, kind, w->leases, w->count, new_leases, new_count);
+        buff->index = start;
+
+        if (count > 0)
+        {
+            ei_x_encode_list_header(buff, count);
+            encode_changes(buff, kind, w->leases, w->count, new_leases, new_count);
+        }
+        ei_x_encode_empty_list(buff);
+        total += count;
+    }
+
+    debug("%s: %d changes", w->ifname, total);
+    if (total > 0)
+        write_packet(buff->buff, buff->index);
+}
+
+static void send_error(struct lease_watcher *lw, const char *ifname, int error)
+{
+    ei_x_buff *buff = &lw->buff;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 3);
+    ei_x_encode_atom(buff, "error");
+    encode_string(buff, ifname);
+    encode_string(buff, strerror(error));
+    write_packet(buff->buff, buff->index);
+}
+
+static void refresh(struct lease_watcher *lw, struct watch *w)
+{
+    struct lease *leases;
+    int count = read_leases(w->path, &leases);
+    if (count < 0)
+    {
+        // Keep the last leases. udhcpd will save them again.
+        warn("%s", w->path);
+        return;
+    }
+
+    send_changes(lw, w, leases, count);
+
+    free(w->leases);
+    w->leases = leases;
+    w->count = count;
+}
+
+static struct watch *find_watch(struct lease_watcher *lw, const char *ifname)
+{
+    int i;
+    for (i = 0; i < MAX_WATCHES; i++)
+    {
+        if (lw->watches[i].in_use && strcmp(lw->watches[i].ifname, ifname) == 0)
+            return &lw->watches[i];
+    }
+    return NULL;
+}
+
+static void remove_watch(struct lease_watcher *lw, struct watch *w)
+{
+    w->in_use = 0;
+    free(w->leases);
+    w->leases = NULL;
+    w->count = 0;
+
+    // Watches on the same directory share the inotify watch
+    int i;
+    for (i = 0; i < MAX_WATCHES; i++)
+    {
+        if (lw->watches[i].in_use && lw->watches[i].wd == w->wd)
+            return;
+    }
+    inotify_rm_watch(lw->inotify_fd, w->wd);
+}
+
+static void add_watch(struct lease_watcher *lw, const char *ifname, const char *path)
+{
+    struct watch *w = find_watch(lw, ifname);
+    if (w)
+        remove_watch(lw, w);
+
+    int i;
+    for (i = 0; i < MAX_WATCHES && !w; i++)
+    {
+        if (!lw->watches[i].in_use)
+            w = &lw->watches[i];
+    }
+    if (!w)
+    {
+        send_error(lw, ifname, EBUSY);
+        return;
+    }
+
+    memset(w, 0, sizeof(*w));
+    strcpy(w->ifname, ifname);
+    strcpy(w->path, path);
+
+    // Watch the directory since the file may not exist yet
+    char *slash = strrchr(w->path, '/');
+    if (slash)
+    {
+        *slash = '\0';
+        w->wd = inotify_add_watch(lw->inotify_fd, w->path[0] ? w->path : "/",
+                                  IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+        *slash = '/';
+        w->filename = slash + 1;
+    }
+    else
+    {
+        w->wd = inotify_add_watch(lw->inotify_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+        w->filename = w->path;
+    }
+
+    if (w->wd < 0)
+    {
+        send_error(lw, ifname, errno);
+        return;
+    }
+
+    w->in_use = 1;
+    refresh(lw, w);
+}
+
+static int inotify_process(struct lease_watcher *lw)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t len = read(lw->inotify_fd, buf, sizeof(buf));
+    if (len < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(inotify)");
+    }
+
+    const char *p = buf;
+    while (p < buf + len)
+    {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->len == 0)
+            continue;
+
+        int i;
+        for (i = 0; i < MAX_WATCHES; i++)
+        {
+            struct watch *w = &lw->watches[i];
+            if (w->in_use && w->wd == event->wd && strcmp(w->filename, event->name) == 0)
+                refresh(lw, w);
+        }
+    }
+    return 0;
+}
+
+static int decode_string(const char *buf, int *index, char *str, size_t max_len)
+{
+    int type;
+    int size;
+    long len;
+    if (ei_get_type(buf, index, &type, &size) < 0 || size < 0 || (size_t)size >= max_len ||
+        ei_decode_binary(buf, index, str, &len) < 0)
+        return -1;
+
+    str[len] = '\0';
+    return 0;
+}
+
+static void process_request(struct lease_watcher *lw, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    char cmd[MAXATOMLEN];
+    char ifname[IF_NAMESIZE];
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+        ei_decode_atom(buf, &index, cmd) < 0 ||
+        decode_string(buf, &index, ifname, sizeof(ifname)) < 0)
+        errx(EXIT_FAILURE, "Expecting {:watch, ifname, path} or {:unwatch, ifname} from Elixir");
+
+    if (strcmp(cmd, "watch") == 0 && arity == 3)
+    {
+        char path[PATH_MAX];
+        if (decode_string(buf, &index, path, sizeof(path)) < 0)
+            errx(EXIT_FAILURE, "Expecting {:watch, ifname, path} from Elixir");
+
+        add_watch(lw, ifname, path);
+    }
+    else if (strcmp(cmd, "unwatch") == 0 && arity == 2)
+    {
+        struct watch *w = find_watch(lw, ifname);
+        if (w)
+            remove_watch(lw, w);
+    }
+    else
+    {
+        errx(EXIT_FAILURE, "Unexpected command from Elixir: %s", cmd);
+    }
+}
+
+static int stdin_process(struct lease_watcher *lw)
+{
+    ssize_t amount = read(STDIN_FILENO, lw->request + lw->request_len, sizeof(lw->request) - lw->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    lw->request_len += amount;
+
+    size_t offset = 0;
+    while (lw->request_len - offset >= PACKET_HEADER_LEN)
+    {
+        uint32_t be_len;
+        memcpy(&be_len, &lw->request[offset], sizeof(be_len));
+        size_t len = ntohl(be_len);
+        if (len > MAX_REQUEST_LEN)
+            errx(EXIT_FAILURE, "Request too large: %zu bytes", len);
+        if (lw->request_len - offset < len + PACKET_HEADER_LEN)
+            break;
+
+        process_request(lw, &lw->request[offset + PACKET_HEADER_LEN]);
+        offset += len + PACKET_HEADER_LEN;
+    }
+
+    lw->request_len -= offset;
+    memmove(lw->request, &lw->request[offset], lw->request_len);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct lease_watcher lw;
+
+    lw.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (lw.inotify_fd < 0)
+        err(EXIT_FAILURE, "inotify_init1");
+
+    if (ei_x_new(&lw.buff) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+
+    for (;;)
+    {
+        struct pollfd fdset[2];
+
+        fdset[0].fd = lw.inotify_fd;
+        fdset[0].events = POLLIN;
+        fdset[0].revents = 0;
+
+        fdset[1].fd = STDIN_FILENO;
+        fdset[1].events = POLLIN;
+        fdset[1].revents = 0;
+
+        int rc = poll(fdset, 2, -1);
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "poll");
+        }
+
+        // Handle requests first so that changes to unwatched files are dropped
+        if ((fdset[1].revents & (POLLIN | POLLHUP)) && stdin_process(&lw) < 0)
+            break;
+        if (fdset[0].revents & POLLIN)
+            inotify_process(&lw);
+    }
+
+    close(lw.inotify_fd);
+    ei_x_free(&lw.buff);
+    return 0;
+}
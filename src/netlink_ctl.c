@@ -0,0 +1,860 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Apply batches of link, address and routing table changes for Elixir
+//
+// Requests are lists of `{operation, map}` tuples. All operations in a request
+// are sent to the kernel in one netlink write and a list with one result per
+// operation is returned. Results are `:ok` or `{:error, reason_string}`.
+//
+// Address flushes need to know what addresses exist, so the first flush in a
+// request dumps them. A flush turns into one RTM_DELADDR per matching address
+// and fails if any of them fail.
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <libmnl/libmnl.h>
+#include <net/if.h>
+#include <linux/fib_rules.h>
+#include <linux/if.h>
+#include <linux/if_addr.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <ei.h>
+
+// Erlang's {:packet, 2} framing limits each message to 64 KB
+#define MAX_PACKET_LEN 65535
+
+// How long to wait for the kernel to respond. Elixir doesn't time out
+// requests since it could end up applying them twice, so this bounds them.
+#define RECV_TIMEOUT_SECS 10
+
+// Limit on operations per request. Elixir splits larger batches.
+#define MAX_OPS 256
+
+// Limit on netlink messages per request. Flushes can expand to more than one.
+// Every message fits in MAX_MSG_LEN bytes.
+#define MAX_MSGS 512
+#define MAX_MSG_LEN 256
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+struct op_result
+{
+    int error; // 0 on success, errno on failure
+};
+
+// Netlink message sent for an operation. Sequence numbers are consecutive
+// starting at first_seq, so the ack for a message can be found by index.
+struct msg_state
+{
+    int op;
+    int acked;
+};
+
+// Address from a dump for flushing
+struct dumped_addr
+{
+    int ifindex;
+    unsigned char family;
+    unsigned char prefixlen;
+    unsigned char local[16];
+    int local_len;
+    unsigned char address[16];
+    int address_len;
+    char label[IF_NAMESIZE];
+};
+
+struct netlink_ctl
+{
+    struct mnl_socket *nl;
+    unsigned int portid;
+    unsigned int seq;
+
+    // Requests from Elixir
+    char request[MAX_PACKET_LEN + 2];
+    size_t request_len;
+
+    // Netlink messages to send and acks to receive
+    char sendbuf[MAX_MSGS * MAX_MSG_LEN];
+    char recvbuf[MNL_SOCKET_BUFFER_SIZE];
+    struct mnl_nlmsg_batch *batch;
+
+    struct op_result results[MAX_OPS];
+    int op_count;
+
+    struct msg_state msgs[MAX_MSGS];
+    int msg_count;
+    unsigned int first_seq;
+
+    // Addresses for flushing. These are dumped once per request.
+    struct dumped_addr *addrs;
+    int addr_count;
+    int addr_capacity;
+    int addrs_valid;
+
+    ei_x_buff response;
+};
+
+// Decoded fields from a request map. Zero-length addresses aren't set.
+struct op_args
+{
+    char ifname[IF_NAMESIZE];
+    unsigned char dst[16];
+    int dst_len_bytes;
+    unsigned char gateway[16];
+    int gateway_len;
+    unsigned char prefsrc[16];
+    int prefsrc_len;
+    unsigned char src[16];
+    int src_len_bytes;
+    long dst_len;
+    long src_len;
+    long priority;
+    long table;
+    long scope;
+    int has_scope;
+    int has_priority;
+    unsigned char address[16];
+    int address_len;
+    unsigned char broadcast[16];
+    int broadcast_len;
+    long prefix_len;
+    char label[IF_NAMESIZE];
+    int up;
+};
+
+static void ctl_init(struct netlink_ctl *ctl)
+{
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->seq = 1;
+
+    ctl->nl = mnl_socket_open(NETLINK_ROUTE);
+    if (!ctl->nl)
+        err(EXIT_FAILURE, "mnl_socket_open (NETLINK_ROUTE)");
+
+    if (mnl_socket_bind(ctl->nl, 0, MNL_SOCKET_AUTOPID) < 0)
+        err(EXIT_FAILURE, "mnl_socket_bind");
+
+    ctl->portid = mnl_socket_get_portid(ctl->nl);
+
+    struct timeval timeout = {RECV_TIMEOUT_SECS, 0};
+    if (setsockopt(mnl_socket_get_fd(ctl->nl), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+        err(EXIT_FAILURE, "setsockopt(SO_RCVTIMEO)");
+
+#ifdef NETLINK_CAP_ACK
+    // Don't echo requests in error acks since batches can have a lot of them.
+    // This is only an optimization, so ignore errors from old kernels.
+    int one = 1;
+    (void) mnl_socket_setsockopt(ctl->nl, NETLINK_CAP_ACK, &one, sizeof(one));
+#endif
+
+    if (ei_x_new(&ctl->response) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+}
+
+static void ctl_cleanup(struct netlink_ctl *ctl)
+{
+    mnl_socket_close(ctl->nl);
+    ctl->nl = NULL;
+    ei_x_free(&ctl->response);
+    free(ctl->addrs);
+    ctl->addrs = NULL;
+}
+
+static void write_packet(const char *data, int len)
+{
+    if (len > MAX_PACKET_LEN)
+        errx(EXIT_FAILURE, "response too large to send: %d bytes", len);
+
+    uint16_t be_len = htons(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static int decode_address(const char *buf, int *index, unsigned char *addr, int *addr_len)
+{
+    int arity;
+    if (ei_decode_tuple_header(buf, index, &arity) < 0)
+        return -1;
+
+    int i;
+    switch (arity)
+    {
+    case 4:
+        for (i = 0; i < 4; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 255)
+                return -1;
+            addr[i] = v;
+        }
+        *addr_len = 4;
+        return 0;
+
+    case 8:
+        for (i = 0; i < 8; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 65535)
+                return -1;
+            addr[2 * i] = v >> 8;
+            addr[2 * i + 1] = v & 0xff;
+        }
+        *addr_len = 16;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+static int decode_scope(const char *buf, int *index, long *scope)
+{
+    char atom[MAXATOMLEN];
+    if (ei_decode_atom(buf, index, atom) < 0)
+        return -1;
+
+    if (strcmp(atom, "universe") == 0)
+        *scope = RT_SCOPE_UNIVERSE;
+    else if (strcmp(atom, "link") == 0)
+        *scope = RT_SCOPE_LINK;
+    else if (strcmp(atom, "host") == 0)
+        *scope = RT_SCOPE_HOST;
+    else
+        return -1;
+
+    return 0;
+}
+
+static int decode_name(const char *buf, int *index, char *name)
+{
+    int type;
+    int size;
+    long len;
+    if (ei_get_type(buf, index, &type, &size) < 0 || size >= IF_NAMESIZE)
+        return -1;
+    return ei_decode_binary(buf, index, name, &len);
+}
+
+static int decode_args(const char *buf, int *index, struct op_args *args)
+{
+    int arity;
+    if (ei_decode_map_header(buf, index, &arity) < 0)
+        return -1;
+
+    memset(args, 0, sizeof(*args));
+    args->table = RT_TABLE_MAIN;
+    args->scope = RT_SCOPE_UNIVERSE;
+
+    int i;
+    for (i = 0; i < arity; i++)
+    {
+        char key[MAXATOMLEN];
+        if (ei_decode_atom(buf, index, key) < 0)
+            return -1;
+
+        int rc;
+        if (strcmp(key, "ifname") == 0)
+            rc = decode_name(buf, index, args->ifname);
+        else if (strcmp(key, "label") == 0)
+            rc = decode_name(buf, index, args->label);
+        else if (strcmp(key, "address") == 0)
+            rc = decode_address(buf, index, args->address, &args->address_len);
+        else if (strcmp(key, "broadcast") == 0)
+            rc = decode_address(buf, index, args->broadcast, &args->broadcast_len);
+        else if (strcmp(key, "prefix_len") == 0)
+            rc = ei_decode_long(buf, index, &args->prefix_len);
+        else if (strcmp(key, "up") == 0)
+            rc = ei_decode_boolean(buf, index, &args->up);
+        else if (strcmp(key, "dst") == 0)
+            rc = decode_address(buf, index, args->dst, &args->dst_len_bytes);
+        else if (strcmp(key, "gateway") == 0)
+            rc = decode_address(buf, index, args->gateway, &args->gateway_len);
+        else if (strcmp(key, "prefsrc") == 0)
+            rc = decode_address(buf, index, args->prefsrc, &args->prefsrc_len);
+        else if (strcmp(key, "src") == 0)
+            rc = decode_address(buf, index, args->src, &args->src_len_bytes);
+        else if (strcmp(key, "dst_len") == 0)
+            rc = ei_decode_long(buf, index, &args->dst_len);
+        else if (strcmp(key, "src_len") == 0)
+            rc = ei_decode_long(buf, index, &args->src_len);
+        else if (strcmp(key, "table") == 0)
+            rc = ei_decode_long(buf, index, &args->table);
+        else if (strcmp(key, "scope") == 0)
+        {
+            rc = decode_scope(buf, index, &args->scope);
+            args->has_scope = 1;
+        }
+        else if (strcmp(key, "priority") == 0)
+        {
+            rc = ei_decode_long(buf, index, &args->priority);
+            args->has_priority = 1;
+        }
+        else
+        {
+            debug("Ignoring unknown key: %s", key);
+            rc = ei_skip_term(buf, index);
+        }
+
+        if (rc < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static unsigned char family_for_len(int len)
+{
+    return len == 16 ? AF_INET6 : AF_INET;
+}
+
+static int build_route(struct nlmsghdr *nlh, const struct op_args *args, int is_new)
+{
+    nlh->nlmsg_type = is_new ? RTM_NEWROUTE : RTM_DELROUTE;
+    if (is_new)
+        nlh->nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+
+    struct rtmsg *rtm = mnl_nlmsg_put_extra_header(nlh, sizeof(struct rtmsg));
+    rtm->rtm_family = family_for_len(args->dst_len_bytes ? args->dst_len_bytes : args->gateway_len);
+    rtm->rtm_dst_len = args->dst_len;
+    rtm->rtm_table = args->table < 256 ? args->table : RT_TABLE_UNSPEC;
+
+    // These defaults are the same as what the ip command uses
+    if (is_new)
+    {
+        rtm->rtm_protocol = RTPROT_BOOT;
+        rtm->rtm_type = RTN_UNICAST;
+        if (args->has_scope)
+            rtm->rtm_scope = args->scope;
+        else
+            rtm->rtm_scope = args->gateway_len ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+    }
+    else
+    {
+        rtm->rtm_scope = args->has_scope ? args->scope : RT_SCOPE_NOWHERE;
+    }
+
+    mnl_attr_put_u32(nlh, RTA_TABLE, args->table);
+
+    if (args->ifname[0])
+    {
+        unsigned int ifindex = if_nametoindex(args->ifname);
+        if (ifindex == 0)
+            return -ENODEV;
+        mnl_attr_put_u32(nlh, RTA_OIF, ifindex);
+    }
+    if (args->dst_len_bytes)
+        mnl_attr_put(nlh, RTA_DST, args->dst_len_bytes, args->dst);
+    if (args->gateway_len)
+        mnl_attr_put(nlh, RTA_GATEWAY, args->gateway_len, args->gateway);
+    if (args->prefsrc_len)
+        mnl_attr_put(nlh, RTA_PREFSRC, args->prefsrc_len, args->prefsrc);
+    if (args->has_priority)
+        mnl_attr_put_u32(nlh, RTA_PRIORITY, args->priority);
+
+    return 0;
+}
+
+static int build_rule(struct nlmsghdr *nlh, const struct op_args *args, int is_new)
+{
+    nlh->nlmsg_type = is_new ? RTM_NEWRULE : RTM_DELRULE;
+    if (is_new)
+        nlh->nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+
+    struct fib_rule_hdr *frh = mnl_nlmsg_put_extra_header(nlh, sizeof(struct fib_rule_hdr));
+    frh->family = family_for_len(args->src_len_bytes);
+    frh->src_len = args->src_len;
+    frh->table = args->table < 256 ? args->table : RT_TABLE_UNSPEC;
+    frh->action = FR_ACT_TO_TBL;
+
+    mnl_attr_put_u32(nlh, FRA_TABLE, args->table);
+    if (args->src_len_bytes)
+        mnl_attr_put(nlh, FRA_SRC, args->src_len_bytes, args->src);
+    if (args->has_priority)
+        mnl_attr_put_u32(nlh, FRA_PRIORITY, args->priority);
+
+    return 0;
+}
+
+static int build_link(struct nlmsghdr *nlh, const struct op_args *args)
+{
+    // RTM_NEWLINK with ifi_change is how the ip command sets flags
+    nlh->nlmsg_type = RTM_NEWLINK;
+
+    unsigned int ifindex = if_nametoindex(args->ifname);
+    if (ifindex == 0)
+        return -ENODEV;
+
+    struct ifinfomsg *ifm = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifinfomsg));
+    ifm->ifi_family = AF_UNSPEC;
+    ifm->ifi_index = ifindex;
+    ifm->ifi_change = IFF_UP;
+    ifm->ifi_flags = args->up ? IFF_UP : 0;
+    return 0;
+}
+
+static int build_addr(struct nlmsghdr *nlh, const struct op_args *args, int is_new)
+{
+    nlh->nlmsg_type = is_new ? RTM_NEWADDR : RTM_DELADDR;
+    if (is_new)
+        nlh->nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+
+    if (args->address_len == 0)
+        return -EINVAL;
+
+    unsigned int ifindex = if_nametoindex(args->ifname);
+    if (ifindex == 0)
+        return -ENODEV;
+
+    struct ifaddrmsg *ifa = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifaddrmsg));
+    ifa->ifa_family = family_for_len(args->address_len);
+    ifa->ifa_prefixlen = args->prefix_len;
+    ifa->ifa_scope = RT_SCOPE_UNIVERSE;
+    ifa->ifa_index = ifindex;
+
+    // The ip command sets both of these when there's no peer address
+    mnl_attr_put(nlh, IFA_LOCAL, args->address_len, args->address);
+    mnl_attr_put(nlh, IFA_ADDRESS, args->address_len, args->address);
+    if (args->broadcast_len)
+        mnl_attr_put(nlh, IFA_BROADCAST, args->broadcast_len, args->broadcast);
+    if (args->label[0])
+        mnl_attr_put_strz(nlh, IFA_LABEL, args->label);
+
+    return 0;
+}
+
+static struct nlmsghdr *start_message(struct netlink_ctl *ctl)
+{
+    if (ctl->msg_count == MAX_MSGS)
+        return NULL;
+
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(mnl_nlmsg_batch_current(ctl->batch));
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    return nlh;
+}
+
+static void finish_message(struct netlink_ctl *ctl, struct nlmsghdr *nlh, int op)
+{
+    nlh->nlmsg_seq = ctl->first_seq + ctl->msg_count;
+    if (!mnl_nlmsg_batch_next(ctl->batch))
+        errx(EXIT_FAILURE, "Batch buffer too small");
+
+    struct msg_state *msg = &ctl->msgs[ctl->msg_count++];
+    msg->op = op;
+    msg->acked = 0;
+}
+
+static int collect_ifa_attrs(const struct nlattr *attr, void *data)
+{
+    const struct nlattr **tb = data;
+    int type = mnl_attr_get_type(attr);
+
+    if (mnl_attr_type_valid(attr, IFA_MAX) < 0)
+        return MNL_CB_OK;
+
+    if (type == IFA_LABEL && mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) < 0)
+        return MNL_CB_OK;
+
+    tb[type] = attr;
+    return MNL_CB_OK;
+}
+
+static void copy_addr_attr(unsigned char *dest, int *len, const struct nlattr *attr)
+{
+    if (attr && mnl_attr_get_payload_len(attr) <= 16)
+    {
+        *len = mnl_attr_get_payload_len(attr);
+        memcpy(dest, mnl_attr_get_payload(attr), *len);
+    }
+}
+
+static int dump_addr_cb(const struct nlmsghdr *nlh, void *data)
+{
+    struct netlink_ctl *ctl = (struct netlink_ctl *)data;
+    const struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
+    struct nlattr *tb[IFA_MAX + 1];
+    memset(tb, 0, sizeof(tb));
+
+    if (nlh->nlmsg_type != RTM_NEWADDR ||
+        mnl_attr_parse(nlh, sizeof(*ifa), collect_ifa_attrs, tb) != MNL_CB_OK)
+        return MNL_CB_OK;
+
+    if (ctl->addr_count == ctl->addr_capacity)
+    {
+        ctl->addr_capacity = ctl->addr_capacity ? ctl->addr_capacity * 2 : 16;
+        ctl->addrs = realloc(ctl->addrs, ctl->addr_capacity * sizeof(struct dumped_addr));
+        if (!ctl->addrs)
+            err(EXIT_FAILURE, "realloc");
+    }
+
+    struct dumped_addr *addr = &ctl->addrs[ctl->addr_count++];
+    memset(addr, 0, sizeof(*addr));
+    addr->ifindex = ifa->ifa_index;
+    addr->family = ifa->ifa_family;
+    addr->prefixlen = ifa->ifa_prefixlen;
+    copy_addr_attr(addr->local, &addr->local_len, tb[IFA_LOCAL]);
+    copy_addr_attr(addr->address, &addr->address_len, tb[IFA_ADDRESS]);
+    if (tb[IFA_LABEL])
+        strncpy(addr->label, mnl_attr_get_str(tb[IFA_LABEL]), sizeof(addr->label) - 1);
+
+    return MNL_CB_OK;
+}
+
+// Get every address on the system. Returns 0 or a negative errno.
+static int dump_addrs(struct netlink_ctl *ctl)
+{
+    char buf[MNL_NLMSG_HDRLEN + MNL_ALIGN(sizeof(struct ifaddrmsg))];
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+    nlh->nlmsg_type = RTM_GETADDR;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh->nlmsg_seq = ctl->seq++;
+
+    struct ifaddrmsg *ifa = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifaddrmsg));
+    ifa->ifa_family = AF_UNSPEC;
+
+    if (mnl_socket_sendto(ctl->nl, nlh, nlh->nlmsg_len) < 0)
+        err(EXIT_FAILURE, "mnl_socket_sendto(RTM_GETADDR)");
+
+    ctl->addr_count = 0;
+    int rc;
+    do
+    {
+        int bytecount = mnl_socket_recvfrom(ctl->nl, ctl->recvbuf, sizeof(ctl->recvbuf));
+        if (bytecount < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return -ETIMEDOUT;
+        if (bytecount < 0)
+            err(EXIT_FAILURE, "mnl_socket_recvfrom");
+
+        rc = mnl_cb_run(ctl->recvbuf, bytecount, nlh->nlmsg_seq, ctl->portid, dump_addr_cb, ctl);
+    } while (rc > MNL_CB_STOP);
+
+    if (rc == MNL_CB_ERROR)
+        return -errno;
+
+    ctl->addrs_valid = 1;
+    return 0;
+}
+
+// Delete the addresses on an interface with the specified label. Addresses
+// without labels are labeled with the interface name like the ip command does.
+static int build_flush(struct netlink_ctl *ctl, const struct op_args *args, int op)
+{
+    unsigned int ifindex = if_nametoindex(args->ifname);
+    if (ifindex == 0)
+        return -ENODEV;
+
+    if (!ctl->addrs_valid)
+    {
+        int rc = dump_addrs(ctl);
+        if (rc < 0)
+            return rc;
+    }
+
+    int i;
+    for (i = 0; i < ctl->addr_count; i++)
+    {
+        struct dumped_addr *addr = &ctl->addrs[i];
+        const char *label = addr->label[0] ? addr->label : args->ifname;
+        if (addr->ifindex != (int)ifindex || (args->label[0] && strcmp(label, args->label) != 0))
+            continue;
+
+        struct nlmsghdr *nlh = start_message(ctl);
+        if (!nlh)
+            return -ENOSPC;
+
+        nlh->nlmsg_type = RTM_DELADDR;
+        struct ifaddrmsg *ifa = mnl_nlmsg_put_extra_header(nlh, sizeof(struct ifaddrmsg));
+        ifa->ifa_family = addr->family;
+        ifa->ifa_prefixlen = addr->prefixlen;
+        ifa->ifa_index = ifindex;
+        if (addr->local_len)
+            mnl_attr_put(nlh, IFA_LOCAL, addr->local_len, addr->local);
+        if (addr->address_len)
+            mnl_attr_put(nlh, IFA_ADDRESS, addr->address_len, addr->address);
+
+        finish_message(ctl, nlh, op);
+
+        // Don't delete it again if there's another flush in the request
+        addr->ifindex = 0;
+    }
+    return 0;
+}
+
+// Encode one operation into the batch. Returns 0 or a negative errno.
+static int build_op(struct netlink_ctl *ctl, int op_index, const char *buf, int *index)
+{
+    int arity;
+    char op[MAXATOMLEN];
+    struct op_args args;
+    if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity != 2 ||
+        ei_decode_atom(buf, index, op) < 0 ||
+        decode_args(buf, index, &args) < 0)
+        errx(EXIT_FAILURE, "Expecting {op, map} from Elixir");
+
+    if (strcmp(op, "flushaddr") == 0)
+        return build_flush(ctl, &args, op_index);
+
+    struct nlmsghdr *nlh = start_message(ctl);
+    if (!nlh)
+        return -ENOSPC;
+
+    int rc;
+    if (strcmp(op, "newroute") == 0)
+        rc = build_route(nlh, &args, 1);
+    else if (strcmp(op, "delroute") == 0)
+        rc = build_route(nlh, &args, 0);
+    else if (strcmp(op, "newrule") == 0)
+        rc = build_rule(nlh, &args, 1);
+    else if (strcmp(op, "delrule") == 0)
+        rc = build_rule(nlh, &args, 0);
+    else if (strcmp(op, "setlink") == 0)
+        rc = build_link(nlh, &args);
+    else if (strcmp(op, "newaddr") == 0)
+        rc = build_addr(nlh, &args, 1);
+    else if (strcmp(op, "deladdr") == 0)
+        rc = build_addr(nlh, &args, 0);
+    else
+        rc = -EOPNOTSUPP;
+
+    if (rc == 0)
+        finish_message(ctl, nlh, op_index);
+    return rc;
+}
+
+static int ack_cb(const struct nlmsghdr *nlh, void *data)
+{
+    // Only NLMSG_ERROR messages are expected and those go to error_cb
+    return MNL_CB_OK;
+}
+
+static int error_cb(const struct nlmsghdr *nlh, void *data)
+{
+    struct netlink_ctl *ctl = (struct netlink_ctl *)data;
+    const struct nlmsgerr *e = mnl_nlmsg_get_payload(nlh);
+
+    unsigned int i = nlh->nlmsg_seq - ctl->first_seq;
+    if (i < (unsigned int)ctl->msg_count && !ctl->msgs[i].acked)
+    {
+        struct msg_state *msg = &ctl->msgs[i];
+        struct op_result *result = &ctl->results[msg->op];
+        msg->acked = 1;
+
+        // Report the first failure for operations with more than one message
+        if (result->error == 0)
+            result->error = -e->error;
+    }
+    return MNL_CB_OK;
+}
+
+static int outstanding_acks(struct netlink_ctl *ctl)
+{
+    int count = 0;
+    int i;
+    for (i = 0; i < ctl->msg_count; i++)
+    {
+        if (!ctl->msgs[i].acked)
+            count++;
+    }
+    return count;
+}
+
+// Sequence numbers aren't reused, so late acks for these are ignored
+static void fail_outstanding(struct netlink_ctl *ctl, int error)
+{
+    int i;
+    for (i = 0; i < ctl->msg_count; i++)
+    {
+        struct msg_state *msg = &ctl->msgs[i];
+        if (!msg->acked)
+        {
+            msg->acked = 1;
+            if (ctl->results[msg->op].error == 0)
+                ctl->results[msg->op].error = error;
+        }
+    }
+}
+
+static void wait_for_acks(struct netlink_ctl *ctl)
+{
+    mnl_cb_t cb_ctl[NLMSG_MIN_TYPE];
+    memset(cb_ctl, 0, sizeof(cb_ctl));
+    cb_ctl[NLMSG_ERROR] = error_cb;
+
+    while (outstanding_acks(ctl) > 0)
+    {
+        int bytecount = mnl_socket_recvfrom(ctl->nl, ctl->recvbuf, sizeof(ctl->recvbuf));
+        if (bytecount < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            warnx("Timed out waiting for %d acks", outstanding_acks(ctl));
+            fail_outstanding(ctl, ETIMEDOUT);
+            return;
+        }
+        if (bytecount < 0)
+            err(EXIT_FAILURE, "mnl_socket_recvfrom");
+
+        // Pass seq 0 since the acks are for a range of sequence numbers
+        if (mnl_cb_run2(ctl->recvbuf, bytecount, 0, ctl->portid, ack_cb, ctl, cb_ctl, NLMSG_MIN_TYPE) == MNL_CB_ERROR)
+            err(EXIT_FAILURE, "mnl_cb_run2");
+    }
+}
+
+static void encode_result(ei_x_buff *buff, const struct op_result *result)
+{
+    if (result->error == 0)
+    {
+        ei_x_encode_atom(buff, "ok");
+    }
+    else
+    {
+        const char *reason = strerror(result->error);
+        ei_x_encode_tuple_header(buff, 2);
+        ei_x_encode_atom(buff, "error");
+        ei_x_encode_binary(buff, reason, strlen(reason));
+    }
+}
+
+static void process_request(struct netlink_ctl *ctl, const char *buf)
+{
+    int index = 0;
+    int version;
+    int count;
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_list_header(buf, &index, &count) < 0 ||
+        count > MAX_OPS)
+        errx(EXIT_FAILURE, "Expecting a list of up to %d operations", MAX_OPS);
+
+    // Leave room past the limit since messages are built before the batch
+    // checks their size
+    ctl->batch = mnl_nlmsg_batch_start(ctl->sendbuf, sizeof(ctl->sendbuf) - MAX_MSG_LEN);
+    ctl->op_count = count;
+    ctl->msg_count = 0;
+    ctl->addrs_valid = 0;
+
+    // Reserve sequence numbers for the batch so that dumps don't use them
+    ctl->first_seq = ctl->seq;
+    ctl->seq += MAX_MSGS;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        // Failures are reported without sending anything to the kernel
+        int rc = build_op(ctl, i, buf, &index);
+        ctl->results[i].error = rc < 0 ? -rc : 0;
+    }
+
+    // Everything goes in one write and the kernel applies them in order
+    if (!mnl_nlmsg_batch_is_empty(ctl->batch) &&
+        mnl_socket_sendto(ctl->nl, mnl_nlmsg_batch_head(ctl->batch), mnl_nlmsg_batch_size(ctl->batch)) < 0)
+        err(EXIT_FAILURE, "mnl_socket_sendto");
+
+    mnl_nlmsg_batch_stop(ctl->batch);
+    ctl->batch = NULL;
+
+    wait_for_acks(ctl);
+
+    ctl->response.index = 0;
+    ei_x_encode_version(&ctl->response);
+    if (count > 0)
+        ei_x_encode_list_header(&ctl->response, count);
+    for (i = 0; i < count; i++)
+        encode_result(&ctl->response, &ctl->results[i]);
+    ei_x_encode_empty_list(&ctl->response);
+
+    write_packet(ctl->response.buff, ctl->response.index);
+}
+
+static int stdin_process(struct netlink_ctl *ctl)
+{
+    ssize_t amount = read(STDIN_FILENO, ctl->request + ctl->request_len, sizeof(ctl->request) - ctl->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    ctl->request_len += amount;
+
+    size_t offset = 0;
+    while (ctl->request_len - offset >= 2)
+    {
+        size_t len = ((unsigned char)ctl->request[offset] << 8) | (unsigned char)ctl->request[offset + 1];
+        if (ctl->request_len - offset < len + 2)
+            break;
+
+        process_request(ctl, &ctl->request[offset + 2]);
+        offset += len + 2;
+    }
+
+    ctl->request_len -= offset;
+    memmove(ctl->request, &ctl->request[offset], ctl->request_len);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct netlink_ctl ctl;
+    ctl_init(&ctl);
+
+    for (;;)
+    {
+        struct pollfd fdset[1];
+
+        fdset[0].fd = STDIN_FILENO;
+        fdset[0].events = POLLIN;
+        fdset[0].revents = 0;
+
+        int rc = poll(fdset, 1, -1);
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "poll");
+        }
+
+        if ((fdset[0].revents & (POLLIN | POLLHUP)) && stdin_process(&ctl) < 0)
+            break;
+    }
+
+    ctl_cleanup(&ctl);
+    return 0;
+}
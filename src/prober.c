@@ -0,0 +1,660 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Check Internet connectivity for Elixir by probing several hosts at once
+//
+// Requests are `{:probe, id, ifname, timeout_ms, targets}` where each target
+// is `{address, port}` for a TCP connection or `{address, :icmp}` for an ICMP
+// echo using an unprivileged ping socket. Every target is started right away
+// on a non-blocking socket bound to the interface. A refused TCP connection
+// counts as a success since the host was reached.
+//
+// The response is `{id, :ok | :error, results}` and is sent as soon as any
+// target succeeds or once they've all failed or timed out. `results` has one
+// entry per target in order: `{:ok, rtt_microseconds}`, `{:error, reason}` or
+// `:cancelled` for targets that were still running when a different one
+// succeeded. Requests from different interfaces can be in progress at the same
+// time.
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <asm/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <ei.h>
+
+// Erlang's {:packet, 2} framing limits each message to 64 KB
+#define MAX_PACKET_LEN 65535
+
+// Limits on requests in progress and targets per request. Requests over the
+// limit fail with EBUSY.
+#define MAX_PROBES 32
+#define MAX_TARGETS 8
+
+#define ICMP_ECHO_REQUEST 8
+#define ICMP_ECHO_REPLY 0
+#define ICMP6_ECHO_REQUEST 128
+#define ICMP6_ECHO_REPLY 129
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+enum target_state
+{
+    TARGET_RUNNING,
+    TARGET_OK,
+    TARGET_FAILED
+};
+
+struct target
+{
+    int fd;
+    int icmp;
+    uint16_t icmp_seq;
+    unsigned char family;
+    unsigned char address[16];
+    unsigned int port;
+
+    enum target_state state;
+    int error;
+    int64_t rtt_us;
+};
+
+struct probe
+{
+    int in_use;
+    long id;
+    int64_t start_us;
+    int64_t deadline_us;
+    int target_count;
+    struct target targets[MAX_TARGETS];
+};
+
+struct prober
+{
+    int epfd;
+    uint16_t icmp_seq;
+
+    char request[MAX_PACKET_LEN + 2];
+    size_t request_len;
+
+    struct probe probes[MAX_PROBES];
+
+    ei_x_buff response;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void prober_init(struct prober *p)
+{
+    memset(p, 0, sizeof(*p));
+
+    p->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (p->epfd < 0)
+        err(EXIT_FAILURE, "epoll_create1");
+
+    // Stdin is registered with a NULL pointer to tell it apart from targets
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) < 0)
+        err(EXIT_FAILURE, "epoll_ctl(stdin)");
+
+    if (ei_x_new(&p->response) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+}
+
+static void write_packet(const char *data, int len)
+{
+    if (len > MAX_PACKET_LEN)
+        errx(EXIT_FAILURE, "response too large to send: %d bytes", len);
+
+    uint16_t be_len = htons(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static int decode_address(const char *buf, int *index, unsigned char *family, unsigned char *addr)
+{
+    int arity;
+    if (ei_decode_tuple_header(buf, index, &arity) < 0)
+        return -1;
+
+    int i;
+    switch (arity)
+    {
+    case 4:
+        for (i = 0; i < 4; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 255)
+                return -1;
+            addr[i] = v;
+        }
+        *family = AF_INET;
+        return 0;
+
+    case 8:
+        for (i = 0; i < 8; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 65535)
+                return -1;
+            addr[2 * i] = v >> 8;
+            addr[2 * i + 1] = v & 0xff;
+        }
+        *family = AF_INET6;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+static int decode_target(const char *buf, int *index, struct target *target)
+{
+    int arity;
+    memset(target, 0, sizeof(*target));
+    target->fd = -1;
+
+    if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity != 2 ||
+        decode_address(buf, index, &target->family, target->address) < 0)
+        return -1;
+
+    char atom[MAXATOMLEN];
+    unsigned long port;
+    if (ei_decode_atom(buf, index, atom) == 0)
+    {
+        if (strcmp(atom, "icmp") != 0)
+            return -1;
+        target->icmp = 1;
+    }
+    else if (ei_decode_ulong(buf, index, &port) == 0 && port > 0 && port <= 65535)
+    {
+        target->port = port;
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static socklen_t target_sockaddr(const struct target *target, struct sockaddr_storage *ss)
+{
+    memset(ss, 0, sizeof(*ss));
+    if (target->family == AF_INET)
+    {
+        struct sockaddr_in *sin = (struct sockaddr_in *)ss;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(target->port);
+        memcpy(&sin->sin_addr, target->address, 4);
+        return sizeof(*sin);
+    }
+    else
+    {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ss;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(target->port);
+        memcpy(&sin6->sin6_addr, target->address, 16);
+        return sizeof(*sin6);
+    }
+}
+
+static void finish_target(struct probe *probe, struct target *target, int error)
+{
+    if (target->fd >= 0)
+    {
+        close(target->fd);
+        target->fd = -1;
+    }
+
+    if (error == 0)
+    {
+        target->state = TARGET_OK;
+        target->rtt_us = now_us() - probe->start_us;
+    }
+    else
+    {
+        target->state = TARGET_FAILED;
+        target->error = error;
+    }
+}
+
+static int send_echo(struct target *target)
+{
+    // The kernel fills in the identifier and checksum for ping sockets
+    unsigned char echo[16];
+    memset(echo, 0, sizeof(echo));
+    echo[0] = target->family == AF_INET ? ICMP_ECHO_REQUEST : ICMP6_ECHO_REQUEST;
+    echo[6] = target->icmp_seq >> 8;
+    echo[7] = target->icmp_seq & 0xff;
+
+    if (send(target->fd, echo, sizeof(echo), 0) < 0)
+        return -errno;
+    return 0;
+}
+
+// Start a connection attempt or echo. Targets that fail or succeed right away
+// are finished here and the rest are added to epoll.
+static void start_target(struct prober *p, struct probe *probe, struct target *target, const char *ifname)
+{
+    int type = target->icmp ? SOCK_DGRAM : SOCK_STREAM;
+    int protocol = 0;
+    if (target->icmp)
+        protocol = target->family == AF_INET ? IPPROTO_ICMP : IPPROTO_ICMPV6;
+
+    target->fd = socket(target->family, type, protocol);
+    if (target->fd < 0)
+    {
+        finish_target(probe, target, errno);
+        return;
+    }
+
+    if (fcntl(target->fd, F_SETFD, FD_CLOEXEC) < 0 ||
+        fcntl(target->fd, F_SETFL, O_NONBLOCK) < 0 ||
+        setsockopt(target->fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname)) < 0)
+    {
+        finish_target(probe, target, errno);
+        return;
+    }
+
+    // Connecting the ICMP socket makes the kernel report unreachable errors
+    struct sockaddr_storage ss;
+    socklen_t ss_len = target_sockaddr(target, &ss);
+    if (connect(target->fd, (struct sockaddr *)&ss, ss_len) < 0)
+    {
+        if (errno != EINPROGRESS)
+        {
+            // A refusal means that the host was reached
+            finish_target(probe, target, errno == ECONNREFUSED ? 0 : errno);
+            return;
+        }
+    }
+    else if (!target->icmp)
+    {
+        // Connected immediately, e.g., over loopback
+        finish_target(probe, target, 0);
+        return;
+    }
+
+    if (target->icmp)
+    {
+        target->icmp_seq = p->icmp_seq++;
+        int rc = send_echo(target);
+        if (rc < 0)
+        {
+            finish_target(probe, target, -rc);
+            return;
+        }
+    }
+
+    struct epoll_event ev;
+    ev.events = target->icmp ? EPOLLIN : EPOLLOUT;
+    ev.data.ptr = target;
+    if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, target->fd, &ev) < 0)
+        err(EXIT_FAILURE, "epoll_ctl");
+}
+
+static int is_echo_reply(const struct target *target, const unsigned char *buf, ssize_t len)
+{
+    unsigned char reply_type = target->family == AF_INET ? ICMP_ECHO_REPLY : ICMP6_ECHO_REPLY;
+    return len >= 8 &&
+           buf[0] == reply_type &&
+           buf[6] == (target->icmp_seq >> 8) &&
+           buf[7] == (target->icmp_seq & 0xff);
+}
+
+static void target_ready(struct probe *probe, struct target *target)
+{
+    int error;
+    if (target->icmp)
+    {
+        unsigned char buf[128];
+        ssize_t len = recv(target->fd, buf, sizeof(buf), 0);
+        if (len < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return;
+            error = errno;
+        }
+        else if (!is_echo_reply(target, buf, len))
+        {
+            debug("Ignoring ICMP type %d", len > 0 ? buf[0] : -1);
+            return;
+        }
+        else
+        {
+            error = 0;
+        }
+    }
+    else
+    {
+        socklen_t len = sizeof(error);
+        if (getsockopt(target->fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+            error = errno;
+
+        if (error == ECONNREFUSED)
+            error = 0;
+    }
+
+    finish_target(probe, target, error);
+}
+
+static void encode_error(ei_x_buff *buff, int error)
+{
+    const char *reason = strerror(error);
+    ei_x_encode_tuple_header(buff, 2);
+    ei_x_encode_atom(buff, "error");
+    ei_x_encode_binary(buff, reason, strlen(reason));
+}
+
+static void send_response(struct prober *p, struct probe *probe, int success)
+{
+    ei_x_buff *buff = &p->response;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 3);
+    ei_x_encode_long(buff, probe->id);
+    ei_x_encode_atom(buff, success ? "ok" : "error");
+
+    ei_x_encode_list_header(buff, probe->target_count);
+    int i;
+    for (i = 0; i < probe->target_count; i++)
+    {
+        struct target *target = &probe->targets[i];
+        switch (target->state)
+        {
+        case TARGET_OK:
+            ei_x_encode_tuple_header(buff, 2);
+            ei_x_encode_atom(buff, "ok");
+            ei_x_encode_longlong(buff, (long long)target->rtt_us);
+            break;
+
+        case TARGET_FAILED:
+            encode_error(buff, target->error);
+            break;
+
+        case TARGET_RUNNING:
+        default:
+            ei_x_encode_atom(buff, "cancelled");
+            break;
+        }
+    }
+    ei_x_encode_empty_list(buff);
+
+    write_packet(buff->buff, buff->index);
+}
+
+static void finish_probe(struct prober *p, struct probe *probe, int success)
+{
+    send_response(p, probe, success);
+
+    // Closing the sockets also removes them from epoll
+    int i;
+    for (i = 0; i < probe->target_count; i++)
+    {
+        if (probe->targets[i].fd >= 0)
+        {
+            close(probe->targets[i].fd);
+            probe->targets[i].fd = -1;
+        }
+    }
+    probe->in_use = 0;
+}
+
+// Send the response if a target succeeded, everything failed or time is up
+static void check_probe(struct prober *p, struct probe *probe, int64_t now)
+{
+    int running = 0;
+    int i;
+    for (i = 0; i < probe->target_count; i++)
+    {
+        switch (probe->targets[i].state)
+        {
+        case TARGET_OK:
+            finish_probe(p, probe, 1);
+            return;
+
+        case TARGET_RUNNING:
+            running++;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (running > 0 && now < probe->deadline_us)
+        return;
+
+    for (i = 0; i < probe->target_count; i++)
+    {
+        if (probe->targets[i].state == TARGET_RUNNING)
+            finish_target(probe, &probe->targets[i], ETIMEDOUT);
+    }
+    finish_probe(p, probe, 0);
+}
+
+static struct probe *alloc_probe(struct prober *p)
+{
+    int i;
+    for (i = 0; i < MAX_PROBES; i++)
+    {
+        if (!p->probes[i].in_use)
+            return &p->probes[i];
+    }
+    return NULL;
+}
+
+static void process_request(struct prober *p, const char *buf)
+{
+    static struct probe busy;
+    int index = 0;
+    int version;
+    int arity;
+    char cmd[MAXATOMLEN];
+    long id;
+    char ifname[IF_NAMESIZE];
+    long ifname_len;
+    unsigned long timeout_ms;
+    int count;
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+        arity != 5 ||
+        ei_decode_atom(buf, &index, cmd) < 0 ||
+        strcmp(cmd, "probe") != 0 ||
+        ei_decode_long(buf, &index, &id) < 0 ||
+        ei_get_type(buf, &index, &arity, &count) < 0 ||
+        count <= 0 || count >= IF_NAMESIZE ||
+        ei_decode_binary(buf, &index, ifname, &ifname_len) < 0 ||
+        ei_decode_ulong(buf, &index, &timeout_ms) < 0 ||
+        ei_decode_list_header(buf, &index, &count) < 0 ||
+        count <= 0 || count > MAX_TARGETS)
+        errx(EXIT_FAILURE, "Expecting {:probe, id, ifname, timeout_ms, targets} from Elixir");
+    ifname[ifname_len] = '\0';
+
+    struct probe *probe = alloc_probe(p);
+    if (!probe)
+    {
+        // Report EBUSY for each target, but still decode them to check the request
+        probe = &busy;
+    }
+
+    memset(probe, 0, sizeof(*probe));
+    probe->id = id;
+    probe->target_count = count;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (decode_target(buf, &index, &probe->targets[i]) < 0)
+            errx(EXIT_FAILURE, "Expecting {address, port} or {address, :icmp} targets");
+    }
+
+    if (probe == &busy)
+    {
+        for (i = 0; i < count; i++)
+            finish_target(probe, &probe->targets[i], EBUSY);
+        send_response(p, probe, 0);
+        return;
+    }
+
+    probe->in_use = 1;
+    probe->start_us = now_us();
+    probe->deadline_us = probe->start_us + (int64_t)timeout_ms * 1000;
+
+    debug("probe %ld: %d targets on %s", id, count, ifname);
+    for (i = 0; i < count; i++)
+        start_target(p, probe, &probe->targets[i], ifname);
+
+    check_probe(p, probe, probe->start_us);
+}
+
+static int stdin_process(struct prober *p)
+{
+    ssize_t amount = read(STDIN_FILENO, p->request + p->request_len, sizeof(p->request) - p->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    p->request_len += amount;
+
+    size_t offset = 0;
+    while (p->request_len - offset >= 2)
+    {
+        size_t len = ((unsigned char)p->request[offset] << 8) | (unsigned char)p->request[offset + 1];
+        if (p->request_len - offset < len + 2)
+            break;
+
+        process_request(p, &p->request[offset + 2]);
+        offset += len + 2;
+    }
+
+    p->request_len -= offset;
+    memmove(p->request, &p->request[offset], p->request_len);
+    return 0;
+}
+
+// Milliseconds until the next deadline or -1 if nothing is in progress
+static int next_timeout(struct prober *p)
+{
+    int64_t now = now_us();
+    int64_t next = -1;
+    int i;
+    for (i = 0; i < MAX_PROBES; i++)
+    {
+        if (!p->probes[i].in_use)
+            continue;
+
+        int64_t remaining = p->probes[i].deadline_us - now;
+        if (remaining < 0)
+            remaining = 0;
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
+
+    // Round up so that the deadline has passed when epoll_wait returns
+    return next < 0 ? -1 : (int)((next + 999) / 1000);
+}
+
+static struct probe *probe_for_target(struct prober *p, struct target *target)
+{
+    size_t i = ((char *)target - (char *)p->probes) / sizeof(struct probe);
+    return &p->probes[i];
+}
+
+int main(int argc, char *argv[])
+{
+    static struct prober p;
+    prober_init(&p);
+
+    for (;;)
+    {
+        struct epoll_event events[MAX_TARGETS * 4];
+
+        int rc = epoll_wait(p.epfd, events, sizeof(events) / sizeof(events[0]), next_timeout(&p));
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "epoll_wait");
+        }
+
+        int i;
+        for (i = 0; i < rc; i++)
+        {
+            struct target *target = events[i].data.ptr;
+            if (target == NULL)
+            {
+                if (stdin_process(&p) < 0)
+                    goto done;
+            }
+            else if (target->fd >= 0)
+            {
+                // Closed targets can still show up later in this batch
+                target_ready(probe_for_target(&p, target), target);
+            }
+        }
+
+        int64_t now = now_us();
+        for (i = 0; i < MAX_PROBES; i++)
+        {
+            if (p.probes[i].in_use)
+                check_probe(&p, &p.probes[i], now);
+        }
+    }
+
+done:
+    close(p.epfd);
+    ei_x_free(&p.response);
+    return 0;
+}
@@ -0,0 +1,435 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Report TCP byte counters for Elixir using NETLINK_SOCK_DIAG
+//
+// Requests are `{:tcp_counters, [{address, netmask}]}` where the list holds
+// the subnets on a network interface. The response is `{:ok, counters}` with
+// an entry for every established TCP socket, BEAM or not, whose source address
+// is on one of the subnets and whose peer is not. `counters` is a binary of
+// `<<cookie::64, bytes_acked::64, bytes_received::64>>` records. Errors are
+// returned as `{:error, reason_string}`.
+
+#include <err.h>
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <arpa/inet.h>
+#include <libmnl/libmnl.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/tcp.h>
+
+#include <ei.h>
+
+// Requests are small, but responses can have thousands of sockets
+#define MAX_REQUEST_LEN 4096
+#define MAX_SUBNETS 32
+
+// TCP_ESTABLISHED in the kernel's TCP state enum
+#define TCPF_ESTABLISHED (1 << 1)
+
+// Size of each record in the response
+#define RECORD_LEN 24
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+struct subnet
+{
+    unsigned char family;
+    unsigned char address[16];
+    unsigned char mask[16];
+};
+
+struct sock_diag
+{
+    struct mnl_socket *nl;
+    unsigned int portid;
+    unsigned int seq;
+
+    char request[MAX_REQUEST_LEN + 4];
+    size_t request_len;
+
+    char recvbuf[MNL_SOCKET_BUFFER_SIZE];
+
+    struct subnet subnets[MAX_SUBNETS];
+    int subnet_count;
+
+    // Packed records for the current response
+    unsigned char *records;
+    size_t records_len;
+    size_t records_size;
+
+    ei_x_buff response;
+};
+
+static void diag_init(struct sock_diag *diag)
+{
+    memset(diag, 0, sizeof(*diag));
+    diag->seq = 1;
+
+    diag->nl = mnl_socket_open(NETLINK_SOCK_DIAG);
+    if (!diag->nl)
+        err(EXIT_FAILURE, "mnl_socket_open (NETLINK_SOCK_DIAG)");
+
+    if (mnl_socket_bind(diag->nl, 0, MNL_SOCKET_AUTOPID) < 0)
+        err(EXIT_FAILURE, "mnl_socket_bind");
+
+    diag->portid = mnl_socket_get_portid(diag->nl);
+
+    if (ei_x_new(&diag->response) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+}
+
+static void diag_cleanup(struct sock_diag *diag)
+{
+    mnl_socket_close(diag->nl);
+    diag->nl = NULL;
+    free(diag->records);
+    diag->records = NULL;
+    ei_x_free(&diag->response);
+}
+
+static void write_packet(const char *data, int len)
+{
+    uint32_t be_len = htonl(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static int decode_address(const char *buf, int *index, unsigned char *family, unsigned char *addr)
+{
+    int arity;
+    if (ei_decode_tuple_header(buf, index, &arity) < 0)
+        return -1;
+
+    int i;
+    switch (arity)
+    {
+    case 4:
+        for (i = 0; i < 4; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 255)
+                return -1;
+            addr[i] = v;
+        }
+        *family = AF_INET;
+        return 0;
+
+    case 8:
+        for (i = 0; i < 8; i++)
+        {
+            unsigned long v;
+            if (ei_decode_ulong(buf, index, &v) < 0 || v > 65535)
+                return -1;
+            addr[2 * i] = v >> 8;
+            addr[2 * i + 1] = v & 0xff;
+        }
+        *family = AF_INET6;
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+static int decode_subnets(struct sock_diag *diag, const char *buf, int *index)
+{
+    int count;
+    if (ei_decode_list_header(buf, index, &count) < 0 || count > MAX_SUBNETS)
+        return -1;
+
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        struct subnet *subnet = &diag->subnets[i];
+        unsigned char mask_family;
+        int arity;
+        memset(subnet, 0, sizeof(*subnet));
+
+        if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity != 2 ||
+            decode_address(buf, index, &subnet->family, subnet->address) < 0 ||
+            decode_address(buf, index, &mask_family, subnet->mask) < 0 ||
+            mask_family != subnet->family)
+            return -1;
+    }
+    diag->subnet_count = count;
+
+    // Skip the list tail
+    if (count > 0 && ei_decode_list_header(buf, index, &count) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int on_subnet(const struct subnet *subnet, const unsigned char *addr)
+{
+    int len = subnet->family == AF_INET ? 4 : 16;
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        if ((addr[i] ^ subnet->address[i]) & subnet->mask[i])
+            return 0;
+    }
+    return 1;
+}
+
+static int on_interface(struct sock_diag *diag, unsigned char family, const unsigned char *addr)
+{
+    int i;
+    for (i = 0; i < diag->subnet_count; i++)
+    {
+        if (diag->subnets[i].family == family && on_subnet(&diag->subnets[i], addr))
+            return 1;
+    }
+    return 0;
+}
+
+static int has_family(struct sock_diag *diag, unsigned char family)
+{
+    int i;
+    for (i = 0; i < diag->subnet_count; i++)
+    {
+        if (diag->subnets[i].family == family)
+            return 1;
+    }
+    return 0;
+}
+
+static void put_u64(unsigned char *p, uint64_t v)
+{
+    int i;
+    for (i = 7; i >= 0; i--)
+    {
+        p[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+static void add_record(struct sock_diag *diag, uint64_t cookie, uint64_t tx, uint64_t rx)
+{
+    if (diag->records_len + RECORD_LEN > diag->records_size)
+    {
+        size_t new_size = diag->records_size ? diag->records_size * 2 : 64 * RECORD_LEN;
+        unsigned char *new_records = realloc(diag->records, new_size);
+        if (!new_records)
+            err(EXIT_FAILURE, "realloc");
+        diag->records = new_records;
+        diag->records_size = new_size;
+    }
+
+    unsigned char *p = diag->records + diag->records_len;
+    put_u64(p, cookie);
+    put_u64(p + 8, tx);
+    put_u64(p + 16, rx);
+    diag->records_len += RECORD_LEN;
+}
+
+static int inet_diag_cb(const struct nlmsghdr *nlh, void *data)
+{
+    struct sock_diag *diag = (struct sock_diag *)data;
+    const struct inet_diag_msg *msg = mnl_nlmsg_get_payload(nlh);
+
+    const unsigned char *src = (const unsigned char *)msg->id.idiag_src;
+    const unsigned char *dst = (const unsigned char *)msg->id.idiag_dst;
+    if (!on_interface(diag, msg->idiag_family, src) || on_interface(diag, msg->idiag_family, dst))
+        return MNL_CB_OK;
+
+    const struct nlattr *attr;
+    mnl_attr_for_each(attr, nlh, sizeof(*msg))
+    {
+        if (mnl_attr_get_type(attr) != INET_DIAG_INFO)
+            continue;
+
+        // Older kernels have a shorter struct tcp_info without byte counters
+        if (mnl_attr_get_payload_len(attr) < offsetof(struct tcp_info, tcpi_bytes_received) + sizeof(uint64_t))
+        {
+            debug("tcp_info too short");
+            break;
+        }
+
+        struct tcp_info info;
+        memcpy(&info, mnl_attr_get_payload(attr), sizeof(info) < mnl_attr_get_payload_len(attr) ? sizeof(info) : mnl_attr_get_payload_len(attr));
+
+        uint64_t cookie = ((uint64_t)msg->id.idiag_cookie[1] << 32) | msg->id.idiag_cookie[0];
+        add_record(diag, cookie, info.tcpi_bytes_acked, info.tcpi_bytes_received);
+        break;
+    }
+    return MNL_CB_OK;
+}
+
+// Dump the established TCP sockets for one address family
+static int dump_family(struct sock_diag *diag, unsigned char family)
+{
+    char buf[MNL_SOCKET_BUFFER_SIZE];
+    struct nlmsghdr *nlh = mnl_nlmsg_put_header(buf);
+    nlh->nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh->nlmsg_seq = diag->seq++;
+
+    struct inet_diag_req_v2 *req = mnl_nlmsg_put_extra_header(nlh, sizeof(struct inet_diag_req_v2));
+    req->sdiag_family = family;
+    req->sdiag_protocol = IPPROTO_TCP;
+    req->idiag_states = TCPF_ESTABLISHED;
+    req->idiag_ext = 1 << (INET_DIAG_INFO - 1);
+
+    if (mnl_socket_sendto(diag->nl, nlh, nlh->nlmsg_len) < 0)
+        return -errno;
+
+    for (;;)
+    {
+        int bytecount = mnl_socket_recvfrom(diag->nl, diag->recvbuf, sizeof(diag->recvbuf));
+        if (bytecount < 0)
+            return -errno;
+
+        int rc = mnl_cb_run(diag->recvbuf, bytecount, nlh->nlmsg_seq, diag->portid, inet_diag_cb, diag);
+        if (rc == MNL_CB_STOP)
+            return 0;
+        else if (rc == MNL_CB_ERROR)
+            return -errno;
+    }
+}
+
+static void encode_error(ei_x_buff *buff, int error)
+{
+    const char *reason = strerror(error);
+    ei_x_encode_tuple_header(buff, 2);
+    ei_x_encode_atom(buff, "error");
+    ei_x_encode_binary(buff, reason, strlen(reason));
+}
+
+static void process_request(struct sock_diag *diag, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    char cmd[MAXATOMLEN];
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+        arity != 2 ||
+        ei_decode_atom(buf, &index, cmd) < 0 ||
+        strcmp(cmd, "tcp_counters") != 0 ||
+        decode_subnets(diag, buf, &index) < 0)
+        errx(EXIT_FAILURE, "Expecting {:tcp_counters, subnets} from Elixir");
+
+    diag->records_len = 0;
+
+    int rc = 0;
+    if (has_family(diag, AF_INET))
+        rc = dump_family(diag, AF_INET);
+    if (rc == 0 && has_family(diag, AF_INET6))
+        rc = dump_family(diag, AF_INET6);
+
+    diag->response.index = 0;
+    ei_x_encode_version(&diag->response);
+    if (rc == 0)
+    {
+        ei_x_encode_tuple_header(&diag->response, 2);
+        ei_x_encode_atom(&diag->response, "ok");
+        ei_x_encode_binary(&diag->response, diag->records, diag->records_len);
+    }
+    else
+    {
+        encode_error(&diag->response, -rc);
+    }
+
+    write_packet(diag->response.buff, diag->response.index);
+}
+
+static int stdin_process(struct sock_diag *diag)
+{
+    ssize_t amount = read(STDIN_FILENO, diag->request + diag->request_len, sizeof(diag->request) - diag->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    diag->request_len += amount;
+
+    size_t offset = 0;
+    while (diag->request_len - offset >= 4)
+    {
+        const unsigned char *p = (const unsigned char *)&diag->request[offset];
+        size_t len = ((size_t)p[0] << 24) | ((size_t)p[1] << 16) | ((size_t)p[2] << 8) | p[3];
+        if (len > MAX_REQUEST_LEN)
+            errx(EXIT_FAILURE, "Request too large: %d bytes", (int)len);
+        if (diag->request_len - offset < len + 4)
+            break;
+
+        process_request(diag, &diag->request[offset + 4]);
+        offset += len + 4;
+    }
+
+    diag->request_len -= offset;
+    memmove(diag->request, &diag->request[offset], diag->request_len);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct sock_diag diag;
+    diag_init(&diag);
+
+    for (;;)
+    {
+        struct pollfd fdset[1];
+
+        fdset[0].fd = STDIN_FILENO;
+        fdset[0].events = POLLIN;
+        fdset[0].revents = 0;
+
+        int rc = poll(fdset, 1, -1);
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "poll");
+        }
+
+        if ((fdset[0].revents & (POLLIN | POLLHUP)) && stdin_process(&diag) < 0)
+            break;
+    }
+
+    diag_cleanup(&diag);
+    return 0;
+}
@@ -0,0 +1,675 @@
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// Run commands for Elixir from a small process
+//
+// Forking the BEAM copies its page tables, which is slow when it's large.
+// This process is small, so it can vfork and exec commands quickly. Several
+// commands can run at once.
+//
+// Requests are:
+//
+//   {:run, id, path, args, env, stderr_to_stdout}
+//   {:kill, id}
+//
+// `env` is a list of `{name, value}` to add to this process's environment. A
+// `nil` value removes the variable. Output is sent as it arrives and then the
+// exit status along with how long it took to start the command:
+//
+//   {:output, id, data}
+//   {:exit, id, status, spawn_usec}
+//
+// The status is the exit code or 128 plus the signal number like Erlang
+// ports report. If the command can't be started, the reason is sent as output
+// and the status is 127.
+//
+// Each command runs in its own process group. `:kill` and exiting this
+// program send SIGKILL to the group. Commands are also killed if this program
+// is killed.
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include <arpa/inet.h>
+
+#include <ei.h>
+
+// Erlang's {:packet, 2} framing limits each message to 64 KB
+#define MAX_PACKET_LEN 65535
+
+// Commands over the limit fail with status 127
+#define MAX_COMMANDS 64
+
+#define OUTPUT_CHUNK_LEN 4096
+
+// Stop waiting for output this long after a command exits. This handles
+// commands that leave a child running with their stdout.
+#define OUTPUT_LINGER_MS 500
+
+//#define DEBUG
+#ifdef DEBUG
+#define debug(...)                    \
+    do                                \
+    {                                 \
+        fprintf(stderr, __VA_ARGS__); \
+        fprintf(stderr, "\r\n");      \
+    } while (0)
+#else
+#define debug(...)
+#endif
+
+extern char **environ;
+
+struct command
+{
+    int in_use;
+    long id;
+    pid_t pid;
+    int out_fd;
+    int exited;
+    int status;
+    int64_t exit_us;
+    int64_t spawn_usec;
+};
+
+struct spawner
+{
+    int signal_fd;
+    int null_fd;
+    pid_t my_pid;
+
+    char request[MAX_PACKET_LEN + 2];
+    size_t request_len;
+
+    struct command commands[MAX_COMMANDS];
+
+    ei_x_buff response;
+};
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void write_packet(const char *data, int len)
+{
+    if (len > MAX_PACKET_LEN)
+        errx(EXIT_FAILURE, "response too large to send: %d bytes", len);
+
+    uint16_t be_len = htons(len);
+    struct iovec iov[2];
+    iov[0].iov_base = &be_len;
+    iov[0].iov_len = sizeof(be_len);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+
+    ssize_t rc = writev(STDOUT_FILENO, iov, 2);
+    if (rc < 0)
+        err(EXIT_FAILURE, "writev");
+
+    if (rc != (ssize_t)(sizeof(be_len) + len))
+        errx(EXIT_FAILURE, "writev wasn't able to send %d chars all at once!", len);
+}
+
+static void send_output(struct spawner *s, long id, const char *data, size_t len)
+{
+    ei_x_buff *buff = &s->response;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 3);
+    ei_x_encode_atom(buff, "output");
+    ei_x_encode_long(buff, id);
+    ei_x_encode_binary(buff, data, len);
+    write_packet(buff->buff, buff->index);
+}
+
+static void send_exit(struct spawner *s, long id, int status, int64_t spawn_usec)
+{
+    ei_x_buff *buff = &s->response;
+    buff->index = 0;
+    ei_x_encode_version(buff);
+    ei_x_encode_tuple_header(buff, 4);
+    ei_x_encode_atom(buff, "exit");
+    ei_x_encode_long(buff, id);
+    ei_x_encode_long(buff, status);
+    ei_x_encode_longlong(buff, spawn_usec);
+    write_packet(buff->buff, buff->index);
+}
+
+static void send_failure(struct spawner *s, long id, const char *what, int error)
+{
+    char message[256];
+    snprintf(message, sizeof(message), "%s: %s\n", what, strerror(error));
+    send_output(s, id, message, strlen(message));
+    send_exit(s, id, 127, 0);
+}
+
+static void set_cloexec(int fd)
+{
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+        err(EXIT_FAILURE, "fcntl(FD_CLOEXEC)");
+}
+
+static void spawner_init(struct spawner *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->my_pid = getpid();
+
+    // SIGCHLD is handled through a signalfd. Children unblock it before exec.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+        err(EXIT_FAILURE, "sigprocmask");
+
+    s->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (s->signal_fd < 0)
+        err(EXIT_FAILURE, "signalfd");
+
+    // Commands get /dev/null for stdin like they would from MuonTrap
+    s->null_fd = open("/dev/null", O_RDWR);
+    if (s->null_fd < 0)
+        err(EXIT_FAILURE, "open(/dev/null)");
+    set_cloexec(s->null_fd);
+
+    if (ei_x_new(&s->response) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+}
+
+static void free_strings(char **strings)
+{
+    if (strings)
+    {
+        char **p;
+        for (p = strings; *p; p++)
+            free(*p);
+        free(strings);
+    }
+}
+
+static char *decode_string(const char *buf, int *index)
+{
+    int type;
+    int size;
+    long len;
+    if (ei_get_type(buf, index, &type, &size) < 0 || type != ERL_BINARY_EXT)
+        return NULL;
+
+    char *str = malloc(size + 1);
+    if (!str)
+        err(EXIT_FAILURE, "malloc");
+
+    if (ei_decode_binary(buf, index, str, &len) < 0)
+    {
+        free(str);
+        return NULL;
+    }
+    str[len] = '\0';
+    return str;
+}
+
+// Decode args into a NULL-terminated argv with path first
+static char **decode_argv(const char *buf, int *index, const char *path)
+{
+    int count;
+    if (ei_decode_list_header(buf, index, &count) < 0)
+        return NULL;
+
+    char **argv = calloc(count + 2, sizeof(char *));
+    if (!argv)
+        err(EXIT_FAILURE, "calloc");
+
+    argv[0] = strdup(path);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        argv[i + 1] = decode_string(buf, index);
+        if (!argv[i + 1])
+        {
+            free_strings(argv);
+            return NULL;
+        }
+    }
+
+    // Skip the tail of non-empty lists
+    if (count > 0 && ei_decode_list_header(buf, index, &count) < 0)
+    {
+        free_strings(argv);
+        return NULL;
+    }
+    return argv;
+}
+
+static int env_matches(const char *entry, const char *name)
+{
+    size_t len = strlen(name);
+    return strncmp(entry, name, len) == 0 && entry[len] == '=';
+}
+
+// Decode the env changes and apply them to a copy of this process's environment
+static char **decode_envp(const char *buf, int *index)
+{
+    int count;
+    if (ei_decode_list_header(buf, index, &count) < 0)
+        return NULL;
+
+    int environ_count = 0;
+    while (environ[environ_count])
+        environ_count++;
+
+    char **envp = calloc(environ_count + count + 1, sizeof(char *));
+    if (!envp)
+        err(EXIT_FAILURE, "calloc");
+
+    int i;
+    for (i = 0; i < environ_count; i++)
+        envp[i] = strdup(environ[i]);
+
+    int used = environ_count;
+    for (i = 0; i < count; i++)
+    {
+        int arity;
+        char *name;
+        if (ei_decode_tuple_header(buf, index, &arity) < 0 || arity != 2 ||
+            (name = decode_string(buf, index)) == NULL)
+        {
+            free_strings(envp);
+            return NULL;
+        }
+
+        // Remove the old value
+        int j;
+        for (j = 0; j < used; j++)
+        {
+            if (env_matches(envp[j], name))
+            {
+                free(envp[j]);
+                envp[j] = envp[--used];
+                envp[used] = NULL;
+                break;
+            }
+        }
+
+        char atom[MAXATOMLEN];
+        char *value;
+        if (ei_decode_atom(buf, index, atom) == 0 && strcmp(atom, "nil") == 0)
+        {
+            free(name);
+            continue;
+        }
+        else if ((value = decode_string(buf, index)) != NULL)
+        {
+            char *entry = malloc(strlen(name) + strlen(value) + 2);
+            if (!entry)
+                err(EXIT_FAILURE, "malloc");
+            sprintf(entry, "%s=%s", name, value);
+            envp[used++] = entry;
+            free(value);
+            free(name);
+        }
+        else
+        {
+            free(name);
+            free_strings(envp);
+            return NULL;
+        }
+    }
+
+    if (count > 0 && ei_decode_list_header(buf, index, &count) < 0)
+    {
+        free_strings(envp);
+        return NULL;
+    }
+    return envp;
+}
+
+static struct command *find_command(struct spawner *s, long id)
+{
+    int i;
+    for (i = 0; i < MAX_COMMANDS; i++)
+    {
+        if (s->commands[i].in_use && s->commands[i].id == id)
+            return &s->commands[i];
+    }
+    return NULL;
+}
+
+static void start_command(struct spawner *s, long id, const char *path, char **argv, char **envp, int stderr_to_stdout)
+{
+    struct command *cmd = NULL;
+    int i;
+    for (i = 0; i < MAX_COMMANDS && !cmd; i++)
+    {
+        if (!s->commands[i].in_use)
+            cmd = &s->commands[i];
+    }
+    if (!cmd)
+    {
+        send_failure(s, id, path, EBUSY);
+        return;
+    }
+
+    int out[2];
+    if (pipe(out) < 0)
+    {
+        send_failure(s, id, path, errno);
+        return;
+    }
+    set_cloexec(out[0]);
+    set_cloexec(out[1]);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+
+    sigset_t empty;
+    sigemptyset(&empty);
+
+    // The child shares memory until it execs, so it can report why exec
+    // failed here
+    volatile int exec_errno = 0;
+    pid_t parent = s->my_pid;
+
+    int64_t start = now_us();
+    pid_t pid = vfork();
+    if (pid == 0)
+    {
+        // Only system calls from here on since memory is shared
+        setpgid(0, 0);
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent)
+            _exit(127);
+
+        dup2(s->null_fd, STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        if (stderr_to_stdout)
+            dup2(out[1], STDERR_FILENO);
+
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+        execve(path, argv, envp);
+
+        exec_errno = errno;
+        _exit(127);
+    }
+    int64_t spawn_usec = now_us() - start;
+    close(out[1]);
+
+    if (pid < 0)
+    {
+        close(out[0]);
+        send_failure(s, id, path, errno);
+        return;
+    }
+
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->in_use = 1;
+    cmd->id = id;
+    cmd->pid = pid;
+    cmd->out_fd = out[0];
+    cmd->spawn_usec = spawn_usec;
+
+    // The status will be 127 when the child exits
+    if (exec_errno)
+    {
+        char message[256];
+        snprintf(message, sizeof(message), "%s: %s\n", path, strerror(exec_errno));
+        send_output(s, id, message, strlen(message));
+    }
+
+    debug("%ld: started %s as %d in %lld us", id, path, pid, (long long)spawn_usec);
+}
+
+static void finish_command(struct spawner *s, struct command *cmd)
+{
+    if (cmd->out_fd >= 0)
+        close(cmd->out_fd);
+
+    send_exit(s, cmd->id, cmd->status, cmd->spawn_usec);
+    cmd->in_use = 0;
+}
+
+static void output_process(struct spawner *s, struct command *cmd)
+{
+    char data[OUTPUT_CHUNK_LEN];
+    ssize_t amount = read(cmd->out_fd, data, sizeof(data));
+    if (amount < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return;
+        amount = 0;
+    }
+
+    if (amount == 0)
+    {
+        close(cmd->out_fd);
+        cmd->out_fd = -1;
+        if (cmd->exited)
+            finish_command(s, cmd);
+        return;
+    }
+
+    send_output(s, cmd->id, data, amount);
+}
+
+static void signal_process(struct spawner *s)
+{
+    struct signalfd_siginfo info;
+    while (read(s->signal_fd, &info, sizeof(info)) == sizeof(info))
+        ;
+
+    // Signals get merged, so reap everything that's done
+    pid_t pid;
+    int wstatus;
+    while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0)
+    {
+        int i;
+        for (i = 0; i < MAX_COMMANDS; i++)
+        {
+            struct command *cmd = &s->commands[i];
+            if (!cmd->in_use || cmd->pid != pid)
+                continue;
+
+            cmd->exited = 1;
+            cmd->exit_us = now_us();
+            cmd->status = WIFSIGNALED(wstatus) ? 128 + WTERMSIG(wstatus) : WEXITSTATUS(wstatus);
+            debug("%ld: exited with %d", cmd->id, cmd->status);
+
+            if (cmd->out_fd < 0)
+                finish_command(s, cmd);
+        }
+    }
+}
+
+static void process_request(struct spawner *s, const char *buf)
+{
+    int index = 0;
+    int version;
+    int arity;
+    char cmd[MAXATOMLEN];
+    long id;
+    if (ei_decode_version(buf, &index, &version) < 0 ||
+        ei_decode_tuple_header(buf, &index, &arity) < 0 ||
+        ei_decode_atom(buf, &index, cmd) < 0 ||
+        ei_decode_long(buf, &index, &id) < 0)
+        errx(EXIT_FAILURE, "Expecting {:run, id, ...} or {:kill, id} from Elixir");
+
+    if (strcmp(cmd, "run") == 0 && arity == 6)
+    {
+        char *path = decode_string(buf, &index);
+        char **argv = path ? decode_argv(buf, &index, path) : NULL;
+        char **envp = argv ? decode_envp(buf, &index) : NULL;
+        int stderr_to_stdout;
+        if (!envp || ei_decode_boolean(buf, &index, &stderr_to_stdout) < 0)
+            errx(EXIT_FAILURE, "Expecting {:run, id, path, args, env, stderr_to_stdout} from Elixir");
+
+        start_command(s, id, path, argv, envp, stderr_to_stdout);
+
+        free(path);
+        free_strings(argv);
+        free_strings(envp);
+    }
+    else if (strcmp(cmd, "kill") == 0 && arity == 2)
+    {
+        struct command *c = find_command(s, id);
+        if (c && !c->exited)
+            kill(-c->pid, SIGKILL);
+    }
+    else
+    {
+        errx(EXIT_FAILURE, "Unexpected command from Elixir: %s", cmd);
+    }
+}
+
+static int stdin_process(struct spawner *s)
+{
+    ssize_t amount = read(STDIN_FILENO, s->request + s->request_len, sizeof(s->request) - s->request_len);
+    if (amount < 0)
+    {
+        if (errno == EINTR)
+            return 0;
+        err(EXIT_FAILURE, "read(stdin)");
+    }
+    if (amount == 0)
+    {
+        // Elixir closed the port
+        return -1;
+    }
+    s->request_len += amount;
+
+    size_t offset = 0;
+    while (s->request_len - offset >= 2)
+    {
+        size_t len = ((unsigned char)s->request[offset] << 8) | (unsigned char)s->request[offset + 1];
+        if (s->request_len - offset < len + 2)
+            break;
+
+        process_request(s, &s->request[offset + 2]);
+        offset += len + 2;
+    }
+
+    s->request_len -= offset;
+    memmove(s->request, &s->request[offset], s->request_len);
+    return 0;
+}
+
+// Finish commands that exited a while ago but still have their output open
+static void check_lingering(struct spawner *s)
+{
+    int64_t now = now_us();
+    int i;
+    for (i = 0; i < MAX_COMMANDS; i++)
+    {
+        struct command *cmd = &s->commands[i];
+        if (cmd->in_use && cmd->exited && now - cmd->exit_us >= OUTPUT_LINGER_MS * 1000)
+            finish_command(s, cmd);
+    }
+}
+
+// Milliseconds until a lingering command should be finished or -1 for none
+static int next_timeout(struct spawner *s)
+{
+    int64_t now = now_us();
+    int64_t next = -1;
+    int i;
+    for (i = 0; i < MAX_COMMANDS; i++)
+    {
+        struct command *cmd = &s->commands[i];
+        if (!cmd->in_use || !cmd->exited)
+            continue;
+
+        int64_t remaining = cmd->exit_us + OUTPUT_LINGER_MS * 1000 - now;
+        if (remaining < 0)
+            remaining = 0;
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
+
+    // Round up so that the deadline has passed when poll returns
+    return next < 0 ? -1 : (int)((next + 999) / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct spawner s;
+    spawner_init(&s);
+
+    for (;;)
+    {
+        struct pollfd fdset[2 + MAX_COMMANDS];
+        struct command *fd_commands[MAX_COMMANDS];
+
+        fdset[0].fd = STDIN_FILENO;
+        fdset[0].events = POLLIN;
+        fdset[0].revents = 0;
+
+        fdset[1].fd = s.signal_fd;
+        fdset[1].events = POLLIN;
+        fdset[1].revents = 0;
+
+        int count = 2;
+        int i;
+        for (i = 0; i < MAX_COMMANDS; i++)
+        {
+            struct command *cmd = &s.commands[i];
+            if (cmd->in_use && cmd->out_fd >= 0)
+            {
+                fd_commands[count - 2] = cmd;
+                fdset[count].fd = cmd->out_fd;
+                fdset[count].events = POLLIN;
+                fdset[count].revents = 0;
+                count++;
+            }
+        }
+
+        int rc = poll(fdset, count, next_timeout(&s));
+        if (rc < 0)
+        {
+            // Retry if EINTR
+            if (errno == EINTR)
+                continue;
+
+            err(EXIT_FAILURE, "poll");
+        }
+
+        // Read output before reaping so that it's sent before the exit status
+        for (i = 2; i < count; i++)
+        {
+            struct command *cmd = fd_commands[i - 2];
+            if ((fdset[i].revents & (POLLIN | POLLHUP)) && cmd->in_use && cmd->out_fd == fdset[i].fd)
+                output_process(&s, cmd);
+        }
+
+        if (fdset[1].revents & POLLIN)
+            signal_process(&s);
+
+        if ((fdset[0].revents & (POLLIN | POLLHUP)) && stdin_process(&s) < 0)
+            break;
+
+        check_lingering(&s);
+    }
+
+    // Don't leave anything running
+    int i;
+    for (i = 0; i < MAX_COMMANDS; i++)
+    {
+        if (s.commands[i].in_use && !s.commands[i].exited)
+            kill(-s.commands[i].pid, SIGKILL);
+    }
+
+    ei_x_free(&s.response);
+    return 0;
+}
@@ -0,0 +1,345 @@
+// SPDX-FileCopyrightText: 2019 Frank Hunleth
+// SPDX-FileCopyrightText: 2026 Frank Hunleth
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+// udhcpc script that reports lease events to VintageNet.DHCP.EventChannel
+//
+// udhcpc runs this with the event name as its only argument and the lease
+// information in environment variables. Only the variables that
+// VintageNet.DHCP.Options knows about are sent and they're parsed here so
+// that Elixir receives typed values. Each report is one datagram containing:
+//
+//   {:udhcpc, sequence_number, op, ifname, %{option => value}}
+//
+// The sequence number comes from CLOCK_MONOTONIC so that Elixir can order
+// and drop duplicate reports from the same interface.
+
+#include <ctype.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include <ei.h>
+
+extern char **environ;
+
+#define SOCKET_PATH_ENV "VINTAGE_NET_DHCP_SOCKET"
+
+enum option_type
+{
+    OPTION_STRING,
+    OPTION_INT,
+    OPTION_HEX,
+    OPTION_IP,
+    OPTION_IP_LIST
+};
+
+struct option_info
+{
+    const char *env_name;
+    const char *key;
+    enum option_type type;
+};
+
+// Keep in sync with VintageNet.DHCP.Options.udhcpc_to_options/1
+static const struct option_info options[] =
+{
+    {"ip", "ip", OPTION_IP},
+    {"mask", "mask", OPTION_INT},
+    {"siaddr", "siaddr", OPTION_IP},
+    {"subnet", "subnet", OPTION_IP},
+    {"timezone", "timezone", OPTION_STRING},
+    {"router", "router", OPTION_IP_LIST},
+    {"dns", "dns", OPTION_IP_LIST},
+    {"lprsrv", "lprsrv", OPTION_IP_LIST},
+    {"hostname", "hostname", OPTION_STRING},
+    {"bootsize", "bootsize", OPTION_STRING},
+    {"domain", "domain", OPTION_STRING},
+    {"swapsrv", "swapsrv", OPTION_IP},
+    {"rootpath", "rootpath", OPTION_STRING},
+    {"ipttl", "ipttl", OPTION_INT},
+    {"mtu", "mtu", OPTION_INT},
+    {"broadcast", "broadcast", OPTION_IP},
+    {"routes", "routes", OPTION_IP_LIST},
+    {"nisdomain", "nisdomain", OPTION_STRING},
+    {"nissrv", "nissrv", OPTION_IP_LIST},
+    {"ntpsrv", "ntpsrv", OPTION_IP_LIST},
+    {"wins", "wins", OPTION_STRING},
+    {"lease", "lease", OPTION_INT},
+    {"serverid", "serverid", OPTION_IP},
+    {"message", "message", OPTION_STRING},
+    {"opt58", "renewal_time", OPTION_HEX},
+    {"opt59", "rebind_time", OPTION_HEX},
+    {"vendor", "vendor", OPTION_STRING},
+    {"tftp", "tftp", OPTION_STRING},
+    {"bootfile", "bootfile", OPTION_STRING},
+    {"opt77", "userclass", OPTION_STRING},
+    {"tzstr", "tzstr", OPTION_STRING},
+    {"tzdbstr", "tzdbstr", OPTION_STRING},
+    {"search", "search", OPTION_STRING},
+    {"sipsrv", "sipsrv", OPTION_STRING},
+    {"staticroutes", "staticroutes", OPTION_IP_LIST},
+    {"vlanid", "vlanid", OPTION_STRING},
+    {"vlanpriority", "vlanpriority", OPTION_INT},
+    {"pxeconffile", "pxeconffile", OPTION_STRING},
+    {"pxepathprefix", "pxepathprefix", OPTION_STRING},
+    {"reboottime", "reboottime", OPTION_STRING},
+    {"ip6rd", "ip6rd", OPTION_STRING},
+    {"msstaticroutes", "msstaticroutes", OPTION_STRING},
+    {"wpad", "wpad", OPTION_STRING}
+};
+#define NUM_OPTIONS (sizeof(options) / sizeof(options[0]))
+
+static const struct option_info *find_option(const char *name, size_t len)
+{
+    size_t i;
+    for (i = 0; i < NUM_OPTIONS; i++)
+    {
+        if (strncmp(options[i].env_name, name, len) == 0 && options[i].env_name[len] == '\0')
+            return &options[i];
+    }
+    return NULL;
+}
+
+static int parse_ip(const char *str, size_t len, unsigned char ip[4])
+{
+    char buffer[INET_ADDRSTRLEN];
+
+    if (len == 0 || len >= sizeof(buffer))
+        return -1;
+
+    memcpy(buffer, str, len);
+    buffer[len] = '\0';
+    return inet_pton(AF_INET, buffer, ip) == 1 ? 0 : -1;
+}
+
+static void encode_ip(ei_x_buff *buff, const unsigned char ip[4])
+{
+    ei_x_encode_tuple_header(buff, 4);
+
+    int i;
+    for (i = 0; i < 4; i++)
+        ei_x_encode_long(buff, ip[i]);
+}
+
+static int encode_ip_value(ei_x_buff *buff, const char *value)
+{
+    unsigned char ip[4];
+    if (parse_ip(value, strlen(value), ip) < 0)
+        return -1;
+
+    encode_ip(buff, ip);
+    return 0;
+}
+
+static int encode_ip_list_value(ei_x_buff *buff, const char *value)
+{
+    // Validate everything first so that a bad address discards the whole
+    // option like it does in Elixir.
+    int count = 0;
+    const char *p = value;
+    while (*p != '\0')
+    {
+        if (*p == ' ')
+        {
+            p++;
+            continue;
+        }
+
+        size_t len = strcspn(p, " ");
+        unsigned char ip[4];
+        if (parse_ip(p, len, ip) < 0)
+            return -1;
+
+        count++;
+        p += len;
+    }
+
+    if (count > 0)
+    {
+        ei_x_encode_list_header(buff, count);
+
+        p = value;
+        while (*p != '\0')
+        {
+            if (*p == ' ')
+            {
+                p++;
+                continue;
+            }
+
+            size_t len = strcspn(p, " ");
+            unsigned char ip[4];
+            parse_ip(p, len, ip);
+            encode_ip(buff, ip);
+            p += len;
+        }
+    }
+    ei_x_encode_empty_list(buff);
+    return 0;
+}
+
+static int encode_int_value(ei_x_buff *buff, const char *value)
+{
+    if (*value == '\0' || isspace((unsigned char) *value))
+        return -1;
+
+    char *end;
+    long long v = strtoll(value, &end, 10);
+    if (*end != '\0')
+        return -1;
+
+    ei_x_encode_longlong(buff, v);
+    return 0;
+}
+
+static int encode_hex_value(ei_x_buff *buff, const char *value)
+{
+    // opt58 and opt59 are 32-bit times like "0000a8c0"
+    size_t len = strlen(value);
+    if (len == 0 || len > 16)
+        return -1;
+
+    unsigned long long v = 0;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        int c = (unsigned char) value[i];
+        if (!isxdigit(c))
+            return -1;
+
+        v = (v << 4) | (unsigned long long)(isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+
+    ei_x_encode_ulonglong(buff, v);
+    return 0;
+}
+
+static int encode_option(ei_x_buff *buff, const struct option_info *option, const char *value)
+{
+    // Rewind if the value can't be parsed so that the option is dropped
+    int start = buff->index;
+
+    ei_x_encode_atom(buff, option->key);
+
+    int rc;
+    switch (option->type)
+    {
+    case OPTION_INT:
+        rc = encode_int_value(buff, value);
+        break;
+    case OPTION_HEX:
+        rc = encode_hex_value(buff, value);
+        break;
+    case OPTION_IP:
+        rc = encode_ip_value(buff, value);
+        break;
+    case OPTION_IP_LIST:
+        rc = encode_ip_list_value(buff, value);
+        break;
+    case OPTION_STRING:
+    default:
+        // Strings from udhcpc are expected to be ASCII, so send as binaries
+        rc = ei_x_encode_binary(buff, value, strlen(value));
+        break;
+    }
+
+    if (rc < 0)
+        buff->index = start;
+
+    return rc;
+}
+
+static unsigned long long sequence_number()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+        err(EXIT_FAILURE, "clock_gettime");
+
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+        errx(EXIT_FAILURE, "Expecting udhcpc to pass an event name");
+
+    const char *socket_path = getenv(SOCKET_PATH_ENV);
+    if (socket_path == NULL)
+        errx(EXIT_FAILURE, SOCKET_PATH_ENV " not set");
+
+    const char *ifname = getenv("interface");
+    if (ifname == NULL)
+        errx(EXIT_FAILURE, "udhcpc didn't set $interface");
+
+    unsigned long long seq = sequence_number();
+
+    // Options are encoded in one pass over the environment and then
+    // appended after the map header once the count is known.
+    ei_x_buff map;
+    if (ei_x_new(&map) < 0)
+        err(EXIT_FAILURE, "ei_x_new");
+
+    int count = 0;
+    char **p;
+    for (p = environ; *p != NULL; p++)
+    {
+        const char *kv = *p;
+
+        // udhcpc's variables are all lowercase
+        if (!islower((unsigned char) kv[0]))
+            continue;
+
+        const char *equal = strchr(kv, '=');
+        if (equal == NULL)
+            continue;
+
+        const struct option_info *option = find_option(kv, equal - kv);
+        if (option && encode_option(&map, option, equal + 1) == 0)
+            count++;
+    }
+
+    ei_x_buff buff;
+    if (ei_x_new_with_version(&buff) < 0)
+        err(EXIT_FAILURE, "ei_x_new_with_version");
+
+    ei_x_encode_tuple_header(&buff, 5);
+    ei_x_encode_atom(&buff, "udhcpc");
+    ei_x_encode_ulonglong(&buff, seq);
+    ei_x_encode_binary(&buff, argv[1], strlen(argv[1]));
+    ei_x_encode_binary(&buff, ifname, strlen(ifname));
+    ei_x_encode_map_header(&buff, count);
+    ei_x_append(&buff, &map);
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        err(EXIT_FAILURE, "socket");
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        errx(EXIT_FAILURE, "Socket path too long: %s", socket_path);
+    strcpy(addr.sun_path, socket_path);
+
+    ssize_t rc = sendto(fd, buff.buff, buff.index, 0, (struct sockaddr *) &addr, sizeof(addr));
+    if (rc < 0)
+        err(EXIT_FAILURE, "sendto %s", socket_path);
+
+    if (rc != buff.index)
+        errx(EXIT_FAILURE, "sendto wasn't able to send %d chars all at once!", buff.index);
+
+    close(fd);
+    ei_x_free(&map);
+    ei_x_free(&buff);
+    return 0;
+}
@@ -14,6 +14,7 @@ defmodule VintageNetTest.Utils do
           Supervisor.child_spec()
   def udhcpc_child_spec(ifname, hostname, dhcp_request_options \\ []) do
     request_option_args = Enum.flat_map(dhcp_request_options, &["-O", &1])
+    {script, script_env} = VintageNet.DHCP.EventChannel.udhcpc_script()
 
     %{
       id: :udhcpc,
@@ -31,13 +32,13 @@ defmodule VintageNetTest.Utils do
                  "-x",
                  "hostname:#{hostname}",
                  "-s",
-                 BEAMNotify.bin_path()
+                 script
                ] ++ request_option_args,
              opts: [
                stderr_to_stdout: true,
                log_output: :debug,
                log_prefix: "udhcpc(#{ifname}): ",
-               env: BEAMNotify.env(name: "vintage_net_comm", report_env: true)
+               env: script_env
              ]
            ]
          ]}
@@ -5,8 +5,18 @@
 # Fresh state
 File.rm_rf!("test/tmp")
 
-# VintageNet.InterfacesMonitor only works on Linux
-exclude = if :os.type() == {:unix, :linux}, do: [], else: [requires_interfaces_monitor: true]
+# VintageNet.InterfacesMonitor, the DNS cache, the spawner, the DHCP client and
+# the lease watcher only work on Linux
+exclude =
+  if :os.type() == {:unix, :linux},
+    do: [],
+    else: [
+      requires_interfaces_monitor: true,
+      requires_dns_cache: true,
+      requires_spawner: true,
+      requires_dhcp_client: true,
+      requires_lease_watcher: true
+    ]
 
 # Networking support has enough pieces that are singleton in nature
 # that parallel running of tests can't be done.
@@ -0,0 +1,73 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Command.SpawnerTest do
+  use ExUnit.Case
+
+  alias VintageNet.Command.Spawner
+
+  setup context do
+    # config.exs turns off native_spawn so only start the port for these tests
+    if context[:requires_spawner] do
+      Application.put_env(:vintage_net, :native_spawn, true)
+      on_exit(fn -> Application.put_env(:vintage_net, :native_spawn, false) end)
+      start_supervised!(Spawner)
+    end
+
+    :ok
+  end
+
+  test "unsupported options aren't handled" do
+    assert Spawner.cmd("/bin/sh", ["-c", "pwd"], cd: "/") == :unavailable
+  end
+
+  @tag :requires_spawner
+  test "runs commands" do
+    assert Spawner.available?()
+    assert {"hello\n", 0} = Spawner.cmd("/bin/sh", ["-c", "echo hello"], [])
+    assert {"", 3} = Spawner.cmd("/bin/sh", ["-c", "exit 3"], [])
+    assert {"", 143} = Spawner.cmd("/bin/sh", ["-c", "kill $$"], [])
+  end
+
+  @tag :requires_spawner
+  test "passes options like System.cmd" do
+    assert {"out\nerr\n", 0} =
+             Spawner.cmd("/bin/sh", ["-c", "echo out; echo err >&2"], stderr_to_stdout: true)
+
+    assert {["x=1 y=\n"], 0} =
+             Spawner.cmd("/bin/sh", ["-c", "echo x=$X y=$Y"],
+               env: [{"X", "1"}, {"Y", nil}],
+               into: []
+             )
+  end
+
+  @tag :requires_spawner
+  test "runs commands at the same time" do
+    start = System.monotonic_time(:millisecond)
+
+    results =
+      1..10
+      |> Task.async_stream(&Spawner.cmd("/bin/sh", ["-c", "sleep 0.2; echo #{&1}"], []))
+      |> Enum.map(fn {:ok, result} -> result end)
+
+    assert results == Enum.map(1..10, &{"#{&1}\n", 0})
+    assert System.monotonic_time(:millisecond) - start < 1000
+    assert Spawner.stats().spawns >= 10
+  end
+
+  @tag :requires_spawner
+  test "kills commands when the caller exits" do
+    pid_file = Path.join(System.tmp_dir!(), "spawner_test.pid")
+    File.rm(pid_file)
+
+    script = "echo $$ > #{pid_file}; sleep 60"
+    task = Task.async(fn -> Spawner.cmd("/bin/sh", ["-c", script], []) end)
+    Process.sleep(200)
+    Task.shutdown(task, :brutal_kill)
+    Process.sleep(200)
+
+    os_pid = pid_file |> File.read!() |> String.trim()
+    refute File.exists?("/proc/#{os_pid}")
+  end
+end
@@ -131,6 +131,21 @@ defmodule VintageNet.Connectivity.InspectorTest do
     end
   end
 
+  test "check_counters/3 needs traffic in both directions" do
+    {status, cache} = Inspector.check_counters({:unknown, %{}}, [{1, 100, 200}, {2, 5, 5}], %{})
+    assert status == :unknown
+    assert cache == %{1 => {100, 200}, 2 => {5, 5}}
+
+    # Only sending isn't enough
+    {status, cache} = Inspector.check_counters({:unknown, %{}}, [{1, 150, 200}], cache)
+    assert status == :unknown
+    assert cache == %{1 => {150, 200}}
+
+    {status, cache} = Inspector.check_counters({:unknown, %{}}, [{1, 160, 210}], cache)
+    assert status == :internet
+    assert cache == %{1 => {160, 210}}
+  end
+
   test "checking the internet of a bogus network interface fails nicely" do
     assert Inspector.check_internet("bogus0", %{}) == {:no_internet, %{}}
   end
@@ -0,0 +1,70 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Connectivity.ProberTest do
+  use ExUnit.Case
+
+  alias VintageNet.Connectivity.Prober
+  alias VintageNetTest.Utils
+
+  setup do
+    # config.exs turns off native_prober so only start the port for these tests
+    Application.put_env(:vintage_net, :native_prober, true)
+    on_exit(fn -> Application.put_env(:vintage_net, :native_prober, false) end)
+    start_supervised!(Prober)
+    :ok
+  end
+
+  test "unavailable when disabled" do
+    stop_supervised!(Prober)
+    Application.put_env(:vintage_net, :native_prober, false)
+
+    assert Prober.probe("eth0", [{{127, 0, 0, 1}, 80}], 1_000) == :unavailable
+  end
+
+  test "probe via loopback" do
+    ifname = Utils.get_loopback_ifname()
+
+    # Nothing's listening on port 80, but a refused connection counts
+    assert {:ok, [{{{127, 0, 0, 1}, 80}, {:ok, rtt}}]} =
+             Prober.probe(ifname, [{{127, 0, 0, 1}, 80}], 1_000)
+
+    assert rtt >= 0
+  end
+
+  test "probe internet_host_list" do
+    ifname = Utils.get_ifname_for_tests()
+
+    # While these won't work for everyone, they should work on CI
+    hosts = Application.fetch_env!(:vintage_net, :internet_host_list)
+    assert {:ok, _results} = Prober.probe(ifname, hosts, 5_000)
+  end
+
+  test "first success cancels the rest" do
+    ifname = Utils.get_ifname_for_tests()
+
+    # 192.0.2.254 is in a reserved IP range and shouldn't respond
+    targets = [{{192, 0, 2, 254}, 80}, {{1, 1, 1, 1}, 53}]
+
+    assert {:ok, [{{{192, 0, 2, 254}, 80}, :cancelled}, {{{1, 1, 1, 1}, 53}, {:ok, _rtt}}]} =
+             Prober.probe(ifname, targets, 5_000)
+  end
+
+  test "times out when nothing responds" do
+    ifname = Utils.get_ifname_for_tests()
+
+    assert {:error, [{{{192, 0, 2, 254}, 80}, {:error, _reason}}]} =
+             Prober.probe(ifname, [{{192, 0, 2, 254}, 80}], 500)
+  end
+
+  test "unknown interfaces fail right away" do
+    assert {:error, [{_target, {:error, "No such device"}}]} =
+             Prober.probe("not_an_interface0", [{{1, 1, 1, 1}, 53}], 5_000)
+  end
+
+  test "too many targets" do
+    targets = for i <- 1..9, do: {{192, 0, 2, i}, 80}
+    assert Prober.probe("eth0", targets, 1_000) == :unavailable
+  end
+end
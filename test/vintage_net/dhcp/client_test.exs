@@ -0,0 +1,159 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.ClientTest do
+  use ExUnit.Case
+
+  import ExUnit.CaptureLog
+
+  alias VintageNet.DHCP.Client
+  alias VintageNetTest.CapturingUdhcpcHandler
+
+  @ifname "test_dhcp0"
+
+  @options %{
+    ip: {192, 168, 9, 50},
+    mask: 24,
+    subnet: {255, 255, 255, 0},
+    router: [{192, 168, 9, 1}],
+    dns: [{192, 168, 9, 1}, {1, 1, 1, 1}],
+    domain: "example.lan",
+    lease: 86400,
+    serverid: {192, 168, 9, 1}
+  }
+
+  setup do
+    CapturingUdhcpcHandler.clear()
+
+    # `cat` stands in for the dhcp_client port. It echoes back the commands
+    # that it's sent so that they can be checked.
+    port =
+      Port.open({:spawn_executable, System.find_executable("cat")}, [{:packet, 2}, :binary])
+
+    on_exit(fn -> PropertyTable.delete(VintageNet, ["interface", @ifname, "dhcp_options"]) end)
+
+    %{port: port, state: %{port: port, monitors: %{}, last: %{}}}
+  end
+
+  defp report(state, event) do
+    {:noreply, state} =
+      Client.handle_info({state.port, {:data, :erlang.term_to_binary(event)}}, state)
+
+    state
+  end
+
+  defp port_commands(port) do
+    receive do
+      {^port, {:data, data}} -> [:erlang.binary_to_term(data) | port_commands(port)]
+    after
+      100 -> []
+    end
+  end
+
+  test "unavailable when disabled" do
+    # config.exs turns off native_dhcp so that tests don't run DHCP on the host
+    refute Client.available?()
+    assert Client.start("eth0", "unit_test", []) == :unavailable
+    assert Client.stop("eth0") == :ok
+  end
+
+  test "leases are reported with udhcpc options", %{state: state} do
+    _state = report(state, {:dhcp, 1, "bound", @ifname, @options})
+
+    assert CapturingUdhcpcHandler.get() == [{@ifname, :bound, @options}]
+    assert VintageNet.get(["interface", @ifname, "dhcp_options"]) == @options
+  end
+
+  test "deconfig clears the dhcp_options property", %{state: state} do
+    state
+    |> report({:dhcp, 1, "bound", @ifname, @options})
+    |> report({:dhcp, 2, "deconfig", @ifname, %{}})
+
+    assert CapturingUdhcpcHandler.get() == [
+             {@ifname, :deconfig, %{}},
+             {@ifname, :bound, @options}
+           ]
+
+    assert VintageNet.get(["interface", @ifname, "dhcp_options"]) == nil
+  end
+
+  test "renewals are reported and replays are dropped", %{state: state} do
+    renewed = %{@options | lease: 3600}
+
+    state
+    |> report({:dhcp, 1, "bound", @ifname, @options})
+    |> report({:dhcp, 2, "renew", @ifname, @options})
+    |> report({:dhcp, 3, "renew", @ifname, renewed})
+    |> report({:dhcp, 3, "renew", @ifname, renewed})
+
+    assert CapturingUdhcpcHandler.get() == [
+             {@ifname, :renew, renewed},
+             {@ifname, :renew, @options},
+             {@ifname, :bound, @options}
+           ]
+  end
+
+  test "errors and unexpected reports are logged", %{state: state} do
+    log =
+      capture_log(fn ->
+        new_state =
+          state
+          |> report({:error, @ifname, "Network is down"})
+          |> report({:dhcp, 1, "bogus", @ifname, @options})
+          |> report(:garbage)
+
+        assert new_state == state
+      end)
+
+    assert log =~ "dhcp_client(#{@ifname}): Network is down"
+    assert log =~ "dropping unexpected report"
+    assert CapturingUdhcpcHandler.get() == []
+  end
+
+  test "interfaces are stopped when their process exits", %{port: port, state: state} do
+    owner = spawn(fn -> Process.sleep(:infinity) end)
+
+    {:reply, :ok, state} =
+      Client.handle_call({:start, @ifname, "unit_test", ["wpad"]}, {owner, :tag}, state)
+
+    state = report(state, {:dhcp, 1, "bound", @ifname, @options})
+    assert Map.has_key?(state.last, @ifname)
+
+    # The monitor is owned by this process since it's standing in for the GenServer
+    Process.exit(owner, :kill)
+    assert_receive {:DOWN, ref, :process, ^owner, :killed}
+
+    {:noreply, state} = Client.handle_info({:DOWN, ref, :process, owner, :killed}, state)
+
+    assert state.monitors == %{}
+    assert state.last == %{}
+
+    assert port_commands(port) == [
+             {:start, @ifname, "unit_test", ["wpad"]},
+             {:stop, @ifname}
+           ]
+  end
+
+  test "restarting an interface replaces its monitor", %{port: port, state: state} do
+    owner = spawn(fn -> Process.sleep(:infinity) end)
+
+    {:reply, :ok, state} =
+      Client.handle_call({:start, @ifname, "unit_test", []}, {owner, :tag}, state)
+
+    {:reply, :ok, state} =
+      Client.handle_call({:start, @ifname, "unit_test", []}, {self(), :tag}, state)
+
+    Process.exit(owner, :kill)
+    refute_receive {:DOWN, _ref, :process, ^owner, _reason}
+
+    {:reply, :ok, state} = Client.handle_call({:stop, @ifname}, {self(), :tag}, state)
+    assert state.monitors == %{}
+
+    assert port_commands(port) == [
+             {:start, @ifname, "unit_test", []},
+             {:start, @ifname, "unit_test", []},
+             {:stop, @ifname}
+           ]
+  end
+end
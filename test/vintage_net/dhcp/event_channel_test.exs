@@ -0,0 +1,84 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.EventChannelTest do
+  use ExUnit.Case, async: false
+
+  alias VintageNet.DHCP.EventChannel
+  alias VintageNetTest.CapturingUdhcpcHandler
+
+  @options %{ip: {192, 168, 9, 131}, mask: 24, router: [{192, 168, 9, 1}], lease: 86400}
+
+  test "events are returned in sequence order" do
+    events = [
+      {3, "bound", "eth0", @options},
+      {1, "deconfig", "eth0", %{}},
+      {2, "bound", "wlan0", @options}
+    ]
+
+    {kept, last} = EventChannel.filter_events(events, %{})
+
+    assert kept == [
+             {1, "deconfig", "eth0", %{}},
+             {2, "bound", "wlan0", @options},
+             {3, "bound", "eth0", @options}
+           ]
+
+    assert last == %{"eth0" => 3, "wlan0" => 2}
+  end
+
+  test "old and replayed events are dropped" do
+    last = %{"eth0" => 10}
+
+    assert {[], ^last} =
+             EventChannel.filter_events(
+               [{10, "deconfig", "eth0", %{}}, {5, "deconfig", "eth0", %{}}],
+               last
+             )
+  end
+
+  test "renewals are kept even if nothing changed" do
+    events = [
+      {1, "bound", "eth0", @options},
+      {2, "renew", "eth0", @options},
+      {3, "renew", "eth0", @options},
+      {3, "renew", "eth0", @options}
+    ]
+
+    {kept, last} = EventChannel.filter_events(events, %{})
+
+    assert kept == [
+             {1, "bound", "eth0", @options},
+             {2, "renew", "eth0", @options},
+             {3, "renew", "eth0", @options}
+           ]
+
+    assert last == %{"eth0" => 3}
+  end
+
+  test "events sent to the socket are dispatched" do
+    CapturingUdhcpcHandler.clear()
+
+    {:ok, socket} = :gen_udp.open(0, [:local, :binary])
+    event = :erlang.term_to_binary({:udhcpc, 1, "bound", "test_ec0", @options})
+    :ok = :gen_udp.send(socket, {:local, EventChannel.socket_path()}, 0, event)
+    :gen_udp.close(socket)
+
+    assert wait_for_capture() == [{"test_ec0", :bound, @options}]
+
+    assert PropertyTable.get(VintageNet, ["interface", "test_ec0", "dhcp_options"]) ==
+             @options
+  end
+
+  defp wait_for_capture(tries \\ 50) do
+    case CapturingUdhcpcHandler.get() do
+      [] when tries > 0 ->
+        Process.sleep(10)
+        wait_for_capture(tries - 1)
+
+      captured ->
+        captured
+    end
+  end
+end
@@ -0,0 +1,167 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.DHCP.LeaseWatcherTest do
+  use ExUnit.Case
+
+  import ExUnit.CaptureLog
+
+  alias VintageNet.DHCP.LeaseWatcher
+
+  @ifname "test_lw0"
+  @property ["interface", @ifname, "dhcpd", "leases"]
+
+  @alpha %{
+    leasetime: 3600,
+    expires: 4600,
+    lease_nip: "192.168.0.10",
+    lease_mac: "0:1:2:3:4:A",
+    hostname: "alpha"
+  }
+
+  @beta %{
+    leasetime: 3600,
+    expires: 4600,
+    lease_nip: "192.168.0.11",
+    lease_mac: "DE:AD:BE:EF:0:1",
+    hostname: ""
+  }
+
+  defp report(state, event) do
+    {:noreply, state} =
+      LeaseWatcher.handle_info({state.port, {:data, :erlang.term_to_binary(event)}}, state)
+
+    state
+  end
+
+  defp leases(), do: VintageNet.get(@property) |> Enum.sort()
+
+  test "unavailable when disabled" do
+    # config.exs turns off native_lease_watcher so udhcpd lease files are parsed on notify
+    refute LeaseWatcher.available?()
+    assert LeaseWatcher.notify_file?()
+    assert LeaseWatcher.watch("eth0", "/tmp/udhcpd.eth0.leases") == :ok
+    assert LeaseWatcher.unwatch("eth0") == :ok
+    assert VintageNet.get(["interface", "eth0", "dhcpd", "leases"]) == nil
+  end
+
+  describe "lease reports" do
+    setup do
+      on_exit(fn -> PropertyTable.delete(VintageNet, @property) end)
+
+      # The port isn't used when handling reports, so a ref stands in for it
+      %{state: %{port: make_ref(), leases: %{@ifname => %{}}}}
+    end
+
+    test "added leases are published", %{state: state} do
+      report(state, {:leases, @ifname, [@alpha, @beta], [], []})
+
+      assert leases() == [@alpha, @beta]
+    end
+
+    test "renewed leases replace the old ones", %{state: state} do
+      renewed = %{@alpha | leasetime: 3590, expires: 5000}
+
+      state
+      |> report({:leases, @ifname, [@alpha, @beta], [], []})
+      |> report({:leases, @ifname, [], [], [renewed]})
+
+      assert leases() == [@beta, renewed]
+    end
+
+    test "removed leases are dropped", %{state: state} do
+      state
+      |> report({:leases, @ifname, [@alpha, @beta], [], []})
+      |> report({:leases, @ifname, [], [@alpha], []})
+
+      assert leases() == [@beta]
+    end
+
+    test "reports for unwatched interfaces are ignored", %{state: state} do
+      new_state = report(state, {:leases, "other0", [@alpha], [], []})
+
+      assert new_state == state
+      assert VintageNet.get(["interface", "other0", "dhcpd", "leases"]) == nil
+    end
+
+    test "errors are logged", %{state: state} do
+      log =
+        capture_log(fn ->
+          assert report(state, {:error, @ifname, "No such file or directory"}) == state
+        end)
+
+      assert log =~ "lease_watcher(#{@ifname}): No such file or directory"
+    end
+  end
+
+  describe "lease_watcher port" do
+    @describetag :requires_lease_watcher
+
+    setup context do
+      # Run the tests with the application stopped.
+      capture_log(fn ->
+        Application.stop(:vintage_net)
+      end)
+
+      start_supervised!({PropertyTable, name: VintageNet, tuple_events: true})
+      on_exit(fn -> Application.start(:vintage_net) end)
+
+      Application.put_env(:vintage_net, :native_lease_watcher, true)
+      on_exit(fn -> Application.put_env(:vintage_net, :native_lease_watcher, false) end)
+      start_supervised!(LeaseWatcher)
+
+      dir = Path.join("test/tmp", to_string(context.test))
+      File.mkdir_p!(dir)
+
+      %{lease_file: Path.join(dir, "udhcpd.#{@ifname}.leases")}
+    end
+
+    test "only changed leases are reported", %{lease_file: lease_file} do
+      VintageNet.subscribe(@property)
+      assert LeaseWatcher.available?()
+
+      write_leases(lease_file, 1000, [{@alpha, 3600}, {@beta, 3600}])
+      :ok = LeaseWatcher.watch(@ifname, lease_file)
+
+      assert_receive {VintageNet, @property, nil, leases, _meta}, 1000
+      assert Enum.sort(leases) == [@alpha, @beta]
+
+      # udhcpd saving less time left on the same leases isn't a change
+      write_leases(lease_file, 1010, [{@alpha, 3590}, {@beta, 3590}])
+      refute_receive {VintageNet, @property, _old, _new, _meta}, 250
+
+      # Renew alpha and drop beta
+      write_leases(lease_file, 1020, [{@alpha, 3600}])
+      assert_receive {VintageNet, @property, _old, [renewed], _meta}, 1000
+      assert renewed == %{@alpha | expires: 4620}
+
+      :ok = LeaseWatcher.unwatch(@ifname)
+      assert_receive {VintageNet, @property, [^renewed], nil, _meta}
+    end
+
+    test "custom udhcpd handlers still get notified" do
+      assert Application.get_env(:vintage_net, :udhcpd_handler) != VintageNet.Interface.Udhcpd
+      assert LeaseWatcher.available?()
+      assert LeaseWatcher.notify_file?()
+    end
+  end
+
+  # Write a lease file like udhcpd does
+  defp write_leases(path, timestamp, leases) do
+    records =
+      for {lease, leasetime} <- leases do
+        {:ok, {a, b, c, d}} = :inet.parse_address(to_charlist(lease.lease_nip))
+
+        mac =
+          for hex <- String.split(lease.lease_mac, ":"),
+              into: <<>>,
+              do: <<String.to_integer(hex, 16)>>
+
+        hostname = String.pad_trailing(lease.hostname, 20, <<0>>)
+        <<leasetime::32, a, b, c, d, mac::binary, hostname::binary, 0, 0>>
+      end
+
+    File.write!(path, [<<timestamp::64>> | records])
+  end
+end
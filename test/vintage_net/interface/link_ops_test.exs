@@ -0,0 +1,51 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Interface.LinkOpsTest do
+  use ExUnit.Case
+
+  alias VintageNet.Interface.{CommandRunner, LinkOps}
+
+  test "converts to ip commands" do
+    ops = [
+      {:flush_addresses, "eth0", "eth0"},
+      {:add_address, "eth0", {192, 168, 1, 2}, 24, broadcast: {192, 168, 1, 255}, label: "eth0"},
+      {:add_address, "eth0", {192, 168, 2, 2}, 24, []},
+      {:link_up, "eth0"},
+      {:link_down, "eth0"}
+    ]
+
+    assert LinkOps.to_commands(ops) == [
+             {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
+             {:run, "ip",
+              [
+                "addr",
+                "add",
+                "192.168.1.2/24",
+                "dev",
+                "eth0",
+                "broadcast",
+                "192.168.1.255",
+                "label",
+                "eth0"
+              ]},
+             {:run, "ip", ["addr", "add", "192.168.2.2/24", "dev", "eth0"]},
+             {:run, "ip", ["link", "set", "eth0", "up"]},
+             {:run, "ip", ["link", "set", "eth0", "down"]}
+           ]
+  end
+
+  test "unavailable when netlink_ctl isn't running" do
+    # config.exs turns off native_routes so that tests don't modify the host
+    assert LinkOps.run([{:link_up, "eth0"}]) == :unavailable
+  end
+
+  test "CommandRunner falls back to ip" do
+    # The test ip command always fails, but flush errors are ignored
+    assert CommandRunner.run({:link_ops, [{:flush_addresses, "eth0", "eth0"}]}) == :ok
+
+    ops = [{:flush_addresses, "eth0", "eth0"}, {:link_up, "eth0"}]
+    assert {:error, _} = CommandRunner.run({:link_ops, ops})
+  end
+end
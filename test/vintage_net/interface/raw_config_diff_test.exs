@@ -0,0 +1,129 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Interface.RawConfigDiffTest do
+  use ExUnit.Case
+
+  alias VintageNet.Interface.RawConfig
+  alias VintageNet.Interface.RawConfigDiff
+
+  defp static_config(opts) do
+    %RawConfig{
+      ifname: "eth0",
+      type: VintageNet.Technology.Ethernet,
+      source_config: %{},
+      required_ifnames: ["eth0"],
+      files: Keyword.get(opts, :files, []),
+      restart_strategy: Keyword.get(opts, :restart_strategy, :one_for_all),
+      child_specs: Keyword.get(opts, :child_specs, []),
+      up_cmds: [
+        {:link_ops, [{:add_address, "eth0", {192, 168, 1, 2}, 24, []}, {:link_up, "eth0"}]},
+        Keyword.get(opts, :route, {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]}),
+        Keyword.get(opts, :resolver, {:fun, VintageNet.NameResolver, :clear, ["eth0"]})
+      ],
+      down_cmds: [
+        {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
+        {:link_ops, [{:link_down, "eth0"}]}
+      ]
+    }
+  end
+
+  defp daemon(id, conf), do: Supervisor.child_spec({Task, [:daemon, ["-c", conf]]}, id: id)
+
+  test "identical configurations don't change anything" do
+    config = static_config(child_specs: [daemon(:a, "/tmp/a.conf")])
+
+    assert {:ok, diff} = RawConfigDiff.diff(config, config)
+    assert diff == %RawConfigDiff{files: [], removed_files: [], up_cmds: [], children: :unchanged}
+  end
+
+  test "only changed replacing commands are run" do
+    old = static_config([])
+
+    new =
+      static_config(
+        route: {:fun, VintageNet.RouteManager, :set_route, ["eth0", [], {192, 168, 1, 1}]},
+        resolver: {:fun, VintageNet.NameResolver, :setup, ["eth0", nil, [{1, 1, 1, 1}]]}
+      )
+
+    assert {:ok, diff} = RawConfigDiff.diff(old, new)
+
+    assert diff.up_cmds == [
+             {:fun, VintageNet.RouteManager, :set_route, ["eth0", [], {192, 168, 1, 1}]},
+             {:fun, VintageNet.NameResolver, :setup, ["eth0", nil, [{1, 1, 1, 1}]]}
+           ]
+
+    newer = static_config(resolver: {:fun, VintageNet.NameResolver, :clear, ["eth0"]})
+    assert {:ok, diff} = RawConfigDiff.diff(new, newer)
+
+    assert diff.up_cmds == [
+             {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
+             {:fun, VintageNet.NameResolver, :clear, ["eth0"]}
+           ]
+  end
+
+  test "other command changes need a full reconfigure" do
+    old = static_config([])
+
+    new_address = {:link_ops, [{:add_address, "eth0", {192, 168, 1, 3}, 24, []}]}
+    new = %{old | up_cmds: [new_address | tl(old.up_cmds)]}
+
+    assert RawConfigDiff.diff(old, new) == :full
+    assert RawConfigDiff.diff(old, %{old | type: VintageNet.Technology.Null}) == :full
+    assert RawConfigDiff.diff(old, %{old | required_ifnames: []}) == :full
+    assert RawConfigDiff.diff(old, %{old | down_cmds: []}) == :full
+  end
+
+  test "changed files restart children that use them" do
+    children = [daemon(:a, "/tmp/a.conf"), daemon(:b, "/tmp/b.conf"), daemon(:c, "/tmp/c.conf")]
+
+    old =
+      static_config(
+        files: [{"/tmp/a.conf", "a"}, {"/tmp/b.conf", "b"}, {"/tmp/old.conf", ""}],
+        child_specs: children,
+        restart_strategy: :one_for_one
+      )
+
+    new = %{old | files: [{"/tmp/a.conf", "a"}, {"/tmp/b.conf", "b2"}]}
+
+    assert {:ok, diff} = RawConfigDiff.diff(old, new)
+    assert diff.files == [{"/tmp/b.conf", "b2"}]
+    assert diff.removed_files == [{"/tmp/old.conf", ""}]
+    assert diff.up_cmds == []
+    assert diff.children == {[:b], [daemon(:b, "/tmp/b.conf")]}
+  end
+
+  test "commands that use changed files need a full reconfigure" do
+    old = static_config(files: [{"/tmp/a.conf", "a"}])
+    old = %{old | up_cmds: old.up_cmds ++ [{:run, "load", ["/tmp/a.conf"]}]}
+
+    assert RawConfigDiff.diff(old, %{old | files: [{"/tmp/a.conf", "a2"}]}) == :full
+  end
+
+  test "children restart according to the restart strategy" do
+    old_children = [daemon(:a, "a"), daemon(:b, "b"), daemon(:c, "c")]
+    new_children = [daemon(:a, "a"), daemon(:b, "b2"), daemon(:c, "c")]
+
+    diff = fn strategy ->
+      {:ok, diff} =
+        RawConfigDiff.diff(
+          static_config(child_specs: old_children, restart_strategy: strategy),
+          static_config(child_specs: new_children, restart_strategy: strategy)
+        )
+
+      diff.children
+    end
+
+    assert diff.(:one_for_one) == {[:b], [daemon(:b, "b2")]}
+    assert diff.(:rest_for_one) == {[:c, :b], [daemon(:b, "b2"), daemon(:c, "c")]}
+    assert diff.(:one_for_all) == :restart
+  end
+
+  test "adding children restarts all of them" do
+    old = static_config(child_specs: [daemon(:a, "a")], restart_strategy: :one_for_one)
+    new = %{old | child_specs: [daemon(:a, "a"), daemon(:b, "b")]}
+
+    assert {:ok, %{children: :restart}} = RawConfigDiff.diff(old, new)
+  end
+end
@@ -342,6 +342,85 @@ defmodule VintageNet.InterfaceTest do
     end)
   end
 
+  test "reconfigure updates in place when possible", context do
+    capture_log_in_tmp(context.test, fn ->
+      child = {Task, fn -> Process.register(self(), ItIsMe) && Process.sleep(:infinity) end}
+
+      config1 = %{
+        type: @interface_type,
+        files: [{"first", "1"}],
+        child_specs: [child],
+        up_cmds: [{:run, "touch", ["ran_up"]}],
+        down_cmds: [{:run, "touch", ["ran_down"]}]
+      }
+
+      configure_and_wait(config1)
+      child_pid = Process.whereis(ItIsMe)
+      assert child_pid
+
+      property = ["interface", @ifname, "state"]
+      VintageNet.subscribe(property)
+      File.rm!("ran_up")
+
+      assert :ok == Interface.configure(@ifname, %{config1 | files: [{"first", "2"}]})
+      assert :ok == Interface.wait_until_configured(@ifname)
+
+      assert File.read!("first") == "2"
+      refute File.exists?("ran_down")
+      refute File.exists?("ran_up")
+      assert Process.whereis(ItIsMe) == child_pid
+      assert_received {VintageNet, ^property, :configured, :updating, _meta}
+      assert_received {VintageNet, ^property, :updating, :configured, _meta}
+    end)
+  end
+
+  test "updates restart the technology if a child doesn't start", context do
+    capture_log_in_tmp(context.test, fn ->
+      {:ok, attempts} = Agent.start_link(fn -> 0 end)
+      child = fn arg -> %{id: :flaky, start: {__MODULE__, :start_flaky, [attempts, arg]}} end
+
+      config1 = %{type: @interface_type, restart_strategy: :one_for_one, child_specs: [child.(1)]}
+
+      configure_and_wait(config1)
+      assert Agent.get(attempts, & &1) == 1
+
+      assert :ok == Interface.configure(@ifname, %{config1 | child_specs: [child.(2)]})
+      assert :ok == Interface.wait_until_configured(@ifname)
+
+      # The updated child fails to start and then starts with everything else
+      assert Agent.get(attempts, & &1) == 3
+    end)
+  end
+
+  test "running commands reports telemetry", context do
+    capture_log_in_tmp(context.test, fn ->
+      :telemetry.attach(
+        context.test,
+        [:vintage_net, :interface, :commands],
+        &__MODULE__.handle_telemetry/4,
+        self()
+      )
+
+      on_exit(fn -> :telemetry.detach(context.test) end)
+
+      config = %{
+        type: @interface_type,
+        up_cmds: [{:run, "touch", ["ran_up"]}, {:run, "true", []}],
+        down_cmds: [{:run, "false", []}]
+      }
+
+      configure_and_wait(config)
+
+      assert_receive {:telemetry, [:vintage_net, :interface, :commands], %{count: 2},
+                      %{ifname: @ifname, phase: :up, result: :ok}}
+
+      :ok = VintageNet.deconfigure(@ifname)
+
+      assert_receive {:telemetry, [:vintage_net, :interface, :commands], %{count: 1},
+                      %{ifname: @ifname, phase: :down, result: :error}}
+    end)
+  end
+
   test "configuring while configuring command", context do
     capture_log_in_tmp(context.test, fn ->
       # Start configuring the first one - it will hang
@@ -693,4 +772,15 @@ defmodule VintageNet.InterfaceTest do
       assert TPM.call_count(@ifname, :power_off) == 1
     end)
   end
+
+  def start_flaky(attempts, _arg) do
+    case Agent.get_and_update(attempts, &{&1 + 1, &1 + 1}) do
+      2 -> {:error, :flaky}
+      _ -> Task.start_link(fn -> Process.sleep(:infinity) end)
+    end
+  end
+
+  def handle_telemetry(event, measurements, metadata, pid) do
+    send(pid, {:telemetry, event, measurements, metadata})
+  end
 end
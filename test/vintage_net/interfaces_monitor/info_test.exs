@@ -9,7 +9,7 @@ defmodule VintageNet.InterfacesMonitor.InfoTest do
 
   test "new interfaces don't have link information or addresses" do
     info = Info.new("eth0")
-    assert info == %VintageNet.InterfacesMonitor.Info{addresses: [], ifname: "eth0", link: %{}}
+    assert info == %VintageNet.InterfacesMonitor.Info{addresses: %{}, ifname: "eth0", link: %{}}
   end
 
   test "newlink reports replace the link information" do
@@ -21,27 +21,62 @@ defmodule VintageNet.InterfacesMonitor.InfoTest do
     assert after_info.link == example_link_report("after_mac", true)
   end
 
+  test "updatelink reports merge into the link information" do
+    info =
+      Info.new("eth0")
+      |> Info.newlink(example_link_report("before_mac", true))
+      |> Info.updatelink(%{up: false, mac_address: "after_mac"})
+
+    assert info.link == example_link_report("after_mac", false)
+
+    info = Info.updatelink(info, %{mtu: nil})
+    refute Map.has_key?(info.link, :mtu)
+  end
+
+  test "stats samples" do
+    sample =
+      <<1::64, 2::64, 3::64, 4::64, 5::64, 6::64, 7::64, 8::64, 9::64, 10::64, 11::64,
+        12::64>>
+
+    assert [{["interface", "eth0", "stats"], stats}] = Info.stats_properties("eth0", sample)
+
+    assert stats == %{
+             rx_bytes: 1,
+             tx_bytes: 2,
+             rx_packets: 3,
+             tx_packets: 4,
+             rx_errors: 5,
+             tx_errors: 6,
+             rx_dropped: 7,
+             tx_dropped: 8,
+             rx_bytes_per_sec: 9,
+             tx_bytes_per_sec: 10,
+             rx_packets_per_sec: 11,
+             tx_packets_per_sec: 12
+           }
+  end
+
   test "newaddr and deladdr" do
     info = Info.new("eth0")
 
-    info = Info.newaddr(info, example_ipv4_report(1))
-    assert info.addresses == [example_ipv4_report(1)]
+    info = Info.newaddr(info, example_ipv4_report(1), 0)
+    assert Info.addresses(info) == [example_ipv4_report(1)]
 
     info = Info.deladdr(info, example_ipv4_report(1))
-    assert info.addresses == []
+    assert Info.addresses(info) == []
   end
 
   test "multiple addresses" do
     info =
       Info.new("eth0")
-      |> Info.newaddr(example_ipv4_report(1))
-      |> Info.newaddr(example_ipv4_report(2))
-      |> Info.newaddr(example_ipv4_report(3))
-      |> Info.newaddr(example_ipv6_report(4))
-      |> Info.newaddr(example_ipv6_report(5))
+      |> Info.newaddr(example_ipv4_report(1), 0)
+      |> Info.newaddr(example_ipv4_report(2), 0)
+      |> Info.newaddr(example_ipv4_report(3), 0)
+      |> Info.newaddr(example_ipv6_report(4), 0)
+      |> Info.newaddr(example_ipv6_report(5), 0)
       |> Info.deladdr(example_ipv4_report(2))
 
-    assert info.addresses == [
+    assert Info.addresses(info) == [
              example_ipv6_report(5),
              example_ipv6_report(4),
              example_ipv4_report(3),
@@ -49,22 +84,132 @@ defmodule VintageNet.InterfacesMonitor.InfoTest do
            ]
   end
 
+  test "repeated and unknown address reports don't change anything" do
+    info = Info.newaddr(Info.new("eth0"), example_ipv6_report(1), 0)
+
+    assert Info.newaddr(info, example_ipv6_report(1), 0) === info
+    assert Info.deladdr(info, example_ipv6_report(2)) === info
+    assert Info.delete_ipv4_addresses(info) === info
+  end
+
+  test "address lifetimes are published as deadlines" do
+    report = Map.merge(example_ipv6_report(1), %{preferred_lft: 3600, valid_lft: :infinity})
+    info = Info.newaddr(Info.new("eth0"), report, 1000)
+
+    assert [%{preferred_until: 3_601_000, valid_until: :infinity} = address] =
+             Info.addresses(info)
+
+    refute Map.has_key?(address, :preferred_lft)
+
+    # Lifetimes that only counted down don't change the deadlines
+    assert Info.newaddr(info, %{report | preferred_lft: 3590}, 11_500) === info
+
+    # Refreshed lifetimes do
+    info = Info.newaddr(info, report, 61_000)
+
+    assert [{["interface", "eth0", "addresses"], [address_info]}] =
+             Info.address_properties(info)
+
+    assert %{preferred_until: 3_661_000, valid_until: :infinity} = address_info
+  end
+
+  test "addresses with different prefix lengths are different" do
+    info =
+      Info.new("eth0")
+      |> Info.newaddr(example_ipv4_report(1), 0)
+      |> Info.newaddr(%{example_ipv4_report(1) | prefixlen: 16}, 0)
+      |> Info.deladdr(example_ipv4_report(1))
+
+    assert Info.addresses(info) == [%{example_ipv4_report(1) | prefixlen: 16}]
+  end
+
   test "removing all ipv4" do
     info =
       Info.new("eth0")
-      |> Info.newaddr(example_ipv4_report(1))
-      |> Info.newaddr(example_ipv4_report(2))
-      |> Info.newaddr(example_ipv4_report(3))
-      |> Info.newaddr(example_ipv6_report(4))
-      |> Info.newaddr(example_ipv6_report(5))
+      |> Info.newaddr(example_ipv4_report(1), 0)
+      |> Info.newaddr(example_ipv4_report(2), 0)
+      |> Info.newaddr(example_ipv4_report(3), 0)
+      |> Info.newaddr(example_ipv6_report(4), 0)
+      |> Info.newaddr(example_ipv6_report(5), 0)
       |> Info.delete_ipv4_addresses()
 
-    assert info.addresses == [
+    assert Info.addresses(info) == [
              example_ipv6_report(5),
              example_ipv6_report(4)
            ]
   end
 
+  test "retaining addresses" do
+    info =
+      Info.new("eth0")
+      |> Info.newaddr(example_ipv4_report(1), 0)
+      |> Info.newaddr(example_ipv4_report(2), 0)
+      |> Info.newaddr(example_ipv6_report(3), 0)
+      |> Info.retain_addresses(
+        MapSet.new([
+          {:inet, {192, 168, 10, 2}, 24},
+          {:inet6, {65152, 0, 0, 0, 45461, 64234, 43649, 3}, 64}
+        ])
+      )
+
+    assert Info.addresses(info) == [example_ipv6_report(3), example_ipv4_report(2)]
+  end
+
+  test "gateway reachability reports the best gateway" do
+    info = Info.new("eth0")
+    assert Info.gateway_properties(info) == [{["interface", "eth0", "gateway_reachability"], nil}]
+
+    info =
+      info
+      |> Info.gateway(%{address: {192, 168, 1, 1}, state: :failed})
+      |> Info.gateway(%{address: {65152, 0, 0, 0, 0, 0, 0, 1}, state: :stale})
+
+    assert Info.gateway_properties(info) == [
+             {["interface", "eth0", "gateway_reachability"], :stale}
+           ]
+
+    info = Info.gateway(info, %{address: {65152, 0, 0, 0, 0, 0, 0, 1}, state: nil})
+
+    assert Info.gateway_properties(info) == [
+             {["interface", "eth0", "gateway_reachability"], :failed}
+           ]
+
+    assert Info.clear_gateways(info).gateways == %{}
+  end
+
+  test "router advertisement prefixes expire" do
+    info = Info.new("eth0")
+    assert Info.next_prefix_expiry(info) == nil
+    assert Info.prefix_properties(info) == [{["interface", "eth0", "ipv6_prefixes"], nil}]
+
+    info =
+      info
+      |> Info.newprefix(example_prefix_report(1, 7200), 1000)
+      |> Info.newprefix(example_prefix_report(2, :infinity), 1000)
+      |> Info.newprefix(example_prefix_report(3, 60), 1000)
+
+    assert Info.next_prefix_expiry(info) == 61_000
+
+    assert [{["interface", "eth0", "ipv6_prefixes"], [first, _, _]}] =
+             Info.prefix_properties(info)
+
+    assert first == %{
+             prefix: {8193, 3512, 1, 0, 0, 0, 0, 0},
+             prefix_length: 64,
+             on_link: true,
+             autoconf: true
+           }
+
+    assert Info.expire_prefixes(info, 60_999) === info
+
+    info = Info.expire_prefixes(info, 61_000)
+    assert Info.next_prefix_expiry(info) == 7_201_000
+
+    info = Info.newprefix(info, example_prefix_report(1, 0), 2000)
+    assert Info.next_prefix_expiry(info) == nil
+    assert map_size(info.prefixes) == 1
+  end
+
   defp example_link_report(mac_address, up) do
     %{
       broadcast: true,
@@ -114,4 +259,16 @@ defmodule VintageNet.InterfacesMonitor.InfoTest do
       scope: :link
     }
   end
+
+  defp example_prefix_report(index, valid_lft) do
+    %{
+      autoconf: true,
+      family: :inet6,
+      on_link: true,
+      preferred_lft: valid_lft,
+      prefix: {8193, 3512, index, 0, 0, 0, 0, 0},
+      prefixlen: 64,
+      valid_lft: valid_lft
+    }
+  end
 end
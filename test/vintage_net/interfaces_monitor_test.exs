@@ -41,6 +41,102 @@ defmodule VintageNet.InterfacesMonitorTest do
     assert_receive {VintageNet, ["interface", "bogus0", "present"], true, nil, %{}}
   end
 
+  test "batched reports only publish final values" do
+    VintageNet.subscribe(["interface", "bogus0", "present"])
+    VintageNet.subscribe(["interface", "bogus0", "lower_up"])
+
+    send_report([
+      {:newlink, "bogus0", 56, %{lower_up: false}},
+      {:newlink, "bogus0", 56, %{lower_up: true}},
+      {:newlink, "bogus0", 56, %{lower_up: false}},
+      {:newlink, "bogus0", 56, %{lower_up: true}}
+    ])
+
+    assert_receive {VintageNet, ["interface", "bogus0", "present"], nil, true, %{}}
+    assert_receive {VintageNet, ["interface", "bogus0", "lower_up"], nil, true, %{}}
+    refute_receive {VintageNet, ["interface", "bogus0", "lower_up"], _, _, %{}}
+
+    send_report([{:newlink, "bogus1", 57, %{}}, {:dellink, "bogus0", 56, %{}}])
+    assert_receive {VintageNet, ["interface", "bogus0", "present"], true, nil, %{}}
+    assert VintageNet.get(["interface", "bogus1", "present"]) == true
+  end
+
+  test "link updates only change what's reported" do
+    VintageNet.subscribe(["interface", "bogus0", "lower_up"])
+    VintageNet.subscribe(["interface", "bogus0", "mac_address"])
+
+    send_report({:newlink, "bogus0", 56, %{lower_up: false, mac_address: "70:85:c2:8f:98:e1"}})
+    assert_receive {VintageNet, ["interface", "bogus0", "lower_up"], nil, false, %{}}
+    assert_receive {VintageNet, ["interface", "bogus0", "mac_address"], nil, _, %{}}
+
+    send_report({:updatelink, "bogus0", 56, %{lower_up: true}})
+    assert_receive {VintageNet, ["interface", "bogus0", "lower_up"], false, true, %{}}
+    refute_receive {VintageNet, ["interface", "bogus0", "mac_address"], _, _, %{}}
+
+    send_report({:updatelink, "bogus0", 56, %{mac_address: nil}})
+    assert_receive {VintageNet, ["interface", "bogus0", "mac_address"], _, nil, %{}}
+  end
+
+  test "resyncing removes interfaces and addresses that went away" do
+    VintageNet.subscribe(["interface", "bogus0", "present"])
+    VintageNet.subscribe(["interface", "bogus1", "addresses"])
+
+    send_report({:newlink, "bogus0", 56, %{}})
+    send_report({:newlink, "bogus1", 57, %{}})
+    send_report({:newaddr, 57, ipv4_report({192, 168, 9, 5})})
+    send_report({:newaddr, 57, ipv4_report({192, 168, 10, 10})})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "present"], nil, true, %{}}
+    assert_receive {VintageNet, ["interface", "bogus1", "addresses"], _, [_, _], %{}}
+
+    send_report([
+      :resync,
+      {:newlink, "bogus1", 57, %{}},
+      {:newaddr, 57, ipv4_report({192, 168, 10, 10})},
+      :synced
+    ])
+
+    assert_receive {VintageNet, ["interface", "bogus0", "present"], true, nil, %{}}
+
+    assert_receive {VintageNet, ["interface", "bogus1", "addresses"], _,
+                    [%{address: {192, 168, 10, 10}}], %{}}
+  end
+
+  @tag :requires_interfaces_monitor
+  test "routes and rules are observed" do
+    # Wait for the initial report so that it doesn't replace the test's routes
+    {:ok, _observed} = InterfacesMonitor.observed_routes()
+
+    send_report([
+      {:newlink, "bogus0", 56, %{}},
+      {:newroute,
+       %{
+         family: :inet,
+         table: 254,
+         dst_len: 0,
+         scope: :universe,
+         type: :unicast,
+         protocol: 3,
+         gateway: {192, 168, 9, 1},
+         oif: 56,
+         priority: 10
+       }},
+      {:newrule,
+       %{family: :inet, table: 100, action: 1, src_len: 32, dst_len: 0, src: {192, 168, 9, 5}}}
+    ])
+
+    {:ok, observed} = InterfacesMonitor.observed_routes()
+    assert {:default_route, "bogus0", {192, 168, 9, 1}, 10, :main} in observed
+    assert {:rule, 100, {192, 168, 9, 5}} in observed
+
+    # Routes go away with their interface, but rules don't
+    send_report({:dellink, "bogus0", 56, %{}})
+
+    {:ok, observed} = InterfacesMonitor.observed_routes()
+    refute {:default_route, "bogus0", {192, 168, 9, 1}, 10, :main} in observed
+    assert {:rule, 100, {192, 168, 9, 5}} in observed
+  end
+
   test "renaming links" do
     VintageNet.subscribe(["interface", "bogus0", "present"])
     VintageNet.subscribe(["interface", "bogus2", "present"])
@@ -53,6 +149,19 @@ defmodule VintageNet.InterfacesMonitorTest do
     assert_receive {VintageNet, ["interface", "bogus2", "present"], nil, true, %{}}
   end
 
+  test "hw_path comes from link reports" do
+    VintageNet.subscribe(["interface", "bogus0", "hw_path"])
+
+    send_report({:newlink, "bogus0", 56, %{hw_path: "/devices/platform/soc/usb1/1-1/1-1:1.0"}})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "hw_path"], nil,
+                    "/devices/platform/soc/usb1/1-1/1-1:1.0", %{}}
+
+    # Link reports without it don't change it
+    send_report({:updatelink, "bogus0", 56, %{lower_up: true}})
+    refute_receive {VintageNet, ["interface", "bogus0", "hw_path"], _, _, %{}}
+  end
+
   test "link fields show up as properties" do
     # When adding support for fields, remember to add them to the docs
     fields = [{"present", true}, {"lower_up", true}, {"mac_address", "70:85:c2:8f:98:e1"}]
@@ -240,6 +349,115 @@ defmodule VintageNet.InterfacesMonitorTest do
                     [^expected_address_info], %{}}
   end
 
+  test "ipv6 address state gets reported" do
+    VintageNet.subscribe(["interface", "bogus0", "addresses"])
+
+    send_report({:newlink, "bogus0", 56, %{}})
+
+    report = %{
+      address: {8193, 3512, 1, 0, 26862, 36095, 65112, 5455},
+      dadfailed: false,
+      deprecated: false,
+      family: :inet6,
+      permanent: false,
+      preferred_lft: 3600,
+      prefixlen: 64,
+      scope: :universe,
+      tentative: true,
+      valid_lft: 7200
+    }
+
+    send_report({:newaddr, 56, report})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "addresses"], _before,
+                    [%{scope: :universe, state: :tentative}], %{}}
+
+    send_report({:newaddr, 56, %{report | tentative: false, preferred_lft: 3599}})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "addresses"], _before,
+                    [%{state: :preferred}], %{}}
+
+    # Lifetime refreshes don't change anything
+    send_report({:newaddr, 56, %{report | tentative: false, preferred_lft: 3598}})
+    refute_receive {VintageNet, ["interface", "bogus0", "addresses"], _before, _after, %{}}
+
+    send_report({:newaddr, 56, %{report | tentative: false, deprecated: true, preferred_lft: 0}})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "addresses"], _before,
+                    [%{state: :deprecated}], %{}}
+  end
+
+  test "ipv6 address lifetimes get reported as deadlines" do
+    VintageNet.subscribe(["interface", "bogus0", "addresses"])
+
+    send_report({:newlink, "bogus0", 56, %{}})
+
+    now = System.monotonic_time(:millisecond)
+
+    send_report(
+      {:newaddr, 56,
+       %{
+         address: {8193, 3512, 1, 0, 26862, 36095, 65112, 5455},
+         dadfailed: false,
+         deprecated: false,
+         family: :inet6,
+         permanent: false,
+         preferred_lft: 3600,
+         prefixlen: 64,
+         scope: :universe,
+         tentative: false,
+         valid_lft: :infinity
+       }}
+    )
+
+    assert_receive {VintageNet, ["interface", "bogus0", "addresses"], _before,
+                    [%{preferred_until: preferred_until, valid_until: :infinity}], %{}}
+
+    assert_in_delta preferred_until, now + 3_600_000, 1000
+  end
+
+  test "router advertisement prefixes get reported" do
+    VintageNet.subscribe(["interface", "bogus0", "ipv6_prefixes"])
+
+    send_report({:newlink, "bogus0", 56, %{}})
+
+    report = %{
+      autoconf: true,
+      family: :inet6,
+      on_link: true,
+      preferred_lft: 3600,
+      prefix: {8193, 3512, 1, 0, 0, 0, 0, 0},
+      prefixlen: 64,
+      valid_lft: 7200
+    }
+
+    send_report({:newprefix, 56, report})
+
+    expected_prefix_info = %{
+      prefix: {8193, 3512, 1, 0, 0, 0, 0, 0},
+      prefix_length: 64,
+      on_link: true,
+      autoconf: true
+    }
+
+    assert_receive {VintageNet, ["interface", "bogus0", "ipv6_prefixes"], nil,
+                    [^expected_prefix_info], %{}}
+
+    # Repeated advertisements don't change anything
+    send_report({:newprefix, 56, report})
+    refute_receive {VintageNet, ["interface", "bogus0", "ipv6_prefixes"], _before, _after, %{}}
+
+    # A valid lifetime of 0 removes the prefix and short ones expire
+    send_report({:newprefix, 56, %{report | valid_lft: 0}})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "ipv6_prefixes"], [_], nil, %{}}
+
+    send_report({:newprefix, 56, %{report | preferred_lft: 0, valid_lft: 1}})
+
+    assert_receive {VintageNet, ["interface", "bogus0", "ipv6_prefixes"], nil, [_], %{}}
+    assert_receive {VintageNet, ["interface", "bogus0", "ipv6_prefixes"], [_], nil, %{}}, 2000
+  end
+
   test "address report beats link report" do
     # Check that the address report isn't lost if it arrives before
     # the initial link report
@@ -349,11 +567,93 @@ defmodule VintageNet.InterfacesMonitorTest do
     refute_receive _
   end
 
+  @tag :requires_interfaces_monitor
+  test "if_monitor reports its counters" do
+    assert {:ok, counters} = InterfacesMonitor.counters()
+
+    assert %{
+             collapsed: _,
+             dropped: 0,
+             overflows: 0,
+             netlink_overruns: _,
+             max_queued_bytes: _
+           } = counters
+  end
+
+  @tag :requires_interfaces_monitor
+  test "if_monitor reports netlink message counts" do
+    assert {:ok, stats} = InterfacesMonitor.netlink_stats()
+
+    assert %{receives: _, bytes: _, newlink: %{messages: _, bytes: _, parse_errors: 0}} = stats
+    assert stats.newlink.messages > 0
+  end
+
+  test "batches report telemetry" do
+    :telemetry.attach(
+      "batch-telemetry-test",
+      [:vintage_net, :interfaces_monitor, :batch],
+      &__MODULE__.handle_telemetry/4,
+      self()
+    )
+
+    on_exit(fn -> :telemetry.detach("batch-telemetry-test") end)
+
+    send_report([{:received, 0}, {:newlink, "bogus0", 56, %{}}, {:newlink, "bogus1", 57, %{}}])
+
+    assert_receive {:telemetry, [:vintage_net, :interfaces_monitor, :batch], measurements, %{}}
+    assert %{reports: 2, bytes: bytes, decode_duration: _, update_duration: _} = measurements
+    assert bytes > 0
+    refute Map.has_key?(measurements, :latency)
+  end
+
+  test "stats are only published for watched interfaces" do
+    VintageNet.subscribe(["interface", "bogus0", "stats"])
+    send_report({:newlink, "bogus0", 56, %{}})
+
+    sample = :binary.copy(<<1::64>>, 12)
+
+    # Not watched
+    send_report({:stats, "bogus0", 56, sample})
+    refute_receive {VintageNet, ["interface", "bogus0", "stats"], _, _, %{}}
+
+    :ok = InterfacesMonitor.watch_stats("bogus0")
+    send_report({:stats, "bogus0", 56, sample})
+    assert_receive {VintageNet, ["interface", "bogus0", "stats"], nil, stats, %{}}
+    assert stats.rx_bytes == 1
+    assert stats.tx_packets_per_sec == 1
+
+    # Stats go away with the last watcher
+    :ok = InterfacesMonitor.unwatch_stats("bogus0")
+    assert_receive {VintageNet, ["interface", "bogus0", "stats"], ^stats, nil, %{}}
+  end
+
+  test "watching stats is limited to 32 interfaces" do
+    for i <- 1..32 do
+      assert :ok = InterfacesMonitor.watch_stats("bogus#{i}")
+    end
+
+    assert {:error, :too_many_watches} = InterfacesMonitor.watch_stats("bogus33")
+
+    # Watching the same interface again is fine
+    assert :ok = InterfacesMonitor.watch_stats("bogus1")
+
+    :ok = InterfacesMonitor.unwatch_stats("bogus1")
+    assert :ok = InterfacesMonitor.watch_stats("bogus33")
+  end
+
+  def handle_telemetry(event, measurements, metadata, pid) do
+    send(pid, {:telemetry, event, measurements, metadata})
+  end
+
   defp get_interfaces() do
     {:ok, interface_infos} = :inet.getifaddrs()
     for {name, _info} <- interface_infos, do: to_string(name)
   end
 
+  defp ipv4_report(address) do
+    %{address: address, family: :inet, permanent: false, prefixlen: 24, scope: :universe}
+  end
+
   defp send_report(report) do
     # Simulate a report coming from C
     state = :sys.get_state(Process.whereis(VintageNet.InterfacesMonitor))
@@ -92,15 +92,46 @@ defmodule VintageNet.IP.IPv4ConfigTest do
         {VintageNet.Connectivity.InternetChecker, "eth0"}
       ],
       down_cmds: [
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip", ["link", "set", "eth0", "down"]}
+        {:link_ops, [{:flush_addresses, "eth0", "eth0"}, {:link_down, "eth0"}]}
       ],
-      up_cmds: [{:run, "ip", ["link", "set", "eth0", "up"]}]
+      up_cmds: [{:link_ops, [{:link_up, "eth0"}]}]
     }
 
     assert expected == IPv4Config.add_config(initial_raw_config, input, default_opts())
   end
 
+  @tag :requires_dhcp_client
+  test "ipv4 dhcp uses dhcp_client when native_dhcp is enabled" do
+    Application.put_env(:vintage_net, :native_dhcp, true)
+    on_exit(fn -> Application.put_env(:vintage_net, :native_dhcp, false) end)
+
+    input =
+      %{
+        hostname: "unit_test",
+        ipv4: %{method: :dhcp, dhcp_request_options: ["wpad"]}
+      }
+      |> IPv4Config.normalize()
+
+    initial_raw_config = %VintageNet.Interface.RawConfig{
+      ifname: "eth0",
+      source_config: input,
+      type: UnitTest,
+      required_ifnames: ["eth0"]
+    }
+
+    raw_config = IPv4Config.add_config(initial_raw_config, input, default_opts())
+
+    assert raw_config.child_specs == [
+             %{
+               id: :dhcp_client,
+               start:
+                 {VintageNet.Interface.DHCPClient, :start_link,
+                  [[ifname: "eth0", hostname: "unit_test", request_options: ["wpad"]]]}
+             },
+             {VintageNet.Connectivity.InternetChecker, "eth0"}
+           ]
+  end
+
   test "ipv4 dhcp default normalizes without :dhcp_request_options" do
     # Unspecified :dhcp_request_options should round-trip as a bare :dhcp config,
     # not gain an empty list — preserves the existing normalized shape.
@@ -152,10 +183,9 @@ defmodule VintageNet.IP.IPv4ConfigTest do
         {VintageNet.Connectivity.InternetChecker, "eth0"}
       ],
       down_cmds: [
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip", ["link", "set", "eth0", "down"]}
+        {:link_ops, [{:flush_addresses, "eth0", "eth0"}, {:link_down, "eth0"}]}
       ],
-      up_cmds: [{:run, "ip", ["link", "set", "eth0", "up"]}]
+      up_cmds: [{:link_ops, [{:link_up, "eth0"}]}]
     }
 
     assert expected == IPv4Config.add_config(initial_raw_config, input, default_opts())
@@ -194,24 +224,16 @@ defmodule VintageNet.IP.IPv4ConfigTest do
       down_cmds: [
         {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
         {:fun, VintageNet.NameResolver, :clear, ["eth0"]},
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip", ["link", "set", "eth0", "down"]}
+        {:link_ops, [{:flush_addresses, "eth0", "eth0"}, {:link_down, "eth0"}]}
       ],
       up_cmds: [
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip",
+        {:link_ops,
          [
-           "addr",
-           "add",
-           "192.168.1.2/24",
-           "dev",
-           "eth0",
-           "broadcast",
-           "192.168.1.255",
-           "label",
-           "eth0"
+           {:flush_addresses, "eth0", "eth0"},
+           {:add_address, "eth0", {192, 168, 1, 2}, 24,
+            broadcast: {192, 168, 1, 255}, label: "eth0"},
+           {:link_up, "eth0"}
          ]},
-        {:run, "ip", ["link", "set", "eth0", "up"]},
         {:fun, VintageNet.RouteManager, :set_route,
          ["eth0", [{{192, 168, 1, 2}, 24}], {192, 168, 1, 1}]},
         {:fun, VintageNet.NameResolver, :setup,
@@ -252,24 +274,16 @@ defmodule VintageNet.IP.IPv4ConfigTest do
       down_cmds: [
         {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
         {:fun, VintageNet.NameResolver, :clear, ["eth0"]},
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip", ["link", "set", "eth0", "down"]}
+        {:link_ops, [{:flush_addresses, "eth0", "eth0"}, {:link_down, "eth0"}]}
       ],
       up_cmds: [
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip",
+        {:link_ops,
          [
-           "addr",
-           "add",
-           "192.168.1.2/24",
-           "dev",
-           "eth0",
-           "broadcast",
-           "192.168.1.255",
-           "label",
-           "eth0"
+           {:flush_addresses, "eth0", "eth0"},
+           {:add_address, "eth0", {192, 168, 1, 2}, 24,
+            broadcast: {192, 168, 1, 255}, label: "eth0"},
+           {:link_up, "eth0"}
          ]},
-        {:run, "ip", ["link", "set", "eth0", "up"]},
         {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
         {:fun, VintageNet.NameResolver, :clear, ["eth0"]}
       ]
@@ -309,24 +323,16 @@ defmodule VintageNet.IP.IPv4ConfigTest do
       down_cmds: [
         {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
         {:fun, VintageNet.NameResolver, :clear, ["eth0"]},
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip", ["link", "set", "eth0", "down"]}
+        {:link_ops, [{:flush_addresses, "eth0", "eth0"}, {:link_down, "eth0"}]}
       ],
       up_cmds: [
-        {:run_ignore_errors, "ip", ["addr", "flush", "dev", "eth0", "label", "eth0"]},
-        {:run, "ip",
+        {:link_ops,
          [
-           "addr",
-           "add",
-           "192.168.1.2/24",
-           "dev",
-           "eth0",
-           "broadcast",
-           "192.168.1.255",
-           "label",
-           "eth0"
+           {:flush_addresses, "eth0", "eth0"},
+           {:add_address, "eth0", {192, 168, 1, 2}, 24,
+            broadcast: {192, 168, 1, 255}, label: "eth0"},
+           {:link_up, "eth0"}
          ]},
-        {:run, "ip", ["link", "set", "eth0", "up"]},
         {:fun, VintageNet.RouteManager, :clear_route, ["eth0"]},
         {:fun, VintageNet.NameResolver, :setup, ["eth0", nil, [{1, 2, 3, 4}]]}
       ]
@@ -0,0 +1,28 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.NetlinkCtlTest do
+  use ExUnit.Case
+
+  alias VintageNet.NetlinkCtl
+  alias VintageNet.Route.IPRoute
+
+  test "empty requests don't need the port" do
+    assert NetlinkCtl.run([]) == {:ok, []}
+  end
+
+  test "unavailable when disabled" do
+    # config.exs turns off native_routes so that tests don't modify the host
+    assert NetlinkCtl.run([{:delrule, %{table: 100}}]) == :unavailable
+  end
+
+  test "IPRoute falls back to ip with one result per operation" do
+    # The test ip command always fails
+    assert [{:error, _}, {:error, _}] =
+             IPRoute.run_all([
+               {:add_default_route, "eth0", {192, 168, 1, 1}, 10, :main},
+               {:clear_a_rule, 100}
+             ])
+  end
+end
@@ -119,4 +119,14 @@ defmodule VintageNet.Persistence.FlatFileTest do
 
     assert ["wlan0"] == FlatFile.enumerate()
   end
+
+  test "hidden files aren't enumerated" do
+    persistence_dir = Application.get_env(:vintage_net, :persistence_dir)
+    File.mkdir_p!(persistence_dir)
+    File.write!(Path.join(persistence_dir, ".snapshot"), "")
+
+    FlatFile.save("eth0", @config)
+
+    assert ["eth0"] == FlatFile.enumerate()
+  end
 end
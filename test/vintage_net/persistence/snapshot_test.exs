@@ -0,0 +1,121 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Persistence.SnapshotTest do
+  use VintageNetTest.Case
+  import ExUnit.CaptureLog
+  alias VintageNet.Persistence.{FlatFile, Snapshot}
+
+  @config %{
+    type: VintageNetTest.TestTechnology,
+    ipv4: %{method: :dhcp},
+    hostname: "unit_test"
+  }
+
+  @config2 %{
+    type: VintageNetTest.TestTechnology,
+    ipv4: %{method: :static, address: {192, 168, 1, 2}, prefix_length: 24},
+    hostname: "unit_test"
+  }
+
+  setup do
+    persistence_dir = Application.get_env(:vintage_net, :persistence_dir)
+
+    if File.exists?(persistence_dir) do
+      File.ls!(persistence_dir)
+      |> Enum.map(&Path.join(persistence_dir, &1))
+      |> Enum.each(&File.rm(&1))
+
+      assert File.ls!(persistence_dir) == []
+    end
+
+    %{snapshot_path: Path.join(persistence_dir, ".snapshot")}
+  end
+
+  test "saves and loads without the GenServer", context do
+    :ok = Snapshot.save("eth0", @config)
+    assert File.exists?(context.snapshot_path)
+
+    assert {:ok, @config} = Snapshot.load("eth0")
+    assert ["eth0"] == Snapshot.enumerate()
+
+    :ok = Snapshot.clear("eth0")
+    assert [] == Snapshot.enumerate()
+    assert {:error, _} = Snapshot.load("eth0")
+  end
+
+  test "load_all loads everything", context do
+    :ok = FlatFile.save("eth0", @config)
+    :ok = Snapshot.save("wlan0", @config2)
+    assert File.exists?(context.snapshot_path)
+
+    assert [{"eth0", {:ok, @config}}, {"wlan0", {:ok, @config2}}, {"usb0", {:error, _}}] =
+             Snapshot.load_all(["eth0", "wlan0", "usb0"])
+  end
+
+  test "saves are batched into one write", context do
+    start_supervised!(Snapshot)
+
+    :ok = Snapshot.save("eth0", @config)
+    :ok = Snapshot.save("wlan0", @config)
+    :ok = Snapshot.save("eth0", @config2)
+
+    # Pending saves are visible before they're written
+    refute File.exists?(context.snapshot_path)
+    assert ["eth0", "wlan0"] == Snapshot.enumerate()
+    assert {:ok, @config2} = Snapshot.load("eth0")
+
+    :ok = Snapshot.flush()
+    assert %{saves: 3, writes: 1} = Snapshot.stats()
+
+    stop_supervised!(Snapshot)
+    assert {:ok, @config2} = Snapshot.load("eth0")
+    assert {:ok, @config} = Snapshot.load("wlan0")
+  end
+
+  test "saves are written after a short delay", context do
+    start_supervised!(Snapshot)
+
+    :ok = Snapshot.save("eth0", @config)
+    Process.sleep(500)
+
+    assert File.exists?(context.snapshot_path)
+    assert %{saves: 1, writes: 1} = Snapshot.stats()
+  end
+
+  test "pending saves are written when stopped" do
+    start_supervised!(Snapshot)
+
+    :ok = Snapshot.save("eth0", @config)
+    stop_supervised!(Snapshot)
+
+    assert {:ok, @config} = Snapshot.load("eth0")
+  end
+
+  test "loads configurations saved by FlatFile" do
+    :ok = FlatFile.save("eth0", @config)
+    :ok = Snapshot.save("wlan0", @config2)
+
+    assert ["eth0", "wlan0"] == Snapshot.enumerate()
+    assert {:ok, @config} = Snapshot.load("eth0")
+
+    # Saving takes precedence over the old file and clearing removes both
+    :ok = Snapshot.save("eth0", @config2)
+    assert {:ok, @config2} = Snapshot.load("eth0")
+
+    :ok = Snapshot.clear("eth0")
+    assert ["wlan0"] == Snapshot.enumerate()
+    assert [] == FlatFile.enumerate()
+  end
+
+  test "corrupt snapshots are ignored", context do
+    File.mkdir_p!(Path.dirname(context.snapshot_path))
+    File.write!(context.snapshot_path, "garbage")
+
+    assert capture_log(fn ->
+             assert [] == Snapshot.enumerate()
+             assert {:error, _} = Snapshot.load("eth0")
+           end) =~ "corrupt"
+  end
+end
@@ -0,0 +1,200 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Resolver.DNSCacheTest do
+  use ExUnit.Case
+  import ExUnit.CaptureLog
+  alias VintageNet.Resolver.DNSCache
+
+  test "global name servers are first and then by interface priority" do
+    name_servers = [
+      %{address: {1, 1, 1, 1}, from: ["wlan0"]},
+      %{address: {8, 8, 8, 8}, from: [:global]},
+      %{address: {192, 168, 1, 1}, from: ["eth0", "wlan0"]},
+      %{address: {10, 0, 0, 1}, from: ["usb0"]}
+    ]
+
+    assert DNSCache.upstream_servers(name_servers, ["eth0", "wlan0"]) == [
+             {{8, 8, 8, 8}, ""},
+             {{192, 168, 1, 1}, "eth0"},
+             {{1, 1, 1, 1}, "wlan0"},
+             {{10, 0, 0, 1}, "usb0"}
+           ]
+  end
+
+  describe "with a stand-in name server" do
+    @describetag :requires_dns_cache
+
+    setup do
+      # Run the tests with the application stopped.
+      capture_log(fn ->
+        Application.stop(:vintage_net)
+      end)
+
+      start_supervised!({PropertyTable, name: VintageNet, tuple_events: true})
+      on_exit(fn -> Application.start(:vintage_net) end)
+
+      # The test process answers queries sent to the name server socket
+      {:ok, server} = :gen_udp.open(0, [:binary, ip: {127, 0, 0, 1}, active: true])
+      {:ok, upstream_port} = :inet.port(server)
+      {:ok, client} = :gen_udp.open(0, [:binary, active: false])
+      listen_port = free_udp_port()
+
+      PropertyTable.put(VintageNet, ["name_servers"], [
+        %{address: {127, 0, 0, 1}, from: [:global]}
+      ])
+
+      start_supervised!(
+        {DNSCache,
+         dns_cache: true, dns_cache_port: listen_port, dns_cache_upstream_port: upstream_port}
+      )
+
+      %{server: server, client: client, listen_port: listen_port}
+    end
+
+    test "answers come from the cache", context do
+      send_query(context, 1, "example.com")
+      answer_upstream(context, :a)
+      assert {1, 0, 1} = receive_answer(context)
+
+      send_query(context, 2, "Example.com")
+      refute_receive {:udp, _, _, _, _}
+      assert {2, 0, 1} = receive_answer(context)
+    end
+
+    test "negative answers are cached", context do
+      send_query(context, 1, "missing.example.com")
+      answer_upstream(context, :nxdomain)
+      assert {1, 3, 0} = receive_answer(context)
+
+      send_query(context, 2, "missing.example.com")
+      refute_receive {:udp, _, _, _, _}
+      assert {2, 3, 0} = receive_answer(context)
+    end
+
+    test "server failures aren't cached", context do
+      send_query(context, 1, "example.com")
+      answer_upstream(context, :servfail)
+      assert {1, 2, 0} = receive_answer(context)
+
+      send_query(context, 2, "example.com")
+      answer_upstream(context, :a)
+      assert {2, 0, 1} = receive_answer(context)
+    end
+
+    test "query types are part of the cache key", context do
+      # 65 and 97 are "A" and "a", so they can't be lowercased with the name
+      send_query(context, 1, "example.com", 65)
+      answer_upstream(context, :a)
+      assert {1, 0, 1} = receive_answer(context)
+
+      send_query(context, 2, "example.com", 97)
+      answer_upstream(context, :nxdomain)
+      assert {2, 3, 0} = receive_answer(context)
+    end
+
+    test "each query comes from a new source port", context do
+      send_query(context, 1, "one.example.com")
+      port1 = answer_upstream(context, :a)
+      assert {1, 0, 1} = receive_answer(context)
+
+      send_query(context, 2, "two.example.com")
+      port2 = answer_upstream(context, :a)
+      assert {2, 0, 1} = receive_answer(context)
+
+      assert port1 != port2
+    end
+
+    test "keeps running if it can't listen", context do
+      stop_supervised!(DNSCache)
+
+      # Take the listen port so that dns_cache exits
+      {:ok, socket} = wait_for_port(context.listen_port)
+
+      log =
+        capture_log(fn ->
+          start_supervised!(
+            {DNSCache,
+             dns_cache: true,
+             dns_cache_port: context.listen_port,
+             dns_cache_upstream_port: context.listen_port}
+          )
+
+          Process.sleep(200)
+          refute DNSCache.running?()
+        end)
+
+      assert log =~ "dns_cache exited"
+      :gen_udp.close(socket)
+    end
+
+    test "queries fail without name servers", context do
+      PropertyTable.put(VintageNet, ["name_servers"], [])
+      _ = :sys.get_state(DNSCache)
+
+      send_query(context, 1, "example.com")
+      refute_receive {:udp, _, _, _, _}
+      assert {1, 2, 0} = receive_answer(context)
+    end
+  end
+
+  defp free_udp_port() do
+    {:ok, socket} = :gen_udp.open(0, ip: {127, 0, 0, 1})
+    {:ok, port} = :inet.port(socket)
+    :gen_udp.close(socket)
+    port
+  end
+
+  # The port closes its socket shortly after it's stopped
+  defp wait_for_port(port, tries \\ 20) do
+    case :gen_udp.open(port, ip: {127, 0, 0, 1}) do
+      {:error, :eaddrinuse} when tries > 0 ->
+        Process.sleep(50)
+        wait_for_port(port, tries - 1)
+
+      result ->
+        result
+    end
+  end
+
+  defp send_query(context, id, name, type \\ 1) do
+    qname =
+      for label <- String.split(name, "."), into: <<>>, do: <<byte_size(label), label::binary>>
+
+    query = <<id::16, 1, 0, 1::16, 0::16, 0::16, 0::16, qname::binary, 0, type::16, 1::16>>
+    :ok = :gen_udp.send(context.client, {127, 0, 0, 1}, context.listen_port, query)
+  end
+
+  # Return the source port of the query
+  defp answer_upstream(context, kind) do
+    assert_receive {:udp, _socket, ip, port,
+                    <<id::16, _flags::16, 1::16, 0::16, 0::16, _ar::16, question::binary>>}
+
+    response =
+      case kind do
+        :a ->
+          <<id::16, 0x81, 0x80, 1::16, 1::16, 0::16, 0::16, question::binary, 0xC0, 12, 1::16,
+            1::16, 300::32, 4::16, 10, 0, 0, 1>>
+
+        :nxdomain ->
+          soa = <<2, "ns", 0, 5, "admin", 0, 1::32, 2::32, 3::32, 4::32, 60::32>>
+
+          <<id::16, 0x81, 0x83, 1::16, 0::16, 1::16, 0::16, question::binary, 0xC0, 12, 6::16,
+            1::16, 600::32, byte_size(soa)::16, soa::binary>>
+
+        :servfail ->
+          <<id::16, 0x81, 0x82, 1::16, 0::16, 0::16, 0::16, question::binary>>
+      end
+
+    :ok = :gen_udp.send(context.server, ip, port, response)
+    port
+  end
+
+  # Return the ID, rcode and answer count
+  defp receive_answer(context) do
+    {:ok, {_ip, _port, response}} = :gen_udp.recv(context.client, 0, 2000)
+    <<id::16, _flags, _ra::4, rcode::4, 1::16, answers::16, _rest::binary>> = response
+    {id, rcode, answers}
+  end
+end
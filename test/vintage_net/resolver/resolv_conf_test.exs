@@ -178,4 +178,21 @@ defmodule VintageNet.Resolver.ResolvConfTest do
 
     assert ResolvConf.to_name_server_list(input, additional_name_servers) == output
   end
+
+  test "dns cache config only lists the local name server" do
+    input = %{
+      "eth0" => %{domain: "example.com", name_servers: [{1, 1, 1, 1}, {8, 8, 8, 8}]},
+      "wlan0" => %{domain: "example2.com", name_servers: [{1, 1, 1, 2}]}
+    }
+
+    output = """
+    # This file is managed by VintageNet. Do not edit.
+
+    search example.com # From eth0
+    search example2.com # From wlan0
+    nameserver 127.0.0.1 # From dns_cache
+    """
+
+    assert input |> ResolvConf.to_dns_cache_config() |> IO.chardata_to_string() == output
+  end
 end
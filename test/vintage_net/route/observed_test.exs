@@ -0,0 +1,104 @@
+# SPDX-FileCopyrightText: 2026 Frank Hunleth
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+defmodule VintageNet.Route.ObservedTest do
+  use ExUnit.Case
+
+  alias VintageNet.Route.Observed
+
+  test "default routes" do
+    report = %{
+      family: :inet,
+      table: 254,
+      dst_len: 0,
+      scope: :universe,
+      type: :unicast,
+      protocol: 3,
+      gateway: {192, 168, 1, 1},
+      oif: 2,
+      priority: 10
+    }
+
+    assert Observed.route_entry(report, "eth0") ==
+             {:default_route, "eth0", {192, 168, 1, 1}, 10, :main}
+
+    assert Observed.route_entry(%{report | table: 100} |> Map.delete(:priority), "eth0") ==
+             {:default_route, "eth0", {192, 168, 1, 1}, 0, 100}
+
+    assert Observed.route_entry(Map.delete(report, :gateway), "ppp0") ==
+             {:default_route, "ppp0", nil, 10, :main}
+  end
+
+  test "local routes" do
+    report = %{
+      family: :inet,
+      table: 254,
+      dst_len: 24,
+      scope: :link,
+      type: :unicast,
+      protocol: 2,
+      dst: {192, 168, 1, 0},
+      prefsrc: {192, 168, 1, 50},
+      oif: 2
+    }
+
+    assert Observed.route_entry(report, "eth0") ==
+             {:local_route, "eth0", {192, 168, 1, 50}, 24, 0, :main}
+  end
+
+  test "ignored routes" do
+    ipv6_report = %{
+      family: :inet6,
+      table: 254,
+      dst_len: 64,
+      scope: :universe,
+      type: :unicast,
+      protocol: 2,
+      dst: {65152, 0, 0, 0, 0, 0, 0, 0},
+      oif: 2,
+      priority: 256
+    }
+
+    assert Observed.route_entry(ipv6_report, "eth0") == nil
+
+    unreachable_report = %{
+      family: :inet,
+      table: 254,
+      dst_len: 0,
+      scope: :universe,
+      type: :unreachable,
+      protocol: 3
+    }
+
+    assert Observed.route_entry(unreachable_report, "eth0") == nil
+    assert Observed.route_entry(%{family: :inet, dst_len: 0, type: :unicast}, nil) == nil
+  end
+
+  test "rules" do
+    report = %{
+      family: :inet,
+      table: 100,
+      action: 1,
+      src_len: 32,
+      dst_len: 0,
+      src: {192, 168, 1, 50},
+      priority: 32765
+    }
+
+    assert Observed.rule_entry(report) == {:rule, 100, {192, 168, 1, 50}}
+
+    default_rule = %{family: :inet, table: 254, action: 1, src_len: 0, dst_len: 0}
+    assert Observed.rule_entry(default_rule) == nil
+  end
+
+  test "applying changes" do
+    entry = {:rule, 100, {192, 168, 1, 50}}
+
+    observed = Observed.apply_changes(MapSet.new(), [{:add, entry}])
+    assert MapSet.member?(observed, entry)
+
+    observed = Observed.apply_changes(observed, [{:del, entry}, {:add, entry}, {:del, entry}])
+    assert observed == MapSet.new()
+  end
+end